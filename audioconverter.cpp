@@ -1,7 +1,15 @@
 #include "audioconverter.h"
+#include "dspkernels.h"
+#include "flacdecoder.h"
+#include "logging.h"
+#include "parallelflacdecoder.h"
+#include "resampler.h"
 #include <QDebug>
 #include <QFile>
+#include <QThread>
+#include <cstring>
 #include<memory>
+#include <vector>
 
 //helper for managing AVFrame pointers with unique_ptr
 
@@ -13,11 +21,191 @@ namespace {
     };
 
     using FramePtr = std::unique_ptr<AVFrame, AvFrameDeleter>;
+
+    // MPEG-1/2/2.5 layer III rates. Anything else (88.2 kHz and up, mostly) is resampled to
+    // the member of its family, 44.1 kHz multiples to 44.1 and the rest to 48
+    int mp3SampleRate(int inputRate)
+    {
+        static const int Supported[] = {48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000};
+        for (int rate : Supported) {
+            if (rate == inputRate) {
+                return rate;
+            }
+        }
+        return inputRate % 11025 == 0 ? 44100 : 48000;
+    }
+
+    // Same rate and layout into planar float is only a sample format change, which the Dsp
+    // kernels do without going through swresample
+    bool isFormatOnly(const AVCodecContext *in, const AVCodecContext *out)
+    {
+        if (in->sample_rate != out->sample_rate || out->sample_fmt != AV_SAMPLE_FMT_FLTP
+            || av_channel_layout_compare(&in->ch_layout, &out->ch_layout) != 0) {
+            return false;
+        }
+        switch (in->sample_fmt) {
+            case AV_SAMPLE_FMT_S16:
+            case AV_SAMPLE_FMT_S16P:
+            case AV_SAMPLE_FMT_S32:
+            case AV_SAMPLE_FMT_S32P:
+            case AV_SAMPLE_FMT_FLT:
+            case AV_SAMPLE_FMT_FLTP:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    //converts in into the FLTP buffers of out, both nb_samples long. packed input goes through
+    //scratch and is split into planes afterwards
+    int convertFormatOnly(const AVFrame *in, AVFrame *out, std::vector<float> &scratch)
+    {
+        const int channels = in->ch_layout.nb_channels;
+        const size_t frames = size_t(in->nb_samples);
+        float *const *planes = reinterpret_cast<float *const *>(out->extended_data);
+        const AVSampleFormat format = static_cast<AVSampleFormat>(in->format);
+
+        if (av_sample_fmt_is_planar(format)) {
+            for (int ch = 0; ch < channels; ++ch) {
+                const uint8_t *src = in->extended_data[ch];
+                if (format == AV_SAMPLE_FMT_S16P) {
+                    Dsp::int16ToFloat(reinterpret_cast<const int16_t *>(src), planes[ch], frames);
+                } else if (format == AV_SAMPLE_FMT_S32P) {
+                    Dsp::int32ToFloat(reinterpret_cast<const int32_t *>(src), planes[ch], frames);
+                } else {
+                    memcpy(planes[ch], src, frames * sizeof(float));
+                }
+            }
+            return in->nb_samples;
+        }
+
+        const size_t samples = frames * size_t(channels);
+        const float *packed = reinterpret_cast<const float *>(in->data[0]);
+        if (format != AV_SAMPLE_FMT_FLT) {
+            scratch.resize(samples);
+            if (format == AV_SAMPLE_FMT_S16) {
+                Dsp::int16ToFloat(reinterpret_cast<const int16_t *>(in->data[0]), scratch.data(), samples);
+            } else {
+                Dsp::int32ToFloat(reinterpret_cast<const int32_t *>(in->data[0]), scratch.data(), samples);
+            }
+            packed = scratch.data();
+        }
+        Dsp::deinterleave(packed, channels, frames, planes);
+        return in->nb_samples;
+    }
+
+    //the native FLAC decoder covers the stream and libavcodec picked the planar format it can fill
+    bool setupNativeFlac(const AVCodecContext *ctx, FlacFrameDecoder *decoder)
+    {
+        if (ctx->codec_id != AV_CODEC_ID_FLAC || !ctx->extradata) {
+            return false;
+        }
+        // Bare STREAMINFO from the FLAC demuxer, some containers keep the "fLaC" marker and block header
+        const uchar *info = ctx->extradata;
+        qsizetype size = ctx->extradata_size;
+        if (size >= 42 && memcmp(info, "fLaC", 4) == 0) {
+            info += 8;
+            size -= 8;
+        }
+        if (!decoder->setStreamInfo(info, size) || decoder->bitsPerSample() > FlacFrameDecoder::MaxBitsPerSample
+            || decoder->channels() != ctx->ch_layout.nb_channels) {
+            return false;
+        }
+        return ctx->sample_fmt == (decoder->bitsPerSample() <= 16 ? AV_SAMPLE_FMT_S16P : AV_SAMPLE_FMT_S32P);
+    }
+
+    //decodes one packet (a whole frame, FFmpeg's FLAC parser splits them) into frame the way
+    //libavcodec would: S16P, or S32P left-justified. false leaves the packet to libavcodec
+    bool decodeFlacPacket(FlacFrameDecoder &decoder, const AVPacket *packet, const AVCodecContext *ctx,
+                          AVFrame *frame, std::vector<std::vector<int32_t>> &scratch)
+    {
+        const int capacity = decoder.maxBlockSize();
+        const int channels = ctx->ch_layout.nb_channels;
+        const bool wide = ctx->sample_fmt == AV_SAMPLE_FMT_S32P;
+        frame->format = ctx->sample_fmt;
+        frame->sample_rate = ctx->sample_rate;
+        frame->nb_samples = capacity;
+        if (av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout) < 0 || av_frame_get_buffer(frame, 0) < 0) {
+            av_frame_unref(frame);
+            return false;
+        }
+
+        // 24-bit is decoded straight into the frame and shifted up in place, 16-bit needs narrowing
+        int32_t *planes[FlacFrameDecoder::MaxChannels];
+        if (!wide) {
+            scratch.resize(size_t(channels));
+        }
+        for (int ch = 0; ch < channels; ++ch) {
+            if (wide) {
+                planes[ch] = reinterpret_cast<int32_t *>(frame->extended_data[ch]);
+            } else {
+                scratch[size_t(ch)].resize(size_t(capacity));
+                planes[ch] = scratch[size_t(ch)].data();
+            }
+        }
+
+        FlacFrameDecoder::Frame info;
+        if (decoder.decodeFrame(packet->data, packet->size, planes, capacity, &info) != FlacFrameDecoder::Ok
+            || info.bitsPerSample != decoder.bitsPerSample()) {
+            av_frame_unref(frame);
+            return false;
+        }
+        const int shift = (wide ? 32 : 16) - info.bitsPerSample;
+        for (int ch = 0; ch < channels; ++ch) {
+            if (wide) {
+                uint32_t *samples = reinterpret_cast<uint32_t *>(planes[ch]);
+                for (int i = 0; i < info.blockSize; ++i) {
+                    samples[i] <<= shift;
+                }
+            } else {
+                int16_t *out = reinterpret_cast<int16_t *>(frame->extended_data[ch]);
+                for (int i = 0; i < info.blockSize; ++i) {
+                    out[i] = int16_t(planes[ch][i] << shift);
+                }
+            }
+        }
+        frame->nb_samples = info.blockSize;
+        return true;
+    }
+
+    //samples [offset, offset + count) of the parallel decoder's chunk as a frame in the same
+    //format decodeFlacPacket gives
+    bool fillFlacFrame(const int32_t *const *planes, int offset, int count, int bitsPerSample,
+                       const AVCodecContext *ctx, AVFrame *frame)
+    {
+        const int channels = ctx->ch_layout.nb_channels;
+        const bool wide = ctx->sample_fmt == AV_SAMPLE_FMT_S32P;
+        frame->format = ctx->sample_fmt;
+        frame->sample_rate = ctx->sample_rate;
+        frame->nb_samples = count;
+        if (av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout) < 0 || av_frame_get_buffer(frame, 0) < 0) {
+            av_frame_unref(frame);
+            return false;
+        }
+        const int shift = (wide ? 32 : 16) - bitsPerSample;
+        for (int ch = 0; ch < channels; ++ch) {
+            const int32_t *in = planes[ch] + offset;
+            if (wide) {
+                int32_t *out = reinterpret_cast<int32_t *>(frame->extended_data[ch]);
+                for (int i = 0; i < count; ++i) {
+                    out[i] = int32_t(uint32_t(in[i]) << shift);
+                }
+            } else {
+                int16_t *out = reinterpret_cast<int16_t *>(frame->extended_data[ch]);
+                for (int i = 0; i < count; ++i) {
+                    out[i] = int16_t(in[i] << shift);
+                }
+            }
+        }
+        return true;
+    }
 }
 
 AudioConverter::AudioConverter(QObject *parent)
     : QObject(parent)
     , m_cancelled(false)
+    , m_resamplerProfile(ResamplerProfile::Balanced)
+    , m_decodeThreads(QThread::idealThreadCount())
 {
 }
 
@@ -98,13 +286,13 @@ void AudioConverter::convertToMP3(const QString &inputPath, const QString &outpu
         }
 
         outputCodecCtx->bit_rate = bitrate;
-        outputCodecCtx->sample_rate = inputCodecCtx->sample_rate;
+        outputCodecCtx->sample_rate = mp3SampleRate(inputCodecCtx->sample_rate);
         av_channel_layout_copy(&outputCodecCtx->ch_layout, &inputCodecCtx->ch_layout);
         
         // Get supported sample format (use first supported format)
         outputCodecCtx->sample_fmt = AV_SAMPLE_FMT_FLTP; // MP3 typically uses floating-point planar
         
-        outputStream->time_base = AVRational{1, inputCodecCtx->sample_rate};
+        outputStream->time_base = AVRational{1, outputCodecCtx->sample_rate};
 
         if (outputFormatCtx->oformat->flags & AVFMT_GLOBALHEADER) {
             outputCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
@@ -160,6 +348,7 @@ void AudioConverter::convertToMP3(const QString &inputPath, const QString &outpu
     if (inputFormatCtx) {
         avformat_close_input(&inputFormatCtx);
     }
+    m_input.close();
     if (outputFormatCtx) {
         if (!(outputFormatCtx->oformat->flags & AVFMT_NOFILE)) {
             avio_closep(&outputFormatCtx->pb);
@@ -177,7 +366,8 @@ void AudioConverter::cancel()
 
 bool AudioConverter::openInputFile(const QString &inputPath, AVFormatContext **inputFormatCtx)
 {
-    if (avformat_open_input(inputFormatCtx, inputPath.toUtf8().constData(), nullptr, nullptr) < 0) {
+    if (!m_input.open(inputPath) || !m_input.openFormat(inputFormatCtx)) {
+        qCWarning(lcConvert) << "AUDIO CONVERTER:" << m_input.lastError() << inputPath;
         return false;
     }
 
@@ -230,24 +420,26 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
         return false;
     }
 
-    // Setup resampler
-    swr_alloc_set_opts2(&swrCtx,
-                        &outputCodecCtx->ch_layout,
-                        outputCodecCtx->sample_fmt,
-                        outputCodecCtx->sample_rate,
-                        &inputCodecCtx->ch_layout,
-                        inputCodecCtx->sample_fmt,
-                        inputCodecCtx->sample_rate,
-                        0, nullptr);
-
-    if (!swrCtx || swr_init(swrCtx) < 0) {
-        // Cleanup allocated resources
-        av_frame_free(&inputFrame);
-        av_frame_free(&outputFrame);
-        av_packet_free(&inputPacket);
-        av_packet_free(&outputPacket);
-        if (swrCtx) swr_free(&swrCtx);
-        return false;
+    // Setup resampler, unless there is nothing to resample or remix
+    const bool formatOnly = isFormatOnly(inputCodecCtx, outputCodecCtx);
+    std::vector<float> scratch;
+    if (!formatOnly) {
+        swrCtx = Resampler::acquire(&outputCodecCtx->ch_layout,
+                                    outputCodecCtx->sample_fmt,
+                                    outputCodecCtx->sample_rate,
+                                    &inputCodecCtx->ch_layout,
+                                    inputCodecCtx->sample_fmt,
+                                    inputCodecCtx->sample_rate,
+                                    m_resamplerProfile);
+
+        if (!swrCtx) {
+            // Cleanup allocated resources
+            av_frame_free(&inputFrame);
+            av_frame_free(&outputFrame);
+            av_packet_free(&inputPacket);
+            av_packet_free(&outputPacket);
+            return false;
+        }
     }
 
     // Create audio FIFO buffer to handle variable frame sizes
@@ -259,7 +451,7 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
         av_frame_free(&outputFrame);
         av_packet_free(&inputPacket);
         av_packet_free(&outputPacket);
-        swr_free(&swrCtx);
+        Resampler::release(swrCtx);
         return false;
     }
 
@@ -273,24 +465,75 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
     int frameCount = 0;
     int encodedPacketCount = 0;
 
-    while (av_read_frame(inputFormatCtx, inputPacket) >= 0) {
-        packetCount++;
-        if (m_cancelled) {
-            av_packet_unref(inputPacket);
-            break;
-        }
+    // FLAC up to 24 bits skips libavcodec, its frames come out in the same format either way
+    FlacFrameDecoder flacDecoder;
+    const bool nativeFlac = setupNativeFlac(inputCodecCtx, &flacDecoder);
+    std::vector<std::vector<int32_t>> flacScratch;
+    int nativeFrames = 0;
+
+    // With cores to spare the whole file is decoded frame-parallel instead of packet by packet,
+    // and block-sized frames are cut back out of its chunks. the demuxer isn't read at all then
+    ParallelFlacDecoder parallelFlac;
+    const bool parallel = nativeFlac && m_decodeThreads > 1
+        && parallelFlac.open(m_input.filePath(), m_decodeThreads)
+        && parallelFlac.bitsPerSample() == flacDecoder.bitsPerSample();
+    int chunkFrames = 0;
+    int chunkOffset = 0;
+    bool parallelFailed = false;
+
+    for (;;) {
+        bool nativeFrame = false;
+        if (parallel) {
+            if (m_cancelled) {
+                break;
+            }
+            if (chunkOffset == chunkFrames) {
+                chunkFrames = parallelFlac.next();
+                chunkOffset = 0;
+                if (chunkFrames <= 0) {
+                    parallelFailed = chunkFrames < 0;
+                    break;
+                }
+            }
+            const int count = qMin(flacDecoder.maxBlockSize(), chunkFrames - chunkOffset);
+            if (!fillFlacFrame(parallelFlac.planes(), chunkOffset, count, parallelFlac.bitsPerSample(),
+                               inputCodecCtx, inputFrame)) {
+                parallelFailed = true;
+                break;
+            }
+            chunkOffset += count;
+            nativeFrame = true;
+            nativeFrames++;
+        } else {
+            if (av_read_frame(inputFormatCtx, inputPacket) < 0) {
+                break;
+            }
+            packetCount++;
+            if (m_cancelled) {
+                av_packet_unref(inputPacket);
+                break;
+            }
 
-        if (inputPacket->stream_index != audioStreamIndex) {
-            av_packet_unref(inputPacket);
-            continue;
-        }
+            if (inputPacket->stream_index != audioStreamIndex) {
+                av_packet_unref(inputPacket);
+                continue;
+            }
 
-        if (avcodec_send_packet(inputCodecCtx, inputPacket) < 0) {
-            av_packet_unref(inputPacket);
-            continue;
+            // A packet the native decoder turns down goes through libavcodec, FLAC frames don't
+            // depend on each other so the two can take turns
+            nativeFrame = nativeFlac
+                && decodeFlacPacket(flacDecoder, inputPacket, inputCodecCtx, inputFrame, flacScratch);
+            if (!nativeFrame && avcodec_send_packet(inputCodecCtx, inputPacket) < 0) {
+                av_packet_unref(inputPacket);
+                continue;
+            }
+            if (nativeFrame) {
+                nativeFrames++;
+            }
         }
 
-        while (avcodec_receive_frame(inputCodecCtx, inputFrame) >= 0) {
+        while (nativeFrame || avcodec_receive_frame(inputCodecCtx, inputFrame) >= 0) {
+            nativeFrame = false;
             frameCount++;
             
             if (m_cancelled) {
@@ -302,7 +545,7 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
             av_frame_unref(outputFrame);
 
             // Calculate required output samples
-            int dst_nb_samples = av_rescale_rnd(
+            int dst_nb_samples = formatOnly ? inputFrame->nb_samples : av_rescale_rnd(
                 swr_get_delay(swrCtx, inputCodecCtx->sample_rate) + inputFrame->nb_samples,
                 outputCodecCtx->sample_rate,
                 inputCodecCtx->sample_rate,
@@ -320,9 +563,11 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
             }
 
             // Convert/resample audio
-            int frame_count = swr_convert(swrCtx,
-                                          outputFrame->data, outputFrame->nb_samples,
-                                          (const uint8_t **)inputFrame->data, inputFrame->nb_samples);
+            int frame_count = formatOnly
+                ? convertFormatOnly(inputFrame, outputFrame, scratch)
+                : swr_convert(swrCtx,
+                              outputFrame->data, outputFrame->nb_samples,
+                              (const uint8_t **)inputFrame->data, inputFrame->nb_samples);
 
             av_frame_unref(inputFrame);
 
@@ -398,7 +643,13 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
             }
 
             // Update progress
-            if (totalDuration > 0) {
+            if (parallel) {
+                if (parallelFlac.totalSamples() > 0) {
+                    int percentage = int((parallelFlac.chunkFirstSample() + chunkOffset) * 100
+                                         / parallelFlac.totalSamples());
+                    emit progressUpdated(qBound(0, percentage, 100));
+                }
+            } else if (totalDuration > 0) {
                 int percentage = (inputPacket->pts * 100) / totalDuration;
                 emit progressUpdated(qBound(0, percentage, 100));
             }
@@ -413,7 +664,7 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
         while (avcodec_receive_frame(inputCodecCtx, inputFrame) >= 0) {
             av_frame_unref(outputFrame);
             
-            int dst_nb_samples = av_rescale_rnd(
+            int dst_nb_samples = formatOnly ? inputFrame->nb_samples : av_rescale_rnd(
                 swr_get_delay(swrCtx, inputCodecCtx->sample_rate) + inputFrame->nb_samples,
                 outputCodecCtx->sample_rate,
                 inputCodecCtx->sample_rate,
@@ -425,10 +676,12 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
             outputFrame->nb_samples = dst_nb_samples;
 
             if (av_frame_get_buffer(outputFrame, 0) >= 0) {
-                int frame_count = swr_convert(swrCtx,
-                                              outputFrame->data, outputFrame->nb_samples,
-                                              (const uint8_t **)inputFrame->data, inputFrame->nb_samples);
-                
+                int frame_count = formatOnly
+                    ? convertFormatOnly(inputFrame, outputFrame, scratch)
+                    : swr_convert(swrCtx,
+                                  outputFrame->data, outputFrame->nb_samples,
+                                  (const uint8_t **)inputFrame->data, inputFrame->nb_samples);
+
                 if (frame_count > 0) {
                     outputFrame->nb_samples = frame_count;
                     // Add to FIFO
@@ -438,8 +691,8 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
             av_frame_unref(inputFrame);
         }
 
-        // Flush resampler - get buffered samples
-        while (true) {
+        // Flush resampler - get buffered samples, the direct conversion holds none back
+        while (swrCtx) {
             av_frame_unref(outputFrame);
             outputFrame->format = outputCodecCtx->sample_fmt;
             av_channel_layout_copy(&outputFrame->ch_layout, &outputCodecCtx->ch_layout);
@@ -508,6 +761,14 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
         }
     }
 
+    if (nativeFlac) {
+        qCDebug(lcConvert) << "AUDIO CONVERTER:" << nativeFrames << "of" << frameCount << "frames decoded natively"
+                           << (parallel ? QString("on %1 threads").arg(parallelFlac.threads()) : QString());
+    }
+    if (parallelFailed) {
+        qCWarning(lcConvert) << "AUDIO CONVERTER: parallel FLAC decode failed:" << parallelFlac.lastError();
+    }
+
     // Cleanup
     if (fifo) {
         av_audio_fifo_free(fifo);
@@ -516,10 +777,10 @@ bool AudioConverter::convertAudio(AVFormatContext *inputFormatCtx, AVFormatConte
     av_frame_free(&outputFrame);
     av_packet_free(&inputPacket);
     av_packet_free(&outputPacket);
-    swr_free(&swrCtx);
+    Resampler::release(swrCtx);
 
     emit progressUpdated(100);
-    return !m_cancelled;
+    return !m_cancelled && !parallelFailed;
 }
 
 //qatomic integer for cancellation flag
@@ -570,12 +831,14 @@ void AudioConverter::copyMetadata(AVFormatContext *inputFormatCtx, AVFormatConte
 
 // Worker implementation
 AudioConverterWorker::AudioConverterWorker(const QString &inputPath, const QString &outputPath,
-                                           AudioConverter::BitratePreset bitrate)
+                                           AudioConverter::BitratePreset bitrate,
+                                           ResamplerProfile profile)
     : m_inputPath(inputPath)
     , m_outputPath(outputPath)
     , m_bitrate(bitrate)
     , m_converter(new AudioConverter(this))
 {
+    m_converter->setResamplerProfile(profile);
     connect(m_converter, &AudioConverter::progressUpdated, this, &AudioConverterWorker::progressUpdated);
     connect(m_converter, &AudioConverter::conversionComplete, this, &AudioConverterWorker::finished);
 }
@@ -5,6 +5,8 @@
 #include <QString>
 #include <QThread>
 #include <QAtomicInteger>
+#include "resampler.h"
+#include "mappedinput.h"
 
 extern "C" {
 #include <libavformat/avformat.h>
@@ -37,6 +39,11 @@ public:
     void convertToMP3(const QString &inputPath, const QString &outputPath, BitratePreset bitrate);
     void cancel();
 
+    //only used when the source rate has no MP3 equivalent (88.2 kHz and up)
+    void setResamplerProfile(ResamplerProfile profile) { m_resamplerProfile = profile; }
+    //cores a FLAC input is decoded on, 1 decodes packet by packet as it is demuxed
+    void setDecodeThreads(int threads) { m_decodeThreads = qMax(1, threads); }
+
 signals:
     void progressUpdated(int percentage);
     void conversionComplete(bool success, const QString &message);
@@ -44,6 +51,9 @@ signals:
 
 private:
     bool m_cancelled;
+    ResamplerProfile m_resamplerProfile;
+    int m_decodeThreads;
+    MappedInput m_input;
     
     bool openInputFile(const QString &inputPath, AVFormatContext **inputFormatCtx);
     bool openOutputFile(const QString &outputPath, AVFormatContext **outputFormatCtx, 
@@ -59,7 +69,8 @@ class AudioConverterWorker : public QObject
 
 public:
     AudioConverterWorker(const QString &inputPath, const QString &outputPath, 
-                         AudioConverter::BitratePreset bitrate);
+                         AudioConverter::BitratePreset bitrate,
+                         ResamplerProfile profile = ResamplerProfile::Balanced);
 
 public slots:
     void process();
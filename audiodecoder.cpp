@@ -0,0 +1,329 @@
+#include "audiodecoder.h"
+#include "flacseeker.h"
+#include "logging.h"
+#include <QElapsedTimer>
+
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+AudioDecoder::AudioDecoder()
+{
+}
+
+AudioDecoder::~AudioDecoder()
+{
+    close();
+}
+
+bool AudioDecoder::open(const QString &filePath, bool strict)
+{
+    close();
+
+    if (!m_input.open(filePath) || !m_input.openFormat(&m_formatCtx)) {
+        m_lastError = m_input.lastError();
+        m_input.close();
+        return false;
+    }
+
+    if (avformat_find_stream_info(m_formatCtx, nullptr) < 0) {
+        m_lastError = "Failed to read stream info";
+        close();
+        return false;
+    }
+
+    const AVCodec *codec = nullptr;
+    m_streamIndex = av_find_best_stream(m_formatCtx, AVMEDIA_TYPE_AUDIO, -1, -1, &codec, 0);
+    if (m_streamIndex < 0 || !codec) {
+        m_lastError = "No audio stream found";
+        close();
+        return false;
+    }
+
+    m_codecCtx = avcodec_alloc_context3(codec);
+    if (!m_codecCtx) {
+        m_lastError = "Failed to allocate codec context";
+        close();
+        return false;
+    }
+
+    if (avcodec_parameters_to_context(m_codecCtx, m_formatCtx->streams[m_streamIndex]->codecpar) < 0) {
+        m_lastError = "Failed to copy codec parameters";
+        close();
+        return false;
+    }
+
+    // Callers run one decoder per file on their own threads, so keep the codec single-threaded
+    m_codecCtx->thread_count = 1;
+    if (strict) {
+        m_codecCtx->err_recognition |= AV_EF_CRCCHECK | AV_EF_BITSTREAM | AV_EF_EXPLODE;
+    }
+
+    if (avcodec_open2(m_codecCtx, codec, nullptr) < 0) {
+        m_lastError = "Failed to open decoder";
+        close();
+        return false;
+    }
+
+    m_packet = av_packet_alloc();
+    m_frame = av_frame_alloc();
+    if (!m_packet || !m_frame) {
+        m_lastError = "Failed to allocate frames/packets";
+        close();
+        return false;
+    }
+
+    m_filePath = filePath;
+    m_lastError.clear();
+    return true;
+}
+
+void AudioDecoder::close()
+{
+    if (m_frame) {
+        av_frame_free(&m_frame);
+    }
+    if (m_packet) {
+        av_packet_free(&m_packet);
+    }
+    if (m_codecCtx) {
+        avcodec_free_context(&m_codecCtx);
+    }
+    if (m_formatCtx) {
+        avformat_close_input(&m_formatCtx);
+    }
+    m_input.close();
+    m_streamIndex = -1;
+    m_flacSeeker.reset();
+    m_flacSeekerFailed = false;
+    m_sampleCursor = -1;
+    m_cursorFrameStart = -1;
+    m_flushing = false;
+    m_atEnd = false;
+    m_readError = false;
+    m_decodeErrors = 0;
+}
+
+AVFrame *AudioDecoder::decodeNextFrame()
+{
+    if (!m_codecCtx || m_atEnd) {
+        return nullptr;
+    }
+
+    while (true) {
+        int ret = avcodec_receive_frame(m_codecCtx, m_frame);
+        if (ret >= 0) {
+            if (m_sampleCursor >= 0) {
+                m_cursorFrameStart = m_sampleCursor;
+                m_sampleCursor += m_frame->nb_samples;
+            }
+            return m_frame;
+        }
+        if (ret == AVERROR_EOF) {
+            m_atEnd = true;
+            return nullptr;
+        }
+        if (ret != AVERROR(EAGAIN)) {
+            // Damaged frame, keep going so the caller sees everything that is still decodable
+            ++m_decodeErrors;
+            m_lastError = "Decoder rejected a frame";
+            continue;
+        }
+
+        if (m_flushing) {
+            m_atEnd = true;
+            return nullptr;
+        }
+
+        // Decoder wants more input
+        ret = av_read_frame(m_formatCtx, m_packet);
+        if (ret < 0) {
+            if (ret != AVERROR_EOF) {
+                m_readError = true;
+                m_lastError = "Read error before end of file";
+            }
+            avcodec_send_packet(m_codecCtx, nullptr);
+            m_flushing = true;
+            continue;
+        }
+
+        if (m_packet->stream_index != m_streamIndex) {
+            av_packet_unref(m_packet);
+            continue;
+        }
+
+        ret = avcodec_send_packet(m_codecCtx, m_packet);
+        av_packet_unref(m_packet);
+        if (ret < 0 && ret != AVERROR(EAGAIN)) {
+            ++m_decodeErrors;
+            m_lastError = "Decoder rejected a packet";
+        }
+    }
+}
+
+bool AudioDecoder::seek(qint64 sample)
+{
+    if (!m_codecCtx || m_codecCtx->sample_rate <= 0) {
+        return false;
+    }
+
+    m_sampleCursor = -1;
+    m_cursorFrameStart = -1;
+    if (m_codecCtx->codec_id == AV_CODEC_ID_FLAC && seekFlacFrame(sample)) {
+        return true;
+    }
+
+    const AVStream *stream = m_formatCtx->streams[m_streamIndex];
+    qint64 timestamp = av_rescale_q(sample, AVRational{1, m_codecCtx->sample_rate}, stream->time_base);
+    if (stream->start_time != AV_NOPTS_VALUE) {
+        timestamp += stream->start_time;
+    }
+
+    if (av_seek_frame(m_formatCtx, m_streamIndex, timestamp, AVSEEK_FLAG_BACKWARD) < 0) {
+        m_lastError = "Seek failed";
+        return false;
+    }
+
+    avcodec_flush_buffers(m_codecCtx);
+    m_flushing = false;
+    m_atEnd = false;
+    return true;
+}
+
+//byte seek to the frame found by FlacSeeker. its first sample is known exactly, so frame
+//positions are counted from there rather than taken from the demuxer
+bool AudioDecoder::seekFlacFrame(qint64 sample)
+{
+    if (m_flacSeekerFailed) {
+        return false;
+    }
+    if (!m_flacSeeker) {
+        m_flacSeeker = std::make_unique<FlacSeeker>();
+        if (!m_flacSeeker->open(m_filePath)) {
+            qCDebug(lcPlayback) << "Frame seeking unavailable:" << m_flacSeeker->lastError();
+            m_flacSeeker.reset();
+            m_flacSeekerFailed = true;
+            return false;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    FlacFramePosition frame;
+    if (!m_flacSeeker->locate(sample, &frame)) {
+        return false;
+    }
+    if (av_seek_frame(m_formatCtx, -1, frame.offset, AVSEEK_FLAG_BYTE) < 0) {
+        return false;
+    }
+
+    avcodec_flush_buffers(m_codecCtx);
+    m_flushing = false;
+    m_atEnd = false;
+    m_sampleCursor = frame.sample;
+
+    const qint64 us = timer.nsecsElapsed() / 1000;
+    qCDebug(lcPlayback) << "FLAC seek to sample" << sample << "frame at" << frame.offset
+                        << m_flacSeeker->lastProbeCount() << "probes" << m_flacSeeker->lastBytesRead() << "bytes" << us << "us";
+    PerfLog::record("playback", "seek_locate", us, m_flacSeeker->lastBytesRead(), m_filePath);
+    return true;
+}
+
+qint64 AudioDecoder::frameStartSample(const AVFrame *frame) const
+{
+    if (frame == m_frame && m_cursorFrameStart >= 0) {
+        return m_cursorFrameStart;
+    }
+    if (!frame || !m_codecCtx || m_codecCtx->sample_rate <= 0 || frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+        return -1;
+    }
+
+    const AVStream *stream = m_formatCtx->streams[m_streamIndex];
+    qint64 timestamp = frame->best_effort_timestamp;
+    if (stream->start_time != AV_NOPTS_VALUE) {
+        timestamp -= stream->start_time;
+    }
+    return av_rescale_q(timestamp, stream->time_base, AVRational{1, m_codecCtx->sample_rate});
+}
+
+int AudioDecoder::sampleRate() const
+{
+    return m_codecCtx ? m_codecCtx->sample_rate : 0;
+}
+
+int AudioDecoder::channels() const
+{
+    return m_codecCtx ? m_codecCtx->ch_layout.nb_channels : 0;
+}
+
+int AudioDecoder::bitsPerSample() const
+{
+    if (!m_codecCtx) {
+        return 0;
+    }
+    if (m_codecCtx->bits_per_raw_sample > 0) {
+        return m_codecCtx->bits_per_raw_sample;
+    }
+    return av_get_bytes_per_sample(m_codecCtx->sample_fmt) * 8;
+}
+
+AVSampleFormat AudioDecoder::sampleFormat() const
+{
+    return m_codecCtx ? m_codecCtx->sample_fmt : AV_SAMPLE_FMT_NONE;
+}
+
+const AVChannelLayout *AudioDecoder::channelLayout() const
+{
+    return m_codecCtx ? &m_codecCtx->ch_layout : nullptr;
+}
+
+qint64 AudioDecoder::totalSamples() const
+{
+    if (!m_formatCtx || m_streamIndex < 0 || !m_codecCtx || m_codecCtx->sample_rate <= 0) {
+        return -1;
+    }
+
+    const AVStream *stream = m_formatCtx->streams[m_streamIndex];
+    if (stream->duration != AV_NOPTS_VALUE) {
+        return av_rescale_q(stream->duration, stream->time_base, AVRational{1, m_codecCtx->sample_rate});
+    }
+    if (m_formatCtx->duration != AV_NOPTS_VALUE) {
+        return av_rescale(m_formatCtx->duration, m_codecCtx->sample_rate, AV_TIME_BASE);
+    }
+    return -1;
+}
+
+AVCodecID AudioDecoder::codecId() const
+{
+    return m_codecCtx ? m_codecCtx->codec_id : AV_CODEC_ID_NONE;
+}
+
+PlanarFloatConverter::~PlanarFloatConverter()
+{
+    swr_free(&m_swr);
+}
+
+bool PlanarFloatConverter::init(const AudioDecoder &decoder)
+{
+    swr_free(&m_swr);
+    m_channels = decoder.channels();
+    int ret = swr_alloc_set_opts2(&m_swr,
+                                  decoder.channelLayout(), AV_SAMPLE_FMT_FLTP, decoder.sampleRate(),
+                                  decoder.channelLayout(), decoder.sampleFormat(), decoder.sampleRate(),
+                                  0, nullptr);
+    return ret >= 0 && swr_init(m_swr) >= 0;
+}
+
+int PlanarFloatConverter::convert(const AVFrame *frame, std::vector<float *> &planes)
+{
+    const size_t needed = size_t(frame->nb_samples);
+    if (m_planes.size() != size_t(m_channels) || m_planes[0].size() < needed) {
+        m_planes.assign(size_t(m_channels), std::vector<float>(needed));
+    }
+    planes.resize(size_t(m_channels));
+    for (int ch = 0; ch < m_channels; ++ch) {
+        planes[size_t(ch)] = m_planes[size_t(ch)].data();
+    }
+    return swr_convert(m_swr, reinterpret_cast<uint8_t **>(planes.data()), frame->nb_samples,
+                       const_cast<const uint8_t **>(frame->extended_data), frame->nb_samples);
+}
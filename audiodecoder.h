@@ -0,0 +1,105 @@
+#ifndef AUDIODECODER_H
+#define AUDIODECODER_H
+
+#include <QString>
+#include <memory>
+#include <vector>
+#include "mappedinput.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+class FlacSeeker;
+struct SwrContext;
+
+//thin FFmpeg decode front end shared by verification, analysis and playback.
+//not thread-safe, use one instance per thread
+class AudioDecoder
+{
+public:
+    AudioDecoder();
+    ~AudioDecoder();
+
+    AudioDecoder(const AudioDecoder &) = delete;
+    AudioDecoder &operator=(const AudioDecoder &) = delete;
+
+    //strict mode turns on CRC checking so damaged frames are reported instead of concealed
+    bool open(const QString &filePath, bool strict = false);
+    void close();
+    bool isOpen() const { return m_codecCtx != nullptr; }
+
+    //decodes the next frame, nullptr at end of stream. the frame is owned by the decoder
+    //and only valid until the next call
+    AVFrame *decodeNextFrame();
+    bool atEnd() const { return m_atEnd; }
+
+    //repositions to the packet at or before sample (in the stream's sample rate), the caller
+    //trims the first decoded frame using frameStartSample(). FLAC goes straight to the frame
+    //holding the sample (seek table + frame header bisection), other formats seek by timestamp
+    bool seek(qint64 sample);
+    //first sample of a decoded frame, -1 when the container has no timestamps
+    qint64 frameStartSample(const AVFrame *frame) const;
+
+    //stream properties, valid after open()
+    int sampleRate() const;
+    int channels() const;
+    int bitsPerSample() const;          //bits of real precision, e.g. 24 for S32 holding 24-bit audio
+    AVSampleFormat sampleFormat() const;
+    const AVChannelLayout *channelLayout() const;
+    qint64 totalSamples() const;        //-1 when the container doesn't say
+    AVCodecID codecId() const;
+
+    //packets/frames the codec rejected, non-zero means the stream is damaged
+    int decodeErrors() const { return m_decodeErrors; }
+    bool hadReadError() const { return m_readError; }
+    //file I/O so far, see MappedInput
+    InputStats inputStats() const { return m_input.stats(); }
+    QString lastError() const { return m_lastError; }
+
+private:
+    bool seekFlacFrame(qint64 sample);
+
+    MappedInput m_input;
+    AVFormatContext *m_formatCtx = nullptr;
+    AVCodecContext *m_codecCtx = nullptr;
+    AVPacket *m_packet = nullptr;
+    AVFrame *m_frame = nullptr;
+    int m_streamIndex = -1;
+
+    QString m_filePath;
+    std::unique_ptr<FlacSeeker> m_flacSeeker;   // opened on the first seek of a FLAC stream
+    bool m_flacSeekerFailed = false;
+    qint64 m_sampleCursor = -1;                 // after a byte seek: first sample of the next frame
+    qint64 m_cursorFrameStart = -1;
+
+    bool m_flushing = false;
+    bool m_atEnd = false;
+    bool m_readError = false;
+    int m_decodeErrors = 0;
+    QString m_lastError;
+};
+
+//decoded audio as planar float at the source rate, for the analysis passes (loudness, waveform).
+//swr only converts the sample format here, nothing is resampled or remixed
+class PlanarFloatConverter
+{
+public:
+    PlanarFloatConverter() = default;
+    ~PlanarFloatConverter();
+
+    PlanarFloatConverter(const PlanarFloatConverter &) = delete;
+    PlanarFloatConverter &operator=(const PlanarFloatConverter &) = delete;
+
+    bool init(const AudioDecoder &decoder);
+    //planes stay valid until the next convert(), returns the frame count or -1
+    int convert(const AVFrame *frame, std::vector<float *> &planes);
+
+private:
+    SwrContext *m_swr = nullptr;
+    int m_channels = 0;
+    std::vector<std::vector<float>> m_planes;
+};
+
+#endif // AUDIODECODER_H
@@ -1,12 +1,61 @@
 #include "audiomanager.h"
-#include "ui_metadataeditor.h"
+#include "logging.h"
 #include <QFile>
 #include <QFileInfo>
 #include <QBuffer>
 #include <QDebug>
-#include <QFileDialog>
-#include <QMessageBox>
-#include <QPixmap>
+#include <QCache>
+#include <QMutex>
+#include <QDateTime>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace {
+    // Parsed metadata plus what it was parsed from, stale once size or mtime change
+    struct CachedMetadata {
+        FlacMetadata metadata;
+        MetadataEditor::MetadataFields fields;
+        qint64 size = 0;
+        QDateTime modified;
+    };
+
+    // Cost is in KiB so decoded album art counts for what it weighs, 64 MiB in total
+    QCache<QString, CachedMetadata> s_metadataCache(64 * 1024);
+    QMutex s_metadataCacheMutex;
+
+    // Header probing budget for container formats, tags live in moov/udta or RIFF chunks
+    constexpr int CONTAINER_PROBE_SIZE = 32 * 1024;
+
+    QString dictValue(const AVDictionary *dict, const char *key)
+    {
+        const AVDictionaryEntry *entry = av_dict_get(dict, key, nullptr, 0);
+        return entry ? QString::fromUtf8(entry->value) : QString();
+    }
+
+    // "-6.52 dB" / "0.988770", a gain only counts when its value parses
+    ReplayGainInfo parseReplayGain(const QString &trackGain, const QString &trackPeak,
+                                   const QString &albumGain, const QString &albumPeak)
+    {
+        auto number = [](QString text, bool *ok) {
+            text = text.trimmed();
+            if (text.endsWith("dB", Qt::CaseInsensitive)) {
+                text.chop(2);
+            }
+            return text.trimmed().toDouble(ok);
+        };
+        ReplayGainInfo gain;
+        bool ok = false;
+        gain.trackGain = number(trackGain, &ok);
+        gain.hasTrack = ok;
+        gain.trackPeak = gain.hasTrack ? qMax(number(trackPeak, &ok), 0.0) : 0.0;
+        gain.albumGain = number(albumGain, &ok);
+        gain.hasAlbum = ok;
+        gain.albumPeak = gain.hasAlbum ? qMax(number(albumPeak, &ok), 0.0) : 0.0;
+        return gain;
+    }
+}
 
 MetadataEditor::MetadataEditor()
 {
@@ -35,43 +84,219 @@ bool MetadataEditor::isValidFlacFile(const QString &filePath)
     return valid;
 }
 
-FlacMetadata MetadataEditor::readMetadata(const QString &filePath)
+FlacMetadata MetadataEditor::readMetadata(const QString &filePath, MetadataFields fields)
+{
+    QFileInfo info(filePath);
+    MetadataFields wanted = fields;
+    
+    {
+        QMutexLocker locker(&s_metadataCacheMutex);
+        CachedMetadata *cached = s_metadataCache.object(filePath);
+        if (cached && cached->size == info.size() && cached->modified == info.lastModified()) {
+            if ((cached->fields & fields) == fields) {
+                PerfLog::record("metadata", "read_cached", 0, 0, filePath);
+                m_lastError.clear();
+                return cached->metadata;
+            }
+            // Re-read with the union so the entry only ever grows
+            wanted |= cached->fields;
+        }
+    }
+    
+    FlacMetadata metadata = isContainerFormat(filePath) ? readContainerMetadata(filePath, wanted)
+                                                        : readFlacMetadata(filePath, wanted);
+    
+    if (m_lastError.isEmpty()) {
+        CachedMetadata *entry = new CachedMetadata;
+        entry->metadata = metadata;
+        entry->fields = wanted;
+        entry->size = info.size();
+        entry->modified = info.lastModified();
+        int cost = 1 + static_cast<int>(metadata.albumArt.sizeInBytes() / 1024);
+        
+        QMutexLocker locker(&s_metadataCacheMutex);
+        s_metadataCache.insert(filePath, entry, cost);
+    }
+    return metadata;
+}
+
+bool MetadataEditor::canReadTags(const QString &filePath)
+{
+    return filePath.toLower().endsWith(".flac") || isContainerFormat(filePath);
+}
+
+bool MetadataEditor::isContainerFormat(const QString &filePath)
+{
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    return suffix == "m4a" || suffix == "mp4" || suffix == "alac" || suffix == "wav" || suffix == "wave";
+}
+
+void MetadataEditor::invalidateCache(const QString &filePath)
+{
+    QMutexLocker locker(&s_metadataCacheMutex);
+    s_metadataCache.remove(filePath);
+}
+
+void MetadataEditor::clearCache()
+{
+    QMutexLocker locker(&s_metadataCacheMutex);
+    s_metadataCache.clear();
+}
+
+FlacMetadata MetadataEditor::readContainerMetadata(const QString &filePath, MetadataFields fields)
+{
+    FlacMetadata metadata;
+    PerfScope perf("metadata", "read_container", filePath);
+    
+    // The container is known from the extension, so skip format probing altogether
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    const AVInputFormat *inputFormat = av_find_input_format(suffix.startsWith("wav") ? "wav" : "mov");
+    
+    AVFormatContext *formatCtx = avformat_alloc_context();
+    if (!formatCtx) {
+        m_lastError = "Failed to allocate format context";
+        return metadata;
+    }
+    
+    // Tags and stream parameters come from the header alone, avformat_find_stream_info() is never
+    // called because it would decode audio
+    AVDictionary *options = nullptr;
+    av_dict_set_int(&options, "probesize", CONTAINER_PROBE_SIZE, 0);
+    av_dict_set_int(&options, "analyzeduration", 0, 0);
+    av_dict_set_int(&options, "formatprobesize", CONTAINER_PROBE_SIZE, 0);
+    
+    int ret = avformat_open_input(&formatCtx, filePath.toUtf8().constData(), inputFormat, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        // avformat_open_input() frees the context on failure
+        m_lastError = "Cannot open file: " + filePath;
+        return metadata;
+    }
+    
+    const AVStream *audioStream = nullptr;
+    const AVStream *pictureStream = nullptr;
+    for (unsigned int i = 0; i < formatCtx->nb_streams; ++i) {
+        const AVStream *stream = formatCtx->streams[i];
+        if (stream->disposition & AV_DISPOSITION_ATTACHED_PIC) {
+            pictureStream = stream;
+        } else if (!audioStream && stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+            audioStream = stream;
+        }
+    }
+    
+    if (fields & FieldStreamInfo && audioStream) {
+        const AVCodecParameters *par = audioStream->codecpar;
+        metadata.sampleRate = par->sample_rate;
+        metadata.channels = par->ch_layout.nb_channels;
+        metadata.bitsPerSample = par->bits_per_raw_sample > 0 ? par->bits_per_raw_sample : par->bits_per_coded_sample;
+        if (audioStream->duration != AV_NOPTS_VALUE && par->sample_rate > 0) {
+            metadata.totalSamples = av_rescale_q(audioStream->duration, audioStream->time_base,
+                                                 AVRational{1, par->sample_rate});
+        }
+    }
+    
+    if (fields & FieldTags) {
+        // MP4 keeps tags on the container, WAV INFO/ID3 chunks end up there too; streams are a fallback
+        const AVDictionary *tags = formatCtx->metadata;
+        const AVDictionary *streamTags = audioStream ? audioStream->metadata : nullptr;
+        auto tag = [&](const char *key) {
+            QString value = dictValue(tags, key);
+            return value.isEmpty() ? dictValue(streamTags, key) : value;
+        };
+        metadata.title = tag("title");
+        metadata.artist = tag("artist");
+        metadata.album = tag("album");
+        metadata.albumArtist = tag("album_artist");
+        metadata.year = tag("date");
+        metadata.genre = tag("genre");
+        metadata.trackNumber = tag("track");
+        metadata.comment = tag("comment");
+        metadata.replayGain = parseReplayGain(tag("replaygain_track_gain"), tag("replaygain_track_peak"),
+                                              tag("replaygain_album_gain"), tag("replaygain_album_peak"));
+    }
+    
+    if (fields & FieldAlbumArt && pictureStream && pictureStream->attached_pic.size > 0) {
+        metadata.albumArt.loadFromData(pictureStream->attached_pic.data, pictureStream->attached_pic.size);
+    }
+    
+    perf.setBytes(avio_tell(formatCtx->pb));
+    avformat_close_input(&formatCtx);
+    m_lastError.clear();
+    return metadata;
+}
+
+FlacMetadata MetadataEditor::readFlacMetadata(const QString &filePath, MetadataFields fields)
 {
-    qDebug() << "[MetadataEditor] readMetadata called for:" << filePath;
+    qCDebug(lcMetadata) << "readMetadata called for:" << filePath;
     FlacMetadata metadata;
+    PerfScope perf("metadata", "read_flac", filePath);
     
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
         m_lastError = "Cannot open file: " + filePath;
-        qDebug() << "[MetadataEditor] ERROR: Cannot open file for reading";
+        qCWarning(lcMetadata) << "Cannot open file for reading";
         return metadata;
     }
     
+    metadata = parseFlacStream(file, fields);
+    perf.setBytes(file.pos());
+    file.close();
+    return metadata;
+}
+
+FlacMetadata MetadataEditor::parseMetadata(const QByteArray &data, MetadataFields fields)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    return parseFlacStream(buffer, fields);
+}
+
+FlacMetadata MetadataEditor::parseFlacStream(QIODevice &device, MetadataFields fields)
+{
+    FlacMetadata metadata;
+    
     // Verify FLAC header
-    if (!readFlacHeader(file)) {
+    if (!readFlacHeader(device)) {
         m_lastError = "Invalid FLAC file format";
-        qDebug() << "[MetadataEditor] ERROR: Invalid FLAC header";
+        qCWarning(lcMetadata) << "Invalid FLAC header";
         return metadata;
-
     }
-    qDebug() << "[MetadataEditor] FLAC header verified";
+    qCDebug(lcMetadata) << "FLAC header verified";
     
-    // Read all metadata blocks
-    QList<MetadataBlock> blocks = readMetadataBlocks(file);
-    qDebug() << "[MetadataEditor] Read" << blocks.size() << "metadata blocks";
+    // Read the metadata blocks, anything the caller didn't ask for is skipped without reading it
+    quint32 skipMask = (1u << BLOCK_TYPE_PADDING) | (1u << BLOCK_TYPE_APPLICATION) | (1u << BLOCK_TYPE_SEEKTABLE);
+    if (!(fields & FieldTags)) {
+        skipMask |= 1u << BLOCK_TYPE_VORBIS_COMMENT;
+    }
+    if (!(fields & FieldAlbumArt)) {
+        skipMask |= 1u << BLOCK_TYPE_PICTURE;
+    }
+    if (!(fields & FieldCueSheet)) {
+        skipMask |= 1u << BLOCK_TYPE_CUESHEET;
+    }
+    QList<MetadataBlock> blocks = readMetadataBlocks(device, skipMask);
+    qCDebug(lcMetadata) << "Read" << blocks.size() << "metadata blocks";
     
     // Parse each block type
     for (const MetadataBlock &block : blocks) {
-        qDebug() << "[MetadataEditor] Block type:" << block.blockType 
+        qCDebug(lcMetadata) << "Block type:" << block.blockType 
                  << "Length:" << block.length 
                  << "IsLast:" << block.isLast;
+        if (block.data.isEmpty()) {
+            continue; // Skipped block
+        }
         switch (block.blockType) {
             case BLOCK_TYPE_STREAMINFO: {
+                if (!(fields & FieldStreamInfo)) {
+                    break;
+                }
                 FlacMetadata streamInfo = parseStreamInfo(block.data);
                 metadata.sampleRate = streamInfo.sampleRate;
                 metadata.channels = streamInfo.channels;
                 metadata.bitsPerSample = streamInfo.bitsPerSample;
                 metadata.totalSamples = streamInfo.totalSamples;
+                metadata.audioMd5 = streamInfo.audioMd5;
                 break;
             }
             case BLOCK_TYPE_VORBIS_COMMENT: {
@@ -84,18 +309,26 @@ FlacMetadata MetadataEditor::readMetadata(const QString &filePath)
                 metadata.genre = comments.value("GENRE", "");
                 metadata.trackNumber = comments.value("TRACKNUMBER", comments.value("TRACK", ""));
                 metadata.comment = comments.value("COMMENT", comments.value("DESCRIPTION", ""));
+                auto gainTag = [&comments](const QString &key) {
+                    return comments.value(key, comments.value(key.toLower()));
+                };
+                metadata.replayGain = parseReplayGain(gainTag("REPLAYGAIN_TRACK_GAIN"), gainTag("REPLAYGAIN_TRACK_PEAK"),
+                                                      gainTag("REPLAYGAIN_ALBUM_GAIN"), gainTag("REPLAYGAIN_ALBUM_PEAK"));
                 break;
             }
             case BLOCK_TYPE_PICTURE: {
                 metadata.albumArt = parsePictureBlock(block.data);
                 break;
             }
+            case BLOCK_TYPE_CUESHEET: {
+                metadata.cueTracks = parseCueSheet(block.data);
+                break;
+            }
         }
     }
     
-    file.close();
     m_lastError.clear();
-    qDebug() << "[MetadataEditor] Successfully read metadata -" 
+    qCDebug(lcMetadata) << "Successfully read metadata -" 
              << "Title:" << metadata.title 
              << "Artist:" << metadata.artist
              << "Album:" << metadata.album;
@@ -103,79 +336,91 @@ FlacMetadata MetadataEditor::readMetadata(const QString &filePath)
 }
 
 
+QList<CueTrack> MetadataEditor::readCueTracks(const QString &filePath, int *sampleRate)
+{
+    // Only STREAMINFO and CUESHEET are parsed, pictures are skipped entirely
+    FlacMetadata metadata = readMetadata(filePath, FieldStreamInfo | FieldCueSheet);
+    if (sampleRate) {
+        *sampleRate = metadata.sampleRate;
+    }
+    return metadata.cueTracks;
+}
 
 bool MetadataEditor::writeMetadata(const QString &filePath, const FlacMetadata &metadata)
 {
-    qDebug() << "[MetadataEditor] writeMetadata called for:" << filePath;
-    qDebug() << "[MetadataEditor] Metadata to write:";
-    qDebug() << "  Title:" << metadata.title;
-    qDebug() << "  Artist:" << metadata.artist;
-    qDebug() << "  Album:" << metadata.album;
-    qDebug() << "  AlbumArtist:" << metadata.albumArtist;
-    qDebug() << "  Year:" << metadata.year;
-    qDebug() << "  Genre:" << metadata.genre;
-    qDebug() << "  TrackNumber:" << metadata.trackNumber;
-    qDebug() << "  Comment:" << metadata.comment;
-    qDebug() << "  AlbumArt isNull:" << metadata.albumArt.isNull();
+    qCDebug(lcMetadata) << "writeMetadata called for:" << filePath;
+    qCDebug(lcMetadata) << "Metadata to write:";
+    qCDebug(lcMetadata) << "  Title:" << metadata.title;
+    qCDebug(lcMetadata) << "  Artist:" << metadata.artist;
+    qCDebug(lcMetadata) << "  Album:" << metadata.album;
+    qCDebug(lcMetadata) << "  AlbumArtist:" << metadata.albumArtist;
+    qCDebug(lcMetadata) << "  Year:" << metadata.year;
+    qCDebug(lcMetadata) << "  Genre:" << metadata.genre;
+    qCDebug(lcMetadata) << "  TrackNumber:" << metadata.trackNumber;
+    qCDebug(lcMetadata) << "  Comment:" << metadata.comment;
+    qCDebug(lcMetadata) << "  AlbumArt isNull:" << metadata.albumArt.isNull();
     if (!metadata.albumArt.isNull()) {
-        qDebug() << "  AlbumArt size:" << metadata.albumArt.width() << "x" << metadata.albumArt.height();
+        qCDebug(lcMetadata) << "  AlbumArt size:" << metadata.albumArt.width() << "x" << metadata.albumArt.height();
     }
     
     QFile file(filePath);
     if (!file.open(QIODevice::ReadOnly)) {
         m_lastError = "Cannot open file for reading: " + filePath;
-        qDebug() << "[MetadataEditor] ERROR: Cannot open file for writing";
+        qCWarning(lcMetadata) << "Cannot open file for writing";
         return false;
     }
-    qDebug() << "[MetadataEditor] File opened successfully for reading, size:" << file.size();
+    qCDebug(lcMetadata) << "File opened successfully for reading, size:" << file.size();
     
     // Verify FLAC header
     if (!readFlacHeader(file)) {
         m_lastError = "Invalid FLAC file format";
-        qDebug() << "[MetadataEditor] ERROR: Invalid FLAC header";
+        qCWarning(lcMetadata) << "Invalid FLAC header";
         file.close();
         return false;
     }
-    qDebug() << "[MetadataEditor] FLAC header verified successfully";
+    qCDebug(lcMetadata) << "FLAC header verified successfully";
     
     // Read existing metadata and audio data
-    qDebug() << "[MetadataEditor] Reading existing metadata blocks...";
+    qCDebug(lcMetadata) << "Reading existing metadata blocks...";
     QList<MetadataBlock> blocks = readMetadataBlocks(file);
-    qDebug() << "[MetadataEditor] Read" << blocks.size() << "metadata blocks";
+    qCDebug(lcMetadata) << "Read" << blocks.size() << "metadata blocks";
     
     qint64 audioDataStartPos = file.pos();
     QByteArray audioData = file.readAll();
-    qDebug() << "[MetadataEditor] Read" << audioData.size() << "bytes of audio data starting at position" << audioDataStartPos;
+    qCDebug(lcMetadata) << "Read" << audioData.size() << "bytes of audio data starting at position" << audioDataStartPos;
     file.close();
     
     // Update or create Vorbis Comment block
     bool hasVorbisComment = false;
     QMap<QString, QString> extraFields;
     
-    qDebug() << "[MetadataEditor] Processing Vorbis Comment block...";
+    qCDebug(lcMetadata) << "Processing Vorbis Comment block...";
     for (int i = 0; i < blocks.size(); ++i) {
         if (blocks[i].blockType == BLOCK_TYPE_VORBIS_COMMENT) {
-            qDebug() << "[MetadataEditor] Found existing Vorbis Comment block at index" << i;
-            qDebug() << "[MetadataEditor] Existing block size:" << blocks[i].data.size();
+            qCDebug(lcMetadata) << "Found existing Vorbis Comment block at index" << i;
+            qCDebug(lcMetadata) << "Existing block size:" << blocks[i].data.size();
             // Preserve extra fields not in our structure
             QMap<QString, QString> existing = parseVorbisComment(blocks[i].data);
-            qDebug() << "[MetadataEditor] Parsed" << existing.size() << "existing comments";
+            qCDebug(lcMetadata) << "Parsed" << existing.size() << "existing comments";
+            // ReplayGain tags are kept as they are unless the caller brings its own
+            const bool replaceGain = !metadata.replayGain.isEmpty();
             for (auto it = existing.constBegin(); it != existing.constEnd(); ++it) {
                 QString key = it.key().toUpper();
                 if (key != "TITLE" && key != "ARTIST" && key != "ALBUM" && 
                     key != "ALBUMARTIST" && key != "ALBUM ARTIST" && 
                     key != "DATE" && key != "YEAR" && key != "GENRE" && 
                     key != "TRACKNUMBER" && key != "TRACK" && 
-                    key != "COMMENT" && key != "DESCRIPTION") {
+                    key != "COMMENT" && key != "DESCRIPTION" &&
+                    !(replaceGain && key.startsWith("REPLAYGAIN_"))) {
                     extraFields[it.key()] = it.value();
                 }
             }
             
             // Replace with new data
-            qDebug() << "[MetadataEditor] Creating new Vorbis Comment block with" << extraFields.size() << "extra fields";
+            qCDebug(lcMetadata) << "Creating new Vorbis Comment block with" << extraFields.size() << "extra fields";
             blocks[i].data = createVorbisCommentBlock(metadata, extraFields);
             blocks[i].length = blocks[i].data.size();
-            qDebug() << "[MetadataEditor] New Vorbis Comment block size:" << blocks[i].length;
+            qCDebug(lcMetadata) << "New Vorbis Comment block size:" << blocks[i].length;
             hasVorbisComment = true;
             break;
         }
@@ -183,40 +428,40 @@ bool MetadataEditor::writeMetadata(const QString &filePath, const FlacMetadata &
     
     // Add Vorbis Comment if it doesn't exist
     if (!hasVorbisComment) {
-        qDebug() << "[MetadataEditor] No existing Vorbis Comment block, creating new one";
+        qCDebug(lcMetadata) << "No existing Vorbis Comment block, creating new one";
         MetadataBlock vorbisBlock;
         vorbisBlock.blockType = BLOCK_TYPE_VORBIS_COMMENT;
         vorbisBlock.isLast = false;
         vorbisBlock.data = createVorbisCommentBlock(metadata, extraFields);
         vorbisBlock.length = vorbisBlock.data.size();
-        qDebug() << "[MetadataEditor] New Vorbis Comment block created, size:" << vorbisBlock.length;
+        qCDebug(lcMetadata) << "New Vorbis Comment block created, size:" << vorbisBlock.length;
         
         // Insert after STREAMINFO (which should be first)
         if (!blocks.isEmpty()) {
-            qDebug() << "[MetadataEditor] Inserting Vorbis Comment block at position 1";
+            qCDebug(lcMetadata) << "Inserting Vorbis Comment block at position 1";
             blocks.insert(1, vorbisBlock);
         } else {
-            qDebug() << "[MetadataEditor] WARNING: No existing blocks, appending Vorbis Comment";
+            qCWarning(lcMetadata) << "No existing blocks, appending Vorbis Comment";
             blocks.append(vorbisBlock);
         }
     }
     
     // Update or remove Picture block
-    qDebug() << "[MetadataEditor] Processing Picture block...";
+    qCDebug(lcMetadata) << "Processing Picture block...";
     bool hasPicture = false;
     for (int i = 0; i < blocks.size(); ++i) {
         if (blocks[i].blockType == BLOCK_TYPE_PICTURE) {
-            qDebug() << "[MetadataEditor] Found existing Picture block at index" << i;
-            qDebug() << "[MetadataEditor] Existing picture block size:" << blocks[i].data.size();
+            qCDebug(lcMetadata) << "Found existing Picture block at index" << i;
+            qCDebug(lcMetadata) << "Existing picture block size:" << blocks[i].data.size();
             if (!metadata.albumArt.isNull()) {
                 // Replace with new image
-                qDebug() << "[MetadataEditor] Replacing with new album art";
+                qCDebug(lcMetadata) << "Replacing with new album art";
                 blocks[i].data = createPictureBlock(metadata.albumArt);
                 blocks[i].length = blocks[i].data.size();
-                qDebug() << "[MetadataEditor] New picture block size:" << blocks[i].length;
+                qCDebug(lcMetadata) << "New picture block size:" << blocks[i].length;
             } else {
                 // Remove picture block
-                qDebug() << "[MetadataEditor] Removing picture block (no album art)";
+                qCDebug(lcMetadata) << "Removing picture block (no album art)";
                 blocks.removeAt(i);
                 --i;
             }
@@ -227,28 +472,28 @@ bool MetadataEditor::writeMetadata(const QString &filePath, const FlacMetadata &
     
     // Add Picture block if needed and doesn't exist
     if (!hasPicture && !metadata.albumArt.isNull()) {
-        qDebug() << "[MetadataEditor] No existing Picture block, creating new one";
+        qCDebug(lcMetadata) << "No existing Picture block, creating new one";
         MetadataBlock pictureBlock;
         pictureBlock.blockType = BLOCK_TYPE_PICTURE;
         pictureBlock.isLast = false;
         pictureBlock.data = createPictureBlock(metadata.albumArt);
         pictureBlock.length = pictureBlock.data.size();
-        qDebug() << "[MetadataEditor] New picture block size:" << pictureBlock.length;
+        qCDebug(lcMetadata) << "New picture block size:" << pictureBlock.length;
         blocks.append(pictureBlock);
     }
     
     // Mark last block
-    qDebug() << "[MetadataEditor] Marking last block flag...";
+    qCDebug(lcMetadata) << "Marking last block flag...";
     if (!blocks.isEmpty()) {
         for (int i = 0; i < blocks.size(); ++i) {
             blocks[i].isLast = (i == blocks.size() - 1);
-            qDebug() << "[MetadataEditor] Block" << i << "- Type:" << blocks[i].blockType 
+            qCDebug(lcMetadata) << "Block" << i << "- Type:" << blocks[i].blockType 
                      << "Length:" << blocks[i].length << "IsLast:" << blocks[i].isLast;
         }
     }
     
     // Write updated file
-    qDebug() << "[MetadataEditor] Calling writeFlacFile with" << blocks.size() << "blocks and" 
+    qCDebug(lcMetadata) << "Calling writeFlacFile with" << blocks.size() << "blocks and" 
              << audioData.size() << "bytes of audio";
     return writeFlacFile(filePath, blocks, audioData);
 }
@@ -257,6 +502,16 @@ bool MetadataEditor::updateField(const QString &filePath, const QString &fieldNa
 {
     FlacMetadata metadata = readMetadata(filePath);
     
+    if (!setField(metadata, fieldName, value)) {
+        m_lastError = "Unknown field: " + fieldName;
+        return false;
+    }
+    
+    return writeMetadata(filePath, metadata);
+}
+
+bool MetadataEditor::setField(FlacMetadata &metadata, const QString &fieldName, const QString &value)
+{
     QString upperField = fieldName.toUpper();
     if (upperField == "TITLE") {
         metadata.title = value;
@@ -275,11 +530,9 @@ bool MetadataEditor::updateField(const QString &filePath, const QString &fieldNa
     } else if (upperField == "COMMENT" || upperField == "DESCRIPTION") {
         metadata.comment = value;
     } else {
-        m_lastError = "Unknown field: " + fieldName;
         return false;
     }
-    
-    return writeMetadata(filePath, metadata);
+    return true;
 }
 
 bool MetadataEditor::updateAlbumArt(const QString &filePath, const QImage &image)
@@ -296,8 +549,58 @@ bool MetadataEditor::removeAlbumArt(const QString &filePath)
     return writeMetadata(filePath, metadata);
 }
 
+bool MetadataEditor::writeReplayGain(const QString &filePath, const ReplayGainInfo &gain)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_lastError = "Cannot open file for reading: " + filePath;
+        return false;
+    }
+    if (!readFlacHeader(file)) {
+        m_lastError = "Invalid FLAC file format";
+        return false;
+    }
+    QList<MetadataBlock> blocks = readMetadataBlocks(file);
+    QByteArray audioData = file.readAll();
+    file.close();
+    
+    // Everything except the old gain tags goes through as an extra field, so the comment block is
+    // rebuilt without touching the picture (writeMetadata() would re-encode it)
+    FlacMetadata tags;
+    tags.replayGain = gain;
+    QMap<QString, QString> keptFields;
+    int commentIndex = -1;
+    for (int i = 0; i < blocks.size(); ++i) {
+        if (blocks[i].blockType == BLOCK_TYPE_VORBIS_COMMENT) {
+            commentIndex = i;
+            QMap<QString, QString> existing = parseVorbisComment(blocks[i].data);
+            for (auto it = existing.constBegin(); it != existing.constEnd(); ++it) {
+                if (!it.key().toUpper().startsWith("REPLAYGAIN_")) {
+                    keptFields[it.key()] = it.value();
+                }
+            }
+            break;
+        }
+    }
+    
+    MetadataBlock commentBlock;
+    commentBlock.blockType = BLOCK_TYPE_VORBIS_COMMENT;
+    commentBlock.isLast = false;
+    commentBlock.data = createVorbisCommentBlock(tags, keptFields);
+    commentBlock.length = commentBlock.data.size();
+    if (commentIndex >= 0) {
+        blocks[commentIndex] = commentBlock;
+    } else {
+        blocks.insert(blocks.isEmpty() ? 0 : 1, commentBlock);
+    }
+    for (int i = 0; i < blocks.size(); ++i) {
+        blocks[i].isLast = (i == blocks.size() - 1);
+    }
+    
+    return writeFlacFile(filePath, blocks, audioData);
+}
 
-bool MetadataEditor::readFlacHeader(QFile &file)
+bool MetadataEditor::readFlacHeader(QIODevice &file)
 {
     // FLAC files start with "fLaC" (0x664C6143)
     QByteArray header = file.read(4);
@@ -309,7 +612,7 @@ bool MetadataEditor::readFlacHeader(QFile &file)
             header[2] == 'a' && header[3] == 'C');
 }
 
-QList<MetadataEditor::MetadataBlock> MetadataEditor::readMetadataBlocks(QFile &file)
+QList<MetadataEditor::MetadataBlock> MetadataEditor::readMetadataBlocks(QIODevice &file, quint32 skipTypeMask)
 {
     QList<MetadataBlock> blocks;
     
@@ -331,10 +634,20 @@ QList<MetadataEditor::MetadataBlock> MetadataEditor::readMetadataBlocks(QFile &f
         // Next 3 bytes: block length (big-endian 24-bit)
         block.length = readBigEndian24(header, 1);
         
+        // Skip unwanted blocks (pictures can be several MB) without pulling them into memory
+        if (block.blockType < 32 && (skipTypeMask & (1u << block.blockType))) {
+            if (file.skip(block.length) != static_cast<qint64>(block.length)) {
+                qCWarning(lcMetadata) << "Failed to skip metadata block";
+                break;
+            }
+            blocks.append(block);
+            continue;
+        }
+        
         // Read block data
         block.data = file.read(block.length);
         if (block.data.size() != static_cast<int>(block.length)) {
-            qWarning() << "Failed to read complete metadata block";
+            qCWarning(lcMetadata) << "Failed to read complete metadata block";
             break;
         }
         
@@ -363,6 +676,9 @@ FlacMetadata MetadataEditor::parseStreamInfo(const QByteArray &data)
     totalSamples |= readBigEndian32(data, 14);
     metadata.totalSamples = totalSamples;
     
+    // Bytes 18-33: MD5 signature of the unencoded audio
+    metadata.audioMd5 = data.mid(18, 16);
+    
     return metadata;
 }
 
@@ -374,7 +690,10 @@ QMap<QString, QString> MetadataEditor::parseVorbisComment(const QByteArray &data
         return comments; // Too small
     }
     
-    int offset = 0;
+    // All lengths are untrusted 32-bit values, so they are compared against what is left
+    // instead of being added to the offset first (which could overflow)
+    const qint64 size = data.size();
+    qint64 offset = 0;
     
     // Vendor string length (little-endian 32-bit)
     quint32 vendorLength = static_cast<quint8>(data[offset]) |
@@ -383,12 +702,11 @@ QMap<QString, QString> MetadataEditor::parseVorbisComment(const QByteArray &data
                           (static_cast<quint8>(data[offset + 3]) << 24);
     offset += 4;
     
-    // Skip vendor string
-    offset += vendorLength;
-    
-    if (offset + 4 > data.size()) {
+    // Skip vendor string, the comment count must still fit after it
+    if (vendorLength > size - offset || size - offset - vendorLength < 4) {
         return comments;
     }
+    offset += vendorLength;
     
     // Number of comments (little-endian 32-bit)
     quint32 commentCount = static_cast<quint8>(data[offset]) |
@@ -399,7 +717,7 @@ QMap<QString, QString> MetadataEditor::parseVorbisComment(const QByteArray &data
     
     // Parse each comment
     for (quint32 i = 0; i < commentCount; ++i) {
-        if (offset + 4 > data.size()) {
+        if (size - offset < 4) {
             break;
         }
         
@@ -410,7 +728,7 @@ QMap<QString, QString> MetadataEditor::parseVorbisComment(const QByteArray &data
                                (static_cast<quint8>(data[offset + 3]) << 24);
         offset += 4;
         
-        if (offset + commentLength > static_cast<quint32>(data.size())) {
+        if (commentLength > size - offset) {
             break;
         }
         
@@ -435,28 +753,29 @@ QImage MetadataEditor::parsePictureBlock(const QByteArray &data)
     if (data.size() < 32) {
         return QImage(); // Too small
     }
-    int offset = 0;
+    // Same rule as the vorbis comment parser: check each length against the remaining bytes
+    const qint64 size = data.size();
+    qint64 offset = 0;
     // Picture type (4 bytes, big-endian) - skip
     offset += 4; 
     // MIME type length (4 bytes, big-endian)
     quint32 mimeLength = readBigEndian32(data, offset);
     offset += 4;
-    // Skip MIME type string
-    offset += mimeLength;
-    if (offset >= data.size()) {
+    // Skip MIME type string, the description length must follow it
+    if (mimeLength > size - offset || size - offset - mimeLength < 4) {
         return QImage();
     }
+    offset += mimeLength;
     
     // Description length (4 bytes, big-endian)
     quint32 descLength = readBigEndian32(data, offset);
     offset += 4;
     
-    // Skip description
-    offset += descLength;
-    
-    if (offset + 20 > data.size()) {
+    // Skip description, then 20 bytes of dimensions and the picture length
+    if (descLength > size - offset || size - offset - descLength < 20) {
         return QImage();
     }
+    offset += descLength;
     
     // Skip width, height, color depth, indexed colors (16 bytes)
     offset += 16;
@@ -465,7 +784,7 @@ QImage MetadataEditor::parsePictureBlock(const QByteArray &data)
     quint32 pictureLength = readBigEndian32(data, offset);
     offset += 4;
     
-    if (offset + pictureLength > static_cast<quint32>(data.size())) {
+    if (pictureLength > size - offset) {
         return QImage();
     }
     
@@ -477,42 +796,123 @@ QImage MetadataEditor::parsePictureBlock(const QByteArray &data)
     return image;
 }
 
+QList<CueTrack> MetadataEditor::parseCueSheet(const QByteArray &data)
+{
+    QList<CueTrack> tracks;
+    
+    // Catalog number (128) + lead-in (8) + CD flag/reserved (259) + track count (1)
+    const int headerSize = 396;
+    // Offset (8) + number (1) + ISRC (12) + flags/reserved (14) + index count (1)
+    const int trackHeaderSize = 36;
+    const int indexSize = 12;
+    
+    if (data.size() < headerSize) {
+        return tracks;
+    }
+    
+    int trackCount = static_cast<quint8>(data[headerSize - 1]);
+    int offset = headerSize;
+    
+    for (int t = 0; t < trackCount; ++t) {
+        if (data.size() - offset < trackHeaderSize) {
+            return QList<CueTrack>(); // Truncated block, don't expose half a cue sheet
+        }
+        
+        quint64 trackOffset = readBigEndian64(data, offset);
+        int number = static_cast<quint8>(data[offset + 8]);
+        QString isrc = QString::fromLatin1(data.mid(offset + 9, 12)).trimmed();
+        isrc.remove(QChar('\0'));
+        bool isAudio = (static_cast<quint8>(data[offset + 21]) & 0x80) == 0;
+        int indexCount = static_cast<quint8>(data[offset + 35]);
+        offset += trackHeaderSize;
+        
+        if ((data.size() - offset) / indexSize < indexCount) {
+            return QList<CueTrack>();
+        }
+        
+        // Track starts at INDEX 01, INDEX 00 is the pregap and belongs to the previous track
+        quint64 startOffset = 0;
+        bool haveIndex = false;
+        for (int i = 0; i < indexCount; ++i) {
+            quint64 indexOffset = readBigEndian64(data, offset);
+            int indexNumber = static_cast<quint8>(data[offset + 8]);
+            if (!haveIndex || indexNumber == 1) {
+                startOffset = indexOffset;
+                haveIndex = true;
+            }
+            offset += indexSize;
+        }
+        
+        // Lead-out (170 for CD-DA, 255 otherwise) only marks where the last track ends
+        bool isLeadOut = (t == trackCount - 1);
+        if (isLeadOut) {
+            if (!tracks.isEmpty()) {
+                tracks.last().endSample = trackOffset;
+            }
+            break;
+        }
+        
+        if (!tracks.isEmpty() && tracks.last().endSample == 0) {
+            tracks.last().endSample = trackOffset + startOffset;
+        }
+        
+        if (!isAudio) {
+            continue; // Data tracks have no samples to play
+        }
+        
+        CueTrack track;
+        track.number = number;
+        track.startSample = trackOffset + startOffset;
+        track.isrc = isrc;
+        tracks.append(track);
+    }
+    
+    // Drop anything that doesn't describe a usable, ordered range
+    QList<CueTrack> valid;
+    for (const CueTrack &track : tracks) {
+        if (track.endSample > track.startSample) {
+            valid.append(track);
+        }
+    }
+    return valid;
+}
 
 bool MetadataEditor::writeFlacFile(const QString &filePath, const QList<MetadataBlock> &blocks, const QByteArray &audioData)
 {
-    qDebug() << "[MetadataEditor] writeFlacFile: Writing" << blocks.size() << "blocks and" << audioData.size() << "bytes of audio";
-    qDebug() << "[MetadataEditor] Original file path:" << filePath;
+    qCDebug(lcMetadata) << "writeFlacFile: Writing" << blocks.size() << "blocks and" << audioData.size() << "bytes of audio";
+    PerfScope perf("metadata", "write_flac", filePath);
+    qCDebug(lcMetadata) << "Original file path:" << filePath;
     
     // Create temporary file
     QString tempPath = filePath + ".tmp";
-    qDebug() << "[MetadataEditor] Creating temporary file:" << tempPath;
+    qCDebug(lcMetadata) << "Creating temporary file:" << tempPath;
     QFile tempFile(tempPath);
     
     if (!tempFile.open(QIODevice::WriteOnly)) {
         m_lastError = "Cannot create temporary file: " + tempPath;
-        qDebug() << "[MetadataEditor] ERROR: Cannot create temp file";
+        qCWarning(lcMetadata) << "Cannot create temp file";
         return false;
     }
-    qDebug() << "[MetadataEditor] Temp file opened successfully";
+    qCDebug(lcMetadata) << "Temp file opened successfully";
     
     // Write FLAC header
-    qDebug() << "[MetadataEditor] Writing FLAC header (fLaC)";
+    qCDebug(lcMetadata) << "Writing FLAC header (fLaC)";
     qint64 headerWritten = tempFile.write("fLaC", 4);
-    qDebug() << "[MetadataEditor] Header bytes written:" << headerWritten;
+    qCDebug(lcMetadata) << "Header bytes written:" << headerWritten;
     
     // Write metadata blocks
-    qDebug() << "[MetadataEditor] Writing" << blocks.size() << "metadata blocks...";
+    qCDebug(lcMetadata) << "Writing" << blocks.size() << "metadata blocks...";
     qint64 totalMetadataWritten = 4; // header
     for (int idx = 0; idx < blocks.size(); ++idx) {
         const MetadataBlock &block = blocks[idx];
-        qDebug() << "[MetadataEditor] Writing block" << idx << "- Type:" << block.blockType 
+        qCDebug(lcMetadata) << "Writing block" << idx << "- Type:" << block.blockType 
                  << "Length:" << block.length 
                  << "IsLast:" << block.isLast
                  << "Data size:" << block.data.size();
         
         // Validate block data
         if (block.data.size() != static_cast<int>(block.length)) {
-            qDebug() << "[MetadataEditor] WARNING: Block data size mismatch! Data size:" 
+            qCWarning(lcMetadata) << "Block data size mismatch! Data size:" 
                      << block.data.size() << "but length field says:" << block.length;
         }
         
@@ -527,7 +927,7 @@ bool MetadataEditor::writeFlacFile(const QString &filePath, const QList<Metadata
         header[2] = static_cast<char>((block.length >> 8) & 0xFF);
         header[3] = static_cast<char>(block.length & 0xFF);
         
-        qDebug() << "[MetadataEditor] Block header bytes:" 
+        qCDebug(lcMetadata) << "Block header bytes:" 
                  << "[0]=" << QString::number(static_cast<quint8>(header[0]), 16)
                  << "[1]=" << QString::number(static_cast<quint8>(header[1]), 16)
                  << "[2]=" << QString::number(static_cast<quint8>(header[2]), 16)
@@ -535,37 +935,38 @@ bool MetadataEditor::writeFlacFile(const QString &filePath, const QList<Metadata
         
         qint64 headerBytesWritten = tempFile.write(header);
         qint64 dataBytesWritten = tempFile.write(block.data);
-        qDebug() << "[MetadataEditor] Block" << idx << "written - Header:" << headerBytesWritten 
+        qCDebug(lcMetadata) << "Block" << idx << "written - Header:" << headerBytesWritten 
                  << "bytes, Data:" << dataBytesWritten << "bytes";
         totalMetadataWritten += headerBytesWritten + dataBytesWritten;
     }
-    qDebug() << "[MetadataEditor] Total metadata written:" << totalMetadataWritten << "bytes";
+    qCDebug(lcMetadata) << "Total metadata written:" << totalMetadataWritten << "bytes";
     
     // Write audio data
-    qDebug() << "[MetadataEditor] Writing audio data (" << audioData.size() << "bytes)...";
+    qCDebug(lcMetadata) << "Writing audio data (" << audioData.size() << "bytes)...";
     qint64 audioBytesWritten = tempFile.write(audioData);
-    qDebug() << "[MetadataEditor] Audio bytes written:" << audioBytesWritten;
+    qCDebug(lcMetadata) << "Audio bytes written:" << audioBytesWritten;
     
     qint64 totalFileSize = tempFile.size();
+    perf.setBytes(totalFileSize);
     tempFile.close();
-    qDebug() << "[MetadataEditor] Temp file closed, total size:" << totalFileSize;
+    qCDebug(lcMetadata) << "Temp file closed, total size:" << totalFileSize;
     
     // Verify temp file integrity before replacing original
-    qDebug() << "[MetadataEditor] Validating temp file integrity...";
+    qCDebug(lcMetadata) << "Validating temp file integrity...";
     QFile verifyFile(tempPath);
     if (!verifyFile.open(QIODevice::ReadOnly)) {
         m_lastError = "Cannot open temp file for verification";
-        qDebug() << "[MetadataEditor] ERROR: Cannot verify temp file";
+        qCWarning(lcMetadata) << "Cannot verify temp file";
         QFile::remove(tempPath);
         return false;
     }
     
     // Verify file size is reasonable
     qint64 verifySize = verifyFile.size();
-    qDebug() << "[MetadataEditor] Temp file verification - Size:" << verifySize;
+    qCDebug(lcMetadata) << "Temp file verification - Size:" << verifySize;
     if (verifySize < 42) { // Minimum FLAC file size (header + STREAMINFO)
         m_lastError = "Temp file too small to be valid FLAC";
-        qDebug() << "[MetadataEditor] ERROR: Temp file too small";
+        qCWarning(lcMetadata) << "Temp file too small";
         verifyFile.close();
         QFile::remove(tempPath);
         return false;
@@ -574,35 +975,36 @@ bool MetadataEditor::writeFlacFile(const QString &filePath, const QList<Metadata
     // Verify FLAC header
     if (!readFlacHeader(verifyFile)) {
         m_lastError = "Temp file has invalid FLAC header";
-        qDebug() << "[MetadataEditor] ERROR: Temp file failed FLAC header validation";
+        qCWarning(lcMetadata) << "Temp file failed FLAC header validation";
         verifyFile.close();
         QFile::remove(tempPath);
         return false;
     }
     verifyFile.close();
-    qDebug() << "[MetadataEditor] Temp file validation successful";
+    qCDebug(lcMetadata) << "Temp file validation successful";
     
     // Replace original file with temporary file (atomic on most systems)
-    qDebug() << "[MetadataEditor] Replacing original file with validated temp file...";
+    qCDebug(lcMetadata) << "Replacing original file with validated temp file...";
     if (!QFile::remove(filePath)) {
-        qDebug() << "[MetadataEditor] WARNING: Could not remove original file (may not exist)";
+        qCWarning(lcMetadata) << "Could not remove original file (may not exist)";
     }
     
     if (!QFile::rename(tempPath, filePath)) {
         m_lastError = "Failed to replace original file - original may be lost!";
-        qDebug() << "[MetadataEditor] ERROR: Failed to rename temp file to original";
+        qCWarning(lcMetadata) << "Failed to rename temp file to original";
         // Temp file still exists, user can manually recover
         return false;
     }
     
-    qDebug() << "[MetadataEditor] Successfully wrote FLAC file";
-    qDebug() << "[MetadataEditor] Final file path:" << filePath;
+    invalidateCache(filePath);
+    qCDebug(lcMetadata) << "Successfully wrote FLAC file";
+    qCDebug(lcMetadata) << "Final file path:" << filePath;
     
     // Verify final file
     QFile finalFile(filePath);
     if (finalFile.open(QIODevice::ReadOnly)) {
         qint64 finalSize = finalFile.size();
-        qDebug() << "[MetadataEditor] Final file size:" << finalSize;
+        qCDebug(lcMetadata) << "Final file size:" << finalSize;
         finalFile.close();
     }
     
@@ -612,14 +1014,14 @@ bool MetadataEditor::writeFlacFile(const QString &filePath, const QList<Metadata
 
 QByteArray MetadataEditor::createVorbisCommentBlock(const FlacMetadata &metadata, const QMap<QString, QString> &extraFields)
 {
-    qDebug() << "[MetadataEditor] createVorbisCommentBlock called";
+    qCDebug(lcMetadata) << "createVorbisCommentBlock called";
     QByteArray block;
     
     // Vendor string
     QString vendor = "Flac Player v2.0";
     QByteArray vendorUtf8 = vendor.toUtf8();
     quint32 vendorLength = vendorUtf8.size();
-    qDebug() << "[MetadataEditor] Vendor string:" << vendor << "length:" << vendorLength;
+    qCDebug(lcMetadata) << "Vendor string:" << vendor << "length:" << vendorLength;
     
     // Write vendor length (little-endian)
     block.append(static_cast<char>(vendorLength & 0xFF));
@@ -646,6 +1048,16 @@ QByteArray MetadataEditor::createVorbisCommentBlock(const FlacMetadata &metadata
     if (!metadata.trackNumber.isEmpty()) comments.append({"TRACKNUMBER", metadata.trackNumber});
     if (!metadata.comment.isEmpty()) comments.append({"COMMENT", metadata.comment});
     
+    const ReplayGainInfo &gain = metadata.replayGain;
+    if (gain.hasTrack) {
+        comments.append({"REPLAYGAIN_TRACK_GAIN", QString("%1 dB").arg(gain.trackGain, 0, 'f', 2)});
+        comments.append({"REPLAYGAIN_TRACK_PEAK", QString::number(gain.trackPeak, 'f', 6)});
+    }
+    if (gain.hasAlbum) {
+        comments.append({"REPLAYGAIN_ALBUM_GAIN", QString("%1 dB").arg(gain.albumGain, 0, 'f', 2)});
+        comments.append({"REPLAYGAIN_ALBUM_PEAK", QString::number(gain.albumPeak, 'f', 6)});
+    }
+    
     // Add extra fields
     for (auto it = extraFields.constBegin(); it != extraFields.constEnd(); ++it) {
         comments.append({it.key(), it.value()});
@@ -653,7 +1065,7 @@ QByteArray MetadataEditor::createVorbisCommentBlock(const FlacMetadata &metadata
     
     // Write comment count (little-endian)
     quint32 commentCount = comments.size();
-    qDebug() << "[MetadataEditor] Total comments to write:" << commentCount;
+    qCDebug(lcMetadata) << "Total comments to write:" << commentCount;
     block.append(static_cast<char>(commentCount & 0xFF));
     block.append(static_cast<char>((commentCount >> 8) & 0xFF));
     block.append(static_cast<char>((commentCount >> 16) & 0xFF));
@@ -661,7 +1073,7 @@ QByteArray MetadataEditor::createVorbisCommentBlock(const FlacMetadata &metadata
     
     // Write each comment
     for (const auto &comment : comments) {
-        qDebug() << "[MetadataEditor] Writing comment:" << comment.first << "=" << comment.second;
+        qCDebug(lcMetadata) << "Writing comment:" << comment.first << "=" << comment.second;
         QString commentStr = comment.first + "=" + comment.second;
         QByteArray commentUtf8 = commentStr.toUtf8();
         quint32 commentLength = commentUtf8.size();
@@ -676,15 +1088,15 @@ QByteArray MetadataEditor::createVorbisCommentBlock(const FlacMetadata &metadata
         block.append(commentUtf8);
     }
     
-    qDebug() << "[MetadataEditor] Vorbis Comment block created, total size:" << block.size();
+    qCDebug(lcMetadata) << "Vorbis Comment block created, total size:" << block.size();
     return block;
 }
 
 
 QByteArray MetadataEditor::createPictureBlock(const QImage &image)
 {
-    qDebug() << "[MetadataEditor] createPictureBlock called";
-    qDebug() << "[MetadataEditor] Image size:" << image.width() << "x" << image.height();
+    qCDebug(lcMetadata) << "createPictureBlock called";
+    qCDebug(lcMetadata) << "Image size:" << image.width() << "x" << image.height();
     QByteArray block;
     
     // Convert image to PNG
@@ -693,7 +1105,7 @@ QByteArray MetadataEditor::createPictureBlock(const QImage &image)
     buffer.open(QIODevice::WriteOnly);
     bool saveSuccess = image.save(&buffer, "PNG");
     buffer.close();
-    qDebug() << "[MetadataEditor] Image converted to PNG, success:" << saveSuccess 
+    qCDebug(lcMetadata) << "Image converted to PNG, success:" << saveSuccess 
              << "size:" << imageData.size() << "bytes";
     
     // Picture type (3 = front cover, big-endian 32-bit)
@@ -725,7 +1137,7 @@ QByteArray MetadataEditor::createPictureBlock(const QImage &image)
     // Picture data
     block.append(imageData);
     
-    qDebug() << "[MetadataEditor] Picture block created, total size:" << block.size();
+    qCDebug(lcMetadata) << "Picture block created, total size:" << block.size();
     return block;
 }
 
@@ -771,139 +1183,3 @@ void MetadataEditor::writeBigEndian32(QByteArray &data, quint32 value)
     data.append(static_cast<char>((value >> 8) & 0xFF));
     data.append(static_cast<char>(value & 0xFF));
 }
-
-
-MetadataEditorDialog::MetadataEditorDialog(const QString &filePath, QWidget *parent)
-    : QDialog(parent)
-    , ui(new Ui::MetadataEditorDialog)
-    , m_filePath(filePath)
-{
-    qDebug() << "[MetadataEditorDialog] Constructor called for:" << filePath;
-    ui->setupUi(this);
-    qDebug() << "[MetadataEditorDialog] UI setup complete, loading metadata...";
-    loadMetadata();
-    qDebug() << "[MetadataEditorDialog] Metadata loaded, dialog ready";
-}
-
-MetadataEditorDialog::~MetadataEditorDialog()
-{
-    delete ui;
-}
-
-void MetadataEditorDialog::loadMetadata()
-{
-    qDebug() << "[MetadataEditorDialog] loadMetadata called for:" << m_filePath;
-    
-    // Validate file exists
-    if (!QFile::exists(m_filePath)) {
-        QMessageBox::critical(this, "Error", "File does not exist: " + m_filePath);
-        return;
-    }
-    
-    m_metadata = m_editor.readMetadata(m_filePath);
-    
-    if (!m_editor.lastError().isEmpty()) {
-        qDebug() << "[MetadataEditorDialog] ERROR:" << m_editor.lastError();
-        QMessageBox::warning(this, "Error", 
-            "Failed to read metadata: " + m_editor.lastError());
-        return;
-    }
-    qDebug() << "[MetadataEditorDialog] Metadata read successfully";
-    
-    // Populate fields
-    ui->titleEdit->setText(m_metadata.title);
-    ui->artistEdit->setText(m_metadata.artist);
-    ui->albumEdit->setText(m_metadata.album);
-    ui->albumArtistEdit->setText(m_metadata.albumArtist);
-    ui->yearEdit->setText(m_metadata.year);
-    ui->genreEdit->setText(m_metadata.genre);
-    ui->trackNumberEdit->setText(m_metadata.trackNumber);
-    ui->commentEdit->setPlainText(m_metadata.comment);
-    
-    // Update file info with technical details
-    QString info = QString("<b>File:</b> %1<br>").arg(QFileInfo(m_filePath).fileName());
-    if (m_metadata.sampleRate > 0) {
-        info += QString("<b>Format:</b> %1 Hz, %2 bit, %3 channels")
-            .arg(m_metadata.sampleRate)
-            .arg(m_metadata.bitsPerSample)
-            .arg(m_metadata.channels);
-    }
-    ui->fileInfoLabel->setText(info);
-    
-    updateAlbumArtDisplay();
-}
-
-void MetadataEditorDialog::updateAlbumArtDisplay()
-{
-    if (!m_metadata.albumArt.isNull()) {
-        QPixmap pixmap = QPixmap::fromImage(m_metadata.albumArt);
-        QPixmap scaled = pixmap.scaled(200, 200, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-        ui->albumArtLabel->setPixmap(scaled);
-        ui->removeArtButton->setEnabled(true);
-    } else {
-        ui->albumArtLabel->clear();
-        ui->albumArtLabel->setText("No album art");
-        ui->removeArtButton->setEnabled(false);
-    }
-}
-
-void MetadataEditorDialog::onSaveClicked()
-{
-    // Update metadata structure
-    m_metadata.title = ui->titleEdit->text();
-    m_metadata.artist = ui->artistEdit->text();
-    m_metadata.album = ui->albumEdit->text();
-    m_metadata.albumArtist = ui->albumArtistEdit->text();
-    m_metadata.year = ui->yearEdit->text();
-    m_metadata.genre = ui->genreEdit->text();
-    m_metadata.trackNumber = ui->trackNumberEdit->text();
-    m_metadata.comment = ui->commentEdit->toPlainText();
-    
-    // Write to file
-    if (m_editor.writeMetadata(m_filePath, m_metadata)) {
-        QMessageBox::information(this, "Success", "Metadata saved successfully!");
-        accept();
-    } else {
-        QMessageBox::critical(this, "Error", 
-            "Failed to save metadata: " + m_editor.lastError());
-    }
-}
-
-void MetadataEditorDialog::onCancelClicked()
-{
-    reject();
-}
-
-void MetadataEditorDialog::onLoadAlbumArtClicked()
-{
-    QString fileName = QFileDialog::getOpenFileName(
-        this,
-        "Select Album Art",
-        "",
-        "Images (*.png *.jpg *.jpeg *.bmp);;All Files (*)"
-    );
-    
-    if (fileName.isEmpty()) {
-        return;
-    }
-    
-    QImage image(fileName);
-    if (image.isNull()) {
-        QMessageBox::warning(this, "Error", "Failed to load image file.");
-        return;
-    }
-    
-    // Resize if too large (keep under 1000x1000)
-    if (image.width() > 1000 || image.height() > 1000) {
-        image = image.scaled(1000, 1000, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    }
-    
-    m_metadata.albumArt = image;
-    updateAlbumArtDisplay();
-}
-
-void MetadataEditorDialog::onRemoveAlbumArtClicked()
-{
-    m_metadata.albumArt = QImage();
-    updateAlbumArtDisplay();
-}
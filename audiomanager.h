@@ -3,16 +3,30 @@
 
 #include <QString>
 #include <QMap>
+#include <QList>
 #include <QByteArray>
 #include <QImage>
 #include <QFile>
-#include <QDialog>
 
-QT_BEGIN_NAMESPACE
-namespace Ui {
-class MetadataEditorDialog;
-}
-QT_END_NAMESPACE
+//one audio track from an embedded CUESHEET block, sample offsets are absolute in the file
+struct CueTrack {
+    int number = 0;
+    quint64 startSample = 0;   //offset of INDEX 01 (falls back to the first index point)
+    quint64 endSample = 0;     //start of the next track, or the lead-out for the last one
+    QString isrc;
+};
+
+//REPLAYGAIN_* tags: gains in dB towards the -18 LUFS reference, peaks linear (1.0 = full scale)
+struct ReplayGainInfo {
+    bool hasTrack = false;
+    double trackGain = 0.0;
+    double trackPeak = 0.0;
+    bool hasAlbum = false;
+    double albumGain = 0.0;
+    double albumPeak = 0.0;
+    
+    bool isEmpty() const { return !hasTrack && !hasAlbum; }
+};
 
 /**
  * @struct FlacMetadata
@@ -28,37 +42,67 @@ struct FlacMetadata {
     QString trackNumber;
     QString comment;
     QImage albumArt;
+    ReplayGainInfo replayGain;
     
     // Technical info (read-only)
     int sampleRate = 0;
     int channels = 0;
     int bitsPerSample = 0;
     quint64 totalSamples = 0;
+    QByteArray audioMd5;        // MD5 of the unencoded audio from STREAMINFO, all zero if the encoder skipped it
+    
+    // Tracks from an embedded CUESHEET, empty for ordinary single-track files
+    QList<CueTrack> cueTracks;
     
     FlacMetadata() = default;
 };
 
 
-//custom FLAC metadata reader/writer with vorbis comment support
+//custom FLAC metadata reader/writer with vorbis comment support.
+//M4A/ALAC and WAV tags are read (not written) through libavformat with capped probing.
+//reads go through a process-wide cache keyed on path, size and mtime
 class MetadataEditor
 {
 public:
+    //which parts of the file readMetadata() parses, leaving out pictures makes bulk scans much cheaper
+    enum MetadataField {
+        FieldStreamInfo = 0x1,
+        FieldTags = 0x2,
+        FieldAlbumArt = 0x4,
+        FieldCueSheet = 0x8,
+        FieldAll = FieldStreamInfo | FieldTags | FieldAlbumArt | FieldCueSheet
+    };
+    Q_DECLARE_FLAGS(MetadataFields, MetadataField)
+
     MetadataEditor();
     ~MetadataEditor();
     
  
      //reads metadata from the given file path and returns a FlacMetadata struct
-    FlacMetadata readMetadata(const QString &filePath);
+    FlacMetadata readMetadata(const QString &filePath, MetadataFields fields = FieldAll);
+     //true for the formats readMetadata() can parse without the media backend
+    static bool canReadTags(const QString &filePath);
+     //parses a FLAC stream held in memory (header and metadata blocks), used by the fuzz and bench harnesses
+    FlacMetadata parseMetadata(const QByteArray &data, MetadataFields fields = FieldAll);
+     //drops a cached entry, writes do this automatically
+    static void invalidateCache(const QString &filePath);
+    static void clearCache();
+     //reads only STREAMINFO and the CUESHEET (no picture decoding), used when queueing album images
+    QList<CueTrack> readCueTracks(const QString &filePath, int *sampleRate = nullptr);
      //checks for valid lossless file
 bool isValidFlacFile(const QString &filePath);
     //writes metadata to the given file path from a FlacMetadata struct
 bool writeMetadata(const QString &filePath, const FlacMetadata &metadata);
     //updating specific field in the metadata
 bool updateField(const QString &filePath, const QString &fieldName, const QString &value);
+    //sets one field by its tag name (TITLE, ARTIST, DATE/YEAR, TRACKNUMBER/TRACK, ...), false when unknown
+static bool setField(FlacMetadata &metadata, const QString &fieldName, const QString &value);
     //updatinf album art in the metadata
 bool updateAlbumArt(const QString &filePath, const QImage &image);
     //removing albumArt from the metaD of the file 
 bool removeAlbumArt(const QString &filePath);
+    //replaces the REPLAYGAIN_* comments and leaves every other block and tag as it is (FLAC only)
+bool writeReplayGain(const QString &filePath, const ReplayGainInfo &gain);
         //returns last error message
     QString lastError() const { return m_lastError; }
     
@@ -73,11 +117,17 @@ private:
     };
     
     // Reading helpers
-    bool readFlacHeader(QFile &file);
-    QList<MetadataBlock> readMetadataBlocks(QFile &file);
+    FlacMetadata readFlacMetadata(const QString &filePath, MetadataFields fields);
+    FlacMetadata readContainerMetadata(const QString &filePath, MetadataFields fields);
+    static bool isContainerFormat(const QString &filePath);
+    FlacMetadata parseFlacStream(QIODevice &device, MetadataFields fields);
+    bool readFlacHeader(QIODevice &file);
+    //blocks whose type bit is set in skipTypeMask are seeked over, their data is left empty
+    QList<MetadataBlock> readMetadataBlocks(QIODevice &file, quint32 skipTypeMask = 0);
     FlacMetadata parseStreamInfo(const QByteArray &data);
     QMap<QString, QString> parseVorbisComment(const QByteArray &data);
     QImage parsePictureBlock(const QByteArray &data);
+    QList<CueTrack> parseCueSheet(const QByteArray &data);
     
     // Writing helpers
     bool writeFlacFile(const QString &filePath, const QList<MetadataBlock> &blocks, const QByteArray &audioData);
@@ -104,29 +154,6 @@ private:
     static const quint8 BLOCK_TYPE_PICTURE = 6;
 };
 
-//UI dialog for metadata editing
-class MetadataEditorDialog : public QDialog
-{
-    Q_OBJECT
-
-public:
-    explicit MetadataEditorDialog(const QString &filePath, QWidget *parent = nullptr);
-    ~MetadataEditorDialog();
-
-private slots:
-    void onSaveClicked();
-    void onCancelClicked();
-    void onLoadAlbumArtClicked();
-    void onRemoveAlbumArtClicked();
-
-private:
-    void loadMetadata();
-    void updateAlbumArtDisplay();
-
-    Ui::MetadataEditorDialog *ui;
-    QString m_filePath;
-    MetadataEditor m_editor;
-    FlacMetadata m_metadata;
-};
+Q_DECLARE_OPERATORS_FOR_FLAGS(MetadataEditor::MetadataFields)
 
 #endif // AUDIOMANAGER_H
@@ -0,0 +1,67 @@
+#include "audiotap.h"
+#include "dspkernels.h"
+#include <chrono>
+
+namespace {
+    qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+AudioTap::AudioTap()
+    : m_ring(Capacity)
+    , m_scratch(size_t(BlockFrames) * MaxChannels)
+    , m_mono(size_t(BlockFrames))
+{
+}
+
+void AudioTap::push(const QAudioFormat &format, const char *data, qint64 frames)
+{
+    const int channels = format.channelCount();
+    const int bytesPerFrame = format.bytesPerFrame();
+    if (channels <= 0 || channels > MaxChannels || frames <= 0) {
+        return;
+    }
+
+    const qint64 start = nowNs();
+    const qint64 total = frames;
+    qint64 dropped = 0;
+    while (frames > 0) {
+        const qint64 block = qMin<qint64>(frames, BlockFrames);
+        Dsp::toFloat(format.sampleFormat(), data, m_scratch.data(), size_t(block) * size_t(channels));
+        Dsp::downmix(m_scratch.data(), channels, size_t(block), m_mono.data());
+        dropped += block - qint64(m_ring.write(m_mono.data(), size_t(block)));
+        data += block * bytesPerFrame;
+        frames -= block;
+    }
+
+    m_blocks.fetch_add(1, std::memory_order_relaxed);
+    m_frames.fetch_add(total, std::memory_order_relaxed);
+    m_totalNs.fetch_add(nowNs() - start, std::memory_order_relaxed);
+    if (dropped > 0) {
+        m_dropped.fetch_add(dropped, std::memory_order_relaxed);
+    }
+}
+
+TapStats AudioTap::stats() const
+{
+    TapStats stats;
+    stats.blocks = m_blocks.load(std::memory_order_relaxed);
+    stats.frames = m_frames.load(std::memory_order_relaxed);
+    stats.dropped = m_dropped.load(std::memory_order_relaxed);
+    const int rate = sampleRate();
+    if (stats.frames > 0 && rate > 0) {
+        stats.load = double(m_totalNs.load(std::memory_order_relaxed)) / (double(stats.frames) * 1e9 / rate);
+    }
+    return stats;
+}
+
+void AudioTap::resetStats()
+{
+    m_blocks.store(0, std::memory_order_relaxed);
+    m_frames.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+    m_totalNs.store(0, std::memory_order_relaxed);
+}
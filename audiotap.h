@@ -0,0 +1,67 @@
+#ifndef AUDIOTAP_H
+#define AUDIOTAP_H
+
+#include <QAudioFormat>
+#include <QtGlobal>
+#include <atomic>
+#include <vector>
+#include "ringbuffer.h"
+
+//cumulative cost of the tap on the audio thread since the last reset
+struct TapStats {
+    qint64 blocks = 0;
+    qint64 frames = 0;
+    qint64 dropped = 0;         // samples the reader didn't make room for
+    double load = 0.0;          // audio thread time over the audio time tapped, 0.01 = 1 %
+};
+
+//mono copy of what the native engine hands the sink, for the visualisations. the audio thread
+//mixes each read down to one channel and writes it into an SPSC ring, one reader thread takes it
+//from there. a full ring drops the new samples, the audio thread never waits for a slow reader.
+//disabled (the default) the audio thread only checks the flag
+class AudioTap
+{
+public:
+    static constexpr size_t Capacity = size_t(1) << 15;    // mono samples, about 0.7 s at 48 kHz
+    static constexpr int BlockFrames = 256;
+    static constexpr int MaxChannels = 8;
+
+    AudioTap();
+
+    // Any thread
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+    int sampleRate() const { return m_sampleRate.load(std::memory_order_relaxed); }
+    //roughly how far the sink's own buffer keeps the tapped samples ahead of what is heard
+    int delayFrames() const { return m_delayFrames.load(std::memory_order_relaxed); }
+    TapStats stats() const;
+    void resetStats();
+
+    // GUI thread, set with every pipeline start
+    void setSampleRate(int sampleRate) { m_sampleRate.store(sampleRate, std::memory_order_relaxed); }
+    void setDelayFrames(int frames) { m_delayFrames.store(frames, std::memory_order_relaxed); }
+
+    // Audio thread, never blocks or allocates
+    void push(const QAudioFormat &format, const char *data, qint64 frames);
+
+    // Reader thread
+    size_t available() const { return m_ring.available(); }
+    size_t read(float *out, size_t count) { return m_ring.read(out, count); }
+
+private:
+    SpscRingBuffer<float> m_ring;
+    std::atomic<bool> m_enabled{false};
+    std::atomic<int> m_sampleRate{44100};
+    std::atomic<int> m_delayFrames{0};
+
+    // Audio side, one block each
+    std::vector<float> m_scratch;
+    std::vector<float> m_mono;
+
+    std::atomic<qint64> m_blocks{0};
+    std::atomic<qint64> m_frames{0};
+    std::atomic<qint64> m_dropped{0};
+    std::atomic<qint64> m_totalNs{0};
+};
+
+#endif // AUDIOTAP_H
@@ -0,0 +1,221 @@
+#include "batchconverter.h"
+#include "loudnessscanner.h"
+#include "logging.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <algorithm>
+
+QString ConvertResult::statusName(Status status)
+{
+    switch (status) {
+        case Converted:
+            return "OK";
+        case Skipped:
+            return "SKIPPED";
+        case Failed:
+            return "ERROR";
+        case Cancelled:
+            return "CANCELLED";
+    }
+    return "ERROR";
+}
+
+BatchConverter::BatchConverter(QObject *parent)
+    : QObject(parent)
+{
+}
+
+BatchConverter::~BatchConverter()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+QList<BatchConverter::Job> BatchConverter::planJobs(const QStringList &paths, const QString &outputDir)
+{
+    auto target = [&outputDir](const QFileInfo &source, const QString &relativeDir) {
+        const QString name = source.completeBaseName() + ".mp3";
+        if (outputDir.isEmpty()) {
+            return source.absoluteDir().filePath(name);
+        }
+        // Files at the top of a tree come back as "" or "." depending on the Qt version
+        const QString relative = relativeDir.isEmpty() ? QString(".") : relativeDir;
+        return QDir::cleanPath(QDir(outputDir).absoluteFilePath(relative + "/" + name));
+    };
+
+    QList<Job> jobs;
+    for (const QString &path : paths) {
+        const QFileInfo info(path);
+        if (info.isDir()) {
+            const QDir root(info.absoluteFilePath());
+            for (const QString &file : LoudnessScanner::collectAudioFiles({root.absolutePath()})) {
+                const QFileInfo source(file);
+                jobs.append({source.absoluteFilePath(), target(source, root.relativeFilePath(source.absolutePath()))});
+            }
+        } else if (info.isFile()) {
+            jobs.append({info.absoluteFilePath(), target(info, ".")});
+        }
+    }
+
+    // Output names are compared ignoring case for the filesystems that do
+    auto key = [](const QString &path) { return QDir::cleanPath(path).toLower(); };
+
+    // A file named on its own and through its folder is converted once, and an .mp3 named
+    // without an output folder would be encoded over itself
+    QSet<QString> inputs;
+    jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&key, &inputs](const Job &job) {
+        const QString input = QDir::cleanPath(job.input);
+        if (key(input) == key(job.output) || inputs.contains(input)) {
+            return true;
+        }
+        inputs.insert(input);
+        return false;
+    }), jobs.end());
+
+    // song.flac and song.wav in one folder both want song.mp3, running at once they would write
+    // the same partial file. every input of a shared name keeps its extension ("song.flac.mp3"),
+    // so the names don't depend on the order the folders were listed in
+    QHash<QString, int> claims;
+    for (const Job &job : jobs) {
+        ++claims[key(job.output)];
+    }
+    QSet<QString> taken;
+    for (Job &job : jobs) {
+        const QFileInfo source(job.input);
+        const QDir dir = QFileInfo(job.output).absoluteDir();
+        if (claims.value(key(job.output)) > 1) {
+            job.output = dir.filePath(source.completeBaseName() + "." + source.suffix() + ".mp3");
+        }
+        // Only left when that name was someone's plain output as well
+        for (int n = 2; taken.contains(key(job.output)); ++n) {
+            job.output = dir.filePath(QString("%1.%2 (%3).mp3").arg(source.completeBaseName(), source.suffix()).arg(n));
+        }
+        taken.insert(key(job.output));
+    }
+    return jobs;
+}
+
+void BatchConverter::start(const QList<Job> &jobs, int maxThreads)
+{
+    m_cancelled = false;
+    m_total = jobs.size();
+    m_pending = m_total;
+    m_done = 0;
+    m_failures = 0;
+    m_totalBytes = 0;
+    m_timer.start();
+
+    m_pool.setMaxThreadCount(maxThreads > 0 ? maxThreads : QThread::idealThreadCount());
+
+    if (jobs.isEmpty()) {
+        emit finished(0, 0, 0);
+        return;
+    }
+
+    // Whole files in parallel scale best, the spare threads of a short list decode within each file
+    const int decodeThreads = qMax(1, m_pool.maxThreadCount() / int(jobs.size()));
+    for (const Job &job : jobs) {
+        m_pool.start([this, job, decodeThreads]() {
+            ConvertResult result = convertFile(job, decodeThreads);
+            QMetaObject::invokeMethod(this, [this, result]() { onResult(result); }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void BatchConverter::cancel()
+{
+    m_cancelled = true;
+}
+
+//runs on a pool thread
+ConvertResult BatchConverter::convertFile(const Job &job, int decodeThreads)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    ConvertResult result;
+    result.inputPath = job.input;
+    result.outputPath = job.output;
+    result.bytes = QFileInfo(job.input).size();
+
+    if (m_cancelled) {
+        result.status = ConvertResult::Cancelled;
+        return result;
+    }
+    if (!m_overwrite && QFileInfo::exists(job.output)) {
+        result.status = ConvertResult::Skipped;
+        result.message = "output exists";
+        return result;
+    }
+    if (!QDir().mkpath(QFileInfo(job.output).absolutePath())) {
+        result.message = "cannot create " + QFileInfo(job.output).absolutePath();
+        return result;
+    }
+
+    // The muxer is picked by the name, so the temporary keeps the extension
+    const QFileInfo output(job.output);
+    const QString partial = output.absoluteDir().filePath(output.completeBaseName() + ".part.mp3");
+    AudioConverter converter;
+    converter.setResamplerProfile(m_profile);
+    converter.setDecodeThreads(decodeThreads);
+    bool success = false;
+    int reported = 0;
+    // Both signals come synchronously from convertToMP3() on this thread
+    connect(&converter, &AudioConverter::progressUpdated, &converter, [this, &converter, &job, &reported](int percentage) {
+        if (m_cancelled) {
+            converter.cancel();
+            return;
+        }
+        if (percentage >= reported + ProgressStep && percentage < 100) {
+            reported = percentage - percentage % ProgressStep;
+            const QString input = job.input;
+            const int step = reported;
+            QMetaObject::invokeMethod(this, [this, input, step]() { emit fileProgress(input, step); }, Qt::QueuedConnection);
+        }
+    }, Qt::DirectConnection);
+    connect(&converter, &AudioConverter::conversionComplete, &converter, [&success, &result](bool ok, const QString &message) {
+        success = ok;
+        result.message = message;
+    }, Qt::DirectConnection);
+
+    converter.convertToMP3(job.input, partial, m_bitrate);
+
+    if (success) {
+        QFile::remove(job.output);
+        if (QFile::rename(partial, job.output)) {
+            result.status = ConvertResult::Converted;
+            result.message.clear();
+        } else {
+            result.message = "cannot rename to " + job.output;
+        }
+    } else {
+        result.status = m_cancelled ? ConvertResult::Cancelled : ConvertResult::Failed;
+    }
+    QFile::remove(partial);
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+void BatchConverter::onResult(const ConvertResult &result)
+{
+    ++m_done;
+    --m_pending;
+    m_totalBytes += result.bytes;
+    if (result.status == ConvertResult::Converted) {
+        PerfLog::record("convert", "convert_file", result.elapsedMs * 1000, result.bytes, result.inputPath);
+    }
+    if (result.isProblem()) {
+        ++m_failures;
+    }
+
+    emit fileConverted(result);
+    emit progressUpdated(m_done, m_total);
+
+    if (m_pending == 0) {
+        emit finished(m_failures, m_totalBytes, m_timer.elapsed());
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef BATCHCONVERTER_H
+#define BATCHCONVERTER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <atomic>
+#include "audioconverter.h"
+
+//outcome of converting one file
+struct ConvertResult {
+    enum Status {
+        Converted,
+        Skipped,        // The output was already there and overwriting is off
+        Failed,
+        Cancelled
+    };
+
+    QString inputPath;
+    QString outputPath;
+    Status status = Failed;
+    QString message;
+    qint64 bytes = 0;           // Size of the input on disk
+    qint64 elapsedMs = 0;
+
+    bool isProblem() const { return status == Failed; }
+    static QString statusName(Status status);
+};
+Q_DECLARE_METATYPE(ConvertResult)
+
+//converts many files to MP3 on a thread pool, one AudioConverter per file. the output is written
+//to "<name>.part.mp3" and renamed once it is complete, so an interrupted run never leaves a file
+//that a later run would take for finished. results are delivered on the thread that owns the
+//converter
+class BatchConverter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Job {
+        QString input;
+        QString output;
+    };
+
+    explicit BatchConverter(QObject *parent = nullptr);
+    ~BatchConverter();
+
+    //the audio files below the given files and directories with their .mp3 targets. files of a
+    //directory keep their layout under outputDir, an empty outputDir puts each output next to
+    //its source. inputs that would share a target keep their extension in its name, an input
+    //that is its own target is left out
+    static QList<Job> planJobs(const QStringList &paths, const QString &outputDir = QString());
+
+    void setBitrate(AudioConverter::BitratePreset bitrate) { m_bitrate = bitrate; }
+    void setResamplerProfile(ResamplerProfile profile) { m_profile = profile; }
+    void setOverwrite(bool overwrite) { m_overwrite = overwrite; }
+
+    void start(const QList<Job> &jobs, int maxThreads = 0);
+    void cancel();
+    bool isRunning() const { return m_pending > 0; }
+
+signals:
+    //a file's own progress in steps of ProgressStep percent
+    void fileProgress(const QString &inputPath, int percentage);
+    void fileConverted(const ConvertResult &result);
+    void progressUpdated(int done, int total);
+    void finished(int failures, qint64 totalBytes, qint64 elapsedMs);
+
+private:
+    static constexpr int ProgressStep = 10;
+
+    ConvertResult convertFile(const Job &job, int decodeThreads);
+    void onResult(const ConvertResult &result);
+
+    QThreadPool m_pool;
+    std::atomic<bool> m_cancelled{false};
+    AudioConverter::BitratePreset m_bitrate = AudioConverter::Bitrate_320;
+    ResamplerProfile m_profile = ResamplerProfile::Balanced;
+    bool m_overwrite = false;
+    int m_pending = 0;
+    int m_total = 0;
+    int m_done = 0;
+    int m_failures = 0;
+    qint64 m_totalBytes = 0;
+    QElapsedTimer m_timer;
+};
+
+#endif // BATCHCONVERTER_H
@@ -0,0 +1,413 @@
+#include "clicommands.h"
+#include "audiomanager.h"
+#include "batchconverter.h"
+#include "flacverifier.h"
+#include "loudnessscanner.h"
+#include <QEventLoop>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <functional>
+
+namespace {
+    // The command that interrupt() stops, set while its event loop runs
+    std::function<void()> s_cancelRunning;
+    bool s_interrupted = false;
+
+    struct Running {
+        explicit Running(std::function<void()> cancel) { s_cancelRunning = std::move(cancel); }
+        ~Running() { s_cancelRunning = nullptr; }
+    };
+
+    void emitEvent(QTextStream &out, const QString &event, QJsonObject fields)
+    {
+        fields.insert("event", event);
+        out << QString::fromUtf8(QJsonDocument(fields).toJson(QJsonDocument::Compact)) << Qt::endl;
+    }
+
+    int usageError(QTextStream &err, const QString &message)
+    {
+        err << "flacplayer-cli: " << message << Qt::endl << Qt::endl << Cli::usage();
+        err.flush();
+        return Cli::UsageError;
+    }
+
+    //removes "--name VALUE" from args. false when the option is there without a value
+    bool takeOption(QStringList &args, const QString &name, QString &value)
+    {
+        const int index = args.indexOf(name);
+        if (index < 0) {
+            return true;
+        }
+        if (index + 1 >= args.size()) {
+            return false;
+        }
+        value = args[index + 1];
+        args.remove(index, 2);
+        return true;
+    }
+
+    bool takeFlag(QStringList &args, const QString &name)
+    {
+        return args.removeAll(name) > 0;
+    }
+
+    //--jobs N, 0 (the default) uses every core
+    bool takeJobs(QStringList &args, int &jobs, QTextStream &err)
+    {
+        QString value;
+        if (!takeOption(args, "--jobs", value)) {
+            usageError(err, "--jobs needs a number");
+            return false;
+        }
+        if (value.isEmpty()) {
+            jobs = 0;
+            return true;
+        }
+        bool ok = false;
+        jobs = value.toInt(&ok);
+        if (!ok || jobs < 0) {
+            usageError(err, "invalid --jobs value: " + value);
+            return false;
+        }
+        return true;
+    }
+
+    //whatever is left over must be paths
+    bool checkPaths(const QStringList &args, QTextStream &err)
+    {
+        for (const QString &arg : args) {
+            if (arg.startsWith("--")) {
+                usageError(err, "unknown option " + arg);
+                return false;
+            }
+        }
+        if (args.isEmpty()) {
+            usageError(err, "no files or folders given");
+            return false;
+        }
+        return true;
+    }
+
+    int exitCode(int problems)
+    {
+        if (s_interrupted) {
+            return Cli::Interrupted;
+        }
+        return problems > 0 ? Cli::Failures : Cli::Success;
+    }
+
+    QJsonObject doneFields(int problems, qint64 elapsedMs)
+    {
+        QJsonObject fields;
+        fields.insert("problems", problems);
+        fields.insert("elapsed_ms", elapsedMs);
+        fields.insert("interrupted", s_interrupted);
+        return fields;
+    }
+
+    int runConvert(QStringList args, QTextStream &out, QTextStream &err)
+    {
+        int jobs = 0;
+        if (!takeJobs(args, jobs, err)) {
+            return Cli::UsageError;
+        }
+
+        QString bitrateName = "320";
+        QString outputDir;
+        QString resamplerName = "balanced";
+        if (!takeOption(args, "--bitrate", bitrateName) || !takeOption(args, "--output", outputDir)
+            || !takeOption(args, "--resampler", resamplerName)) {
+            return usageError(err, "option without a value");
+        }
+        const bool overwrite = takeFlag(args, "--overwrite");
+
+        static const QMap<QString, AudioConverter::BitratePreset> bitrates = {
+            {"128", AudioConverter::Bitrate_128}, {"192", AudioConverter::Bitrate_192},
+            {"256", AudioConverter::Bitrate_256}, {"320", AudioConverter::Bitrate_320}};
+        static const QMap<QString, ResamplerProfile> profiles = {
+            {"fast", ResamplerProfile::Fast}, {"balanced", ResamplerProfile::Balanced},
+            {"high", ResamplerProfile::HighQuality}, {"soxr", ResamplerProfile::Soxr}};
+        if (!bitrates.contains(bitrateName)) {
+            return usageError(err, "invalid --bitrate " + bitrateName + ", use 128, 192, 256 or 320");
+        }
+        if (!profiles.contains(resamplerName)) {
+            return usageError(err, "invalid --resampler " + resamplerName + ", use fast, balanced, high or soxr");
+        }
+        if (!checkPaths(args, err)) {
+            return Cli::UsageError;
+        }
+
+        const QList<BatchConverter::Job> plan = BatchConverter::planJobs(args, outputDir);
+        if (plan.isEmpty()) {
+            return usageError(err, "no audio files found");
+        }
+
+        BatchConverter converter;
+        converter.setBitrate(bitrates.value(bitrateName));
+        converter.setResamplerProfile(profiles.value(resamplerName));
+        converter.setOverwrite(overwrite);
+
+        QEventLoop loop;
+        QObject::connect(&converter, &BatchConverter::fileProgress, [&out](const QString &inputPath, int percentage) {
+            emitEvent(out, "progress", {{"file", inputPath}, {"percent", percentage}});
+        });
+        QObject::connect(&converter, &BatchConverter::fileConverted, [&out](const ConvertResult &result) {
+            QJsonObject fields{{"status", ConvertResult::statusName(result.status)}, {"file", result.inputPath},
+                               {"output", result.outputPath}, {"elapsed_ms", result.elapsedMs}};
+            if (!result.message.isEmpty()) {
+                fields.insert("message", result.message);
+            }
+            emitEvent(out, "file", fields);
+        });
+        QObject::connect(&converter, &BatchConverter::finished, [&out, &loop](int failures, qint64 totalBytes, qint64 elapsedMs) {
+            QJsonObject fields = doneFields(failures, elapsedMs);
+            fields.insert("bytes", totalBytes);
+            emitEvent(out, "done", fields);
+            loop.exit(exitCode(failures));
+        });
+
+        Running running([&converter]() { converter.cancel(); });
+        emitEvent(out, "start", {{"command", "convert"}, {"files", int(plan.size())}});
+        converter.start(plan, jobs);
+        return loop.exec();
+    }
+
+    int runVerify(QStringList args, QTextStream &out, QTextStream &err)
+    {
+        int jobs = 0;
+        if (!takeJobs(args, jobs, err) || !checkPaths(args, err)) {
+            return Cli::UsageError;
+        }
+        const QStringList files = FlacVerifier::collectFlacFiles(args);
+        if (files.isEmpty()) {
+            return usageError(err, "no FLAC files found");
+        }
+
+        FlacVerifier verifier;
+        QEventLoop loop;
+        QObject::connect(&verifier, &FlacVerifier::fileVerified, [&out](const VerifyResult &result) {
+            QJsonObject fields{{"status", VerifyResult::statusName(result.status)}, {"file", result.filePath},
+                               {"elapsed_ms", result.elapsedMs}};
+            if (!result.message.isEmpty()) {
+                fields.insert("message", result.message);
+            }
+            emitEvent(out, "file", fields);
+        });
+        QObject::connect(&verifier, &FlacVerifier::finished, [&out, &loop](int problems, qint64 totalBytes, qint64 elapsedMs) {
+            QJsonObject fields = doneFields(problems, elapsedMs);
+            fields.insert("bytes", totalBytes);
+            emitEvent(out, "done", fields);
+            loop.exit(exitCode(problems));
+        });
+
+        Running running([&verifier]() { verifier.cancel(); });
+        emitEvent(out, "start", {{"command", "verify"}, {"files", int(files.size())}});
+        verifier.start(files, jobs);
+        return loop.exec();
+    }
+
+    int runScan(QStringList args, QTextStream &out, QTextStream &err)
+    {
+        int jobs = 0;
+        if (!takeJobs(args, jobs, err)) {
+            return Cli::UsageError;
+        }
+        const bool writeTags = takeFlag(args, "--write-tags");
+        if (!checkPaths(args, err)) {
+            return Cli::UsageError;
+        }
+        const QStringList files = LoudnessScanner::collectAudioFiles(args);
+        if (files.isEmpty()) {
+            return usageError(err, "no audio files found");
+        }
+
+        LoudnessScanner scanner;
+        QEventLoop loop;
+        int tagFailures = 0;
+        QObject::connect(&scanner, &LoudnessScanner::trackScanned, [&out](const LoudnessResult &result) {
+            QJsonObject fields{{"status", result.ok ? "OK" : "ERROR"}, {"file", result.filePath},
+                               {"elapsed_ms", result.elapsedMs}};
+            if (result.ok) {
+                fields.insert("lufs", result.integratedLufs);
+                fields.insert("range_lu", result.rangeLu);
+                fields.insert("peak", result.truePeak);
+                fields.insert("gain_db", result.gainDb);
+            } else {
+                fields.insert("message", result.message);
+            }
+            emitEvent(out, "file", fields);
+        });
+        QObject::connect(&scanner, &LoudnessScanner::albumScanned, [&out](const AlbumLoudness &album) {
+            emitEvent(out, "album", {{"album", album.albumKey}, {"tracks", int(album.files.size())},
+                                     {"lufs", album.integratedLufs}, {"range_lu", album.rangeLu},
+                                     {"peak", album.truePeak}, {"gain_db", album.gainDb}});
+        });
+        QObject::connect(&scanner, &LoudnessScanner::tagsWritten, [&out, &tagFailures](const QString &filePath, bool ok, const QString &message) {
+            QJsonObject fields{{"status", ok ? "OK" : "ERROR"}, {"file", filePath}};
+            if (!ok) {
+                ++tagFailures;
+                fields.insert("message", message);
+            }
+            emitEvent(out, "tags", fields);
+        });
+        QObject::connect(&scanner, &LoudnessScanner::finished, [&out, &loop, &tagFailures](int failures, qint64 audioMs, qint64 elapsedMs) {
+            // A track whose tags couldn't be written is as much a failure for cron as one that didn't decode
+            QJsonObject fields = doneFields(failures + tagFailures, elapsedMs);
+            fields.insert("audio_ms", audioMs);
+            emitEvent(out, "done", fields);
+            loop.exit(exitCode(failures + tagFailures));
+        });
+
+        Running running([&scanner]() { scanner.cancel(); });
+        emitEvent(out, "start", {{"command", "scan"}, {"files", int(files.size())}});
+        scanner.start(files, writeTags, jobs);
+        return loop.exec();
+    }
+
+    QJsonObject tagsObject(const FlacMetadata &metadata)
+    {
+        QJsonObject tags{{"TITLE", metadata.title}, {"ARTIST", metadata.artist}, {"ALBUM", metadata.album},
+                         {"ALBUMARTIST", metadata.albumArtist}, {"DATE", metadata.year}, {"GENRE", metadata.genre},
+                         {"TRACKNUMBER", metadata.trackNumber}, {"COMMENT", metadata.comment}};
+        if (metadata.replayGain.hasTrack) {
+            tags.insert("REPLAYGAIN_TRACK_GAIN", metadata.replayGain.trackGain);
+            tags.insert("REPLAYGAIN_TRACK_PEAK", metadata.replayGain.trackPeak);
+        }
+        if (metadata.replayGain.hasAlbum) {
+            tags.insert("REPLAYGAIN_ALBUM_GAIN", metadata.replayGain.albumGain);
+            tags.insert("REPLAYGAIN_ALBUM_PEAK", metadata.replayGain.albumPeak);
+        }
+        return tags;
+    }
+
+    int runTag(QStringList args, QTextStream &out, QTextStream &err)
+    {
+        if (args.size() < 2 || (args[0] != "get" && args[0] != "set")) {
+            return usageError(err, "use tag get <file> [FIELD...] or tag set <file> FIELD=VALUE...");
+        }
+        const QString action = args.takeFirst();
+        const QString filePath = args.takeFirst();
+        if (!QFileInfo(filePath).isFile()) {
+            err << "flacplayer-cli: no such file: " << filePath << Qt::endl;
+            return Cli::Failures;
+        }
+
+        MetadataEditor editor;
+        if (action == "get") {
+            const FlacMetadata metadata = editor.readMetadata(filePath, MetadataEditor::FieldStreamInfo | MetadataEditor::FieldTags);
+            if (!editor.lastError().isEmpty()) {
+                err << "flacplayer-cli: " << editor.lastError() << Qt::endl;
+                return Cli::Failures;
+            }
+            const QJsonObject allTags = tagsObject(metadata);
+            QJsonObject tags;
+            for (const QString &field : args) {
+                // setField() knows the aliases (YEAR, TRACK, ...), whichever key the marker lands in is the one
+                const QString marker = "\x01";
+                FlacMetadata probe;
+                if (!MetadataEditor::setField(probe, field, marker)) {
+                    return usageError(err, "unknown field " + field);
+                }
+                const QJsonObject probed = tagsObject(probe);
+                for (auto it = probed.begin(); it != probed.end(); ++it) {
+                    if (it.value().toString() == marker) {
+                        tags.insert(field.toUpper(), allTags.value(it.key()));
+                    }
+                }
+            }
+            if (args.isEmpty()) {
+                tags = allTags;
+            }
+
+            QJsonObject result{{"file", filePath}, {"tags", tags}};
+            if (args.isEmpty()) {
+                result.insert("sample_rate", metadata.sampleRate);
+                result.insert("channels", metadata.channels);
+                result.insert("bits_per_sample", metadata.bitsPerSample);
+                result.insert("total_samples", qint64(metadata.totalSamples));
+            }
+            out << QString::fromUtf8(QJsonDocument(result).toJson(QJsonDocument::Compact)) << Qt::endl;
+            return Cli::Success;
+        }
+
+        if (args.isEmpty()) {
+            return usageError(err, "tag set needs at least one FIELD=VALUE");
+        }
+        // The whole file is read so writing it back keeps the picture and cue sheet
+        FlacMetadata metadata = editor.readMetadata(filePath, MetadataEditor::FieldAll);
+        if (!editor.lastError().isEmpty()) {
+            err << "flacplayer-cli: " << editor.lastError() << Qt::endl;
+            return Cli::Failures;
+        }
+        for (const QString &assignment : args) {
+            const int equals = assignment.indexOf('=');
+            if (equals <= 0) {
+                return usageError(err, "expected FIELD=VALUE, got " + assignment);
+            }
+            if (!MetadataEditor::setField(metadata, assignment.left(equals), assignment.mid(equals + 1))) {
+                return usageError(err, "unknown field " + assignment.left(equals));
+            }
+        }
+        if (!editor.writeMetadata(filePath, metadata)) {
+            err << "flacplayer-cli: " << editor.lastError() << Qt::endl;
+            return Cli::Failures;
+        }
+        emitEvent(out, "done", {{"file", filePath}, {"fields", int(args.size())}});
+        return Cli::Success;
+    }
+}
+
+namespace Cli {
+    QString usage()
+    {
+        return "usage: flacplayer-cli <command> [options]\n"
+               "\n"
+               "  convert [--bitrate 128|192|256|320] [--jobs N] [--output DIR] [--overwrite]\n"
+               "          [--resampler fast|balanced|high|soxr] <files or folders>...\n"
+               "  tag get <file> [FIELD...]\n"
+               "  tag set <file> FIELD=VALUE...\n"
+               "  verify [--jobs N] <files or folders>...\n"
+               "  scan [--jobs N] [--write-tags] <files or folders>...\n"
+               "\n"
+               "Progress is printed as one JSON object per line. Exit codes: 0 success,\n"
+               "1 some files failed, 2 usage error, 130 interrupted.\n";
+    }
+
+    int run(const QStringList &args, QTextStream &out, QTextStream &err)
+    {
+        s_interrupted = false;
+        if (args.isEmpty()) {
+            return usageError(err, "no command given");
+        }
+        const QString command = args.first();
+        const QStringList rest = args.mid(1);
+        if (command == "convert") {
+            return runConvert(rest, out, err);
+        }
+        if (command == "tag") {
+            return runTag(rest, out, err);
+        }
+        if (command == "verify") {
+            return runVerify(rest, out, err);
+        }
+        if (command == "scan") {
+            return runScan(rest, out, err);
+        }
+        if (command == "help" || command == "--help" || command == "-h") {
+            out << usage();
+            out.flush();
+            return Success;
+        }
+        return usageError(err, "unknown command " + command);
+    }
+
+    void interrupt()
+    {
+        s_interrupted = true;
+        if (s_cancelRunning) {
+            s_cancelRunning();
+        }
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef CLICOMMANDS_H
+#define CLICOMMANDS_H
+
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+//subcommands of flacplayer-cli, for cron jobs and scripts:
+//
+//   convert [--bitrate 128|192|256|320] [--jobs N] [--output DIR] [--overwrite]
+//           [--resampler fast|balanced|high|soxr] <files or folders>...
+//   tag get <file> [FIELD...]
+//   tag set <file> FIELD=VALUE...
+//   verify [--jobs N] <files or folders>...
+//   scan [--jobs N] [--write-tags] <files or folders>...
+//
+//progress goes to out as one JSON object per line ({"event":"file",...}, {"event":"done",...}),
+//usage and setup errors go to err. tag get prints a single JSON object. the exit code is one of
+//ExitCode, so a cron job can tell a damaged file from a typo in its command line
+namespace Cli {
+    enum ExitCode {
+        Success = 0,
+        Failures = 1,       // Ran, but some files failed (conversion errors, damaged files, ...)
+        UsageError = 2,     // Bad arguments or nothing to work on
+        Interrupted = 130   // Stopped by interrupt(), e.g. on SIGINT
+    };
+
+    //args without the program name, e.g. {"verify", "--jobs", "4", "/music"}
+    int run(const QStringList &args, QTextStream &out, QTextStream &err);
+
+    //stops the command that is running, files not finished yet are reported as cancelled.
+    //call it from the thread running run()
+    void interrupt();
+
+    QString usage();
+}
+
+#endif // CLICOMMANDS_H
@@ -6,6 +6,7 @@
 #include <QMessageBox>
 #include <QFileInfo>
 #include <QDebug>
+#include <QSettings>
 
 // ConversionDialog implementation
 
@@ -163,7 +164,10 @@ void ConversionDialog::onConvertClicked()
     
     // Create worker thread
     m_workerThread = new QThread();
-    m_worker = new AudioConverterWorker(m_inputFile, outputPath, bitrate);
+    // Same rate conversion quality as playback (Tools > Resampler)
+    const ResamplerProfile profile =
+        static_cast<ResamplerProfile>(QSettings().value("resampler/profile", int(ResamplerProfile::Balanced)).toInt());
+    m_worker = new AudioConverterWorker(m_inputFile, outputPath, bitrate, profile);
     m_worker->moveToThread(m_workerThread);
     
     connect(m_workerThread, &QThread::started, m_worker, &AudioConverterWorker::process);
@@ -0,0 +1,869 @@
+#include "dspkernels.h"
+#include <QtGlobal>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+// SSE2 and AVX2 versions are built with per-function target attributes and picked at run
+// time, so the rest of the build keeps its baseline instruction set
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DSP_X86 1
+#define DSP_TARGET(isa) __attribute__((target(isa)))
+#include <immintrin.h>
+#else
+#define DSP_X86 0
+#endif
+
+namespace Dsp {
+
+namespace {
+    constexpr float HalfPi = 1.57079632679f;
+}
+
+float fadeInGain(FadeCurve curve, float t)
+{
+    t = qBound(0.0f, t, 1.0f);
+    switch (curve) {
+        case FadeCurve::Linear:
+            return t;
+        case FadeCurve::EqualPower:
+            return std::sin(t * HalfPi);
+        case FadeCurve::SCurve:
+            return t * t * (3.0f - 2.0f * t);
+    }
+    return t;
+}
+
+float fadeOutGain(FadeCurve curve, float t)
+{
+    t = qBound(0.0f, t, 1.0f);
+    switch (curve) {
+        case FadeCurve::Linear:
+            return 1.0f - t;
+        case FadeCurve::EqualPower:
+            return std::cos(t * HalfPi);
+        case FadeCurve::SCurve:
+            return 1.0f - t * t * (3.0f - 2.0f * t);
+    }
+    return 1.0f - t;
+}
+
+void toFloat(QAudioFormat::SampleFormat format, const void *in, float *out, size_t count)
+{
+    switch (format) {
+        case QAudioFormat::Int16:
+            int16ToFloat(static_cast<const int16_t *>(in), out, count);
+            break;
+        case QAudioFormat::Int32:
+            int32ToFloat(static_cast<const int32_t *>(in), out, count);
+            break;
+        case QAudioFormat::Float:
+            std::memcpy(out, in, count * sizeof(float));
+            break;
+        default:
+            std::memset(out, 0, count * sizeof(float));
+            break;
+    }
+}
+
+void fromFloat(QAudioFormat::SampleFormat format, const float *in, void *out, size_t count, DitherState *dither)
+{
+    switch (format) {
+        case QAudioFormat::Int16:
+            floatToInt16(in, static_cast<int16_t *>(out), count, dither);
+            break;
+        case QAudioFormat::Int32:
+            floatToInt32(in, static_cast<int32_t *>(out), count);
+            break;
+        case QAudioFormat::Float:
+            std::memcpy(out, in, count * sizeof(float));
+            break;
+        default:
+            break;
+    }
+}
+
+void crossfade(float *incoming, const float *outgoing, size_t frames, int channels,
+               float inGain0, float inGain1, float outGain0, float outGain1)
+{
+    const size_t count = frames * size_t(channels);
+    if (count == 0) {
+        return;
+    }
+
+    float *__restrict in = incoming;
+    const float *__restrict out = outgoing;
+    const float inStep = (inGain1 - inGain0) / float(count);
+    const float outStep = (outGain1 - outGain0) / float(count);
+    for (size_t i = 0; i < count; ++i) {
+        in[i] = in[i] * (inGain0 + inStep * float(i)) + out[i] * (outGain0 + outStep * float(i));
+    }
+}
+
+namespace {
+    template <typename T>
+    void interleavePlanes(const T *const *planes, int channels, size_t frames, T *out)
+    {
+        // Stereo is by far the common case, give the compiler a fixed stride for it
+        if (channels == 2) {
+            const T *__restrict left = planes[0];
+            const T *__restrict right = planes[1];
+            T *__restrict dst = out;
+            for (size_t i = 0; i < frames; ++i) {
+                dst[2 * i] = left[i];
+                dst[2 * i + 1] = right[i];
+            }
+            return;
+        }
+        for (int ch = 0; ch < channels; ++ch) {
+            const T *__restrict src = planes[ch];
+            T *__restrict dst = out + ch;
+            for (size_t i = 0; i < frames; ++i) {
+                dst[i * channels] = src[i];
+            }
+        }
+    }
+}
+
+void interleave16(const int16_t *const *planes, int channels, size_t frames, int16_t *out)
+{
+    interleavePlanes(planes, channels, frames, out);
+}
+
+void interleave32(const int32_t *const *planes, int channels, size_t frames, int32_t *out)
+{
+    interleavePlanes(planes, channels, frames, out);
+}
+
+namespace {
+    template <typename T>
+    void deinterleaveFrames(const T *in, int channels, size_t frames, T *const *planes)
+    {
+        for (int ch = 0; ch < channels; ++ch) {
+            const T *__restrict src = in + ch;
+            T *__restrict dst = planes[ch];
+            for (size_t i = 0; i < frames; ++i) {
+                dst[i] = src[i * channels];
+            }
+        }
+    }
+}
+
+void downmix(const float *in, int channels, size_t frames, float *out)
+{
+    const float *__restrict src = in;
+    float *__restrict dst = out;
+    if (channels == 2) {
+        for (size_t i = 0; i < frames; ++i) {
+            dst[i] = (src[2 * i] + src[2 * i + 1]) * 0.5f;
+        }
+        return;
+    }
+    const float gain = 1.0f / float(channels);
+    for (size_t i = 0; i < frames; ++i) {
+        float sum = 0.0f;
+        for (int ch = 0; ch < channels; ++ch) {
+            sum += src[i * size_t(channels) + size_t(ch)];
+        }
+        dst[i] = sum * gain;
+    }
+}
+
+namespace {
+    // Channels fixed at compile time so the inner loop is one short vector op per frame
+    template <int Channels>
+    void biquadSection(float *samples, size_t frames, const Biquad &c, float *state)
+    {
+        float s1[Channels], s2[Channels];
+        for (int ch = 0; ch < Channels; ++ch) {
+            s1[ch] = state[2 * ch];
+            s2[ch] = state[2 * ch + 1];
+        }
+        for (size_t i = 0; i < frames; ++i) {
+            float *frame = samples + i * Channels;
+            for (int ch = 0; ch < Channels; ++ch) {
+                const float x = frame[ch];
+                const float y = c.b0 * x + s1[ch];
+                s1[ch] = c.b1 * x - c.a1 * y + s2[ch];
+                s2[ch] = c.b2 * x - c.a2 * y;
+                frame[ch] = y;
+            }
+        }
+        for (int ch = 0; ch < Channels; ++ch) {
+            state[2 * ch] = s1[ch];
+            state[2 * ch + 1] = s2[ch];
+        }
+    }
+
+    void biquadSectionAny(float *samples, int channels, size_t frames, const Biquad &c, float *state)
+    {
+        for (int ch = 0; ch < channels; ++ch) {
+            float s1 = state[2 * ch], s2 = state[2 * ch + 1];
+            for (size_t i = 0; i < frames; ++i) {
+                float &sample = samples[i * channels + ch];
+                const float x = sample;
+                const float y = c.b0 * x + s1;
+                s1 = c.b1 * x - c.a1 * y + s2;
+                s2 = c.b2 * x - c.a2 * y;
+                sample = y;
+            }
+            state[2 * ch] = s1;
+            state[2 * ch + 1] = s2;
+        }
+    }
+}
+
+void biquadCascade(float *samples, int channels, size_t frames,
+                   const Biquad *sections, int sectionCount, float *state)
+{
+    for (int s = 0; s < sectionCount; ++s) {
+        float *sectionState = state + size_t(s) * size_t(channels) * 2;
+        switch (channels) {
+            case 1:
+                biquadSection<1>(samples, frames, sections[s], sectionState);
+                break;
+            case 2:
+                biquadSection<2>(samples, frames, sections[s], sectionState);
+                break;
+            case 4:
+                biquadSection<4>(samples, frames, sections[s], sectionState);
+                break;
+            case 6:
+                biquadSection<6>(samples, frames, sections[s], sectionState);
+                break;
+            case 8:
+                biquadSection<8>(samples, frames, sections[s], sectionState);
+                break;
+            default:
+                biquadSectionAny(samples, channels, frames, sections[s], sectionState);
+                break;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Runtime-dispatched conversion kernels. Every level produces the same samples, the SIMD
+// versions only do more of them per instruction; tails always go through the scalar code
+
+DitherState::DitherState(uint32_t seed)
+{
+    for (int i = 0; i < DitherLanes; ++i) {
+        uint32_t x = (seed + uint32_t(i)) * 2654435761u;
+        lanes[i] = x != 0 ? x : 0x9E3779B9u;     // xorshift never leaves zero
+    }
+}
+
+namespace {
+    constexpr float Int16Scale = 32768.0f;
+    constexpr float Int32Scale = 2147483648.0f;
+    constexpr float NoiseScale = 1.0f / 65536.0f;
+
+    std::atomic<int> s_detectedLevel{-1};
+    std::atomic<int> s_level{-1};
+
+    inline uint32_t xorshift(uint32_t x)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return x;
+    }
+
+    // Triangular noise in (-1, 1) LSB: difference of the two 16-bit halves of one draw
+    inline float tpdf(uint32_t x)
+    {
+        return float(int32_t(x & 0xFFFF) - int32_t(x >> 16)) * NoiseScale;
+    }
+
+    inline int16_t toInt16(float v)
+    {
+        v = v < -32768.0f ? -32768.0f : (v > 32767.0f ? 32767.0f : v);
+        return static_cast<int16_t>(std::lrintf(v));
+    }
+
+    inline int32_t toInt32(float v)
+    {
+        // 2^31 - 1 is not a float, anything from 2^31 up is the positive limit
+        if (v >= Int32Scale) {
+            return INT32_MAX;
+        }
+        return v <= -Int32Scale ? INT32_MIN : static_cast<int32_t>(std::lrintf(v));
+    }
+
+    void scaleScalar(float *samples, size_t count, float gain)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            samples[i] *= gain;
+        }
+    }
+
+    void int16ToFloatScalar(const int16_t *in, float *out, size_t count, float factor)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = float(in[i]) * factor;
+        }
+    }
+
+    void int32ToFloatScalar(const int32_t *in, float *out, size_t count, float factor)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = float(in[i]) * factor;
+        }
+    }
+
+    // Works in groups of DitherLanes samples, one draw per lane per group, so every
+    // implementation (and every way of splitting a buffer into groups) takes the same noise
+    void floatToInt16Scalar(const float *in, int16_t *out, size_t count, DitherState *dither)
+    {
+        if (!dither) {
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = toInt16(in[i] * Int16Scale);
+            }
+            return;
+        }
+        for (size_t i = 0; i < count; i += DitherState::DitherLanes) {
+            const size_t n = std::min<size_t>(DitherState::DitherLanes, count - i);
+            for (int lane = 0; lane < DitherState::DitherLanes; ++lane) {
+                dither->lanes[lane] = xorshift(dither->lanes[lane]);
+            }
+            for (size_t j = 0; j < n; ++j) {
+                out[i + j] = toInt16(in[i + j] * Int16Scale + tpdf(dither->lanes[j]));
+            }
+        }
+    }
+
+    void floatToInt32Scalar(const float *in, int32_t *out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            out[i] = toInt32(in[i] * Int32Scale);
+        }
+    }
+
+    // Restores samples [from, count). The 32-bit sums are done unsigned so they wrap like the
+    // vector multiplies do, a corrupt stream gives garbage samples rather than undefined behaviour
+    void deinterleaveStereoScalar(const float *in, float *left, float *right, size_t frames)
+    {
+        for (size_t i = 0; i < frames; ++i) {
+            left[i] = in[2 * i];
+            right[i] = in[2 * i + 1];
+        }
+    }
+
+    void lpcRestoreScalar(int32_t *samples, size_t from, size_t count, const int32_t *coeffs, int order,
+                          int shift, bool wide)
+    {
+        for (size_t i = from; i < count; ++i) {
+            int32_t prediction;
+            if (wide) {
+                int64_t sum = 0;
+                for (int j = 0; j < order; ++j) {
+                    sum += int64_t(coeffs[j]) * samples[i - 1 - j];
+                }
+                prediction = int32_t(sum >> shift);
+            } else {
+                uint32_t sum = 0;
+                for (int j = 0; j < order; ++j) {
+                    sum += uint32_t(coeffs[j]) * uint32_t(samples[i - 1 - j]);
+                }
+                prediction = int32_t(sum) >> shift;
+            }
+            samples[i] = int32_t(uint32_t(samples[i]) + uint32_t(prediction));
+        }
+    }
+
+    // Half is a power of two, so a group never straddles the end and the vector versions need no tail
+    void fftPassScalar(float *re, float *im, size_t n, size_t half, const float *twRe, const float *twIm)
+    {
+        for (size_t group = 0; group < n; group += 2 * half) {
+            float *__restrict aRe = re + group;
+            float *__restrict aIm = im + group;
+            float *__restrict bRe = aRe + half;
+            float *__restrict bIm = aIm + half;
+            for (size_t k = 0; k < half; ++k) {
+                const float tr = bRe[k] * twRe[k] - bIm[k] * twIm[k];
+                const float ti = bRe[k] * twIm[k] + bIm[k] * twRe[k];
+                bRe[k] = aRe[k] - tr;
+                bIm[k] = aIm[k] - ti;
+                aRe[k] += tr;
+                aIm[k] += ti;
+            }
+        }
+    }
+
+#if DSP_X86
+    // SSE2
+
+    DSP_TARGET("sse2") void scaleSse2(float *samples, size_t count, float gain)
+    {
+        const __m128 g = _mm_set1_ps(gain);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+        }
+        scaleScalar(samples + i, count - i, gain);
+    }
+
+    DSP_TARGET("sse2") void int16ToFloatSse2(const int16_t *in, float *out, size_t count, float factor)
+    {
+        const __m128 f = _mm_set1_ps(factor);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            // Sign extension without SSE4.1: duplicate into the high half, shift back down
+            const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+            const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), f));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), f));
+        }
+        int16ToFloatScalar(in + i, out + i, count - i, factor);
+    }
+
+    DSP_TARGET("sse2") void int32ToFloatSse2(const int32_t *in, float *out, size_t count, float factor)
+    {
+        const __m128 f = _mm_set1_ps(factor);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(x), f));
+        }
+        int32ToFloatScalar(in + i, out + i, count - i, factor);
+    }
+
+    DSP_TARGET("sse2") __m128 tpdfSse2(__m128i &state)
+    {
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+        state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+        state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+        const __m128i low = _mm_and_si128(state, _mm_set1_epi32(0xFFFF));
+        const __m128i high = _mm_srli_epi32(state, 16);
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(low, high)), _mm_set1_ps(NoiseScale));
+    }
+
+    DSP_TARGET("sse2") __m128i clampRoundSse2(__m128 v)
+    {
+        v = _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-32768.0f)), _mm_set1_ps(32767.0f));
+        return _mm_cvtps_epi32(v);
+    }
+
+    DSP_TARGET("sse2") void floatToInt16Sse2(const float *in, int16_t *out, size_t count, DitherState *dither)
+    {
+        const __m128 scale = _mm_set1_ps(Int16Scale);
+        size_t i = 0;
+        if (dither) {
+            __m128i state0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dither->lanes));
+            __m128i state1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dither->lanes + 4));
+            for (; i + 8 <= count; i += 8) {
+                const __m128 noise0 = tpdfSse2(state0);
+                const __m128 noise1 = tpdfSse2(state1);
+                const __m128i a = clampRoundSse2(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i), scale), noise0));
+                const __m128i b = clampRoundSse2(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale), noise1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(a, b));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dither->lanes), state0);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dither->lanes + 4), state1);
+        } else {
+            for (; i + 8 <= count; i += 8) {
+                const __m128i a = clampRoundSse2(_mm_mul_ps(_mm_loadu_ps(in + i), scale));
+                const __m128i b = clampRoundSse2(_mm_mul_ps(_mm_loadu_ps(in + i + 4), scale));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(a, b));
+            }
+        }
+        floatToInt16Scalar(in + i, out + i, count - i, dither);
+    }
+
+    DSP_TARGET("sse2") void floatToInt32Sse2(const float *in, int32_t *out, size_t count)
+    {
+        const __m128 scale = _mm_set1_ps(Int32Scale);
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            const __m128 v = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+            // Out of range converts to 0x80000000, flipping it where v >= 2^31 gives INT32_MAX
+            const __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(v, scale));
+            const __m128i x = _mm_xor_si128(_mm_cvtps_epi32(v), overflow);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
+        }
+        floatToInt32Scalar(in + i, out + i, count - i);
+    }
+
+    DSP_TARGET("sse2") void deinterleaveStereoSse2(const float *in, float *left, float *right, size_t frames)
+    {
+        size_t i = 0;
+        for (; i + 4 <= frames; i += 4) {
+            const __m128 a = _mm_loadu_ps(in + 2 * i);        // L0 R0 L1 R1
+            const __m128 b = _mm_loadu_ps(in + 2 * i + 4);    // L2 R2 L3 R3
+            _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+        deinterleaveStereoScalar(in + 2 * i, left + i, right + i, frames - i);
+    }
+
+    DSP_TARGET("sse2") void fftPassSse2(float *re, float *im, size_t n, size_t half,
+                                        const float *twRe, const float *twIm)
+    {
+        if (half < 4) {
+            return fftPassScalar(re, im, n, half, twRe, twIm);
+        }
+        for (size_t group = 0; group < n; group += 2 * half) {
+            float *aRe = re + group;
+            float *aIm = im + group;
+            float *bRe = aRe + half;
+            float *bIm = aIm + half;
+            for (size_t k = 0; k < half; k += 4) {
+                const __m128 wr = _mm_loadu_ps(twRe + k);
+                const __m128 wi = _mm_loadu_ps(twIm + k);
+                const __m128 br = _mm_loadu_ps(bRe + k);
+                const __m128 bi = _mm_loadu_ps(bIm + k);
+                const __m128 tr = _mm_sub_ps(_mm_mul_ps(br, wr), _mm_mul_ps(bi, wi));
+                const __m128 ti = _mm_add_ps(_mm_mul_ps(br, wi), _mm_mul_ps(bi, wr));
+                const __m128 ar = _mm_loadu_ps(aRe + k);
+                const __m128 ai = _mm_loadu_ps(aIm + k);
+                _mm_storeu_ps(aRe + k, _mm_add_ps(ar, tr));
+                _mm_storeu_ps(aIm + k, _mm_add_ps(ai, ti));
+                _mm_storeu_ps(bRe + k, _mm_sub_ps(ar, tr));
+                _mm_storeu_ps(bIm + k, _mm_sub_ps(ai, ti));
+            }
+        }
+    }
+
+    // AVX2
+
+    DSP_TARGET("avx2") void scaleAvx2(float *samples, size_t count, float gain)
+    {
+        const __m256 g = _mm256_set1_ps(gain);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+        }
+        scaleScalar(samples + i, count - i, gain);
+    }
+
+    DSP_TARGET("avx2") void deinterleaveStereoAvx2(const float *in, float *left, float *right, size_t frames)
+    {
+        size_t i = 0;
+        for (; i + 8 <= frames; i += 8) {
+            const __m256 a = _mm256_loadu_ps(in + 2 * i);
+            const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+            // The shuffle works per 128-bit lane (L0 L1 L4 L5 | L2 L3 L6 L7), the permute puts the pairs in order
+            const __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm256_storeu_ps(left + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))));
+            _mm256_storeu_ps(right + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))));
+        }
+        deinterleaveStereoScalar(in + 2 * i, left + i, right + i, frames - i);
+    }
+
+    DSP_TARGET("avx2") void int16ToFloatAvx2(const int16_t *in, float *out, size_t count, float factor)
+    {
+        const __m256 f = _mm256_set1_ps(factor);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i)));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), f));
+        }
+        int16ToFloatScalar(in + i, out + i, count - i, factor);
+    }
+
+    DSP_TARGET("avx2") void int32ToFloatAvx2(const int32_t *in, float *out, size_t count, float factor)
+    {
+        const __m256 f = _mm256_set1_ps(factor);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(in + i));
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), f));
+        }
+        int32ToFloatScalar(in + i, out + i, count - i, factor);
+    }
+
+    DSP_TARGET("avx2") void floatToInt16Avx2(const float *in, int16_t *out, size_t count, DitherState *dither)
+    {
+        const __m256 scale = _mm256_set1_ps(Int16Scale);
+        const __m256 low = _mm256_set1_ps(-32768.0f);
+        const __m256 high = _mm256_set1_ps(32767.0f);
+        __m256i state = dither ? _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dither->lanes))
+                               : _mm256_setzero_si256();
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + i), scale);
+            if (dither) {
+                state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 13));
+                state = _mm256_xor_si256(state, _mm256_srli_epi32(state, 17));
+                state = _mm256_xor_si256(state, _mm256_slli_epi32(state, 5));
+                const __m256i diff = _mm256_sub_epi32(_mm256_and_si256(state, _mm256_set1_epi32(0xFFFF)),
+                                                      _mm256_srli_epi32(state, 16));
+                v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_cvtepi32_ps(diff), _mm256_set1_ps(NoiseScale)));
+            }
+            v = _mm256_min_ps(_mm256_max_ps(v, low), high);
+            const __m256i x = _mm256_cvtps_epi32(v);
+            // packs works per 128-bit lane, the halves are already in range so pack them directly
+            const __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), packed);
+        }
+        if (dither) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dither->lanes), state);
+        }
+        floatToInt16Scalar(in + i, out + i, count - i, dither);
+    }
+
+    DSP_TARGET("avx2") void floatToInt32Avx2(const float *in, int32_t *out, size_t count)
+    {
+        const __m256 scale = _mm256_set1_ps(Int32Scale);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(in + i), scale);
+            const __m256i overflow = _mm256_castps_si256(_mm256_cmp_ps(v, scale, _CMP_GE_OQ));
+            const __m256i x = _mm256_xor_si256(_mm256_cvtps_epi32(v), overflow);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), x);
+        }
+        floatToInt32Scalar(in + i, out + i, count - i);
+    }
+
+    // Four samples per step, lane k predicting samples[i + k]. Taps 3 and up only reach samples
+    // from before the step, so they are one broadcast multiply over an unaligned history load for
+    // all lanes. taps 0-2 depend on the lanes before them and finish in scalar code, lane by lane
+    DSP_TARGET("avx2") void lpcRestoreAvx2(int32_t *samples, size_t count, const int32_t *coeffs, int order,
+                                           int shift, bool wide)
+    {
+        size_t i = size_t(order);
+        if (order > 3 && wide) {
+            for (; i + 4 <= count; i += 4) {
+                __m256i acc = _mm256_setzero_si256();
+                for (int j = 3; j < order; ++j) {
+                    const __m128i history = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i - 1 - j));
+                    acc = _mm256_add_epi64(acc, _mm256_mul_epi32(_mm256_set1_epi64x(coeffs[j]),
+                                                                 _mm256_cvtepi32_epi64(history)));
+                }
+                alignas(32) int64_t sums[4];
+                _mm256_store_si256(reinterpret_cast<__m256i *>(sums), acc);
+                for (int k = 0; k < 4; ++k) {
+                    int32_t *out = samples + i + k;
+                    int64_t sum = sums[k];
+                    for (int j = 0; j < 3; ++j) {
+                        sum += int64_t(coeffs[j]) * out[-1 - j];
+                    }
+                    *out = int32_t(uint32_t(*out) + uint32_t(int32_t(sum >> shift)));
+                }
+            }
+        } else if (order > 3) {
+            for (; i + 4 <= count; i += 4) {
+                __m128i acc = _mm_setzero_si128();
+                for (int j = 3; j < order; ++j) {
+                    const __m128i history = _mm_loadu_si128(reinterpret_cast<const __m128i *>(samples + i - 1 - j));
+                    acc = _mm_add_epi32(acc, _mm_mullo_epi32(_mm_set1_epi32(coeffs[j]), history));
+                }
+                alignas(16) int32_t sums[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(sums), acc);
+                for (int k = 0; k < 4; ++k) {
+                    int32_t *out = samples + i + k;
+                    uint32_t sum = uint32_t(sums[k]);
+                    for (int j = 0; j < 3; ++j) {
+                        sum += uint32_t(coeffs[j]) * uint32_t(out[-1 - j]);
+                    }
+                    *out = int32_t(uint32_t(*out) + uint32_t(int32_t(sum) >> shift));
+                }
+            }
+        }
+        lpcRestoreScalar(samples, i, count, coeffs, order, shift, wide);
+    }
+
+    DSP_TARGET("avx2") void fftPassAvx2(float *re, float *im, size_t n, size_t half,
+                                        const float *twRe, const float *twIm)
+    {
+        if (half < 8) {
+            return fftPassSse2(re, im, n, half, twRe, twIm);
+        }
+        for (size_t group = 0; group < n; group += 2 * half) {
+            float *aRe = re + group;
+            float *aIm = im + group;
+            float *bRe = aRe + half;
+            float *bIm = aIm + half;
+            for (size_t k = 0; k < half; k += 8) {
+                const __m256 wr = _mm256_loadu_ps(twRe + k);
+                const __m256 wi = _mm256_loadu_ps(twIm + k);
+                const __m256 br = _mm256_loadu_ps(bRe + k);
+                const __m256 bi = _mm256_loadu_ps(bIm + k);
+                const __m256 tr = _mm256_sub_ps(_mm256_mul_ps(br, wr), _mm256_mul_ps(bi, wi));
+                const __m256 ti = _mm256_add_ps(_mm256_mul_ps(br, wi), _mm256_mul_ps(bi, wr));
+                const __m256 ar = _mm256_loadu_ps(aRe + k);
+                const __m256 ai = _mm256_loadu_ps(aIm + k);
+                _mm256_storeu_ps(aRe + k, _mm256_add_ps(ar, tr));
+                _mm256_storeu_ps(aIm + k, _mm256_add_ps(ai, ti));
+                _mm256_storeu_ps(bRe + k, _mm256_sub_ps(ar, tr));
+                _mm256_storeu_ps(bIm + k, _mm256_sub_ps(ai, ti));
+            }
+        }
+    }
+#endif
+
+    SimdLevel activeLevel()
+    {
+        int level = s_level.load(std::memory_order_relaxed);
+        if (level < 0) {
+            level = int(detectedSimdLevel());
+            s_level.store(level, std::memory_order_relaxed);
+        }
+        return SimdLevel(level);
+    }
+}
+
+SimdLevel detectedSimdLevel()
+{
+    int level = s_detectedLevel.load(std::memory_order_relaxed);
+    if (level < 0) {
+        level = int(SimdLevel::Scalar);
+#if DSP_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            level = int(SimdLevel::Avx2);
+        } else if (__builtin_cpu_supports("sse2")) {
+            level = int(SimdLevel::Sse2);
+        }
+#endif
+        s_detectedLevel.store(level, std::memory_order_relaxed);
+    }
+    return SimdLevel(level);
+}
+
+SimdLevel simdLevel()
+{
+    return activeLevel();
+}
+
+void setSimdLevel(SimdLevel level)
+{
+    s_level.store(std::min(int(level), int(detectedSimdLevel())), std::memory_order_relaxed);
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+    switch (level) {
+        case SimdLevel::Scalar:
+            return "scalar";
+        case SimdLevel::Sse2:
+            return "sse2";
+        case SimdLevel::Avx2:
+            return "avx2";
+    }
+    return "scalar";
+}
+
+void scale(float *samples, size_t count, float gain)
+{
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return scaleAvx2(samples, count, gain);
+        case SimdLevel::Sse2:
+            return scaleSse2(samples, count, gain);
+#endif
+        default:
+            return scaleScalar(samples, count, gain);
+    }
+}
+
+void int16ToFloat(const int16_t *in, float *out, size_t count, float gain)
+{
+    const float factor = gain / Int16Scale;
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return int16ToFloatAvx2(in, out, count, factor);
+        case SimdLevel::Sse2:
+            return int16ToFloatSse2(in, out, count, factor);
+#endif
+        default:
+            return int16ToFloatScalar(in, out, count, factor);
+    }
+}
+
+void int32ToFloat(const int32_t *in, float *out, size_t count, float gain)
+{
+    const float factor = gain / Int32Scale;
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return int32ToFloatAvx2(in, out, count, factor);
+        case SimdLevel::Sse2:
+            return int32ToFloatSse2(in, out, count, factor);
+#endif
+        default:
+            return int32ToFloatScalar(in, out, count, factor);
+    }
+}
+
+void floatToInt16(const float *in, int16_t *out, size_t count, DitherState *dither)
+{
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return floatToInt16Avx2(in, out, count, dither);
+        case SimdLevel::Sse2:
+            return floatToInt16Sse2(in, out, count, dither);
+#endif
+        default:
+            return floatToInt16Scalar(in, out, count, dither);
+    }
+}
+
+void floatToInt32(const float *in, int32_t *out, size_t count)
+{
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return floatToInt32Avx2(in, out, count);
+        case SimdLevel::Sse2:
+            return floatToInt32Sse2(in, out, count);
+#endif
+        default:
+            return floatToInt32Scalar(in, out, count);
+    }
+}
+
+void deinterleave(const float *in, int channels, size_t frames, float *const *planes)
+{
+    // Stereo is the case that matters for decoding, other layouts stay scalar
+    if (channels != 2) {
+        deinterleaveFrames(in, channels, frames, planes);
+        return;
+    }
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return deinterleaveStereoAvx2(in, planes[0], planes[1], frames);
+        case SimdLevel::Sse2:
+            return deinterleaveStereoSse2(in, planes[0], planes[1], frames);
+#endif
+        default:
+            return deinterleaveStereoScalar(in, planes[0], planes[1], frames);
+    }
+}
+
+void lpcRestore(int32_t *samples, size_t count, const int32_t *coeffs, int order, int shift, bool wide)
+{
+    // SSE2 has neither a 32-bit low multiply nor a signed 32x32->64 one, it keeps the scalar loop
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return lpcRestoreAvx2(samples, count, coeffs, order, shift, wide);
+#endif
+        default:
+            return lpcRestoreScalar(samples, size_t(order), count, coeffs, order, shift, wide);
+    }
+}
+
+void fftPass(float *re, float *im, size_t n, size_t half, const float *twRe, const float *twIm)
+{
+    switch (activeLevel()) {
+#if DSP_X86
+        case SimdLevel::Avx2:
+            return fftPassAvx2(re, im, n, half, twRe, twIm);
+        case SimdLevel::Sse2:
+            return fftPassSse2(re, im, n, half, twRe, twIm);
+#endif
+        default:
+            return fftPassScalar(re, im, n, half, twRe, twIm);
+    }
+}
+
+} // namespace Dsp
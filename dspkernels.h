@@ -0,0 +1,102 @@
+#ifndef DSPKERNELS_H
+#define DSPKERNELS_H
+
+#include <QAudioFormat>
+#include <cstddef>
+#include <cstdint>
+
+//sample kernels for the native engine's mixing stages. plain loops over restrict pointers
+//with no branches inside, so the compiler vectorises them. the format conversions below have
+//hand-written SSE2/AVX2 versions as well, picked once at run time from what the CPU supports
+namespace Dsp {
+
+enum class SimdLevel {
+    Scalar = 0,
+    Sse2 = 1,
+    Avx2 = 2
+};
+
+//best level this CPU runs, and the one the kernels currently use (the best one by default).
+//setSimdLevel is clamped to what the CPU supports, it exists for tests and benchmarks
+SimdLevel detectedSimdLevel();
+SimdLevel simdLevel();
+void setSimdLevel(SimdLevel level);
+const char *simdLevelName(SimdLevel level);
+
+//TPDF dither for float -> 16-bit, +-1 LSB triangular noise from eight xorshift generators.
+//one state per stream, samples take the lanes in groups of eight so the output is the same
+//whichever level runs
+struct DitherState {
+    static constexpr int DitherLanes = 8;
+    explicit DitherState(uint32_t seed = 1);
+    uint32_t lanes[DitherLanes];
+};
+
+enum class FadeCurve {
+    Linear = 0,         // Constant amplitude sum, dips in loudness for uncorrelated material
+    EqualPower = 1,     // sin/cos, constant power, the usual choice between different songs
+    SCurve = 2          // Smoothstep, slow start and end with a quick middle
+};
+
+//gains at fade progress t in [0, 1]
+float fadeInGain(FadeCurve curve, float t);
+float fadeOutGain(FadeCurve curve, float t);
+
+//interleaved sink samples <-> float in [-1, 1], count is samples (frames * channels).
+//only Int16, Int32 and Float are handled, the formats the engine opens the sink with
+void toFloat(QAudioFormat::SampleFormat format, const void *in, float *out, size_t count);
+//with dither set Int16 output is dithered, Int32 never needs it
+void fromFloat(QAudioFormat::SampleFormat format, const float *in, void *out, size_t count,
+               DitherState *dither = nullptr);
+
+//the dispatched kernels underneath, usable on interleaved and planar buffers alike since they
+//only see a run of samples. full scale is 32768 and 2^31, positive overflow clamps to the max
+void scale(float *samples, size_t count, float gain);
+void int16ToFloat(const int16_t *in, float *out, size_t count, float gain = 1.0f);
+void int32ToFloat(const int32_t *in, float *out, size_t count, float gain = 1.0f);
+void floatToInt16(const float *in, int16_t *out, size_t count, DitherState *dither = nullptr);
+void floatToInt32(const float *in, int32_t *out, size_t count);
+
+//incoming = incoming * inGain + outgoing * outGain over interleaved frames, both gains ramp
+//linearly across the block from their *0 to their *1 value. the ramp advances per sample rather
+//than per frame so the loop stays flat, keep blocks short enough for that not to matter
+void crossfade(float *incoming, const float *outgoing, size_t frames, int channels,
+               float inGain0, float inGain1, float outGain0, float outGain1);
+
+//integer-only interleaving for the bit-perfect path, planes holds one pointer per channel.
+//samples are copied untouched, 24-bit audio stays left-justified in its 32-bit container
+void interleave16(const int16_t *const *planes, int channels, size_t frames, int16_t *out);
+void interleave32(const int32_t *const *planes, int channels, size_t frames, int32_t *out);
+
+//interleaved float to one plane per channel
+void deinterleave(const float *in, int channels, size_t frames, float *const *planes);
+
+//interleaved float to one plane holding the average of the channels
+void downmix(const float *in, int channels, size_t frames, float *out);
+
+//FLAC LPC restoration in place: samples[0, order) are the warm-up samples, the rest come in as
+//residuals and leave as audio. coeffs[j] weighs the sample j + 1 back. wide accumulates in 64 bits,
+//needed once bits per sample + coefficient precision + log2(order) goes past 32. the AVX2 version
+//predicts four samples at a time, only the three newest taps run serially
+void lpcRestore(int32_t *samples, size_t count, const int32_t *coeffs, int order, int shift, bool wide);
+
+//one radix-2 decimation-in-time pass of an in-place complex FFT over split re/im arrays of n points,
+//bit-reversed on the way in: butterflies between the points half apart in every group of 2 * half,
+//twRe/twIm[k] = exp(-i pi k / half) for k < half. the SSE2/AVX2 versions run four/eight butterflies
+//per step once the groups are that wide, the first narrow passes stay scalar
+void fftPass(float *re, float *im, size_t n, size_t half, const float *twRe, const float *twIm);
+
+//direct form II transposed section, a1/a2 with the sign the difference equation subtracts
+struct Biquad {
+    float b0 = 1.0f, b1 = 0.0f, b2 = 0.0f, a1 = 0.0f, a2 = 0.0f;
+};
+
+//runs every channel of the interleaved block through the sections in turn. the channels are
+//the vector lanes: one section at a time over the block, all channels of a frame per step, so
+//the recursion stays serial in time only. state holds sections * channels pairs
+void biquadCascade(float *samples, int channels, size_t frames,
+                   const Biquad *sections, int sectionCount, float *state);
+
+} // namespace Dsp
+
+#endif // DSPKERNELS_H
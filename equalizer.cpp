@@ -0,0 +1,298 @@
+#include "equalizer.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr double Pi = 3.14159265358979323846;
+
+    qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    EqPreset peaks(const QString &name, double preampDb, const QList<double> &gains)
+    {
+        EqPreset preset = EqPreset::flat();
+        preset.name = name;
+        preset.enabled = true;
+        preset.preampDb = preampDb;
+        for (int i = 0; i < preset.bands.size() && i < gains.size(); ++i) {
+            preset.bands[i].gainDb = gains[i];
+        }
+        return preset;
+    }
+}
+
+bool EqBand::isNeutral() const
+{
+    if (!enabled) {
+        return true;
+    }
+    return (type == Peak || type == LowShelf || type == HighShelf) && std::fabs(gainDb) < 0.01;
+}
+
+// ---------------------------------------------------------------------------
+// EqPreset
+
+QByteArray EqPreset::toJson() const
+{
+    QJsonArray bandArray;
+    for (const EqBand &band : bands) {
+        QJsonObject entry;
+        entry["type"] = int(band.type);
+        entry["frequency"] = band.frequency;
+        entry["gain"] = band.gainDb;
+        entry["q"] = band.q;
+        entry["enabled"] = band.enabled;
+        bandArray.append(entry);
+    }
+    QJsonObject root;
+    root["name"] = name;
+    root["enabled"] = enabled;
+    root["preamp"] = preampDb;
+    root["bands"] = bandArray;
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+EqPreset EqPreset::fromJson(const QByteArray &json)
+{
+    const QJsonDocument document = QJsonDocument::fromJson(json);
+    if (!document.isObject()) {
+        return flat();
+    }
+    const QJsonObject root = document.object();
+    EqPreset preset;
+    preset.name = root["name"].toString();
+    preset.enabled = root["enabled"].toBool();
+    preset.preampDb = root["preamp"].toDouble();
+    const QJsonArray bandArray = root["bands"].toArray();
+    for (const QJsonValue &value : bandArray) {
+        if (preset.bands.size() == Equalizer::MaxBands) {
+            break;
+        }
+        const QJsonObject entry = value.toObject();
+        EqBand band;
+        band.type = static_cast<EqBand::Type>(qBound(0, entry["type"].toInt(), int(EqBand::HighPass)));
+        band.frequency = entry["frequency"].toDouble(1000.0);
+        band.gainDb = entry["gain"].toDouble();
+        band.q = entry["q"].toDouble(1.41);
+        band.enabled = entry["enabled"].toBool(true);
+        preset.bands.append(band);
+    }
+    return preset;
+}
+
+EqPreset EqPreset::flat()
+{
+    EqPreset preset;
+    preset.name = "Flat";
+    for (double frequency = 31.25; frequency < 20000.0; frequency *= 2.0) {
+        EqBand band;
+        band.frequency = std::round(frequency);
+        preset.bands.append(band);
+    }
+    return preset;
+}
+
+QList<EqPreset> EqPreset::builtIns()
+{
+    // Boosting presets come with enough preamp cut that full-scale masters don't clip
+    return {
+        flat(),
+        peaks("Bass Boost", -6.0, {6.0, 5.0, 4.0, 2.0, 0.5}),
+        peaks("Treble Boost", -6.0, {0.0, 0.0, 0.0, 0.0, 0.0, 0.5, 2.0, 4.0, 5.0, 6.0}),
+        peaks("Vocal", -3.0, {-2.0, -2.0, -1.0, 0.0, 1.5, 3.0, 3.0, 1.5, 0.0, -1.0}),
+        peaks("Loudness", -5.0, {5.0, 4.0, 2.0, 0.0, -1.0, 0.0, 0.0, 1.0, 3.0, 4.0}),
+    };
+}
+
+// ---------------------------------------------------------------------------
+// Equalizer
+
+Equalizer::Equalizer()
+    : m_preset(EqPreset::flat())
+{
+}
+
+void Equalizer::setPreset(const EqPreset &preset)
+{
+    m_preset = preset;
+    if (m_preset.bands.size() > MaxBands) {
+        m_preset.bands = m_preset.bands.mid(0, MaxBands);
+    }
+    publish();
+}
+
+void Equalizer::setFormat(int sampleRate, int channels)
+{
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_statsRate.store(sampleRate, std::memory_order_relaxed);
+    publish();
+}
+
+Dsp::Biquad Equalizer::coefficients(const EqBand &band, int sampleRate)
+{
+    // Corners above ~0.49 fs have no digital equivalent, keep them just below Nyquist
+    const double frequency = qBound(10.0, band.frequency, 0.49 * sampleRate);
+    const double w0 = 2.0 * Pi * frequency / sampleRate;
+    const double cosW = std::cos(w0);
+    const double alpha = std::sin(w0) / (2.0 * qMax(band.q, 0.05));
+    const double A = std::pow(10.0, band.gainDb / 40.0);
+    const double rootA = 2.0 * std::sqrt(A) * alpha;
+
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+    switch (band.type) {
+        case EqBand::Peak:
+            b0 = 1.0 + alpha * A;
+            b1 = -2.0 * cosW;
+            b2 = 1.0 - alpha * A;
+            a0 = 1.0 + alpha / A;
+            a1 = -2.0 * cosW;
+            a2 = 1.0 - alpha / A;
+            break;
+        case EqBand::LowShelf:
+            b0 = A * ((A + 1.0) - (A - 1.0) * cosW + rootA);
+            b1 = 2.0 * A * ((A - 1.0) - (A + 1.0) * cosW);
+            b2 = A * ((A + 1.0) - (A - 1.0) * cosW - rootA);
+            a0 = (A + 1.0) + (A - 1.0) * cosW + rootA;
+            a1 = -2.0 * ((A - 1.0) + (A + 1.0) * cosW);
+            a2 = (A + 1.0) + (A - 1.0) * cosW - rootA;
+            break;
+        case EqBand::HighShelf:
+            b0 = A * ((A + 1.0) + (A - 1.0) * cosW + rootA);
+            b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cosW);
+            b2 = A * ((A + 1.0) + (A - 1.0) * cosW - rootA);
+            a0 = (A + 1.0) - (A - 1.0) * cosW + rootA;
+            a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cosW);
+            a2 = (A + 1.0) - (A - 1.0) * cosW - rootA;
+            break;
+        case EqBand::LowPass:
+            b0 = (1.0 - cosW) / 2.0;
+            b1 = 1.0 - cosW;
+            b2 = (1.0 - cosW) / 2.0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cosW;
+            a2 = 1.0 - alpha;
+            break;
+        case EqBand::HighPass:
+            b0 = (1.0 + cosW) / 2.0;
+            b1 = -(1.0 + cosW);
+            b2 = (1.0 + cosW) / 2.0;
+            a0 = 1.0 + alpha;
+            a1 = -2.0 * cosW;
+            a2 = 1.0 - alpha;
+            break;
+    }
+
+    Dsp::Biquad c;
+    c.b0 = float(b0 / a0);
+    c.b1 = float(b1 / a0);
+    c.b2 = float(b2 / a0);
+    c.a1 = float(a1 / a0);
+    c.a2 = float(a2 / a0);
+    return c;
+}
+
+void Equalizer::publish()
+{
+    Coefficients &c = m_slots[m_writeSlot];
+    c.channels = m_channels;
+    c.sampleRate = m_sampleRate;
+    c.preamp = float(std::pow(10.0, m_preset.preampDb / 20.0));
+    c.sectionCount = 0;
+    if (m_preset.enabled && m_sampleRate > 0) {
+        for (int i = 0; i < m_preset.bands.size(); ++i) {
+            if (!m_preset.bands[i].isNeutral()) {
+                c.bandIndex[c.sectionCount] = i;
+                c.sections[c.sectionCount] = coefficients(m_preset.bands[i], m_sampleRate);
+                ++c.sectionCount;
+            }
+        }
+    }
+    c.active = m_preset.enabled && m_channels > 0 && m_channels <= MaxChannels
+               && (c.sectionCount > 0 || std::fabs(m_preset.preampDb) >= 0.01);
+
+    // Hand the filled slot over and take whichever one the audio thread isn't using
+    m_writeSlot = m_middleSlot.exchange(m_writeSlot | FreshBit, std::memory_order_acq_rel) & 3;
+}
+
+bool Equalizer::update(int channels)
+{
+    if (m_middleSlot.load(std::memory_order_relaxed) & FreshBit) {
+        // The old slot belongs to the GUI thread again once it is exchanged, read it before that
+        const int previousChannels = m_slots[m_readSlot].channels;
+        const int previousSampleRate = m_slots[m_readSlot].sampleRate;
+        m_readSlot = m_middleSlot.exchange(m_readSlot, std::memory_order_acq_rel) & 3;
+
+        // Bands that just came in start from silence, the others keep their history so moving
+        // a slider changes the response without a discontinuity in the filter state
+        const Coefficients &c = m_slots[m_readSlot];
+        const bool reshaped = c.channels != previousChannels || c.sampleRate != previousSampleRate;
+        unsigned live = 0;
+        for (int s = 0; s < c.sectionCount; ++s) {
+            const int band = c.bandIndex[s];
+            if (reshaped || !(m_liveBands & (1u << band))) {
+                std::memset(m_state + size_t(band) * MaxChannels * 2, 0, sizeof(float) * MaxChannels * 2);
+            }
+            live |= 1u << band;
+        }
+        m_liveBands = c.active ? live : 0;
+    }
+    return m_slots[m_readSlot].active && m_slots[m_readSlot].channels == channels;
+}
+
+void Equalizer::process(float *samples, size_t frames)
+{
+    const Coefficients &c = m_slots[m_readSlot];
+    if (!c.active || frames == 0) {
+        return;
+    }
+
+    const qint64 start = nowNs();
+    if (c.preamp != 1.0f) {
+        Dsp::scale(samples, frames * size_t(c.channels), c.preamp);
+    }
+    for (int s = 0; s < c.sectionCount; ++s) {
+        Dsp::biquadCascade(samples, c.channels, frames, &c.sections[s], 1,
+                           m_state + size_t(c.bandIndex[s]) * MaxChannels * 2);
+    }
+    const qint64 elapsed = nowNs() - start;
+
+    m_blocks.fetch_add(1, std::memory_order_relaxed);
+    m_frames.fetch_add(qint64(frames), std::memory_order_relaxed);
+    m_totalNs.fetch_add(elapsed, std::memory_order_relaxed);
+    if (elapsed > m_maxNs.load(std::memory_order_relaxed)) {
+        m_maxNs.store(elapsed, std::memory_order_relaxed);
+    }
+}
+
+EqStats Equalizer::stats() const
+{
+    EqStats stats;
+    stats.blocks = m_blocks.load(std::memory_order_relaxed);
+    stats.frames = m_frames.load(std::memory_order_relaxed);
+    const qint64 totalNs = m_totalNs.load(std::memory_order_relaxed);
+    stats.maxUs = m_maxNs.load(std::memory_order_relaxed) / 1000.0;
+    if (stats.blocks > 0) {
+        stats.averageUs = totalNs / 1000.0 / stats.blocks;
+    }
+    const int rate = m_statsRate.load(std::memory_order_relaxed);
+    if (stats.frames > 0 && rate > 0) {
+        stats.load = double(totalNs) / (double(stats.frames) * 1e9 / rate);
+    }
+    return stats;
+}
+
+void Equalizer::resetStats()
+{
+    m_blocks.store(0, std::memory_order_relaxed);
+    m_frames.store(0, std::memory_order_relaxed);
+    m_totalNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+}
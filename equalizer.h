@@ -0,0 +1,118 @@
+#ifndef EQUALIZER_H
+#define EQUALIZER_H
+
+#include <QString>
+#include <QList>
+#include <QByteArray>
+#include <QtGlobal>
+#include <atomic>
+#include "dspkernels.h"
+
+struct EqBand {
+    enum Type {
+        Peak = 0,
+        LowShelf = 1,
+        HighShelf = 2,
+        LowPass = 3,
+        HighPass = 4
+    };
+
+    Type type = Peak;
+    double frequency = 1000.0;  // Hz, centre for peaks, corner for shelves and passes
+    double gainDb = 0.0;        // ignored by the passes
+    double q = 1.41;
+    bool enabled = true;
+
+    //true when the band leaves the signal as it is and needs no section
+    bool isNeutral() const;
+};
+
+//what the user edits and what gets saved, one per output device
+struct EqPreset {
+    QString name;
+    bool enabled = false;
+    double preampDb = 0.0;
+    QList<EqBand> bands;
+
+    QByteArray toJson() const;
+    static EqPreset fromJson(const QByteArray &json);
+
+    //ten peaking bands an octave apart from 31 Hz, all at 0 dB
+    static EqPreset flat();
+    static QList<EqPreset> builtIns();
+};
+
+//cumulative cost of the processing since the last reset
+struct EqStats {
+    qint64 blocks = 0;
+    qint64 frames = 0;
+    double averageUs = 0.0;     // per block
+    double maxUs = 0.0;
+    double load = 0.0;          // processing time over the audio time processed, 0.01 = 1 %
+};
+
+//parametric EQ stage of the native engine, up to MaxBands biquads per channel.
+//the GUI thread edits the preset and the format, the audio thread runs process(). coefficients
+//travel through a triple buffer: the GUI fills its own slot and swaps it into the middle, the
+//audio thread swaps the middle out at the start of a block, neither ever waits for the other
+class Equalizer
+{
+public:
+    static constexpr int MaxBands = 16;
+    static constexpr int MaxChannels = 8;
+
+    Equalizer();
+
+    // GUI thread
+    void setPreset(const EqPreset &preset);
+    EqPreset preset() const { return m_preset; }
+    void setFormat(int sampleRate, int channels);
+    EqStats stats() const;
+    void resetStats();
+
+    //RBJ cookbook coefficients of one band, normalised by a0
+    static Dsp::Biquad coefficients(const EqBand &band, int sampleRate);
+
+    // Audio thread, never blocks or allocates
+    //picks up the newest coefficients, false when a block of this many channels can be left alone
+    bool update(int channels);
+    //interleaved float frames in the channel count given to setFormat
+    void process(float *samples, size_t frames);
+
+private:
+    struct Coefficients {
+        bool active = false;
+        int channels = 0;
+        int sampleRate = 0;
+        float preamp = 1.0f;
+        int sectionCount = 0;
+        int bandIndex[MaxBands];        // where each section keeps its state
+        Dsp::Biquad sections[MaxBands];
+    };
+
+    static constexpr int FreshBit = 4;
+
+    void publish();
+
+    // GUI side
+    EqPreset m_preset;
+    int m_sampleRate = 44100;
+    int m_channels = 2;
+    int m_writeSlot = 0;
+
+    Coefficients m_slots[3];
+    std::atomic<int> m_middleSlot{1};   // slot index, | FreshBit when the GUI published into it
+
+    // Audio side
+    int m_readSlot = 2;
+    unsigned m_liveBands = 0;           // bit per band whose state is carried over
+    float m_state[MaxBands * MaxChannels * 2] = {};
+
+    std::atomic<qint64> m_blocks{0};
+    std::atomic<qint64> m_frames{0};
+    std::atomic<qint64> m_totalNs{0};
+    std::atomic<qint64> m_maxNs{0};
+    std::atomic<int> m_statsRate{44100};
+};
+
+#endif // EQUALIZER_H
@@ -0,0 +1,243 @@
+#include "equalizerdialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QDialogButtonBox>
+#include <QPushButton>
+
+namespace {
+    // Sliders work in tenths of a dB
+    constexpr int SliderScale = 10;
+    constexpr int BandRangeDb = 12;
+
+    QString dbText(double dB)
+    {
+        return QString("%1%2 dB").arg(dB > 0.0 ? "+" : "").arg(dB, 0, 'f', 1);
+    }
+}
+
+// EqualizerDialog implementation
+
+EqualizerDialog::EqualizerDialog(Equalizer &equalizer, const QString &deviceName, QWidget *parent)
+    : QDialog(parent)
+    , m_equalizer(equalizer)
+    , m_original(equalizer.preset())
+    , m_preset(equalizer.preset())
+    , m_loading(false)
+{
+    setupUI(deviceName);
+    setWindowTitle("Equalizer");
+
+    loadControls();
+
+    connect(m_presetCombo, qOverload<int>(&QComboBox::activated), this, &EqualizerDialog::onPresetChosen);
+    connect(m_bandCountSpin, qOverload<int>(&QSpinBox::valueChanged), this, &EqualizerDialog::onBandCountChanged);
+    connect(m_enabledCheck, &QCheckBox::toggled, this, &EqualizerDialog::apply);
+    connect(m_preampSlider, &QSlider::valueChanged, this, &EqualizerDialog::apply);
+
+    // Cost of the stage on the audio thread, measured since the dialog opened
+    m_equalizer.resetStats();
+    m_statsTimer.setInterval(500);
+    connect(&m_statsTimer, &QTimer::timeout, this, &EqualizerDialog::updateStats);
+    m_statsTimer.start();
+    updateStats();
+}
+
+void EqualizerDialog::setupUI(const QString &deviceName)
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    QHBoxLayout *topLayout = new QHBoxLayout();
+    m_enabledCheck = new QCheckBox("Enabled");
+    m_presetCombo = new QComboBox();
+    for (const EqPreset &preset : EqPreset::builtIns()) {
+        m_presetCombo->addItem(preset.name);
+    }
+    m_bandCountSpin = new QSpinBox();
+    m_bandCountSpin->setRange(1, Equalizer::MaxBands);
+    m_bandCountSpin->setSuffix(" bands");
+    topLayout->addWidget(m_enabledCheck);
+    topLayout->addStretch();
+    topLayout->addWidget(new QLabel("Preset:"));
+    topLayout->addWidget(m_presetCombo);
+    topLayout->addWidget(m_bandCountSpin);
+    mainLayout->addLayout(topLayout);
+
+    QFormLayout *formLayout = new QFormLayout();
+    formLayout->addRow("Output:", new QLabel(deviceName));
+    QHBoxLayout *preampLayout = new QHBoxLayout();
+    m_preampSlider = new QSlider(Qt::Horizontal);
+    m_preampSlider->setRange(-BandRangeDb * SliderScale, 6 * SliderScale);
+    m_preampLabel = new QLabel();
+    m_preampLabel->setMinimumWidth(60);
+    preampLayout->addWidget(m_preampSlider);
+    preampLayout->addWidget(m_preampLabel);
+    formLayout->addRow("Preamp:", preampLayout);
+    mainLayout->addLayout(formLayout);
+
+    m_bandGrid = new QGridLayout();
+    mainLayout->addLayout(m_bandGrid);
+
+    m_statsLabel = new QLabel();
+    m_statsLabel->setAlignment(Qt::AlignCenter);
+    mainLayout->addWidget(m_statsLabel);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    mainLayout->addWidget(buttons);
+}
+
+//one column per band: enable, gain slider, frequency, Q and filter type
+void EqualizerDialog::rebuildBands()
+{
+    for (const BandControls &controls : m_bands) {
+        delete controls.enabled;
+        delete controls.gain;
+        delete controls.gainLabel;
+        delete controls.frequency;
+        delete controls.q;
+        delete controls.type;
+    }
+    m_bands.clear();
+
+    for (int i = 0; i < m_preset.bands.size(); ++i) {
+        BandControls controls;
+        controls.enabled = new QCheckBox();
+        controls.gain = new QSlider(Qt::Vertical);
+        controls.gain->setRange(-BandRangeDb * SliderScale, BandRangeDb * SliderScale);
+        controls.gain->setMinimumHeight(140);
+        controls.gainLabel = new QLabel();
+        controls.gainLabel->setAlignment(Qt::AlignCenter);
+        controls.frequency = new QSpinBox();
+        controls.frequency->setRange(10, 22000);
+        controls.frequency->setSuffix(" Hz");
+        controls.q = new QDoubleSpinBox();
+        controls.q->setRange(0.1, 10.0);
+        controls.q->setSingleStep(0.1);
+        controls.q->setPrefix("Q ");
+        controls.type = new QComboBox();
+        controls.type->addItem("Peak", int(EqBand::Peak));
+        controls.type->addItem("Low shelf", int(EqBand::LowShelf));
+        controls.type->addItem("High shelf", int(EqBand::HighShelf));
+        controls.type->addItem("Low pass", int(EqBand::LowPass));
+        controls.type->addItem("High pass", int(EqBand::HighPass));
+
+        m_bandGrid->addWidget(controls.enabled, 0, i, Qt::AlignHCenter);
+        m_bandGrid->addWidget(controls.gain, 1, i, Qt::AlignHCenter);
+        m_bandGrid->addWidget(controls.gainLabel, 2, i);
+        m_bandGrid->addWidget(controls.frequency, 3, i);
+        m_bandGrid->addWidget(controls.q, 4, i);
+        m_bandGrid->addWidget(controls.type, 5, i);
+
+        connect(controls.enabled, &QCheckBox::toggled, this, &EqualizerDialog::apply);
+        connect(controls.gain, &QSlider::valueChanged, this, &EqualizerDialog::apply);
+        connect(controls.frequency, qOverload<int>(&QSpinBox::valueChanged), this, &EqualizerDialog::apply);
+        connect(controls.q, qOverload<double>(&QDoubleSpinBox::valueChanged), this, &EqualizerDialog::apply);
+        connect(controls.type, qOverload<int>(&QComboBox::currentIndexChanged), this, &EqualizerDialog::apply);
+        m_bands.append(controls);
+    }
+    adjustSize();
+}
+
+void EqualizerDialog::loadControls()
+{
+    m_loading = true;
+    if (m_bands.size() != m_preset.bands.size()) {
+        rebuildBands();
+    }
+    m_enabledCheck->setChecked(m_preset.enabled);
+    m_presetCombo->setCurrentIndex(qMax(0, m_presetCombo->findText(m_preset.name)));
+    m_bandCountSpin->setValue(int(m_preset.bands.size()));
+    m_preampSlider->setValue(qRound(m_preset.preampDb * SliderScale));
+    m_preampLabel->setText(dbText(m_preset.preampDb));
+    for (int i = 0; i < m_bands.size(); ++i) {
+        const EqBand &band = m_preset.bands[i];
+        const BandControls &controls = m_bands[i];
+        controls.enabled->setChecked(band.enabled);
+        controls.gain->setValue(qRound(band.gainDb * SliderScale));
+        controls.gainLabel->setText(dbText(band.gainDb));
+        controls.frequency->setValue(qRound(band.frequency));
+        controls.q->setValue(band.q);
+        controls.type->setCurrentIndex(controls.type->findData(int(band.type)));
+    }
+    m_loading = false;
+}
+
+void EqualizerDialog::readControls()
+{
+    m_preset.enabled = m_enabledCheck->isChecked();
+    m_preset.preampDb = double(m_preampSlider->value()) / SliderScale;
+    m_preampLabel->setText(dbText(m_preset.preampDb));
+    for (int i = 0; i < m_bands.size(); ++i) {
+        EqBand &band = m_preset.bands[i];
+        const BandControls &controls = m_bands[i];
+        band.enabled = controls.enabled->isChecked();
+        band.gainDb = double(controls.gain->value()) / SliderScale;
+        band.frequency = controls.frequency->value();
+        band.q = controls.q->value();
+        band.type = static_cast<EqBand::Type>(controls.type->currentData().toInt());
+        controls.gainLabel->setText(dbText(band.gainDb));
+        // Passes have no gain
+        controls.gain->setEnabled(band.type != EqBand::LowPass && band.type != EqBand::HighPass);
+    }
+}
+
+//pushes the controls to the audio thread, cheap enough to run on every slider step
+void EqualizerDialog::apply()
+{
+    if (m_loading) {
+        return;
+    }
+    readControls();
+    m_equalizer.setPreset(m_preset);
+}
+
+void EqualizerDialog::onPresetChosen(int index)
+{
+    const QList<EqPreset> presets = EqPreset::builtIns();
+    if (index < 0 || index >= presets.size()) {
+        return;
+    }
+    m_preset = presets[index];
+    m_preset.enabled = true;
+    loadControls();
+    m_equalizer.setPreset(m_preset);
+}
+
+void EqualizerDialog::onBandCountChanged(int count)
+{
+    if (m_loading) {
+        return;
+    }
+    readControls();
+    // New bands continue an octave above the last one
+    while (m_preset.bands.size() < count) {
+        EqBand band;
+        band.frequency = m_preset.bands.isEmpty() ? 1000.0 : qMin(m_preset.bands.last().frequency * 2.0, 20000.0);
+        m_preset.bands.append(band);
+    }
+    m_preset.bands = m_preset.bands.mid(0, count);
+    loadControls();
+    m_equalizer.setPreset(m_preset);
+}
+
+void EqualizerDialog::updateStats()
+{
+    const EqStats stats = m_equalizer.stats();
+    if (stats.blocks == 0) {
+        m_statsLabel->setText("Not processing (needs the native engine, bit-perfect output bypasses it)");
+        return;
+    }
+    m_statsLabel->setText(QString("CPU: %1 us per %2-frame block (max %3 us), %4% of realtime")
+        .arg(stats.averageUs, 0, 'f', 2)
+        .arg(stats.frames / stats.blocks)
+        .arg(stats.maxUs, 0, 'f', 1)
+        .arg(stats.load * 100.0, 0, 'f', 3));
+}
+
+void EqualizerDialog::reject()
+{
+    m_equalizer.setPreset(m_original);
+    QDialog::reject();
+}
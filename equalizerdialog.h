@@ -0,0 +1,67 @@
+#ifndef EQUALIZERDIALOG_H
+#define EQUALIZERDIALOG_H
+
+#include <QDialog>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDoubleSpinBox>
+#include <QGridLayout>
+#include <QLabel>
+#include <QSlider>
+#include <QSpinBox>
+#include <QTimer>
+#include "equalizer.h"
+
+//edits the equalizer live: every change is pushed to the audio thread straight away, Cancel
+//puts back the settings the dialog was opened with. the caller saves preset() on accept
+class EqualizerDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    EqualizerDialog(Equalizer &equalizer, const QString &deviceName, QWidget *parent = nullptr);
+
+    EqPreset preset() const { return m_preset; }
+
+public slots:
+    void reject() override;
+
+private slots:
+    void onPresetChosen(int index);
+    void onBandCountChanged(int count);
+    void updateStats();
+
+private:
+    // Controls of one band, a column in the grid
+    struct BandControls {
+        QCheckBox *enabled;
+        QSlider *gain;
+        QLabel *gainLabel;
+        QSpinBox *frequency;
+        QDoubleSpinBox *q;
+        QComboBox *type;
+    };
+
+    void setupUI(const QString &deviceName);
+    void rebuildBands();
+    void loadControls();
+    void readControls();
+    void apply();
+
+    Equalizer &m_equalizer;
+    EqPreset m_original;
+    EqPreset m_preset;
+    bool m_loading;
+
+    QCheckBox *m_enabledCheck;
+    QComboBox *m_presetCombo;
+    QSpinBox *m_bandCountSpin;
+    QSlider *m_preampSlider;
+    QLabel *m_preampLabel;
+    QGridLayout *m_bandGrid;
+    QList<BandControls> m_bands;
+    QLabel *m_statsLabel;
+    QTimer m_statsTimer;
+};
+
+#endif // EQUALIZERDIALOG_H
@@ -0,0 +1,635 @@
+#include "flacdecoder.h"
+#include "flacseeker.h"
+#include "dspkernels.h"
+#include <QtAlgorithms>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    const int SampleRates[12] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    const int SampleSizes[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+
+    enum ChannelAssignment {
+        LeftSide = 8,
+        RightSide = 9,
+        MidSide = 10
+    };
+
+    // CRC-8, polynomial x^8 + x^2 + x + 1, over the frame header
+    quint8 crc8(const uchar *data, qsizetype size)
+    {
+        quint8 crc = 0;
+        for (qsizetype i = 0; i < size; ++i) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 0x80) ? static_cast<quint8>((crc << 1) ^ 0x07) : static_cast<quint8>(crc << 1);
+            }
+        }
+        return crc;
+    }
+
+    // CRC-16, polynomial x^16 + x^15 + x^2 + 1, over the whole frame. this one sees every byte
+    // so it goes through a table
+    struct Crc16Table {
+        quint16 values[256];
+
+        Crc16Table()
+        {
+            for (int i = 0; i < 256; ++i) {
+                quint16 crc = quint16(i << 8);
+                for (int bit = 0; bit < 8; ++bit) {
+                    crc = (crc & 0x8000) ? quint16((crc << 1) ^ 0x8005) : quint16(crc << 1);
+                }
+                values[i] = crc;
+            }
+        }
+    };
+
+    quint16 crc16(const uchar *data, qsizetype size)
+    {
+        static const Crc16Table table;
+        quint16 crc = 0;
+        for (qsizetype i = 0; i < size; ++i) {
+            crc = quint16((crc << 8) ^ table.values[(crc >> 8) ^ data[i]]);
+        }
+        return crc;
+    }
+
+    //MSB-first reader over a 64-bit cache. bits below the m_bits valid ones are either zero or
+    //the stream's own next bits, so refills can OR whole 8-byte loads over them. reading past
+    //the end returns zeros and sets overrun()
+    class BitReader
+    {
+    public:
+        BitReader(const uchar *data, qsizetype size)
+            : m_data(data)
+            , m_size(size)
+        {
+        }
+
+        bool overrun() const { return m_overrun; }
+
+        //bytes consumed, only meaningful after alignToByte()
+        qsizetype bytePosition() const { return (m_pos * 8 - m_bits) / 8; }
+
+        void alignToByte()
+        {
+            const int drop = m_bits & 7;
+            m_cache <<= drop;
+            m_bits -= drop;
+        }
+
+        //n in 0..32
+        uint32_t read(int n)
+        {
+            if (n == 0) {
+                return 0;
+            }
+            if (m_bits < n) {
+                refill();
+                if (m_bits < n) {
+                    return overrunValue();
+                }
+            }
+            const uint32_t value = uint32_t(m_cache >> (64 - n));
+            m_cache <<= n;
+            m_bits -= n;
+            return value;
+        }
+
+        int32_t readSigned(int n)
+        {
+            if (n == 0) {
+                return 0;
+            }
+            const uint32_t value = read(n);
+            return n == 32 ? int32_t(value) : int32_t(value << (32 - n)) >> (32 - n);
+        }
+
+        //zeros before the next 1 bit, which is consumed as well
+        uint32_t readUnary()
+        {
+            uint32_t count = 0;
+            for (;;) {
+                if (m_bits == 0) {
+                    refill();
+                    if (m_bits == 0) {
+                        return overrunValue();
+                    }
+                }
+                const int zeros = qCountLeadingZeroBits(m_cache);
+                if (zeros < m_bits) {
+                    m_cache <<= zeros + 1;
+                    m_bits -= zeros + 1;
+                    return count + uint32_t(zeros);
+                }
+                count += uint32_t(m_bits);
+                m_cache = 0;
+                m_bits = 0;
+            }
+        }
+
+        //count zigzag-folded rice codes with parameter k. false on a code that can't fit 32 bits
+        bool readRice(int32_t *out, int count, int k)
+        {
+            for (int i = 0; i < count; ++i) {
+                if (m_bits < 32) {
+                    refill();
+                }
+                uint32_t quotient;
+                uint32_t low;
+                const int zeros = qCountLeadingZeroBits(m_cache);
+                if (zeros + 1 + k <= m_bits) {
+                    // The whole code is in the cache, the common case
+                    m_cache <<= zeros + 1;
+                    low = k > 0 ? uint32_t(m_cache >> (64 - k)) : 0;
+                    m_cache <<= k;
+                    m_bits -= zeros + 1 + k;
+                    quotient = uint32_t(zeros);
+                } else {
+                    quotient = readUnary();
+                    low = read(k);
+                    if (m_overrun) {
+                        return true;    // the caller reports the short frame
+                    }
+                }
+                if (k > 0 && (quotient >> (32 - k)) != 0) {
+                    return false;
+                }
+                const uint32_t folded = (quotient << k) | low;
+                out[i] = int32_t(folded >> 1) ^ -int32_t(folded & 1);
+            }
+            return true;
+        }
+
+    private:
+        void refill()
+        {
+            if (m_pos + 8 <= m_size) {
+                m_cache |= qFromBigEndian<quint64>(m_data + m_pos) >> m_bits;
+                const int bytes = (63 - m_bits) >> 3;
+                m_pos += bytes;
+                m_bits += bytes * 8;
+            } else {
+                while (m_bits <= 56 && m_pos < m_size) {
+                    m_cache |= quint64(m_data[m_pos++]) << (56 - m_bits);
+                    m_bits += 8;
+                }
+            }
+        }
+
+        uint32_t overrunValue()
+        {
+            m_overrun = true;
+            m_cache = 0;
+            m_bits = 0;
+            return 0;
+        }
+
+        const uchar *m_data;
+        qsizetype m_size;
+        qsizetype m_pos = 0;            // next byte to load
+        quint64 m_cache = 0;
+        int m_bits = 0;                 // valid bits at the top of m_cache
+        bool m_overrun = false;
+    };
+
+    //residual of one subframe, written after the predictorOrder warm-up samples.
+    //returns an error, or nullptr (the caller checks for overrun)
+    const char *readResidual(BitReader &in, int32_t *out, int blockSize, int predictorOrder)
+    {
+        const uint32_t method = in.read(2);
+        if (method > 1) {
+            return "Reserved residual coding method";
+        }
+        const int parameterBits = method == 0 ? 4 : 5;
+        const uint32_t escape = method == 0 ? 15 : 31;
+        const int partitionOrder = int(in.read(4));
+        const int partitionSize = blockSize >> partitionOrder;
+        if ((partitionSize << partitionOrder) != blockSize || partitionSize < predictorOrder) {
+            return "Bad residual partition order";
+        }
+
+        int32_t *samples = out + predictorOrder;
+        for (int partition = 0; partition < (1 << partitionOrder); ++partition) {
+            const int count = partition == 0 ? partitionSize - predictorOrder : partitionSize;
+            const uint32_t parameter = in.read(parameterBits);
+            if (parameter == escape) {
+                // Unencoded partition, fixed-width samples
+                const int bits = int(in.read(5));
+                for (int i = 0; i < count; ++i) {
+                    samples[i] = in.readSigned(bits);
+                }
+            } else if (!in.readRice(samples, count, int(parameter))) {
+                return "Rice code out of range";
+            }
+            if (in.overrun()) {
+                return nullptr;
+            }
+            samples += count;
+        }
+        return nullptr;
+    }
+
+    // The fixed predictors are the polynomial ones, differences of order 1 to 4
+    void restoreFixed(int32_t *samples, int blockSize, int order)
+    {
+        uint32_t *s = reinterpret_cast<uint32_t *>(samples);
+        switch (order) {
+            case 1:
+                for (int i = 1; i < blockSize; ++i) {
+                    s[i] += s[i - 1];
+                }
+                break;
+            case 2:
+                for (int i = 2; i < blockSize; ++i) {
+                    s[i] += 2 * s[i - 1] - s[i - 2];
+                }
+                break;
+            case 3:
+                for (int i = 3; i < blockSize; ++i) {
+                    s[i] += 3 * s[i - 1] - 3 * s[i - 2] + s[i - 3];
+                }
+                break;
+            case 4:
+                for (int i = 4; i < blockSize; ++i) {
+                    s[i] += 4 * s[i - 1] - 6 * s[i - 2] + 4 * s[i - 3] - s[i - 4];
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    const char *decodeSubframe(BitReader &in, int32_t *out, int blockSize, int bitsPerSample)
+    {
+        if (in.read(1) != 0) {
+            return "Subframe padding bit set";
+        }
+        const uint32_t type = in.read(6);
+        int wasted = 0;
+        if (in.read(1)) {
+            wasted = int(in.readUnary()) + 1;
+            if (wasted >= bitsPerSample) {
+                return "More wasted bits than the sample has";
+            }
+            bitsPerSample -= wasted;
+        }
+
+        if (type == 0) {
+            std::fill(out, out + blockSize, in.readSigned(bitsPerSample));
+        } else if (type == 1) {
+            for (int i = 0; i < blockSize; ++i) {
+                out[i] = in.readSigned(bitsPerSample);
+            }
+        } else if (type >= 8 && type <= 12) {
+            const int order = int(type) - 8;
+            if (order > blockSize) {
+                return "Predictor order above the block size";
+            }
+            for (int i = 0; i < order; ++i) {
+                out[i] = in.readSigned(bitsPerSample);
+            }
+            if (const char *error = readResidual(in, out, blockSize, order)) {
+                return error;
+            }
+            restoreFixed(out, blockSize, order);
+        } else if (type >= 32) {
+            const int order = int(type & 31) + 1;
+            if (order > blockSize) {
+                return "Predictor order above the block size";
+            }
+            for (int i = 0; i < order; ++i) {
+                out[i] = in.readSigned(bitsPerSample);
+            }
+            const int precision = int(in.read(4)) + 1;
+            if (precision == 16) {
+                return "Invalid coefficient precision";
+            }
+            const int shift = in.readSigned(5);
+            if (shift < 0) {
+                return "Negative prediction shift";
+            }
+            int32_t coeffs[32];
+            for (int j = 0; j < order; ++j) {
+                coeffs[j] = in.readSigned(precision);
+            }
+            if (const char *error = readResidual(in, out, blockSize, order)) {
+                return error;
+            }
+            // The sum of order products fits 32 bits as long as this does, see libFLAC
+            const int log2Order = 31 - qCountLeadingZeroBits(quint32(order));
+            Dsp::lpcRestore(out, size_t(blockSize), coeffs, order, shift,
+                            bitsPerSample + precision + log2Order > 32);
+        } else {
+            return "Reserved subframe type";
+        }
+
+        if (wasted > 0) {
+            for (int i = 0; i < blockSize; ++i) {
+                out[i] = int32_t(uint32_t(out[i]) << wasted);
+            }
+        }
+        return nullptr;
+    }
+}
+
+void FlacFrameDecoder::setStreamInfo(int sampleRate, int channels, int bitsPerSample, int maxBlockSize)
+{
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_bitsPerSample = bitsPerSample;
+    m_maxBlockSize = maxBlockSize;
+}
+
+bool FlacFrameDecoder::setStreamInfo(const uchar *streamInfo, qsizetype size)
+{
+    if (size < 34) {
+        m_lastError = "Truncated STREAMINFO";
+        return false;
+    }
+    const quint64 packed = qFromBigEndian<quint64>(streamInfo + 10);
+    setStreamInfo(static_cast<int>(packed >> 44), static_cast<int>((packed >> 41) & 0x7) + 1,
+                  static_cast<int>((packed >> 36) & 0x1F) + 1, qFromBigEndian<quint16>(streamInfo + 2));
+    return true;
+}
+
+FlacFrameDecoder::Status FlacFrameDecoder::fail(Status status, const char *error)
+{
+    m_lastError = error;
+    return status;
+}
+
+FlacFrameDecoder::Status FlacFrameDecoder::decodeFrame(const uchar *data, qsizetype size, int32_t *const *planes,
+                                                       int capacity, Frame *frame)
+{
+    if (size < 6) {
+        return fail(NeedMoreData, "Truncated frame header");
+    }
+    if (data[0] != 0xFF || (data[1] & 0xFE) != 0xF8) {
+        return fail(Corrupt, "No frame sync code");
+    }
+    const bool variableBlockSize = data[1] & 0x01;
+    const int blockSizeCode = data[2] >> 4;
+    const int rateCode = data[2] & 0x0F;
+    const int channelCode = data[3] >> 4;
+    const int sizeCode = (data[3] >> 1) & 0x07;
+    if (blockSizeCode == 0 || rateCode == 15 || channelCode > MidSide || sizeCode == 3 || (data[3] & 0x01)) {
+        return fail(Corrupt, "Reserved value in frame header");
+    }
+    const int channels = channelCode < LeftSide ? channelCode + 1 : 2;
+    if (channels != m_channels) {
+        return fail(Corrupt, "Channel count differs from STREAMINFO");
+    }
+    const int bitsPerSample = sizeCode == 0 ? m_bitsPerSample : SampleSizes[sizeCode];
+    if (bitsPerSample > MaxBitsPerSample) {
+        return fail(Unsupported, "Sample depth above 24 bits");
+    }
+    if (bitsPerSample < 4) {
+        return fail(Corrupt, "Invalid sample depth");
+    }
+
+    // Frame or sample number, UTF-8 style variable length
+    qsizetype pos = 4;
+    const uchar first = data[pos++];
+    quint64 number;
+    int extra;
+    if (!(first & 0x80)) {
+        number = first;
+        extra = 0;
+    } else if ((first & 0xE0) == 0xC0) {
+        number = first & 0x1F;
+        extra = 1;
+    } else if ((first & 0xF0) == 0xE0) {
+        number = first & 0x0F;
+        extra = 2;
+    } else if ((first & 0xF8) == 0xF0) {
+        number = first & 0x07;
+        extra = 3;
+    } else if ((first & 0xFC) == 0xF8) {
+        number = first & 0x03;
+        extra = 4;
+    } else if ((first & 0xFE) == 0xFC) {
+        number = first & 0x01;
+        extra = 5;
+    } else if (first == 0xFE) {
+        number = 0;
+        extra = 6;
+    } else {
+        return fail(Corrupt, "Bad frame number");
+    }
+    // Worst case, extra bytes + 2 block size + 2 rate + CRC-8
+    if (pos + extra + 5 > size) {
+        return fail(NeedMoreData, "Truncated frame header");
+    }
+    for (int i = 0; i < extra; ++i) {
+        const uchar byte = data[pos++];
+        if ((byte & 0xC0) != 0x80) {
+            return fail(Corrupt, "Bad frame number");
+        }
+        number = (number << 6) | (byte & 0x3F);
+    }
+
+    int blockSize;
+    if (blockSizeCode == 1) {
+        blockSize = 192;
+    } else if (blockSizeCode <= 5) {
+        blockSize = 576 << (blockSizeCode - 2);
+    } else if (blockSizeCode == 6) {
+        blockSize = data[pos++] + 1;
+    } else if (blockSizeCode == 7) {
+        blockSize = ((data[pos] << 8) | data[pos + 1]) + 1;
+        pos += 2;
+    } else {
+        blockSize = 256 << (blockSizeCode - 8);
+    }
+
+    int sampleRate = rateCode == 0 ? m_sampleRate : SampleRates[qMin(rateCode, 11)];
+    if (rateCode >= 12) {
+        const int value = rateCode == 12 ? data[pos++] : (data[pos] << 8) | data[pos + 1];
+        if (rateCode != 12) {
+            pos += 2;
+        }
+        sampleRate = rateCode == 12 ? value * 1000 : (rateCode == 13 ? value : value * 10);
+    }
+
+    if (crc8(data, pos) != data[pos]) {
+        return fail(Corrupt, "Frame header CRC mismatch");
+    }
+    ++pos;
+    if (m_maxBlockSize > 0 && blockSize > m_maxBlockSize) {
+        return fail(Corrupt, "Block larger than STREAMINFO allows");
+    }
+    if (blockSize > capacity) {
+        return fail(Unsupported, "Block larger than the output buffer");
+    }
+
+    BitReader in(data + pos, size - pos);
+    for (int ch = 0; ch < channels; ++ch) {
+        // The side channel carries one extra bit
+        const bool side = (channelCode == LeftSide && ch == 1) || (channelCode == RightSide && ch == 0)
+                       || (channelCode == MidSide && ch == 1);
+        if (const char *error = decodeSubframe(in, planes[ch], blockSize, bitsPerSample + (side ? 1 : 0))) {
+            return fail(Corrupt, error);
+        }
+        if (in.overrun()) {
+            return fail(NeedMoreData, "Frame runs past the end of the data");
+        }
+    }
+    in.alignToByte();
+    const qsizetype bytes = pos + in.bytePosition() + 2;
+    if (bytes > size) {
+        return fail(NeedMoreData, "Frame runs past the end of the data");
+    }
+    if (m_verifyCrc && crc16(data, bytes - 2) != qFromBigEndian<quint16>(data + bytes - 2)) {
+        return fail(Corrupt, "Frame CRC mismatch");
+    }
+
+    if (channelCode >= LeftSide) {
+        uint32_t *a = reinterpret_cast<uint32_t *>(planes[0]);
+        uint32_t *b = reinterpret_cast<uint32_t *>(planes[1]);
+        if (channelCode == LeftSide) {
+            for (int i = 0; i < blockSize; ++i) {
+                b[i] = a[i] - b[i];
+            }
+        } else if (channelCode == RightSide) {
+            for (int i = 0; i < blockSize; ++i) {
+                a[i] += b[i];
+            }
+        } else {
+            // The side's lowest bit is the one the halved mid lost
+            for (int i = 0; i < blockSize; ++i) {
+                const uint32_t mid = (a[i] << 1) | (b[i] & 1);
+                a[i] = uint32_t(int32_t(mid + b[i]) >> 1);
+                b[i] = uint32_t(int32_t(mid - b[i]) >> 1);
+            }
+        }
+    }
+
+    // Fixed-size streams count frames, every frame but the last has the STREAMINFO block size
+    frame->firstSample = variableBlockSize ? static_cast<qint64>(number)
+        : static_cast<qint64>(number) * (m_maxBlockSize > 0 ? m_maxBlockSize : blockSize);
+    frame->blockSize = blockSize;
+    frame->channels = channels;
+    frame->bitsPerSample = bitsPerSample;
+    frame->sampleRate = sampleRate;
+    frame->bytes = bytes;
+    m_lastError.clear();
+    return Ok;
+}
+
+FlacFileDecoder::~FlacFileDecoder()
+{
+    close();
+}
+
+bool FlacFileDecoder::open(const QString &filePath, InputStorage storage)
+{
+    close();
+    // A mapped file cut short underneath us is a SIGBUS rather than a read error
+    if (storage == InputStorage::Auto) {
+        storage = MappedInput::detectStorage(filePath);
+    }
+    if (!MappedInput::tuningFor(storage).map) {
+        m_lastError = "Not mapping a file on " + MappedInput::storageName(storage) + " storage";
+        return false;
+    }
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_lastError = "Cannot open file: " + m_file.errorString();
+        return false;
+    }
+
+    FlacSeeker seeker;
+    if (!seeker.open(&m_file)) {
+        m_lastError = seeker.lastError();
+        close();
+        return false;
+    }
+    if (seeker.bitsPerSample() > FlacFrameDecoder::MaxBitsPerSample) {
+        m_lastError = "Sample depth above 24 bits";
+        close();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_map = m_file.map(0, m_size);
+    if (!m_map) {
+        m_lastError = "Cannot map file: " + m_file.errorString();
+        close();
+        return false;
+    }
+    m_decoder.setStreamInfo(seeker.sampleRate(), seeker.channels(), seeker.bitsPerSample(), seeker.maxBlockSize());
+    m_audioOffset = seeker.audioOffset();
+    m_offset = m_audioOffset;
+    m_totalSamples = seeker.totalSamples();
+    m_lastError.clear();
+    return true;
+}
+
+void FlacFileDecoder::close()
+{
+    if (m_map) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_audioOffset = 0;
+    m_offset = 0;
+    m_position = 0;
+    m_totalSamples = 0;
+    m_skippedFrames = 0;
+    m_resyncing = false;
+}
+
+int FlacFileDecoder::decodeNext(int32_t *const *planes, int capacity)
+{
+    if (!m_map) {
+        m_lastError = "Not open";
+        return -1;
+    }
+
+    while (m_offset < m_size) {
+        FlacFrameDecoder::Frame frame;
+        const FlacFrameDecoder::Status status = m_decoder.decodeFrame(m_map + m_offset, m_size - m_offset,
+                                                                      planes, capacity, &frame);
+        if (status == FlacFrameDecoder::Ok) {
+            m_offset += frame.bytes;
+            m_position = frame.firstSample + frame.blockSize;
+            m_resyncing = false;
+            return frame.blockSize;
+        }
+        if (status == FlacFrameDecoder::Unsupported) {
+            m_lastError = m_decoder.lastError();
+            return -1;
+        }
+        // A damaged or cut off frame is dropped, decoding goes on from the next header. false
+        // sync codes met on the way aren't counted, neither are trailing tags (ID3v1)
+        if (!m_resyncing && m_map[m_offset] == 0xFF) {
+            ++m_skippedFrames;
+        }
+        m_resyncing = true;
+        m_offset = nextSync(m_offset + 1);
+    }
+    return 0;
+}
+
+qint64 FlacFileDecoder::nextSync(qint64 from) const
+{
+    // 0xFF is rare enough in compressed audio for memchr to skip most of the way
+    while (from + 1 < m_size) {
+        const uchar *found = static_cast<const uchar *>(memchr(m_map + from, 0xFF, size_t(m_size - from - 1)));
+        if (!found) {
+            break;
+        }
+        from = found - m_map;
+        if ((m_map[from + 1] & 0xFE) == 0xF8) {
+            return from;
+        }
+        ++from;
+    }
+    return m_size;
+}
@@ -0,0 +1,124 @@
+#ifndef FLACDECODER_H
+#define FLACDECODER_H
+
+#include <QFile>
+#include <QString>
+#include <cstdint>
+#include "mappedinput.h"
+
+//decodes single FLAC frames without libavcodec: partitioned rice residuals, verbatim, constant,
+//fixed and LPC subframes, wasted bits and the three stereo decorrelation modes. samples go
+//straight into the caller's planes as int32, right-justified at the stream's bit depth (a
+//16-bit stream gives -32768..32767). LPC restoration runs through Dsp::lpcRestore, so it is
+//vectorised wherever the other kernels are. 32-bit streams are left to libavcodec
+class FlacFrameDecoder
+{
+public:
+    static constexpr int MaxBitsPerSample = 24;
+    static constexpr int MaxChannels = 8;
+    static constexpr int MaxBlockSize = 65535;
+
+    enum Status {
+        Ok,
+        NeedMoreData,       // the frame runs past the end of the buffer
+        Corrupt,            // bad header, CRC mismatch or an impossible subframe
+        Unsupported         // valid FLAC this decoder doesn't handle (32-bit)
+    };
+
+    struct Frame {
+        qint64 firstSample = 0;
+        int blockSize = 0;
+        int channels = 0;
+        int bitsPerSample = 0;
+        int sampleRate = 0;
+        qsizetype bytes = 0;        // header to CRC-16 inclusive
+    };
+
+    //STREAMINFO values, frame headers that leave rate or depth out fall back to them
+    void setStreamInfo(int sampleRate, int channels, int bitsPerSample, int maxBlockSize);
+    //from the 34-byte STREAMINFO block itself, e.g. FFmpeg's FLAC extradata
+    bool setStreamInfo(const uchar *streamInfo, qsizetype size);
+    //the frame CRC-16 is checked by default, the header CRC-8 always
+    void setVerifyCrc(bool verify) { m_verifyCrc = verify; }
+
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+    int bitsPerSample() const { return m_bitsPerSample; }
+    //STREAMINFO's maximum, or the largest block FLAC allows when it isn't given
+    int maxBlockSize() const { return m_maxBlockSize > 0 ? m_maxBlockSize : MaxBlockSize; }
+
+    //decodes the frame at data into planes[0..channels), each with room for capacity samples.
+    //the planes are scratch space too: on anything but Ok their contents are undefined
+    Status decodeFrame(const uchar *data, qsizetype size, int32_t *const *planes, int capacity, Frame *frame);
+    QString lastError() const { return m_lastError; }
+
+private:
+    Status fail(Status status, const char *error);
+
+    int m_sampleRate = 0;
+    int m_channels = 0;
+    int m_bitsPerSample = 0;
+    int m_maxBlockSize = 0;        // 0 = not given
+    bool m_verifyCrc = true;
+    QString m_lastError;
+};
+
+//a whole FLAC file through FlacFrameDecoder. the file is mapped, metadata comes from FlacSeeker,
+//and a frame that fails to decode is skipped up to the next valid frame header:
+//
+//  FlacFileDecoder decoder;
+//  if (decoder.open(path)) {
+//      planes: decoder.channels() buffers of decoder.maxBlockSize() samples
+//      while ((frames = decoder.decodeNext(planes, decoder.maxBlockSize())) > 0) { ... }
+//  }
+class FlacFileDecoder
+{
+public:
+    FlacFileDecoder() = default;
+    ~FlacFileDecoder();
+
+    FlacFileDecoder(const FlacFileDecoder &) = delete;
+    FlacFileDecoder &operator=(const FlacFileDecoder &) = delete;
+
+    //fails for anything FlacFrameDecoder can't do as well, so callers can fall back to libavcodec.
+    //frames are read from a mapping, so it also fails for storage that is never mapped (network)
+    bool open(const QString &filePath, InputStorage storage = MappedInput::defaultStorage());
+    void close();
+
+    //frames decoded into planes, 0 at the end of the stream, -1 on an error lastError() explains
+    int decodeNext(int32_t *const *planes, int capacity);
+
+    int sampleRate() const { return m_decoder.sampleRate(); }
+    int channels() const { return m_decoder.channels(); }
+    int bitsPerSample() const { return m_decoder.bitsPerSample(); }
+    int maxBlockSize() const { return m_decoder.maxBlockSize(); }
+    qint64 totalSamples() const { return m_totalSamples; }
+    qint64 position() const { return m_position; }      // first sample of the next frame
+    int skippedFrames() const { return m_skippedFrames; }
+    QString lastError() const { return m_lastError; }
+
+    //the mapped file and a decoder set up for its stream, for callers that split the frames
+    //between threads themselves (ParallelFlacDecoder)
+    const uchar *mappedData() const { return m_map; }
+    qint64 mappedSize() const { return m_size; }
+    qint64 audioOffset() const { return m_audioOffset; }
+    const FlacFrameDecoder &frameDecoder() const { return m_decoder; }
+    //first position at or after from holding a frame sync code, mappedSize() when there is none
+    qint64 nextSync(qint64 from) const;
+
+private:
+
+    QFile m_file;
+    const uchar *m_map = nullptr;
+    qint64 m_size = 0;
+    qint64 m_audioOffset = 0;
+    qint64 m_offset = 0;
+    qint64 m_position = 0;
+    qint64 m_totalSamples = 0;
+    int m_skippedFrames = 0;
+    bool m_resyncing = false;       // looking for the header after a bad frame
+    FlacFrameDecoder m_decoder;
+    QString m_lastError;
+};
+
+#endif // FLACDECODER_H
@@ -0,0 +1,55 @@
+#include "clicommands.h"
+#include <QCoreApplication>
+#include <QTextStream>
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <unistd.h>
+#endif
+
+// Batch tool for cron jobs and scripts, see Cli for the commands:
+//   flacplayer-cli convert --bitrate 256 --jobs 4 --output /srv/mp3 /srv/flac
+//   flacplayer-cli verify /srv/flac || mail -s "damaged files" admin
+// SIGINT/SIGTERM cancel the files not done yet and exit with 130 once the running ones stop
+
+namespace {
+#ifdef Q_OS_UNIX
+    // Self-pipe: the handler only writes a byte, the event loop does the rest
+    int s_signalPipe[2] = {-1, -1};
+
+    void onSignal(int)
+    {
+        const char byte = 1;
+        const ssize_t written = ::write(s_signalPipe[1], &byte, 1);
+        Q_UNUSED(written);
+    }
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("flacplayer");
+    QCoreApplication::setApplicationName("flacplayer");     // Same resampler and log settings as the window
+#ifdef FLACPLAYER_VERSION
+    QCoreApplication::setApplicationVersion(FLACPLAYER_VERSION);
+#endif
+
+#ifdef Q_OS_UNIX
+    if (::pipe(s_signalPipe) == 0) {
+        QSocketNotifier *notifier = new QSocketNotifier(s_signalPipe[0], QSocketNotifier::Read, &app);
+        QObject::connect(notifier, &QSocketNotifier::activated, []() {
+            char byte;
+            const ssize_t got = ::read(s_signalPipe[0], &byte, 1);
+            Q_UNUSED(got);
+            Cli::interrupt();
+        });
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+    }
+#endif
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    return Cli::run(app.arguments().mid(1), out, err);
+}
@@ -0,0 +1,113 @@
+#include "playerdaemon.h"
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QTextStream>
+#ifdef Q_OS_UNIX
+#include <QSocketNotifier>
+#include <csignal>
+#include <unistd.h>
+#endif
+
+// Headless player for audio servers, no widgets or display needed:
+//   flacplayerd [--socket NAME] [files...]        runs the daemon, files are queued up front
+//   flacplayerd [--socket NAME] --send COMMAND...  sends one command to a running daemon and
+//                                                 prints the reply, exit code 1 when it failed
+// See PlayerDaemon for the commands. A plain socket client works just as well, e.g.
+//   echo status | socat - UNIX-CONNECT:/tmp/flacplayerd
+
+namespace {
+#ifdef Q_OS_UNIX
+    // Self-pipe: the handler only writes a byte, the event loop does the rest
+    int s_signalPipe[2] = {-1, -1};
+
+    void onSignal(int)
+    {
+        const char byte = 1;
+        const ssize_t written = ::write(s_signalPipe[1], &byte, 1);
+        Q_UNUSED(written);
+    }
+#endif
+
+    int sendCommand(const QString &socketName, const QString &command)
+    {
+        QTextStream out(stdout);
+        QTextStream err(stderr);
+        QLocalSocket socket;
+        socket.connectToServer(socketName);
+        if (!socket.waitForConnected(2000)) {
+            err << QString("flacplayerd: cannot connect to %1: %2").arg(socketName, socket.errorString()) << Qt::endl;
+            return 2;
+        }
+        socket.write(command.toUtf8() + '\n');
+        while (!socket.canReadLine()) {
+            if (!socket.waitForReadyRead(5000)) {
+                err << "flacplayerd: no reply" << Qt::endl;
+                return 2;
+            }
+        }
+        const QByteArray reply = socket.readLine().trimmed();
+        out << QString::fromUtf8(reply) << Qt::endl;
+        return QJsonDocument::fromJson(reply).object().value("ok").toBool() ? 0 : 1;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName("flacplayer");
+    QCoreApplication::setApplicationName("flacplayer");     // Shares the window's saved settings
+#ifdef FLACPLAYER_VERSION
+    QCoreApplication::setApplicationVersion(FLACPLAYER_VERSION);
+#endif
+
+    QStringList args = app.arguments().mid(1);
+    QString socketName = PlayerDaemon::defaultSocketName();
+    const int socketIndex = args.indexOf("--socket");
+    if (socketIndex >= 0 && socketIndex + 1 < args.size()) {
+        socketName = args[socketIndex + 1];
+        args.remove(socketIndex, 2);
+    }
+
+    const int sendIndex = args.indexOf("--send");
+    if (sendIndex >= 0) {
+        QStringList words = args.mid(sendIndex + 1);
+        // The daemon only takes absolute paths, a relative one means this shell's directory
+        if (words.size() > 1 && words.first().compare("enqueue", Qt::CaseInsensitive) == 0) {
+            words = QStringList{words.first(), QFileInfo(words.mid(1).join(' ')).absoluteFilePath()};
+        }
+        const QString command = words.join(' ');
+        if (command.isEmpty()) {
+            QTextStream(stderr) << "usage: flacplayerd [--socket NAME] --send COMMAND..." << Qt::endl;
+            return 2;
+        }
+        return sendCommand(socketName, command);
+    }
+
+    PlayerDaemon daemon;
+    if (!daemon.listen(socketName)) {
+        QTextStream(stderr) << "flacplayerd: " << daemon.lastError() << Qt::endl;
+        return 1;
+    }
+    QObject::connect(&daemon, &PlayerDaemon::quitRequested, &app, &QCoreApplication::quit);
+#ifdef Q_OS_UNIX
+    // SIGINT/SIGTERM from the service manager end the event loop, the socket file is removed on the way out
+    if (::pipe(s_signalPipe) == 0) {
+        QSocketNotifier *notifier = new QSocketNotifier(s_signalPipe[0], QSocketNotifier::Read, &app);
+        QObject::connect(notifier, &QSocketNotifier::activated, &app, &QCoreApplication::quit);
+        std::signal(SIGINT, onSignal);
+        std::signal(SIGTERM, onSignal);
+    }
+#endif
+
+    for (const QString &file : args) {
+        const QByteArray reply = daemon.execute("enqueue " + QFileInfo(file).absoluteFilePath());
+        if (!QJsonDocument::fromJson(reply).object().value("ok").toBool()) {
+            QTextStream(stderr) << "flacplayerd: " << QString::fromUtf8(reply) << Qt::endl;
+        }
+    }
+    QTextStream(stderr) << "flacplayerd: listening on " << daemon.serverName() << Qt::endl;
+    return app.exec();
+}
@@ -0,0 +1,383 @@
+#include "flacseeker.h"
+#include <QIODevice>
+#include <QtEndian>
+
+namespace {
+    // Header search reads this much at a time, the largest frame header is 16 bytes
+    constexpr qint64 ScanWindow = 64 * 1024;
+    constexpr qint64 MaxHeaderSize = 16;
+    // Below this range the remaining frames are walked one by one instead of bisected
+    constexpr qint64 LinearScanBytes = 32 * 1024;
+    constexpr int MaxBisectSteps = 64;
+
+    const int SampleRates[12] = {0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000};
+    const int SampleSizes[8] = {0, 8, 12, 0, 16, 20, 24, 32};
+
+    // CRC-8, polynomial x^8 + x^2 + x + 1, over the frame header
+    quint8 crc8(const uchar *data, qsizetype size)
+    {
+        quint8 crc = 0;
+        for (qsizetype i = 0; i < size; ++i) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 0x80) ? static_cast<quint8>((crc << 1) ^ 0x07) : static_cast<quint8>(crc << 1);
+            }
+        }
+        return crc;
+    }
+}
+
+bool FlacSeeker::open(const QString &filePath)
+{
+    m_file.close();
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_device = nullptr;
+        m_lastError = "Cannot open file";
+        return false;
+    }
+    return open(&m_file);
+}
+
+bool FlacSeeker::open(QIODevice *device)
+{
+    m_device = device;
+    m_size = device ? device->size() : 0;
+    m_seekPoints.clear();
+    m_totalSamples = 0;
+    m_sampleRate = 0;
+    m_channels = 0;
+    m_bitsPerSample = 0;
+    m_minBlockSize = 0;
+    m_maxBlockSize = 0;
+
+    if (!m_device || !readMetadata()) {
+        m_device = nullptr;
+        return false;
+    }
+    m_lastError.clear();
+    return true;
+}
+
+//STREAMINFO and SEEKTABLE only, everything else is skipped over
+bool FlacSeeker::readMetadata()
+{
+    if (!m_device->seek(0)) {
+        m_lastError = "Cannot read file";
+        return false;
+    }
+
+    QByteArray marker = m_device->read(10);
+    qint64 pos = 0;
+    // Some taggers put an ID3v2 tag in front of the stream
+    if (marker.size() == 10 && marker.startsWith("ID3")) {
+        const uchar *id3 = reinterpret_cast<const uchar *>(marker.constData());
+        qint64 tagSize = (qint64(id3[6] & 0x7F) << 21) | (qint64(id3[7] & 0x7F) << 14)
+                       | (qint64(id3[8] & 0x7F) << 7) | qint64(id3[9] & 0x7F);
+        pos = 10 + tagSize + ((id3[5] & 0x10) ? 10 : 0);
+        if (!m_device->seek(pos)) {
+            m_lastError = "Cannot read file";
+            return false;
+        }
+        marker = m_device->read(4);
+    }
+    if (!marker.startsWith("fLaC")) {
+        m_lastError = "Not a FLAC stream";
+        return false;
+    }
+    pos += 4;
+
+    bool last = false;
+    while (!last) {
+        if (!m_device->seek(pos)) {
+            m_lastError = "Truncated metadata";
+            return false;
+        }
+        QByteArray header = m_device->read(4);
+        if (header.size() < 4) {
+            m_lastError = "Truncated metadata";
+            return false;
+        }
+        const uchar *h = reinterpret_cast<const uchar *>(header.constData());
+        last = (h[0] & 0x80) != 0;
+        const int type = h[0] & 0x7F;
+        const qint64 length = (qint64(h[1]) << 16) | (qint64(h[2]) << 8) | h[3];
+        pos += 4;
+        if (pos + length > m_size) {
+            m_lastError = "Metadata block runs past the end of the file";
+            return false;
+        }
+
+        if (type == 0 && length >= 34) {
+            QByteArray info = m_device->read(34);
+            if (info.size() < 34) {
+                m_lastError = "Truncated STREAMINFO";
+                return false;
+            }
+            const uchar *d = reinterpret_cast<const uchar *>(info.constData());
+            m_minBlockSize = qFromBigEndian<quint16>(d);
+            m_maxBlockSize = qFromBigEndian<quint16>(d + 2);
+            const quint64 packed = qFromBigEndian<quint64>(d + 10);
+            m_sampleRate = static_cast<int>(packed >> 44);
+            m_channels = static_cast<int>((packed >> 41) & 0x7) + 1;
+            m_bitsPerSample = static_cast<int>((packed >> 36) & 0x1F) + 1;
+            m_totalSamples = static_cast<qint64>(packed & 0xFFFFFFFFFULL);
+        } else if (type == 3) {
+            QByteArray table = m_device->read(length);
+            const uchar *d = reinterpret_cast<const uchar *>(table.constData());
+            for (qsizetype i = 0; i + 18 <= table.size(); i += 18) {
+                const quint64 sample = qFromBigEndian<quint64>(d + i);
+                if (sample == 0xFFFFFFFFFFFFFFFFULL) {
+                    continue;   // Placeholder point
+                }
+                m_seekPoints.append(SeekPoint{static_cast<qint64>(sample),
+                                              static_cast<qint64>(qFromBigEndian<quint64>(d + i + 8))});
+            }
+        }
+        pos += length;
+    }
+
+    if (m_sampleRate <= 0) {
+        m_lastError = "Missing STREAMINFO";
+        return false;
+    }
+
+    // Seek point offsets are relative to the first frame
+    m_audioOffset = pos;
+    for (SeekPoint &point : m_seekPoints) {
+        point.offset += m_audioOffset;
+    }
+    return true;
+}
+
+bool FlacSeeker::locate(qint64 sample, FlacFramePosition *frame)
+{
+    m_probes = 0;
+    m_bytesRead = 0;
+    if (!m_device) {
+        m_lastError = "Not open";
+        return false;
+    }
+    sample = qMax<qint64>(sample, 0);
+    if (m_totalSamples > 0 && sample >= m_totalSamples) {
+        m_lastError = "Position past the end of the stream";
+        return false;
+    }
+
+    // lo is a frame start at or before the target, hi the first known position after it
+    FlacFramePosition lo;
+    lo.offset = m_audioOffset;
+    lo.sample = 0;
+    qint64 hiOffset = m_size;
+    qint64 hiSample = m_totalSamples > 0 ? m_totalSamples : -1;
+
+    for (const SeekPoint &point : m_seekPoints) {
+        if (point.offset < lo.offset || point.offset >= m_size) {
+            continue;   // Broken point, ignore it
+        }
+        if (point.sample <= sample) {
+            lo.offset = point.offset;
+            lo.sample = point.sample;
+        } else {
+            hiOffset = point.offset;
+            hiSample = point.sample;
+            break;
+        }
+    }
+
+    for (int step = 0; step < MaxBisectSteps && hiOffset - lo.offset > LinearScanBytes; ++step) {
+        // Interpolate by byte rate when the end is known, plain bisection otherwise
+        qint64 guess;
+        if (hiSample > lo.sample) {
+            double fraction = double(sample - lo.sample) / double(hiSample - lo.sample);
+            guess = lo.offset + static_cast<qint64>(fraction * double(hiOffset - lo.offset));
+        } else {
+            guess = lo.offset + (hiOffset - lo.offset) / 2;
+        }
+        guess = qBound(lo.offset + 1, guess, hiOffset - 1);
+
+        FlacFramePosition found;
+        if (!findFrame(guess, hiOffset, &found)) {
+            hiOffset = guess;   // No frame starts in [guess, hi), the target's frame is before it
+            continue;
+        }
+        if (found.sample > sample) {
+            hiOffset = found.offset;
+            hiSample = found.sample;
+        } else if (sample < found.sample + found.blockSize) {
+            *frame = found;
+            return true;
+        } else {
+            lo = found;
+        }
+    }
+
+    // Few frames left, walk them
+    FlacFramePosition best;
+    FlacFramePosition found;
+    qint64 pos = lo.offset;
+    while (findFrame(pos, hiOffset, &found)) {
+        if (found.sample > sample) {
+            break;
+        }
+        best = found;
+        if (sample < found.sample + found.blockSize) {
+            break;
+        }
+        pos = found.offset + 1;
+    }
+
+    if (best.offset < 0) {
+        m_lastError = "No frame found for the position";
+        return false;
+    }
+    *frame = best;
+    return true;
+}
+
+//first valid frame header starting in [from, limit)
+bool FlacSeeker::findFrame(qint64 from, qint64 limit, FlacFramePosition *frame)
+{
+    ++m_probes;
+    qint64 pos = qMax(from, m_audioOffset);
+    limit = qMin(limit, m_size);
+
+    while (pos < limit) {
+        const qint64 want = qMin(qMin(ScanWindow, limit - pos) + MaxHeaderSize, m_size - pos);
+        if (!m_device->seek(pos)) {
+            return false;
+        }
+        m_window.resize(want);
+        const qint64 got = m_device->read(m_window.data(), want);
+        if (got <= 0) {
+            return false;
+        }
+        m_bytesRead += got;
+
+        const uchar *data = reinterpret_cast<const uchar *>(m_window.constData());
+        const qint64 scanEnd = qMin(qMin(got, ScanWindow), limit - pos);
+        for (qint64 i = 0; i < scanEnd; ++i) {
+            if (data[i] == 0xFF && i + 1 < got && (data[i + 1] & 0xFE) == 0xF8
+                && parseFrameHeader(data + i, got - i, frame)) {
+                frame->offset = pos + i;
+                return true;
+            }
+        }
+        pos += scanEnd;
+    }
+    return false;
+}
+
+//a sync code alone turns up in compressed audio all the time, so everything in the header
+//has to be valid, consistent with STREAMINFO and match its CRC-8
+bool FlacSeeker::parseFrameHeader(const uchar *data, qsizetype size, FlacFramePosition *frame) const
+{
+    if (size < 6 || data[0] != 0xFF || (data[1] & 0xFE) != 0xF8) {
+        return false;
+    }
+    const bool variableBlockSize = data[1] & 0x01;
+    const int blockSizeCode = data[2] >> 4;
+    const int rateCode = data[2] & 0x0F;
+    const int channelCode = data[3] >> 4;
+    const int sizeCode = (data[3] >> 1) & 0x07;
+    if (blockSizeCode == 0 || rateCode == 15 || channelCode > 10 || sizeCode == 3 || (data[3] & 0x01)) {
+        return false;
+    }
+    const int channels = channelCode < 8 ? channelCode + 1 : 2;
+    if (channels != m_channels || (sizeCode != 0 && SampleSizes[sizeCode] != m_bitsPerSample)) {
+        return false;
+    }
+
+    // Frame or sample number, UTF-8 style variable length
+    qsizetype pos = 4;
+    const uchar first = data[pos++];
+    quint64 number;
+    int extra;
+    if (!(first & 0x80)) {
+        number = first;
+        extra = 0;
+    } else if ((first & 0xE0) == 0xC0) {
+        number = first & 0x1F;
+        extra = 1;
+    } else if ((first & 0xF0) == 0xE0) {
+        number = first & 0x0F;
+        extra = 2;
+    } else if ((first & 0xF8) == 0xF0) {
+        number = first & 0x07;
+        extra = 3;
+    } else if ((first & 0xFC) == 0xF8) {
+        number = first & 0x03;
+        extra = 4;
+    } else if ((first & 0xFE) == 0xFC) {
+        number = first & 0x01;
+        extra = 5;
+    } else if (first == 0xFE) {
+        number = 0;
+        extra = 6;
+    } else {
+        return false;
+    }
+    if (pos + extra > size) {
+        return false;
+    }
+    for (int i = 0; i < extra; ++i) {
+        const uchar byte = data[pos++];
+        if ((byte & 0xC0) != 0x80) {
+            return false;
+        }
+        number = (number << 6) | (byte & 0x3F);
+    }
+
+    int blockSize;
+    if (blockSizeCode == 1) {
+        blockSize = 192;
+    } else if (blockSizeCode <= 5) {
+        blockSize = 576 << (blockSizeCode - 2);
+    } else if (blockSizeCode == 6) {
+        if (pos + 1 > size) {
+            return false;
+        }
+        blockSize = data[pos] + 1;
+        pos += 1;
+    } else if (blockSizeCode == 7) {
+        if (pos + 2 > size) {
+            return false;
+        }
+        blockSize = ((data[pos] << 8) | data[pos + 1]) + 1;
+        pos += 2;
+    } else {
+        blockSize = 256 << (blockSizeCode - 8);
+    }
+
+    int rate = SampleRates[qMin(rateCode, 11)];
+    if (rateCode >= 12) {
+        const int bytes = rateCode == 12 ? 1 : 2;
+        if (pos + bytes > size) {
+            return false;
+        }
+        const int value = bytes == 1 ? data[pos] : ((data[pos] << 8) | data[pos + 1]);
+        rate = rateCode == 12 ? value * 1000 : (rateCode == 13 ? value : value * 10);
+        pos += bytes;
+    }
+    if (rateCode != 0 && rate != m_sampleRate) {
+        return false;
+    }
+
+    if (pos >= size || crc8(data, pos) != data[pos]) {
+        return false;
+    }
+    if (m_maxBlockSize > 0 && blockSize > m_maxBlockSize) {
+        return false;
+    }
+
+    // Fixed-size streams count frames, every frame but the last has the STREAMINFO block size
+    const qint64 firstSample = variableBlockSize ? static_cast<qint64>(number)
+        : static_cast<qint64>(number) * (m_maxBlockSize > 0 ? m_maxBlockSize : blockSize);
+    if (m_totalSamples > 0 && firstSample >= m_totalSamples) {
+        return false;
+    }
+
+    frame->sample = firstSample;
+    frame->blockSize = blockSize;
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef FLACSEEKER_H
+#define FLACSEEKER_H
+
+#include <QString>
+#include <QList>
+#include <QFile>
+
+class QIODevice;
+
+//a FLAC frame found in the stream: absolute byte offset of its header and its first sample
+struct FlacFramePosition {
+    qint64 offset = -1;
+    qint64 sample = -1;
+    int blockSize = 0;
+};
+
+//finds the frame holding a given sample without decoding anything. SEEKTABLE points narrow
+//the search when present, inside the remaining range frame headers are bisected (interpolated
+//by byte rate, validated by CRC-8 and the STREAMINFO parameters) until the frame is found.
+//the caller decodes from there and drops the samples before the target
+class FlacSeeker
+{
+public:
+    FlacSeeker() = default;
+
+    FlacSeeker(const FlacSeeker &) = delete;
+    FlacSeeker &operator=(const FlacSeeker &) = delete;
+
+    bool open(const QString &filePath);
+    //device must stay open and alive while the seeker is used, it is not taken over
+    bool open(QIODevice *device);
+
+    bool locate(qint64 sample, FlacFramePosition *frame);
+
+    int sampleRate() const { return m_sampleRate; }
+    int channels() const { return m_channels; }
+    int bitsPerSample() const { return m_bitsPerSample; }
+    int maxBlockSize() const { return m_maxBlockSize; }     // 0 = not given
+    qint64 totalSamples() const { return m_totalSamples; }
+    qint64 audioOffset() const { return m_audioOffset; }
+    int seekPointCount() const { return m_seekPoints.size(); }
+
+    //cost of the last locate(), for the seek benchmark and the playback log
+    int lastProbeCount() const { return m_probes; }
+    qint64 lastBytesRead() const { return m_bytesRead; }
+    QString lastError() const { return m_lastError; }
+
+private:
+    struct SeekPoint {
+        qint64 sample;
+        qint64 offset;      // absolute
+    };
+
+    bool readMetadata();
+    bool findFrame(qint64 from, qint64 limit, FlacFramePosition *frame);
+    bool parseFrameHeader(const uchar *data, qsizetype size, FlacFramePosition *frame) const;
+
+    QFile m_file;
+    QIODevice *m_device = nullptr;
+    qint64 m_size = 0;
+    QByteArray m_window;
+
+    qint64 m_audioOffset = 0;
+    int m_minBlockSize = 0;
+    int m_maxBlockSize = 0;
+    int m_sampleRate = 0;
+    int m_channels = 0;
+    int m_bitsPerSample = 0;
+    qint64 m_totalSamples = 0;      // 0 = unknown
+    QList<SeekPoint> m_seekPoints;
+
+    int m_probes = 0;
+    qint64 m_bytesRead = 0;
+    QString m_lastError;
+};
+
+#endif // FLACSEEKER_H
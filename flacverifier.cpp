@@ -0,0 +1,281 @@
+#include "flacverifier.h"
+#include "audiodecoder.h"
+#include "audiomanager.h"
+#include "logging.h"
+#include "parallelflacdecoder.h"
+#include <QCryptographicHash>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QThread>
+
+namespace {
+    // Repacks a decoded frame the way the FLAC MD5 is defined: interleaved, little-endian,
+    // ceil(bps / 8) bytes per sample, with the decoder's left-justification undone
+    bool packFrameForMd5(const AVFrame *frame, int bitsPerSample, QByteArray &scratch)
+    {
+        const AVSampleFormat format = static_cast<AVSampleFormat>(frame->format);
+        const int containerBytes = av_get_bytes_per_sample(format);
+        if (containerBytes != 2 && containerBytes != 4) {
+            return false;
+        }
+        if (bitsPerSample <= 0 || bitsPerSample > containerBytes * 8) {
+            return false;
+        }
+
+        const int shift = containerBytes * 8 - bitsPerSample;
+        const int outBytes = (bitsPerSample + 7) / 8;
+        const int channels = frame->ch_layout.nb_channels;
+        const int samples = frame->nb_samples;
+        const bool planar = av_sample_fmt_is_planar(format);
+
+        scratch.resize(samples * channels * outBytes);
+        uchar *out = reinterpret_cast<uchar *>(scratch.data());
+
+        for (int i = 0; i < samples; ++i) {
+            for (int ch = 0; ch < channels; ++ch) {
+                const int plane = planar ? ch : 0;
+                const int index = planar ? i : i * channels + ch;
+                qint32 value;
+                if (containerBytes == 2) {
+                    value = reinterpret_cast<const qint16 *>(frame->extended_data[plane])[index];
+                } else {
+                    value = reinterpret_cast<const qint32 *>(frame->extended_data[plane])[index];
+                }
+                value >>= shift;
+                for (int b = 0; b < outBytes; ++b) {
+                    *out++ = static_cast<uchar>(value >> (8 * b));
+                }
+            }
+        }
+        return true;
+    }
+
+    // The same from the native decoder's right-justified int32 planes
+    void packPlanesForMd5(const int32_t *const *planes, int channels, int offset, int samples,
+                          int bitsPerSample, QByteArray &scratch)
+    {
+        const int outBytes = (bitsPerSample + 7) / 8;
+        scratch.resize(samples * channels * outBytes);
+        uchar *out = reinterpret_cast<uchar *>(scratch.data());
+        for (int i = offset; i < offset + samples; ++i) {
+            for (int ch = 0; ch < channels; ++ch) {
+                const int32_t value = planes[ch][i];
+                for (int b = 0; b < outBytes; ++b) {
+                    *out++ = static_cast<uchar>(value >> (8 * b));
+                }
+            }
+        }
+    }
+
+    // Status of a file whose audio decoded without errors
+    void compareSignature(VerifyResult &result, const FlacMetadata &metadata, bool hasSignature,
+                          quint64 decodedSamples, const QByteArray &md5)
+    {
+        if (metadata.totalSamples > 0 && decodedSamples != metadata.totalSamples) {
+            result.status = VerifyResult::Mismatch;
+            result.message = QString("Decoded %1 samples, STREAMINFO says %2")
+                .arg(decodedSamples).arg(metadata.totalSamples);
+        } else if (!hasSignature) {
+            result.status = VerifyResult::NoSignature;
+            result.message = "No MD5 stored, audio decodes cleanly";
+        } else if (md5 != metadata.audioMd5) {
+            result.status = VerifyResult::Mismatch;
+            result.message = "Audio MD5 does not match STREAMINFO";
+        } else {
+            result.status = VerifyResult::Ok;
+        }
+    }
+}
+
+QString VerifyResult::statusName(Status status)
+{
+    switch (status) {
+        case Ok:
+            return "OK";
+        case Mismatch:
+            return "MISMATCH";
+        case NoSignature:
+            return "NO_MD5";
+        case DecodeError:
+            return "ERROR";
+        case Cancelled:
+            return "CANCELLED";
+    }
+    return "ERROR";
+}
+
+FlacVerifier::FlacVerifier(QObject *parent)
+    : QObject(parent)
+{
+}
+
+FlacVerifier::~FlacVerifier()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+QStringList FlacVerifier::collectFlacFiles(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QDirIterator it(path, QStringList() << "*.flac" << "*.FLAC", QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                files.append(it.next());
+            }
+        } else if (info.isFile()) {
+            files.append(path);
+        }
+    }
+    return files;
+}
+
+VerifyResult FlacVerifier::verifyFile(const QString &filePath, const std::atomic<bool> *cancelled, int decodeThreads)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    VerifyResult result;
+    result.filePath = filePath;
+    result.bytes = QFileInfo(filePath).size();
+
+    if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+        result.status = VerifyResult::Cancelled;
+        return result;
+    }
+
+    // STREAMINFO only, no tags or pictures
+    MetadataEditor editor;
+    FlacMetadata metadata = editor.readMetadata(filePath, MetadataEditor::FieldStreamInfo);
+    if (!editor.lastError().isEmpty() || metadata.sampleRate == 0) {
+        result.status = VerifyResult::DecodeError;
+        result.message = editor.lastError().isEmpty() ? "Missing STREAMINFO" : editor.lastError();
+        result.elapsedMs = timer.elapsed();
+        return result;
+    }
+
+    const bool hasSignature = metadata.audioMd5.size() == 16 && metadata.audioMd5 != QByteArray(16, '\0');
+
+    QCryptographicHash md5(QCryptographicHash::Md5);
+    QByteArray scratch;
+    quint64 decodedSamples = 0;
+
+    // Up to 24 bits the frames are decoded natively, split across decodeThreads cores. 32-bit
+    // streams (and files FlacSeeker can't parse) go through libavcodec below
+    ParallelFlacDecoder flac;
+    if (flac.open(filePath, decodeThreads)) {
+        int frames;
+        while ((frames = flac.next()) > 0) {
+            if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+                result.status = VerifyResult::Cancelled;
+                result.elapsedMs = timer.elapsed();
+                return result;
+            }
+            // In pieces so the scratch buffer stays small
+            for (int offset = 0; offset < frames; offset += flac.maxBlockSize()) {
+                const int samples = qMin(flac.maxBlockSize(), frames - offset);
+                packPlanesForMd5(flac.planes(), flac.channels(), offset, samples, metadata.bitsPerSample, scratch);
+                md5.addData(scratch);
+            }
+            decodedSamples += frames;
+        }
+        result.elapsedMs = timer.elapsed();
+        if (frames < 0) {
+            result.status = VerifyResult::DecodeError;
+            result.message = flac.lastError();
+        } else if (flac.skippedFrames() > 0) {
+            result.status = VerifyResult::DecodeError;
+            result.message = QString("%1 damaged frame(s)").arg(flac.skippedFrames());
+        } else {
+            compareSignature(result, metadata, hasSignature, decodedSamples, md5.result());
+        }
+        return result;
+    }
+
+    AudioDecoder decoder;
+    if (!decoder.open(filePath, true)) {
+        result.status = VerifyResult::DecodeError;
+        result.message = decoder.lastError();
+        result.elapsedMs = timer.elapsed();
+        return result;
+    }
+
+    while (AVFrame *frame = decoder.decodeNextFrame()) {
+        if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+            result.status = VerifyResult::Cancelled;
+            result.elapsedMs = timer.elapsed();
+            return result;
+        }
+        if (!packFrameForMd5(frame, metadata.bitsPerSample, scratch)) {
+            result.status = VerifyResult::DecodeError;
+            result.message = "Unsupported decoder sample format";
+            result.elapsedMs = timer.elapsed();
+            return result;
+        }
+        md5.addData(scratch);
+        decodedSamples += frame->nb_samples;
+    }
+
+    result.elapsedMs = timer.elapsed();
+
+    if (decoder.decodeErrors() > 0 || decoder.hadReadError()) {
+        result.status = VerifyResult::DecodeError;
+        result.message = decoder.hadReadError() ? decoder.lastError()
+            : QString("%1 damaged frame(s)").arg(decoder.decodeErrors());
+    } else {
+        compareSignature(result, metadata, hasSignature, decodedSamples, md5.result());
+    }
+    return result;
+}
+
+void FlacVerifier::start(const QStringList &files, int maxThreads)
+{
+    m_cancelled = false;
+    m_total = files.size();
+    m_pending = m_total;
+    m_done = 0;
+    m_problems = 0;
+    m_totalBytes = 0;
+    m_timer.start();
+
+    m_pool.setMaxThreadCount(maxThreads > 0 ? maxThreads : QThread::idealThreadCount());
+
+    if (files.isEmpty()) {
+        emit finished(0, 0, 0);
+        return;
+    }
+
+    // With fewer files than threads the spare ones go to decoding within each file
+    const int decodeThreads = qMax(1, m_pool.maxThreadCount() / int(files.size()));
+    for (const QString &file : files) {
+        m_pool.start([this, file, decodeThreads]() {
+            VerifyResult result = verifyFile(file, &m_cancelled, decodeThreads);
+            QMetaObject::invokeMethod(this, [this, result]() { onResult(result); }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void FlacVerifier::cancel()
+{
+    m_cancelled = true;
+}
+
+void FlacVerifier::onResult(const VerifyResult &result)
+{
+    ++m_done;
+    --m_pending;
+    m_totalBytes += result.bytes;
+    PerfLog::record("verify", "verify_file", result.elapsedMs * 1000, result.bytes, result.filePath);
+    if (result.isProblem()) {
+        ++m_problems;
+    }
+
+    emit fileVerified(result);
+    emit progressUpdated(m_done, m_total);
+
+    if (m_pending == 0) {
+        emit finished(m_problems, m_totalBytes, m_timer.elapsed());
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef FLACVERIFIER_H
+#define FLACVERIFIER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <atomic>
+
+//outcome of checking one file against the MD5 stored in its STREAMINFO
+struct VerifyResult {
+    enum Status {
+        Ok,             // Decoded audio matches the signature
+        Mismatch,       // Decoded cleanly but the MD5 (or sample count) differs
+        NoSignature,    // Encoder didn't store an MD5, only decodability was checked
+        DecodeError,    // Unreadable, damaged frames or CRC failures
+        Cancelled
+    };
+
+    QString filePath;
+    Status status = DecodeError;
+    QString message;
+    qint64 bytes = 0;           // Size of the file on disk
+    qint64 elapsedMs = 0;
+
+    bool isProblem() const { return status == Mismatch || status == DecodeError; }
+    static QString statusName(Status status);
+};
+Q_DECLARE_METATYPE(VerifyResult)
+
+//decodes FLAC files on a thread pool and checks the audio MD5 against STREAMINFO.
+//results are delivered on the thread that owns the verifier
+class FlacVerifier : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FlacVerifier(QObject *parent = nullptr);
+    ~FlacVerifier();
+
+    //expands directories recursively to the *.flac files below them
+    static QStringList collectFlacFiles(const QStringList &paths);
+
+    //synchronous check of one file, safe to call from any thread. FLAC up to 24 bits is decoded
+    //on up to decodeThreads cores
+    static VerifyResult verifyFile(const QString &filePath, const std::atomic<bool> *cancelled = nullptr,
+                                   int decodeThreads = 1);
+
+    void start(const QStringList &files, int maxThreads = 0);
+    void cancel();
+    bool isRunning() const { return m_pending > 0; }
+
+signals:
+    void fileVerified(const VerifyResult &result);
+    void progressUpdated(int done, int total);
+    //totalBytes / elapsedMs gives the achieved throughput
+    void finished(int problems, qint64 totalBytes, qint64 elapsedMs);
+
+private:
+    void onResult(const VerifyResult &result);
+
+    QThreadPool m_pool;
+    std::atomic<bool> m_cancelled{false};
+    int m_pending = 0;
+    int m_total = 0;
+    int m_done = 0;
+    int m_problems = 0;
+    qint64 m_totalBytes = 0;
+    QElapsedTimer m_timer;
+};
+
+#endif // FLACVERIFIER_H
@@ -0,0 +1,137 @@
+#include "framescheduler.h"
+#include <QEvent>
+#include <QScreen>
+#include <QWidget>
+
+FrameScheduler::FrameScheduler(QWidget *window, QObject *parent)
+    : QObject(parent)
+    , m_window(window)
+{
+    m_timer.setTimerType(Qt::PreciseTimer);
+    m_timer.setInterval(1000 / DefaultRefreshHz);
+    connect(&m_timer, &QTimer::timeout, this, &FrameScheduler::frame);
+    m_clock.start();
+    if (m_window) {
+        m_window->installEventFilter(this);
+    }
+}
+
+int FrameScheduler::addClient(const QString &name, Work work)
+{
+    Client client;
+    client.name = name;
+    client.work = std::move(work);
+    m_clients.append(client);
+    return m_clients.size() - 1;
+}
+
+void FrameScheduler::markDirty(int client)
+{
+    m_clients[client].dirty = true;
+    wake();
+}
+
+void FrameScheduler::setContinuous(int client, bool continuous)
+{
+    m_clients[client].continuous = continuous;
+    if (continuous) {
+        wake();
+    }
+}
+
+FrameStats FrameScheduler::stats() const
+{
+    FrameStats stats;
+    stats.frames = m_frames;
+    stats.hiddenSkips = m_hiddenSkips;
+    stats.late = m_late;
+    stats.averageUs = m_work.meanUs();
+    stats.maxUs = double(m_work.maxUs());
+    stats.intervalMs = m_timer.interval();
+    return stats;
+}
+
+void FrameScheduler::resetStats()
+{
+    m_frames = 0;
+    m_hiddenSkips = 0;
+    m_late = 0;
+    m_work.clear();
+    m_intervals.clear();
+    for (Client &client : m_clients) {
+        client.runs = 0;
+    }
+}
+
+//shown again or un-minimized: whatever piled up meanwhile gets its frame
+bool FrameScheduler::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == m_window && (event->type() == QEvent::Show || event->type() == QEvent::WindowStateChange)) {
+        wake();
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void FrameScheduler::frame()
+{
+    if (!windowShown()) {
+        // Nothing to look at, the dirty flags stay for when the window comes back
+        ++m_hiddenSkips;
+        m_timer.stop();
+        m_lastFrameNs = -1;
+        return;
+    }
+    if (!hasWork()) {
+        m_timer.stop();
+        m_lastFrameNs = -1;
+        return;
+    }
+
+    const qint64 startNs = m_clock.nsecsElapsed();
+    if (m_lastFrameNs >= 0) {
+        const qint64 intervalUs = (startNs - m_lastFrameNs) / 1000;
+        m_intervals.add(intervalUs);
+        if (intervalUs > qint64(m_timer.interval()) * 1500) {
+            ++m_late;
+        }
+    }
+    m_lastFrameNs = startNs;
+
+    // A client marking itself (or another) dirty from its work is picked up on the next frame
+    for (Client &client : m_clients) {
+        if (client.dirty || client.continuous) {
+            client.dirty = false;
+            ++client.runs;
+            client.work();
+        }
+    }
+    ++m_frames;
+    m_work.add((m_clock.nsecsElapsed() - startNs) / 1000);
+}
+
+void FrameScheduler::wake()
+{
+    if (m_timer.isActive() || !hasWork() || !windowShown()) {
+        return;
+    }
+    // The screen can change between wakes, e.g. the window was moved to a 144 Hz monitor
+    const QScreen *screen = m_window ? m_window->screen() : nullptr;
+    const qreal refreshHz = screen && screen->refreshRate() >= 24.0 ? screen->refreshRate() : DefaultRefreshHz;
+    m_timer.setInterval(qMax(1, qRound(1000.0 / refreshHz)));
+    m_timer.start();
+}
+
+bool FrameScheduler::hasWork() const
+{
+    for (const Client &client : m_clients) {
+        if (client.dirty || client.continuous) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameScheduler::windowShown() const
+{
+    return !m_window || (m_window->isVisible() && !m_window->isMinimized());
+}
@@ -0,0 +1,90 @@
+#ifndef FRAMESCHEDULER_H
+#define FRAMESCHEDULER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+#include <functional>
+#include "latencytracker.h"
+
+class QWidget;
+
+struct FrameStats
+{
+    qint64 frames = 0;          // frames that ran at least one client
+    qint64 hiddenSkips = 0;     // frames that found the window hidden or minimized
+    qint64 late = 0;            // frames that started more than half an interval late
+    double averageUs = 0.0;     // work per frame, all clients together
+    double maxUs = 0.0;
+    int intervalMs = 0;
+};
+
+//one frame clock for the window's periodic UI updates. clients mark themselves dirty when their
+//value changes (a position from the backend, the mouse moved) and each dirty client runs once on
+//the next frame, so a burst of backend ticks or mouse moves costs one label update and one repaint
+//per frame. continuous clients (the spectrum bars) run every frame while they are on.
+//the clock follows the screen's refresh rate and only ticks while there is work, the paints the
+//clients ask for are then merged by Qt into one flush per frame. nothing runs while the window is
+//hidden or minimized, the dirty clients catch up when it is shown again
+class FrameScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    using Work = std::function<void()>;
+
+    static constexpr int DefaultRefreshHz = 60;
+
+    //window is the top-level widget whose visibility gates the frames, nullptr for always shown
+    explicit FrameScheduler(QWidget *window, QObject *parent = nullptr);
+
+    int addClient(const QString &name, Work work);
+    void markDirty(int client);
+    void setContinuous(int client, bool continuous);
+    bool isDirty(int client) const { return m_clients[client].dirty; }
+    bool isRunning() const { return m_timer.isActive(); }
+    int intervalMs() const { return m_timer.interval(); }
+
+    int clientCount() const { return m_clients.size(); }
+    QString clientName(int client) const { return m_clients[client].name; }
+    qint64 clientRuns(int client) const { return m_clients[client].runs; }
+
+    FrameStats stats() const;
+    //work per frame and time between frames, for the latency panel
+    const LatencyHistogram &workHistogram() const { return m_work; }
+    const LatencyHistogram &intervalHistogram() const { return m_intervals; }
+    void resetStats();
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    struct Client
+    {
+        QString name;
+        Work work;
+        bool dirty = false;
+        bool continuous = false;
+        qint64 runs = 0;
+    };
+
+    void frame();
+    void wake();
+    bool hasWork() const;
+    bool windowShown() const;
+
+    QWidget *m_window;
+    QVector<Client> m_clients;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_lastFrameNs = -1;
+    qint64 m_frames = 0;
+    qint64 m_hiddenSkips = 0;
+    qint64 m_late = 0;
+    LatencyHistogram m_work;
+    LatencyHistogram m_intervals;
+};
+
+#endif // FRAMESCHEDULER_H
@@ -0,0 +1,235 @@
+#include "latencytracker.h"
+#include "logging.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <chrono>
+#include <cmath>
+
+// ---------------------------------------------------------------------------
+// LatencyHistogram
+
+void LatencyHistogram::add(qint64 us)
+{
+    us = qMax<qint64>(us, 0);
+    ++m_buckets[bucketFor(us)];
+    m_minUs = m_count == 0 ? us : qMin(m_minUs, us);
+    m_maxUs = m_count == 0 ? us : qMax(m_maxUs, us);
+    m_sumUs += us;
+    ++m_count;
+}
+
+void LatencyHistogram::clear()
+{
+    *this = LatencyHistogram();
+}
+
+double LatencyHistogram::meanUs() const
+{
+    return m_count > 0 ? double(m_sumUs) / double(m_count) : 0.0;
+}
+
+qint64 LatencyHistogram::percentileUs(double p) const
+{
+    if (m_count == 0) {
+        return 0;
+    }
+    const qint64 rank = qMax<qint64>(1, qint64(std::ceil(qBound(0.0, p, 100.0) / 100.0 * double(m_count))));
+    qint64 seen = 0;
+    for (int i = 0; i < BucketCount; ++i) {
+        seen += m_buckets[i];
+        if (seen >= rank) {
+            return qBound(m_minUs, bucketUpperUs(i), m_maxUs);
+        }
+    }
+    return m_maxUs;
+}
+
+int LatencyHistogram::bucketFor(qint64 us)
+{
+    for (int i = 0; i < BucketCount - 1; ++i) {
+        if (us <= bucketUpperUs(i)) {
+            return i;
+        }
+    }
+    return BucketCount - 1;
+}
+
+qint64 LatencyHistogram::bucketUpperUs(int bucket)
+{
+    // 50 us * sqrt(2)^bucket, exact at the even buckets
+    return qint64(std::llround(50.0 * std::pow(2.0, bucket / 2.0)));
+}
+
+// ---------------------------------------------------------------------------
+// LatencyTracker
+
+qint64 LatencyTracker::nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyTracker::begin(Action action, qint64 ns)
+{
+    if (m_open) {
+        ++m_abandoned[m_action];
+    }
+    m_open = true;
+    m_action = action;
+    for (qint64 &stamp : m_stamps) {
+        stamp = 0;
+    }
+    for (qint64 &span : m_spans) {
+        span = -1;
+    }
+    m_stamps[UiEvent] = ns;
+}
+
+void LatencyTracker::mark(Stage stage, qint64 ns)
+{
+    if (!m_open || stage == UiEvent || ns < m_stamps[UiEvent] || m_stamps[stage] != 0) {
+        return;
+    }
+    m_stamps[stage] = ns;
+    if (stage == FirstOutput) {
+        complete();
+    }
+}
+
+void LatencyTracker::addSpan(Span span, qint64 us)
+{
+    if (m_open) {
+        m_spans[span] = qMax<qint64>(us, 0);
+    }
+}
+
+void LatencyTracker::complete()
+{
+    m_open = false;
+    ++m_completed[m_action];
+
+    // Gaps between the stages that were reached, a seek has no source stage and the Qt
+    // Multimedia backend reports no decoded stage
+    int previous = UiEvent;
+    for (int stage = SourceSet; stage < StageCount; ++stage) {
+        if (m_stamps[stage] == 0) {
+            continue;
+        }
+        // Backends can stamp a stage marginally before the one it follows on another thread
+        const qint64 us = qMax<qint64>(0, (m_stamps[stage] - m_stamps[previous]) / 1000);
+        record(stageName(Stage(previous)) + "_to_" + stageName(Stage(stage)), us);
+        previous = stage;
+    }
+    for (int span = 0; span < SpanCount; ++span) {
+        if (m_spans[span] >= 0) {
+            record(spanName(Span(span)), m_spans[span]);
+        }
+    }
+
+    const qint64 totalUs = (m_stamps[FirstOutput] - m_stamps[UiEvent]) / 1000;
+    record("total", totalUs);
+    qCDebug(lcPlayback) << actionName(m_action) << "to audio in" << totalUs << "us";
+    PerfLog::record("latency", (actionName(m_action) + "_total").toLatin1().constData(), totalUs, 0);
+}
+
+void LatencyTracker::record(const QString &interval, qint64 us)
+{
+    m_histograms[m_action][interval].add(us);
+}
+
+void LatencyTracker::clear()
+{
+    *this = LatencyTracker();
+}
+
+QByteArray LatencyTracker::toJson() const
+{
+    QJsonObject actions;
+    for (int action = 0; action < ActionCount; ++action) {
+        QJsonObject intervals;
+        for (auto it = m_histograms[action].cbegin(); it != m_histograms[action].cend(); ++it) {
+            const LatencyHistogram &histogram = it.value();
+            // Only the occupied buckets, keyed by their upper edge
+            QJsonArray buckets;
+            for (int i = 0; i < LatencyHistogram::BucketCount; ++i) {
+                if (histogram.bucketCount(i) > 0) {
+                    QJsonObject bucket;
+                    bucket["le_us"] = i == LatencyHistogram::BucketCount - 1 ? -1.0 : double(LatencyHistogram::bucketUpperUs(i));
+                    bucket["count"] = double(histogram.bucketCount(i));
+                    buckets.append(bucket);
+                }
+            }
+            QJsonObject entry;
+            entry["count"] = double(histogram.count());
+            entry["min_us"] = double(histogram.minUs());
+            entry["max_us"] = double(histogram.maxUs());
+            entry["mean_us"] = histogram.meanUs();
+            entry["p50_us"] = double(histogram.percentileUs(50));
+            entry["p90_us"] = double(histogram.percentileUs(90));
+            entry["p99_us"] = double(histogram.percentileUs(99));
+            entry["buckets"] = buckets;
+            intervals[it.key()] = entry;
+        }
+        QJsonObject summary;
+        summary["completed"] = m_completed[action];
+        summary["abandoned"] = m_abandoned[action];
+        summary["intervals"] = intervals;
+        actions[actionName(Action(action))] = summary;
+    }
+
+    QJsonObject root;
+    root["version"] = QCoreApplication::applicationVersion();
+    root["exported"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["actions"] = actions;
+    return QJsonDocument(root).toJson();
+}
+
+QString LatencyTracker::actionName(Action action)
+{
+    switch (action) {
+        case Play:
+            return "play";
+        case Next:
+            return "next";
+        case Previous:
+            return "previous";
+        case Seek:
+            return "seek";
+        case ActionCount:
+            break;
+    }
+    return "unknown";
+}
+
+QString LatencyTracker::stageName(Stage stage)
+{
+    switch (stage) {
+        case UiEvent:
+            return "ui";
+        case SourceSet:
+            return "source";
+        case FirstDecoded:
+            return "decoded";
+        case FirstOutput:
+            return "output";
+        case StageCount:
+            break;
+    }
+    return "unknown";
+}
+
+QString LatencyTracker::spanName(Span span)
+{
+    switch (span) {
+        case Metadata:
+            return "metadata";
+        case BackendSetup:
+            return "backend_setup";
+        case SpanCount:
+            break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,88 @@
+#ifndef LATENCYTRACKER_H
+#define LATENCYTRACKER_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+
+//log-scale latency histogram. bucket edges grow by sqrt(2) from 50 us, so percentiles come out
+//within ~20% whether it's a 2 ms seek or a multi-second cold start over the network
+class LatencyHistogram
+{
+public:
+    static constexpr int BucketCount = 40;      // the last one is open-ended, from ~26 s
+
+    void add(qint64 us);
+    void clear();
+
+    qint64 count() const { return m_count; }
+    qint64 minUs() const { return m_minUs; }
+    qint64 maxUs() const { return m_maxUs; }
+    double meanUs() const;
+    //upper edge of the bucket holding the p-th percentile (0..100), never above the largest sample
+    qint64 percentileUs(double p) const;
+    qint64 bucketCount(int bucket) const { return m_buckets[bucket]; }
+
+    static int bucketFor(qint64 us);
+    static qint64 bucketUpperUs(int bucket);
+
+private:
+    qint64 m_buckets[BucketCount] = {};
+    qint64 m_count = 0;
+    qint64 m_sumUs = 0;
+    qint64 m_minUs = 0;
+    qint64 m_maxUs = 0;
+};
+
+//end-to-end latency of user actions, from the click to the first audio handed to the device.
+//MainWindow opens a trace on the UI event and stamps the source being set, the backend stamps
+//the first decoded frame and the first buffer the sink pulled. each completed trace adds the
+//gaps between consecutive stages (and the loadTrack spans) to per-action histograms, which the
+//debug panel shows and toJson() exports so numbers can be compared between releases
+class LatencyTracker
+{
+public:
+    enum Action { Play, Next, Previous, Seek, ActionCount };
+    enum Stage { UiEvent, SourceSet, FirstDecoded, FirstOutput, StageCount };
+    enum Span { Metadata, BackendSetup, SpanCount };    // where loadTrack's time goes
+
+    //steady clock in ns, the same one the native engine stamps its stages with
+    static qint64 nowNs();
+
+    //opens a trace, a previous one still waiting for audio is counted as abandoned
+    void begin(Action action, qint64 ns = nowNs());
+    //stages stamped before the open trace began come from an earlier action and are dropped,
+    //FirstOutput completes the trace
+    void mark(Stage stage, qint64 ns = nowNs());
+    void addSpan(Span span, qint64 us);
+
+    bool isOpen() const { return m_open; }
+    Action openAction() const { return m_action; }
+    qint64 openedNs() const { return m_stamps[UiEvent]; }
+
+    //histograms of one action, keyed "ui_to_source", "decoded_to_output", "total", "metadata", ...
+    const QMap<QString, LatencyHistogram> &histograms(Action action) const { return m_histograms[action]; }
+    int completed(Action action) const { return m_completed[action]; }
+    int abandoned(Action action) const { return m_abandoned[action]; }
+    void clear();
+
+    QByteArray toJson() const;
+
+    static QString actionName(Action action);
+    static QString stageName(Stage stage);
+    static QString spanName(Span span);
+
+private:
+    void complete();
+    void record(const QString &interval, qint64 us);
+
+    bool m_open = false;
+    Action m_action = Play;
+    qint64 m_stamps[StageCount] = {};       // 0 = not reached
+    qint64 m_spans[SpanCount] = {};         // us, -1 = not timed
+    QMap<QString, LatencyHistogram> m_histograms[ActionCount];
+    int m_completed[ActionCount] = {};
+    int m_abandoned[ActionCount] = {};
+};
+
+#endif // LATENCYTRACKER_H
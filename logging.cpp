@@ -0,0 +1,87 @@
+#include "logging.h"
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+
+Q_LOGGING_CATEGORY(lcMetadata, "flacplayer.metadata", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcPlayback, "flacplayer.playback", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcConvert, "flacplayer.convert", QtInfoMsg)
+
+namespace {
+    struct PerfSink {
+        QMutex mutex;
+        QFile file;
+        bool enabled = false;
+
+        PerfSink()
+        {
+            const QString path = qEnvironmentVariable("FLACPLAYER_PERF_LOG");
+            if (path.isEmpty()) {
+                return;
+            }
+            file.setFileName(path);
+            enabled = file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text);
+            if (!enabled) {
+                qWarning() << "Cannot open performance log" << path;
+            }
+        }
+    };
+
+    // Opened once on first use, the environment is only consulted at that point
+    PerfSink &perfSink()
+    {
+        static PerfSink sink;
+        return sink;
+    }
+}
+
+bool PerfLog::isEnabled()
+{
+    return perfSink().enabled;
+}
+
+void PerfLog::record(const char *category, const char *event, qint64 durationUs, qint64 bytes, const QString &path)
+{
+    PerfSink &sink = perfSink();
+    if (!sink.enabled) {
+        return;
+    }
+
+    QJsonObject entry;
+    entry["ts"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    entry["cat"] = QString::fromLatin1(category);
+    entry["event"] = QString::fromLatin1(event);
+    entry["us"] = durationUs;
+    entry["bytes"] = bytes;
+    if (!path.isEmpty()) {
+        entry["path"] = path;
+    }
+
+    QByteArray line = QJsonDocument(entry).toJson(QJsonDocument::Compact);
+    line.append('\n');
+
+    // Whole lines, flushed, so the file stays parseable if the app dies
+    QMutexLocker locker(&sink.mutex);
+    sink.file.write(line);
+    sink.file.flush();
+}
+
+PerfScope::PerfScope(const char *category, const char *event, const QString &path)
+    : m_category(category)
+    , m_event(event)
+    , m_enabled(PerfLog::isEnabled())
+{
+    if (m_enabled) {
+        m_path = path;
+        m_timer.start();
+    }
+}
+
+PerfScope::~PerfScope()
+{
+    if (m_enabled) {
+        PerfLog::record(m_category, m_event, m_timer.nsecsElapsed() / 1000, m_bytes, m_path);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef LOGGING_H
+#define LOGGING_H
+
+#include <QLoggingCategory>
+#include <QElapsedTimer>
+#include <QString>
+
+//logging categories for the hot paths. debug output is off by default and costs a single
+//flag check when disabled, enable it with e.g. QT_LOGGING_RULES="flacplayer.metadata.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(lcMetadata)
+Q_DECLARE_LOGGING_CATEGORY(lcPlayback)
+Q_DECLARE_LOGGING_CATEGORY(lcConvert)
+
+//optional structured sink for performance analysis. when FLACPLAYER_PERF_LOG names a file,
+//every recorded event is appended to it as one JSON object per line:
+//{"ts":"...","cat":"metadata","event":"read","us":412,"bytes":8192,"path":"..."}
+namespace PerfLog {
+    bool isEnabled();
+    void record(const char *category, const char *event, qint64 durationUs, qint64 bytes,
+                const QString &path = QString());
+}
+
+//times a scope and records it on destruction, does nothing (not even start a timer) when the sink is off
+class PerfScope
+{
+public:
+    PerfScope(const char *category, const char *event, const QString &path = QString());
+    ~PerfScope();
+
+    PerfScope(const PerfScope &) = delete;
+    PerfScope &operator=(const PerfScope &) = delete;
+
+    void setBytes(qint64 bytes) { m_bytes = bytes; }
+    void addBytes(qint64 bytes) { m_bytes += bytes; }
+    //renames the event, e.g. "read" -> "read_cached"
+    void setEvent(const char *event) { m_event = event; }
+
+private:
+    const char *m_category;
+    const char *m_event;
+    QString m_path;
+    qint64 m_bytes = 0;
+    bool m_enabled;
+    QElapsedTimer m_timer;
+};
+
+#endif // LOGGING_H
@@ -0,0 +1,240 @@
+#include "loudnessdialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <cmath>
+
+namespace {
+    QString peakText(double linear)
+    {
+        return linear > 0.0 ? QString("%1 dBTP").arg(20.0 * std::log10(linear), 0, 'f', 1) : QString("-inf dBTP");
+    }
+}
+
+// LoudnessDialog implementation
+
+LoudnessDialog::LoudnessDialog(const QStringList &initialFiles, QWidget *parent)
+    : QDialog(parent)
+    , m_paths(initialFiles)
+    , m_scanner(new LoudnessScanner(this))
+    , m_albumCount(0)
+{
+    setupUI();
+    setWindowTitle("Loudness Scan (ReplayGain)");
+    resize(720, 460);
+
+    connect(m_scanner, &LoudnessScanner::trackScanned, this, &LoudnessDialog::onTrackScanned);
+    connect(m_scanner, &LoudnessScanner::albumScanned, this, &LoudnessDialog::onAlbumScanned);
+    connect(m_scanner, &LoudnessScanner::tagsWritten, this, &LoudnessDialog::onTagsWritten);
+    connect(m_scanner, &LoudnessScanner::progressUpdated, this, &LoudnessDialog::onProgressUpdated);
+    connect(m_scanner, &LoudnessScanner::finished, this, &LoudnessDialog::onScanFinished);
+}
+
+LoudnessDialog::~LoudnessDialog()
+{
+    // LoudnessScanner's destructor cancels and waits for the pool
+}
+
+void LoudnessDialog::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    // Source selection
+    QHBoxLayout *sourceLayout = new QHBoxLayout();
+    m_queuedLabel = new QLabel();
+    m_addFolderButton = new QPushButton("Add Folder...");
+    m_addFilesButton = new QPushButton("Add Files...");
+    sourceLayout->addWidget(m_queuedLabel);
+    sourceLayout->addStretch();
+    sourceLayout->addWidget(m_addFolderButton);
+    sourceLayout->addWidget(m_addFilesButton);
+    mainLayout->addLayout(sourceLayout);
+
+    // Parallelism, one decoder per thread
+    QFormLayout *formLayout = new QFormLayout();
+    m_threadsSpin = new QSpinBox();
+    m_threadsSpin->setRange(1, 64);
+    m_threadsSpin->setValue(QThread::idealThreadCount());
+    formLayout->addRow("Parallel files:", m_threadsSpin);
+    m_writeTagsCheck = new QCheckBox("Write REPLAYGAIN_* tags (FLAC)");
+    m_writeTagsCheck->setChecked(true);
+    formLayout->addRow("", m_writeTagsCheck);
+    mainLayout->addLayout(formLayout);
+
+    m_resultList = new QListWidget();
+    mainLayout->addWidget(m_resultList);
+
+    m_progressBar = new QProgressBar();
+    m_progressBar->setRange(0, 100);
+    m_progressBar->setValue(0);
+    mainLayout->addWidget(m_progressBar);
+
+    m_statusLabel = new QLabel("Ready to scan");
+    m_statusLabel->setAlignment(Qt::AlignCenter);
+    mainLayout->addWidget(m_statusLabel);
+
+    // Buttons
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addStretch();
+
+    m_scanButton = new QPushButton("Scan");
+    m_scanButton->setDefault(true);
+    m_scanButton->setMinimumWidth(100);
+
+    m_cancelButton = new QPushButton("Close");
+    m_cancelButton->setMinimumWidth(100);
+
+    buttonLayout->addWidget(m_scanButton);
+    buttonLayout->addWidget(m_cancelButton);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(m_addFolderButton, &QPushButton::clicked, this, &LoudnessDialog::onAddFolderClicked);
+    connect(m_addFilesButton, &QPushButton::clicked, this, &LoudnessDialog::onAddFilesClicked);
+    connect(m_scanButton, &QPushButton::clicked, this, &LoudnessDialog::onScanClicked);
+    connect(m_cancelButton, &QPushButton::clicked, this, &LoudnessDialog::onCancelClicked);
+
+    updateQueuedLabel();
+}
+
+void LoudnessDialog::updateQueuedLabel()
+{
+    m_queuedLabel->setText(QString("%1 file(s)/folder(s) selected").arg(m_paths.size()));
+    m_scanButton->setEnabled(!m_paths.isEmpty());
+}
+
+void LoudnessDialog::onAddFolderClicked()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, "Select Folder to Scan");
+    if (!dir.isEmpty()) {
+        m_paths.append(dir);
+        updateQueuedLabel();
+    }
+}
+
+void LoudnessDialog::onAddFilesClicked()
+{
+    QStringList files = QFileDialog::getOpenFileNames(this, "Select Audio Files", "",
+                                                      "Audio Files (*.flac *.m4a *.wav);;All Files (*)");
+    if (!files.isEmpty()) {
+        m_paths.append(files);
+        updateQueuedLabel();
+    }
+}
+
+void LoudnessDialog::onScanClicked()
+{
+    if (m_scanner->isRunning()) {
+        return;
+    }
+
+    QStringList files = LoudnessScanner::collectAudioFiles(m_paths);
+    files.removeDuplicates();
+    if (files.isEmpty()) {
+        m_statusLabel->setText("No audio files found");
+        return;
+    }
+
+    m_resultList->clear();
+    m_albumCount = 0;
+    m_progressBar->setRange(0, files.size());
+    m_progressBar->setValue(0);
+    m_statusLabel->setText(QString("Scanning %1 file(s)...").arg(files.size()));
+    m_scanButton->setEnabled(false);
+    m_addFolderButton->setEnabled(false);
+    m_addFilesButton->setEnabled(false);
+    m_threadsSpin->setEnabled(false);
+    m_writeTagsCheck->setEnabled(false);
+    m_cancelButton->setText("Cancel");
+
+    m_scanner->start(files, m_writeTagsCheck->isChecked(), m_threadsSpin->value());
+}
+
+void LoudnessDialog::onCancelClicked()
+{
+    if (m_scanner->isRunning()) {
+        m_statusLabel->setText("Cancelling...");
+        m_cancelButton->setEnabled(false);
+        m_scanner->cancel();
+    } else {
+        accept();
+    }
+}
+
+void LoudnessDialog::onTrackScanned(const LoudnessResult &result)
+{
+    QListWidgetItem *item;
+    if (result.ok) {
+        item = new QListWidgetItem(QString("%1 LUFS  LRA %2 LU  %3  gain %4 dB - %5")
+            .arg(result.integratedLufs, 0, 'f', 1)
+            .arg(result.rangeLu, 0, 'f', 1)
+            .arg(peakText(result.truePeak))
+            .arg(result.gainDb, 0, 'f', 2)
+            .arg(QFileInfo(result.filePath).fileName()));
+    } else {
+        item = new QListWidgetItem(QString("[ERROR] %1 - %2")
+            .arg(QFileInfo(result.filePath).fileName())
+            .arg(result.message));
+        item->setForeground(QColor(220, 60, 60));
+    }
+    item->setToolTip(result.filePath);
+    m_resultList->addItem(item);
+}
+
+void LoudnessDialog::onAlbumScanned(const AlbumLoudness &album)
+{
+    ++m_albumCount;
+    QListWidgetItem *item = new QListWidgetItem(QString("[Album] %1 LUFS  LRA %2 LU  %3  gain %4 dB - %5 (%6 tracks)")
+        .arg(album.integratedLufs, 0, 'f', 1)
+        .arg(album.rangeLu, 0, 'f', 1)
+        .arg(peakText(album.truePeak))
+        .arg(album.gainDb, 0, 'f', 2)
+        .arg(QDir(album.albumKey).dirName())
+        .arg(album.files.size()));
+    item->setToolTip(album.albumKey);
+    QFont font = item->font();
+    font.setBold(true);
+    item->setFont(font);
+    m_resultList->addItem(item);
+}
+
+void LoudnessDialog::onTagsWritten(const QString &filePath, bool ok, const QString &message)
+{
+    if (ok) {
+        m_taggedFiles.append(filePath);
+        return;
+    }
+    QListWidgetItem *item = new QListWidgetItem(QString("[TAGS] %1 - %2")
+        .arg(QFileInfo(filePath).fileName())
+        .arg(message));
+    item->setToolTip(filePath);
+    item->setForeground(QColor(220, 60, 60));
+    m_resultList->addItem(item);
+}
+
+void LoudnessDialog::onProgressUpdated(int done, int total)
+{
+    m_progressBar->setValue(done);
+    m_statusLabel->setText(QString("Scanned %1 of %2...").arg(done).arg(total));
+}
+
+void LoudnessDialog::onScanFinished(int failures, qint64 audioMs, qint64 elapsedMs)
+{
+    m_scanButton->setEnabled(true);
+    m_addFolderButton->setEnabled(true);
+    m_addFilesButton->setEnabled(true);
+    m_threadsSpin->setEnabled(true);
+    m_writeTagsCheck->setEnabled(true);
+    m_cancelButton->setText("Close");
+    m_cancelButton->setEnabled(true);
+
+    double speed = double(audioMs) / qMax<qint64>(elapsedMs, 1);
+    m_statusLabel->setText(QString("%1 album(s), %2 file(s) tagged, %3 problem(s) - %4x realtime")
+        .arg(m_albumCount)
+        .arg(m_taggedFiles.size())
+        .arg(failures)
+        .arg(speed, 0, 'f', 0));
+}
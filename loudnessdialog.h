@@ -0,0 +1,58 @@
+#ifndef LOUDNESSDIALOG_H
+#define LOUDNESSDIALOG_H
+
+#include <QDialog>
+#include <QListWidget>
+#include <QPushButton>
+#include <QProgressBar>
+#include <QLabel>
+#include <QSpinBox>
+#include <QCheckBox>
+#include "loudnessscanner.h"
+
+//batch EBU R128 analysis, lists track and album loudness and writes ReplayGain tags on request
+class LoudnessDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit LoudnessDialog(const QStringList &initialFiles, QWidget *parent = nullptr);
+    ~LoudnessDialog();
+
+    //tags were rewritten during the scan, cached metadata for these files is stale
+    QStringList taggedFiles() const { return m_taggedFiles; }
+
+private slots:
+    void onAddFolderClicked();
+    void onAddFilesClicked();
+    void onScanClicked();
+    void onCancelClicked();
+    void onTrackScanned(const LoudnessResult &result);
+    void onAlbumScanned(const AlbumLoudness &album);
+    void onTagsWritten(const QString &filePath, bool ok, const QString &message);
+    void onProgressUpdated(int done, int total);
+    void onScanFinished(int failures, qint64 audioMs, qint64 elapsedMs);
+
+private:
+    void setupUI();
+    void updateQueuedLabel();
+
+    QStringList m_paths;
+    QStringList m_taggedFiles;
+
+    QLabel *m_queuedLabel;
+    QPushButton *m_addFolderButton;
+    QPushButton *m_addFilesButton;
+    QSpinBox *m_threadsSpin;
+    QCheckBox *m_writeTagsCheck;
+    QListWidget *m_resultList;
+    QProgressBar *m_progressBar;
+    QLabel *m_statusLabel;
+    QPushButton *m_scanButton;
+    QPushButton *m_cancelButton;
+
+    LoudnessScanner *m_scanner;
+    int m_albumCount;
+};
+
+#endif // LOUDNESSDIALOG_H
@@ -0,0 +1,286 @@
+#include "loudnessmeter.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+    constexpr double Pi = 3.14159265358979323846;
+
+    // BS.1770 gates, compared as energies so no block needs a log
+    constexpr double AbsoluteGateLufs = -70.0;
+    constexpr double RelativeGateLu = -10.0;
+    constexpr double RangeRelativeGateLu = -20.0;
+
+    constexpr size_t GatingHops = 4;        // 400 ms
+    constexpr size_t ShortTermHops = 30;    // 3 s
+
+    double lufsToEnergy(double lufs)
+    {
+        return std::pow(10.0, (lufs + 0.691) / 10.0);
+    }
+
+    // Mean of every run of span consecutive hops
+    std::vector<double> slidingMeans(const std::vector<double> &hops, size_t span)
+    {
+        std::vector<double> blocks;
+        if (hops.size() < span) {
+            return blocks;
+        }
+        blocks.reserve(hops.size() - span + 1);
+        double sum = 0.0;
+        for (size_t i = 0; i < span; ++i) {
+            sum += hops[i];
+        }
+        blocks.push_back(sum / span);
+        for (size_t i = span; i < hops.size(); ++i) {
+            sum += hops[i] - hops[i - span];
+            blocks.push_back(std::max(sum, 0.0) / span);
+        }
+        return blocks;
+    }
+}
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channels)
+    : m_sampleRate(sampleRate)
+    , m_channels(channels)
+    , m_hopFrames(static_cast<size_t>(std::max(sampleRate / 10, 1)))
+{
+    // K-weighting for any rate, from the analogue prototypes behind the 48 kHz table in BS.1770
+    {
+        const double f0 = 1681.974450955533;
+        const double gainDb = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(Pi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        const double a0 = 1.0 + k / q + k * k;
+        m_shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        m_shelf.b1 = 2.0 * (k * k - vh) / a0;
+        m_shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        m_shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(Pi * f0 / sampleRate);
+        const double a0 = 1.0 + k / q + k * k;
+        m_highPass.b0 = 1.0;
+        m_highPass.b1 = -2.0;
+        m_highPass.b2 = 1.0;
+        m_highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        m_highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    m_filterState.assign(size_t(channels) * 4, 0.0);
+
+    // Surrounds count +1.5 dB, the LFE not at all (FFmpeg order: FL FR FC LFE BL BR)
+    m_weights.assign(size_t(channels), 1.0);
+    if (channels == 5) {
+        m_weights[3] = m_weights[4] = 1.41;
+    } else if (channels == 6) {
+        m_weights[3] = 0.0;
+        m_weights[4] = m_weights[5] = 1.41;
+    }
+
+    // True peak: 4x below 96 kHz, 2x below 192 kHz, above that the samples are close enough
+    m_oversample = sampleRate < 96000 ? 4 : (sampleRate < 192000 ? 2 : 1);
+    if (m_oversample > 1) {
+        m_tapsPerPhase = 12;
+        const int length = m_oversample * m_tapsPerPhase;
+        const double centre = (length - 1) / 2.0;
+        std::vector<double> prototype(size_t(length), 0.0);
+        for (int n = 0; n < length; ++n) {
+            // Windowed sinc cut at the original Nyquist, Blackman window
+            const double t = (n - centre) / m_oversample;
+            const double sinc = t == 0.0 ? 1.0 : std::sin(Pi * t) / (Pi * t);
+            const double w = 2.0 * Pi * (n + 1) / (length + 1);
+            prototype[size_t(n)] = sinc * (0.42 - 0.5 * std::cos(w) + 0.08 * std::cos(2.0 * w));
+        }
+        m_taps.assign(size_t(length), 0.0f);
+        for (int p = 0; p < m_oversample; ++p) {
+            // Each phase passes DC at unity so a flat signal never reads above its level
+            double sum = 0.0;
+            for (int k = 0; k < m_tapsPerPhase; ++k) {
+                sum += prototype[size_t(p + k * m_oversample)];
+            }
+            for (int k = 0; k < m_tapsPerPhase; ++k) {
+                m_taps[size_t(p * m_tapsPerPhase + k)] = float(prototype[size_t(p + k * m_oversample)] / sum);
+            }
+        }
+        m_history.assign(size_t(channels) * size_t(m_tapsPerPhase - 1), 0.0f);
+        m_window.resize(m_hopFrames + size_t(m_tapsPerPhase - 1));
+        m_interpolated.resize(m_hopFrames);
+    }
+}
+
+void LoudnessMeter::addPlanar(const float *const *planes, size_t frames)
+{
+    // Chunks never straddle a 100 ms hop, so each hop's energy is just a running sum
+    size_t done = 0;
+    while (done < frames) {
+        const size_t count = std::min(frames - done, m_hopFrames - m_hopFill);
+        processChunk(planes, done, count);
+        done += count;
+    }
+}
+
+void LoudnessMeter::processChunk(const float *const *planes, size_t offset, size_t frames)
+{
+    const Biquad s = m_shelf;
+    const Biquad h = m_highPass;
+
+    for (int ch = 0; ch < m_channels; ++ch) {
+        const float *in = planes[ch] + offset;
+        m_truePeak = std::max(m_truePeak, oversampledPeak(ch, in, frames));
+
+        const double weight = m_weights[size_t(ch)];
+        if (weight == 0.0) {
+            continue;
+        }
+
+        // The recursion is serial in time, locals keep the state in registers
+        double *state = m_filterState.data() + size_t(ch) * 4;
+        double s1 = state[0], s2 = state[1], h1 = state[2], h2 = state[3];
+        double sum = 0.0;
+        for (size_t i = 0; i < frames; ++i) {
+            const double x = in[i];
+            const double y = s.b0 * x + s1;
+            s1 = s.b1 * x - s.a1 * y + s2;
+            s2 = s.b2 * x - s.a2 * y;
+            const double z = h.b0 * y + h1;
+            h1 = h.b1 * y - h.a1 * z + h2;
+            h2 = h.b2 * y - h.a2 * z;
+            sum += z * z;
+        }
+        state[0] = s1;
+        state[1] = s2;
+        state[2] = h1;
+        state[3] = h2;
+        m_hopEnergy += weight * sum;
+    }
+
+    m_hopFill += frames;
+    if (m_hopFill == m_hopFrames) {
+        m_hops.push_back(m_hopEnergy / double(m_hopFrames));
+        m_hopEnergy = 0.0;
+        m_hopFill = 0;
+    }
+}
+
+float LoudnessMeter::oversampledPeak(int channel, const float *samples, size_t frames)
+{
+    float peak = 0.0f;
+    for (size_t i = 0; i < frames; ++i) {
+        peak = std::max(peak, std::fabs(samples[i]));
+    }
+    m_samplePeak = std::max(m_samplePeak, peak);
+    if (m_oversample == 1) {
+        return peak;
+    }
+
+    // History in front of the chunk so every tap reads a plain offset into one array
+    const size_t history = size_t(m_tapsPerPhase - 1);
+    float *history0 = m_history.data() + size_t(channel) * history;
+    float *window = m_window.data();
+    std::copy(history0, history0 + history, window);
+    std::copy(samples, samples + frames, window + history);
+
+    // One pass per phase and tap: out[i] += c * x[i - k] has no cross-lane dependency,
+    // which is what lets the compiler vectorise it without reassociating a dot product
+    float *out = m_interpolated.data();
+    for (int p = 0; p < m_oversample; ++p) {
+        const float *taps = m_taps.data() + size_t(p) * size_t(m_tapsPerPhase);
+        std::fill(out, out + frames, 0.0f);
+        for (int k = 0; k < m_tapsPerPhase; ++k) {
+            const float c = taps[k];
+            const float *x = window + history - size_t(k);
+            for (size_t i = 0; i < frames; ++i) {
+                out[i] += c * x[i];
+            }
+        }
+        for (size_t i = 0; i < frames; ++i) {
+            peak = std::max(peak, std::fabs(out[i]));
+        }
+    }
+
+    std::copy(window + frames, window + frames + history, history0);
+    return peak;
+}
+
+std::vector<double> LoudnessMeter::gatingBlocks() const
+{
+    return slidingMeans(m_hops, GatingHops);
+}
+
+std::vector<double> LoudnessMeter::shortTermBlocks() const
+{
+    return slidingMeans(m_hops, ShortTermHops);
+}
+
+double LoudnessMeter::energyToLufs(double energy)
+{
+    if (energy <= 0.0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    return -0.691 + 10.0 * std::log10(energy);
+}
+
+double LoudnessMeter::gatedLoudness(const std::vector<double> &blocks)
+{
+    const double absoluteGate = lufsToEnergy(AbsoluteGateLufs);
+    double sum = 0.0;
+    size_t count = 0;
+    for (double energy : blocks) {
+        if (energy > absoluteGate) {
+            sum += energy;
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+
+    const double relativeGate = std::max(absoluteGate, sum / count * std::pow(10.0, RelativeGateLu / 10.0));
+    sum = 0.0;
+    count = 0;
+    for (double energy : blocks) {
+        if (energy > relativeGate) {
+            sum += energy;
+            ++count;
+        }
+    }
+    return count > 0 ? energyToLufs(sum / count) : -std::numeric_limits<double>::infinity();
+}
+
+double LoudnessMeter::loudnessRange(const std::vector<double> &shortTerm)
+{
+    const double absoluteGate = lufsToEnergy(AbsoluteGateLufs);
+    double sum = 0.0;
+    size_t count = 0;
+    for (double energy : shortTerm) {
+        if (energy > absoluteGate) {
+            sum += energy;
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return 0.0;
+    }
+
+    const double relativeGate = std::max(absoluteGate, sum / count * std::pow(10.0, RangeRelativeGateLu / 10.0));
+    std::vector<double> loudness;
+    loudness.reserve(count);
+    for (double energy : shortTerm) {
+        if (energy > relativeGate) {
+            loudness.push_back(energyToLufs(energy));
+        }
+    }
+    if (loudness.size() < 2) {
+        return 0.0;
+    }
+    std::sort(loudness.begin(), loudness.end());
+    const size_t last = loudness.size() - 1;
+    const double low = loudness[size_t(std::lround(last * 0.10))];
+    const double high = loudness[size_t(std::lround(last * 0.95))];
+    return high - low;
+}
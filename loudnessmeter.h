@@ -0,0 +1,67 @@
+#ifndef LOUDNESSMETER_H
+#define LOUDNESSMETER_H
+
+#include <cstddef>
+#include <vector>
+
+//ITU-R BS.1770-4 / EBU R128 measurement of planar float audio: integrated loudness with the
+//absolute and relative gates, loudness range (EBU Tech 3342) and true peak by oversampling.
+//only the K-weighted energy of every 100 ms is kept, the 400 ms gating blocks and 3 s short-term
+//windows are built from those, so pooling the blocks of several tracks measures an album
+class LoudnessMeter
+{
+public:
+    LoudnessMeter(int sampleRate, int channels);
+
+    //one pointer per channel, each holding frames samples
+    void addPlanar(const float *const *planes, size_t frames);
+
+    //channel-weighted mean square of each gating block (400 ms, 75% overlap) and each
+    //short-term window (3 s, 100 ms apart). a partial block at the end is left out
+    std::vector<double> gatingBlocks() const;
+    std::vector<double> shortTermBlocks() const;
+
+    double integratedLoudness() const { return gatedLoudness(gatingBlocks()); }
+    double loudnessRange() const { return loudnessRange(shortTermBlocks()); }
+    double truePeak() const { return m_truePeak; }      // linear, 1.0 = full scale
+    double samplePeak() const { return m_samplePeak; }
+
+    //LUFS of the given gating blocks, -inf when nothing passes the -70 LUFS gate
+    static double gatedLoudness(const std::vector<double> &blocks);
+    //LU between the 10th and 95th percentile of the gated short-term loudness
+    static double loudnessRange(const std::vector<double> &shortTerm);
+    static double energyToLufs(double energy);
+
+private:
+    // Direct form II transposed, a1/a2 with the sign the difference equation subtracts
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    void processChunk(const float *const *planes, size_t offset, size_t frames);
+    float oversampledPeak(int channel, const float *samples, size_t frames);
+
+    int m_sampleRate;
+    int m_channels;
+    size_t m_hopFrames;                 // 100 ms
+    Biquad m_shelf;                     // K-weighting stage 1, high shelf
+    Biquad m_highPass;                  // stage 2, RLB high-pass
+    std::vector<double> m_filterState;  // four per channel
+    std::vector<double> m_weights;      // BS.1770 channel weights, 0 for the LFE
+
+    double m_hopEnergy = 0.0;
+    size_t m_hopFill = 0;
+    std::vector<double> m_hops;         // mean square of each complete 100 ms hop
+
+    // True peak: polyphase interpolation, phase p tap k at m_taps[p * m_tapsPerPhase + k]
+    int m_oversample = 1;
+    int m_tapsPerPhase = 0;
+    std::vector<float> m_taps;
+    std::vector<float> m_history;       // last m_tapsPerPhase - 1 input samples per channel
+    std::vector<float> m_window;        // history followed by the chunk
+    std::vector<float> m_interpolated;
+    float m_truePeak = 0.0f;
+    float m_samplePeak = 0.0f;
+};
+
+#endif // LOUDNESSMETER_H
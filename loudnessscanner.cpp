@@ -0,0 +1,292 @@
+#include "loudnessscanner.h"
+#include "loudnessmeter.h"
+#include "audiodecoder.h"
+#include "audiomanager.h"
+#include "parallelflacdecoder.h"
+#include "dspkernels.h"
+#include "logging.h"
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QThread>
+#include <cmath>
+
+namespace {
+    const QStringList AudioFilePatterns = {"*.flac", "*.FLAC", "*.m4a", "*.M4A", "*.wav", "*.WAV"};
+}
+
+LoudnessScanner::LoudnessScanner(QObject *parent)
+    : QObject(parent)
+{
+}
+
+LoudnessScanner::~LoudnessScanner()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+QStringList LoudnessScanner::collectAudioFiles(const QStringList &paths)
+{
+    QStringList files;
+    for (const QString &path : paths) {
+        QFileInfo info(path);
+        if (info.isDir()) {
+            QDirIterator it(path, AudioFilePatterns, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                files.append(it.next());
+            }
+        } else if (info.isFile()) {
+            files.append(path);
+        }
+    }
+    return files;
+}
+
+LoudnessResult LoudnessScanner::scanFile(const QString &filePath, const std::atomic<bool> *cancelled,
+                                         int decodeThreads)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    LoudnessResult result;
+    result.filePath = filePath;
+    result.albumKey = QFileInfo(filePath).absolutePath();
+
+    // FLAC up to 24 bits decodes natively straight into int32 planes, a chunk per core at a
+    // time, everything else (and anything the native decoder turns down) through libavcodec and swr
+    ParallelFlacDecoder flac;
+    const bool native = filePath.endsWith(".flac", Qt::CaseInsensitive) && flac.open(filePath, decodeThreads);
+    AudioDecoder decoder;
+    PlanarFloatConverter converter;
+    if (!native) {
+        if (!decoder.open(filePath)) {
+            result.message = decoder.lastError();
+            result.elapsedMs = timer.elapsed();
+            return result;
+        }
+        if (!converter.init(decoder)) {
+            result.message = "Unsupported decoder sample format";
+            result.elapsedMs = timer.elapsed();
+            return result;
+        }
+    }
+
+    const int sampleRate = native ? flac.sampleRate() : decoder.sampleRate();
+    const int channels = native ? flac.channels() : decoder.channels();
+    LoudnessMeter meter(sampleRate, channels);
+    std::vector<float *> planes;
+    std::vector<std::vector<float>> floatPlanes;
+    if (native) {
+        floatPlanes.assign(size_t(channels), std::vector<float>(size_t(flac.maxBlockSize())));
+        for (int ch = 0; ch < channels; ++ch) {
+            planes.push_back(floatPlanes[size_t(ch)].data());
+        }
+    }
+    // Chunks go to the meter in block-sized pieces
+    int chunkFrames = 0;
+    int chunkOffset = 0;
+    // Right-justified samples, full scale is 2^(bits - 1)
+    const float nativeGain = native ? float(1u << (32 - flac.bitsPerSample())) : 1.0f;
+
+    qint64 frames = 0;
+    for (;;) {
+        if (cancelled && cancelled->load(std::memory_order_relaxed)) {
+            result.message = "Cancelled";
+            result.elapsedMs = timer.elapsed();
+            return result;
+        }
+        int converted;
+        if (native) {
+            if (chunkOffset == chunkFrames) {
+                chunkFrames = flac.next();
+                chunkOffset = 0;
+                if (chunkFrames < 0) {
+                    result.message = flac.lastError();
+                    result.elapsedMs = timer.elapsed();
+                    return result;
+                }
+                if (chunkFrames == 0) {
+                    break;
+                }
+            }
+            converted = qMin(flac.maxBlockSize(), chunkFrames - chunkOffset);
+            for (int ch = 0; ch < channels; ++ch) {
+                Dsp::int32ToFloat(flac.planes()[ch] + chunkOffset, planes[size_t(ch)], size_t(converted), nativeGain);
+            }
+            chunkOffset += converted;
+        } else {
+            AVFrame *frame = decoder.decodeNextFrame();
+            if (!frame) {
+                break;
+            }
+            converted = converter.convert(frame, planes);
+            if (converted < 0) {
+                result.message = "Sample conversion failed";
+                result.elapsedMs = timer.elapsed();
+                return result;
+            }
+        }
+        meter.addPlanar(planes.data(), size_t(converted));
+        frames += converted;
+    }
+    if (!native && decoder.hadReadError()) {
+        result.message = decoder.lastError();
+        result.elapsedMs = timer.elapsed();
+        return result;
+    }
+
+    result.audioMs = frames * 1000 / sampleRate;
+    result.integratedLufs = meter.integratedLoudness();
+    result.rangeLu = meter.loudnessRange();
+    result.truePeak = meter.truePeak();
+    result.gatingBlocks = meter.gatingBlocks();
+    result.shortTermBlocks = meter.shortTermBlocks();
+    result.elapsedMs = timer.elapsed();
+
+    // Silence (or under 400 ms of audio) has no loudness to normalise
+    if (!std::isfinite(result.integratedLufs)) {
+        result.message = "Too short or silent to measure";
+        return result;
+    }
+    result.gainDb = replayGain(result.integratedLufs);
+    result.ok = true;
+    return result;
+}
+
+AlbumLoudness LoudnessScanner::measureAlbum(const QList<LoudnessResult> &tracks)
+{
+    // The gates run over the album's blocks pooled, not over the track values
+    AlbumLoudness album;
+    std::vector<double> gating;
+    std::vector<double> shortTerm;
+    for (const LoudnessResult &track : tracks) {
+        if (!track.ok) {
+            continue;
+        }
+        album.albumKey = track.albumKey;
+        album.files.append(track.filePath);
+        album.truePeak = qMax(album.truePeak, track.truePeak);
+        gating.insert(gating.end(), track.gatingBlocks.begin(), track.gatingBlocks.end());
+        shortTerm.insert(shortTerm.end(), track.shortTermBlocks.begin(), track.shortTermBlocks.end());
+    }
+    album.integratedLufs = LoudnessMeter::gatedLoudness(gating);
+    album.rangeLu = LoudnessMeter::loudnessRange(shortTerm);
+    album.gainDb = std::isfinite(album.integratedLufs) ? replayGain(album.integratedLufs) : 0.0;
+    return album;
+}
+
+void LoudnessScanner::start(const QStringList &files, bool writeTags, int maxThreads)
+{
+    m_cancelled = false;
+    m_writeTags = writeTags;
+    m_total = files.size();
+    m_pending = m_total;
+    m_done = 0;
+    m_failures = 0;
+    m_audioMs = 0;
+    m_albumRemaining.clear();
+    m_albumTracks.clear();
+    m_timer.start();
+
+    m_pool.setMaxThreadCount(maxThreads > 0 ? maxThreads : QThread::idealThreadCount());
+
+    if (files.isEmpty()) {
+        emit finished(0, 0, 0);
+        return;
+    }
+
+    for (const QString &file : files) {
+        ++m_albumRemaining[QFileInfo(file).absolutePath()];
+    }
+    // Cores left over when there are fewer files than threads decode inside the files
+    const int decodeThreads = qMax(1, m_pool.maxThreadCount() / int(files.size()));
+    for (const QString &file : files) {
+        m_pool.start([this, file, decodeThreads]() {
+            LoudnessResult result = scanFile(file, &m_cancelled, decodeThreads);
+            QMetaObject::invokeMethod(this, [this, result]() { onResult(result); }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void LoudnessScanner::cancel()
+{
+    m_cancelled = true;
+}
+
+void LoudnessScanner::onResult(const LoudnessResult &result)
+{
+    ++m_done;
+    m_audioMs += result.audioMs;
+    PerfLog::record("loudness", "scan_file", result.elapsedMs * 1000, 0, result.filePath);
+    if (!result.ok) {
+        ++m_failures;
+    }
+    emit trackScanned(result);
+    emit progressUpdated(m_done, m_total);
+
+    // The last track of a directory completes its album
+    QList<LoudnessResult> &tracks = m_albumTracks[result.albumKey];
+    tracks.append(result);
+    if (--m_albumRemaining[result.albumKey] == 0) {
+        const QList<LoudnessResult> albumTracks = m_albumTracks.take(result.albumKey);
+        m_albumRemaining.remove(result.albumKey);
+        const AlbumLoudness album = measureAlbum(albumTracks);
+        if (!album.files.isEmpty()) {
+            emit albumScanned(album);
+            if (m_writeTags && !m_cancelled) {
+                writeAlbumTags(album, albumTracks);
+            }
+        }
+    }
+    taskDone();
+}
+
+void LoudnessScanner::writeAlbumTags(const AlbumLoudness &album, const QList<LoudnessResult> &tracks)
+{
+    for (const LoudnessResult &track : tracks) {
+        if (!track.ok) {
+            continue;
+        }
+        if (!track.filePath.toLower().endsWith(".flac")) {
+            emit tagsWritten(track.filePath, false, "Tags can only be written to FLAC files");
+            continue;
+        }
+
+        ReplayGainInfo gain;
+        gain.hasTrack = true;
+        gain.trackGain = track.gainDb;
+        gain.trackPeak = track.truePeak;
+        gain.hasAlbum = std::isfinite(album.integratedLufs);
+        gain.albumGain = album.gainDb;
+        gain.albumPeak = album.truePeak;
+
+        // Rewriting the file is I/O bound, it runs on the pool next to the remaining scans
+        const QString filePath = track.filePath;
+        ++m_pending;
+        m_pool.start([this, filePath, gain]() {
+            MetadataEditor editor;
+            const bool ok = editor.writeReplayGain(filePath, gain);
+            const QString message = ok ? QString() : editor.lastError();
+            QMetaObject::invokeMethod(this, [this, filePath, ok, message]() {
+                onTagsWritten(filePath, ok, message);
+            }, Qt::QueuedConnection);
+        });
+    }
+}
+
+void LoudnessScanner::onTagsWritten(const QString &filePath, bool ok, const QString &message)
+{
+    if (!ok) {
+        ++m_failures;
+        qCWarning(lcMetadata) << "ReplayGain write failed for" << filePath << message;
+    }
+    emit tagsWritten(filePath, ok, message);
+    taskDone();
+}
+
+void LoudnessScanner::taskDone()
+{
+    if (--m_pending == 0) {
+        emit finished(m_failures, m_audioMs, m_timer.elapsed());
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef LOUDNESSSCANNER_H
+#define LOUDNESSSCANNER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QList>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QMetaType>
+#include <atomic>
+#include <vector>
+
+//loudness of one track. the gating and short-term blocks are kept so albums can be measured
+//from their tracks without decoding anything twice
+struct LoudnessResult {
+    QString filePath;
+    QString albumKey;           // Tracks sharing it are measured together as an album
+    bool ok = false;
+    QString message;
+    double integratedLufs = 0.0;
+    double rangeLu = 0.0;
+    double truePeak = 0.0;      // Linear
+    double gainDb = 0.0;        // ReplayGain 2.0, towards -18 LUFS
+    qint64 audioMs = 0;
+    qint64 elapsedMs = 0;
+    std::vector<double> gatingBlocks;
+    std::vector<double> shortTermBlocks;
+};
+Q_DECLARE_METATYPE(LoudnessResult)
+
+struct AlbumLoudness {
+    QString albumKey;
+    QStringList files;
+    double integratedLufs = 0.0;
+    double rangeLu = 0.0;
+    double truePeak = 0.0;
+    double gainDb = 0.0;
+};
+Q_DECLARE_METATYPE(AlbumLoudness)
+
+//measures EBU R128 loudness on a thread pool, one decoder per thread, and optionally writes the
+//results back as REPLAYGAIN_* comments. an album is a directory: once its last track is measured
+//the album values are computed from the pooled blocks and every track of it gets tagged.
+//results are delivered on the thread that owns the scanner
+class LoudnessScanner : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr double ReferenceLufs = -18.0;
+
+    explicit LoudnessScanner(QObject *parent = nullptr);
+    ~LoudnessScanner();
+
+    //expands directories recursively to the audio files below them
+    static QStringList collectAudioFiles(const QStringList &paths);
+
+    //synchronous measurement of one file, safe to call from any thread. FLAC is decoded on up to
+    //decodeThreads cores
+    static LoudnessResult scanFile(const QString &filePath, const std::atomic<bool> *cancelled = nullptr,
+                                   int decodeThreads = 1);
+    static AlbumLoudness measureAlbum(const QList<LoudnessResult> &tracks);
+    static double replayGain(double lufs) { return ReferenceLufs - lufs; }
+
+    void start(const QStringList &files, bool writeTags, int maxThreads = 0);
+    void cancel();
+    bool isRunning() const { return m_pending > 0; }
+
+signals:
+    void trackScanned(const LoudnessResult &result);
+    void albumScanned(const AlbumLoudness &album);
+    void tagsWritten(const QString &filePath, bool ok, const QString &message);
+    void progressUpdated(int done, int total);
+    //audioMs / elapsedMs is the speed against realtime
+    void finished(int failures, qint64 audioMs, qint64 elapsedMs);
+
+private:
+    void onResult(const LoudnessResult &result);
+    void onTagsWritten(const QString &filePath, bool ok, const QString &message);
+    void writeAlbumTags(const AlbumLoudness &album, const QList<LoudnessResult> &tracks);
+    void taskDone();
+
+    QThreadPool m_pool;
+    std::atomic<bool> m_cancelled{false};
+    bool m_writeTags = false;
+    int m_pending = 0;          // Scans and tag writes still queued or running
+    int m_total = 0;
+    int m_done = 0;
+    int m_failures = 0;
+    qint64 m_audioMs = 0;
+    QMap<QString, int> m_albumRemaining;
+    QMap<QString, QList<LoudnessResult>> m_albumTracks;
+    QElapsedTimer m_timer;
+};
+
+#endif // LOUDNESSSCANNER_H
@@ -1,12 +1,34 @@
 #include "mainwindow.h"
+#include "clicommands.h"
 #include <QApplication>
+#include <QCoreApplication>
 #include <QLocale>
 #include <QTranslator>
+#include <QTextStream>
+
+// Headless integrity audit: flacplayer --verify [--jobs N] <files or folders>...
+// Kept for existing scripts, it is `flacplayer-cli verify` with the same JSON lines and exit codes
+static int runVerify(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    return Cli::run(QStringList{"verify"} + app.arguments().mid(2), out, err);
+}
 
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && QString::fromLocal8Bit(argv[1]) == "--verify") {
+        return runVerify(argc, argv);
+    }
+
     QApplication a(argc, argv);
-    
+    QCoreApplication::setOrganizationName("flacplayer");
+    QCoreApplication::setApplicationName("flacplayer");
+#ifdef FLACPLAYER_VERSION
+    QCoreApplication::setApplicationVersion(FLACPLAYER_VERSION);
+#endif
+
     // Setup translations
     QTranslator translator;
     const QStringList uiLanguages = QLocale::system().uiLanguages();
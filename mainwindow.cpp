@@ -1,7 +1,13 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "audiomanager.h"
+#include "metadataeditordialog.h"
 #include "conversiondialog.h"
+#include "verifydialog.h"
+#include "loudnessdialog.h"
+#include "equalizerdialog.h"
+#include "mappedinput.h"
+#include "logging.h"
 #include <QMessageBox>
 #include <QStatusBar>
 #include <QFileDialog> //for file manager window
@@ -17,11 +23,24 @@
 #include <QTimer>
 #include <QEventLoop>
 #include <QMediaMetaData>
+#include <QAudioDevice>
 #include <QPixmap>
 #include <QImage>
 #include <algorithm>
 #include <random>
+#include <cmath>
+#include <climits>
 #include <QRegularExpression> //for sanitizing metadata
+#include <QSettings>
+#include <QInputDialog>
+#include <QFormLayout>
+#include <QSpinBox>
+#include <QActionGroup>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QTreeWidget>
+#include <QFile>
+#include <QHeaderView>
 
 
 // * Initializes the UI, sets up button icons, configures media playback components,
@@ -44,6 +63,71 @@ MainWindow::MainWindow(QWidget *parent)
     MPlayer = new QMediaPlayer();
     audioOutput = new QAudioOutput();
     MPlayer->setAudioOutput(audioOutput);
+    
+    // Native engine, selected from Tools and remembered between runs
+    QSettings settings;
+    nativeEngine = new PlaybackEngine(this);
+    nativeEngine->setBufferDuration(settings.value("playback/bufferMs", 500).toInt());
+    nativeEngine->setCrossfade(settings.value("playback/crossfadeMs", 0).toInt(),
+        static_cast<Dsp::FadeCurve>(settings.value("playback/crossfadeCurve", int(Dsp::FadeCurve::EqualPower)).toInt()));
+    nativeEngine->setBitPerfect(settings.value("playback/bitPerfect", false).toBool());
+    ui->actionBitPerfect->setChecked(nativeEngine->bitPerfect());
+    useNativeEngine = settings.value("playback/nativeEngine", false).toBool();
+    ui->actionNativeEngine->setChecked(useNativeEngine);
+    
+    // ReplayGain applies to both engines through the output volume
+    QActionGroup *replayGainGroup = new QActionGroup(this);
+    replayGainGroup->addAction(ui->actionReplayGainOff);
+    replayGainGroup->addAction(ui->actionReplayGainTrack);
+    replayGainGroup->addAction(ui->actionReplayGainAlbum);
+    connect(ui->actionReplayGainOff, &QAction::triggered, this, [this]() { setReplayGainMode(ReplayGainMode::Off); });
+    connect(ui->actionReplayGainTrack, &QAction::triggered, this, [this]() { setReplayGainMode(ReplayGainMode::Track); });
+    connect(ui->actionReplayGainAlbum, &QAction::triggered, this, [this]() { setReplayGainMode(ReplayGainMode::Album); });
+    replayGainMode = static_cast<ReplayGainMode>(qBound(0, settings.value("playback/replayGain", 0).toInt(), 2));
+    ui->actionReplayGainOff->setChecked(replayGainMode == ReplayGainMode::Off);
+    ui->actionReplayGainTrack->setChecked(replayGainMode == ReplayGainMode::Track);
+    ui->actionReplayGainAlbum->setChecked(replayGainMode == ReplayGainMode::Album);
+    
+    // Equalizer and output rate belong to the output device, follow the default one around
+    nativeEngine->setResamplerProfile(static_cast<ResamplerProfile>(
+        qBound(0, settings.value("resampler/profile", int(ResamplerProfile::Balanced)).toInt(), int(ResamplerProfile::Soxr))));
+    mediaDevices = new QMediaDevices(this);
+    connect(mediaDevices, &QMediaDevices::audioOutputsChanged, this, &MainWindow::loadOutputDeviceSettings);
+    loadOutputDeviceSettings();
+    
+    // How decoders, the converter and the scanners read their input (mmap or large reads)
+    MappedInput::setDefaultStorage(static_cast<InputStorage>(
+        qBound(0, settings.value("io/storage", int(InputStorage::Auto)).toInt(), int(InputStorage::Network))));
+    
+    // Read-ahead of upcoming tracks, a few seconds after a track change so it doesn't compete with the open
+    prefetcher = new TrackPrefetcher(this);
+    prefetcher->setBudget(settings.value("prefetch/budgetMB", 512).toLongLong() * 1024 * 1024);
+    prefetchDepth = qBound(0, settings.value("prefetch/tracks", 3).toInt(), 50);
+    prefetchTimer = new QTimer(this);
+    prefetchTimer->setSingleShot(true);
+    prefetchTimer->setInterval(3000);
+    connect(prefetchTimer, &QTimer::timeout, this, &MainWindow::prefetchUpcoming);
+    
+    // Waveform behind the seek bar, from the cache or decoded in the background
+    waveformBuilder = new WaveformBuilder(this);
+    connect(waveformBuilder, &WaveformBuilder::overviewReady, this, &MainWindow::onWaveformReady);
+    
+    // Spectrum of what the native engine plays, between the album art and the volume slider
+    spectrumAnalyzer = new SpectrumAnalyzer(nativeEngine->audioTap(), this);
+    spectrumWidget = new SpectrumWidget(spectrumAnalyzer, ui->centralwidget);
+    spectrumWidget->setGeometry(625, 90, 210, 200);
+    const bool showSpectrum = settings.value("view/spectrum", false).toBool();
+    ui->actionSpectrum->setChecked(showSpectrum);
+    spectrumWidget->setVisible(showSpectrum);
+    spectrumAnalyzer->setActive(showSpectrum);
+    
+    // Periodic UI work shares one frame clock: the time label and seek bar, the hover gradient
+    // and the spectrum bars each run at most once per frame, and not at all while minimized
+    frameScheduler = new FrameScheduler(this, this);
+    positionClient = frameScheduler->addClient("position", [this]() { updatePositionDisplay(); });
+    gradientClient = frameScheduler->addClient("gradient", [this]() { updateGradient(); });
+    spectrumClient = frameScheduler->addClient("spectrum", [this]() { spectrumWidget->tick(); });
+    frameScheduler->setContinuous(spectrumClient, showSpectrum);
 
 
     // Set button icons from resources 
@@ -88,10 +172,31 @@ MainWindow::MainWindow(QWidget *parent)
     connect(MPlayer, &QMediaPlayer::mediaStatusChanged, this, &MainWindow::onMediaStatusChanged); 
     connect(MPlayer, &QMediaPlayer::metaDataChanged, this, &MainWindow::displayMetadata);
     connect(MPlayer, &QMediaPlayer::errorOccurred, this, &MainWindow::onMediaPlayerError);
+    
+    // The native engine drives the same handlers, it has no metadata signal (see onMediaStatusChanged)
+    connect(nativeEngine, &PlaybackEngine::positionChanged, this, &MainWindow::onPositionChanged);
+    connect(nativeEngine, &PlaybackEngine::durationChanged, this, &MainWindow::onDurationChanged);
+    connect(nativeEngine, &PlaybackEngine::mediaStatusChanged, this, &MainWindow::onMediaStatusChanged);
+    connect(nativeEngine, &PlaybackEngine::errorOccurred, this, &MainWindow::onMediaPlayerError);
+    connect(nativeEngine, &PlaybackEngine::latencyMeasured, this, &MainWindow::onEngineLatency);
+    connect(nativeEngine, &PlaybackEngine::latencyStages, this, &MainWindow::onEngineLatencyStages);
+    connect(nativeEngine, &PlaybackEngine::nextSourceStarted, this, &MainWindow::onGaplessTrackStarted);
+    connect(nativeEngine, &PlaybackEngine::bitPerfectStatus, this, &MainWindow::onBitPerfectStatus);
 
     // Install event filter on next/previous buttons to detect hold vs click
     ui->nextTrack->installEventFilter(this);
     ui->previousTrack->installEventFilter(this);
+    
+    // Seek bar in milliseconds, drags and scrubbing reach the backend through the coalescer
+    ui->seekSlider->setRange(0, 0);
+    ui->seekSlider->setSingleStep(5000);
+    ui->seekSlider->setPageStep(30000);
+    seekCoalescer = new SeekCoalescer(this);
+    connect(seekCoalescer, &SeekCoalescer::seekRequested, this, &MainWindow::onCoalescedSeek);
+    connect(ui->seekSlider, &QSlider::sliderReleased, seekCoalescer, &SeekCoalescer::flush);
+    scrubTimer = new QTimer(this);
+    scrubTimer->setInterval(Scrub::TickMs);
+    connect(scrubTimer, &QTimer::timeout, this, &MainWindow::scrubTick);
 
     // Connect button signals to slots for mute toggle
     connect(ui->muteButton, &QPushButton::clicked, this, &MainWindow::onMuteToggle);
@@ -116,16 +221,14 @@ MainWindow::MainWindow(QWidget *parent)
             widget->installEventFilter(this);
         }
     }
-    
-    // Initialize frame timer for performance tracking
-    //only applicable for mouse gradient effect
-    frameTimer.start();
-    lastUpdateTime = 0;
+
     statusBar()->showMessage("Ready - Click buttons to test UI", 3000);
 }
 
 MainWindow::~MainWindow()
 {
+    // The engine owning the tap goes first among the children, the analyzer must not outlive it
+    spectrumAnalyzer->setActive(false);
     delete ui;
 }
 
@@ -146,7 +249,7 @@ void MainWindow::on_actionOpen_triggered()
 
     // Add files to playlist
     for (const QString &fileName : fileNames) {
-        playlist.append(fileName);
+        appendToQueue(fileName);
         // qDebug() << "[MainWindow] Added to playlist:" << fileName;
     }
     
@@ -160,6 +263,30 @@ void MainWindow::on_actionOpen_triggered()
     statusBar()->showMessage(QString("Added %1 file(s) to queue").arg(fileNames.size()), 2000);
 }
 
+//queues a file, album images with an embedded CUESHEET become one virtual entry per track
+void MainWindow::appendToQueue(const QString &fileName)
+{
+    if (fileName.toLower().endsWith(".flac")) {
+        MetadataEditor editor;
+        int sampleRate = 0;
+        const QList<CueTrack> cueTracks = editor.readCueTracks(fileName, &sampleRate);
+        if (!cueTracks.isEmpty() && sampleRate > 0) {
+            for (int i = 0; i < cueTracks.size(); ++i) {
+                PlaylistEntry entry(fileName);
+                entry.startSample = cueTracks[i].startSample;
+                // Last track runs to the end of the file so EndOfMedia still fires for it
+                entry.endSample = (i == cueTracks.size() - 1) ? 0 : cueTracks[i].endSample;
+                entry.sampleRate = sampleRate;
+                entry.cueTrack = cueTracks[i].number;
+                playlist.append(entry);
+            }
+            return;
+        }
+    }
+    
+    playlist.append(fileName);
+}
+
 
 //shows track queue, if user double clicks a track it will load and play that track
 void MainWindow::on_trackQueue_clicked()
@@ -178,11 +305,20 @@ void MainWindow::on_trackQueue_clicked()
     
     // Add list widget showing all tracks
     QListWidget *trackList = new QListWidget(queueDialog);
+    MetadataEditor tagReader;
     for (int i = 0; i < playlist.size(); ++i) {
-        QFileInfo fileInfo(playlist[i]);
-        QListWidgetItem *item = new QListWidgetItem(
-            QString("%1. %2").arg(i + 1).arg(fileInfo.fileName())
-        );
+        const PlaylistEntry &entry = playlist[i];
+        QString label = entry.displayName();
+        
+        // Tags only, no pictures, so a long queue stays quick to open
+        if (!entry.isVirtual() && MetadataEditor::canReadTags(entry.filePath)) {
+            FlacMetadata tags = tagReader.readMetadata(entry.filePath, MetadataEditor::FieldTags);
+            if (!tags.title.isEmpty()) {
+                label = tags.artist.isEmpty() ? tags.title : QString("%1 - %2").arg(tags.artist, tags.title);
+            }
+        }
+        
+        QListWidgetItem *item = new QListWidgetItem(QString("%1. %2").arg(i + 1).arg(label));
         
         // Highlight current track
         if (i == currentTrackIndex) {
@@ -198,7 +334,7 @@ void MainWindow::on_trackQueue_clicked()
             [this, trackList, queueDialog](QListWidgetItem *item) {
         int index = trackList->row(item);
         loadTrack(index);
-        MPlayer->play();
+        playerPlay();
         isPlaying = true;
         ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
         queueDialog->accept();
@@ -236,9 +372,9 @@ void MainWindow::on_actionEditMetadata_triggered()
         return;
     }
     
-    QString currentFile = playlist[currentTrackIndex];
-    qDebug() << "[MainWindow] Current file:" << currentFile;
-    qDebug() << "[MainWindow] File exists:" << QFile::exists(currentFile);
+    QString currentFile = playlist[currentTrackIndex].filePath;
+    qCDebug(lcPlayback) << "Current file:" << currentFile;
+    qCDebug(lcPlayback) << "File exists:" << QFile::exists(currentFile);
     
     // Check if it's a FLAC file to edit metadata 
     if (!currentFile.toLower().endsWith(".flac")) {
@@ -249,34 +385,40 @@ void MainWindow::on_actionEditMetadata_triggered()
     }
     
     // Open metadata editor dialog
-    qDebug() << "[MainWindow] Creating MetadataEditorDialog...";
+    qCDebug(lcPlayback) << "Creating MetadataEditorDialog...";
     MetadataEditorDialog dialog(currentFile, this);
-    qDebug() << "[MainWindow] Dialog created, executing...";
+    qCDebug(lcPlayback) << "Dialog created, executing...";
     if (dialog.exec() == QDialog::Accepted) {
-        qDebug() << "[MainWindow] Dialog accepted, refreshing metadata...";
+        qCDebug(lcPlayback) << "Dialog accepted, refreshing metadata...";
         // Reload metadata display after editing
         statusBar()->showMessage("Metadata updated - reloading track info...", 2000);
         
         // Force metadata refresh by fully reloading the track 
         //necessary due to QMediaPlayer caching issues
-        qint64 currentPosition = MPlayer->position();
+        qint64 currentPosition = playerPosition();
         bool wasPlaying = isPlaying;
         
         // Stop playback and clear the current source to force cache invalidation
-        MPlayer->stop();
-        MPlayer->setSource(QUrl());
+        playerStop();
+        playerSetSource(QUrl());
+        loadedFilePath.clear();
         
         // Small delay to ensure the player releases the file
         QEventLoop loop;
         QTimer::singleShot(100, &loop, &QEventLoop::quit);
         loop.exec();
         
-        // Reload the track with fresh metadata
+        // Reload the track with fresh metadata, position is restored once the media is loaded.
+        // The native engine loads synchronously, so it takes the position directly
         loadTrack(currentTrackIndex);
-        MPlayer->setPosition(currentPosition);
+        if (useNativeEngine) {
+            playerSetPosition(currentPosition);
+        } else {
+            pendingStartPosition = currentPosition;
+        }
         
         if (wasPlaying) {
-            MPlayer->play();
+            playerPlay();
         }
     }
 }
@@ -295,7 +437,7 @@ void MainWindow::on_actionConvertToMP3_triggered()
         return;
     }
     
-    QString currentFile = playlist[currentTrackIndex];
+    QString currentFile = playlist[currentTrackIndex].filePath;
     
     // Check if it's a FLAC file
     if (!currentFile.toLower().endsWith(".flac")) {
@@ -305,54 +447,143 @@ void MainWindow::on_actionConvertToMP3_triggered()
         return;
     }
     
-    // Open conversion dialog
+    // Open conversion dialog, read-ahead waits while it keeps the disk busy
     ConversionDialog dialog(currentFile, this);
+    prefetcher->setThrottled(true);
     dialog.exec();
+    prefetcher->setThrottled(false);
+}
+
+/**
+ * Verify audio integrity
+ *
+ * Checks files against the MD5 signature in their STREAMINFO. The FLAC files
+ * in the queue are preselected, more files or whole folders can be added.
+ */
+void MainWindow::on_actionVerifyAudio_triggered()
+{
+    QStringList queuedFiles;
+    for (int i = 0; i < playlist.size(); ++i) {
+        const QString &filePath = playlist[i].filePath;
+        if (filePath.toLower().endsWith(".flac") && !queuedFiles.contains(filePath)) {
+            queuedFiles.append(filePath);
+        }
+    }
+    
+    VerifyDialog dialog(queuedFiles, this);
+    prefetcher->setThrottled(true);
+    dialog.exec();
+    prefetcher->setThrottled(false);
+}
+
+//EBU R128 scan of the queue (or any folder), writes ReplayGain tags for playback to use
+void MainWindow::on_actionLoudnessScan_triggered()
+{
+    QStringList queuedFiles;
+    for (int i = 0; i < playlist.size(); ++i) {
+        const QString &filePath = playlist[i].filePath;
+        if (MetadataEditor::canReadTags(filePath) && !queuedFiles.contains(filePath)) {
+            queuedFiles.append(filePath);
+        }
+    }
+    
+    LoudnessDialog dialog(queuedFiles, this);
+    prefetcher->setThrottled(true);
+    dialog.exec();
+    prefetcher->setThrottled(false);
+    
+    // New tags for the playing track take effect right away
+    if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()
+        && dialog.taggedFiles().contains(playlist[currentTrackIndex].filePath)) {
+        MetadataEditor editor;
+        applyReplayGain(editor.readMetadata(playlist[currentTrackIndex].filePath, MetadataEditor::FieldTags).replayGain);
+    }
 }
 
 //song loading and metadata display
 void MainWindow::loadTrack(int index)
 {
     if (index >= 0 && index < playlist.size()) {
+        // A seek still waiting for its interval belongs to the track being left
+        seekCoalescer->cancel();
+        stopScrub();
         currentTrackIndex = index;
-        QString fileName = playlist[index];
-        MPlayer->setSource(QUrl::fromLocalFile(fileName));
+        const PlaylistEntry &entry = playlist[index];
+        QString fileName = entry.filePath;
         
-        QFileInfo fileinfo(fileName);
-        ui->labelFileName->setText(fileinfo.fileName());
-        ui->seekSlider->setEnabled(true);
-        ui->seekSlider->setValue(0);
-        
-        // Immediately load and display metadata from FLAC file if available
-        if (fileName.toLower().endsWith(".flac")) {
-            MetadataEditor editor;
-            FlacMetadata flacMeta = editor.readMetadata(fileName);
-            
-            // Update UI with FLAC metadata immediately
-            ui->trackName->setText(flacMeta.title.isEmpty() ? fileinfo.completeBaseName() : flacMeta.title);
-            ui->albumArtist->setText(flacMeta.albumArtist.isEmpty() ? 
-                (flacMeta.artist.isEmpty() ? "Unknown Artist" : flacMeta.artist) : flacMeta.albumArtist);
-            ui->albumName->setText(flacMeta.album.isEmpty() ? "Unknown Album" : flacMeta.album);
-            ui->albumYear->setText(flacMeta.year.isEmpty() ? "----" : flacMeta.year);
-            
-            // Display album art if available
-            if (!flacMeta.albumArt.isNull()) {
-                QPixmap coverPixmap = QPixmap::fromImage(flacMeta.albumArt);
-                QSize labelSize = ui->albumArtLabel->size();
-                QPixmap scaledPixmap = coverPixmap.scaled(labelSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-                ui->albumArtLabel->setPixmap(scaledPixmap);
-                ui->albumArtLabel->setAlignment(Qt::AlignCenter);
+        // Moving between virtual tracks of the album image that is already open is just a seek.
+        // When playback has already arrived at the track start (consecutive cue tracks) nothing
+        // is touched at all, so the album keeps playing without a gap
+        if (entry.isVirtual() && fileName == loadedFilePath) {
+            if (qAbs(playerPosition() - entry.startMs()) > 500) {
+                pendingStartPosition = entry.startMs();  // Cleared once the backend reports the new range
+                playerSetPosition(entry.startMs());
             } else {
-                ui->albumArtLabel->clear();
-                ui->albumArtLabel->setText("No Album Art");
-                ui->albumArtLabel->setAlignment(Qt::AlignCenter);
+                pendingStartPosition = -1;
             }
+            updateTrackDuration();
+        } else {
+            loadedFilePath = fileName;
+            ui->seekSlider->clearOverview();
+            waveformBuilder->request(fileName);
+            pendingStartPosition = entry.startMs() > 0 ? entry.startMs() : -1;
+            sourceLoadTimer.start();
+            playerSetSource(QUrl::fromLocalFile(fileName));
+            latencyTracker.addSpan(LatencyTracker::BackendSetup, sourceLoadTimer.nsecsElapsed() / 1000);
+            latencyTracker.mark(LatencyTracker::SourceSet);
         }
         
+        QElapsedTimer metadataTimer;
+        metadataTimer.start();
+        showTrackInfo(entry);
+        latencyTracker.addSpan(LatencyTracker::Metadata, metadataTimer.nsecsElapsed() / 1000);
         updateNextTrackDisplay();
     }
 }
 
+//file name, tags and cover of an entry, read straight from the file where possible
+void MainWindow::showTrackInfo(const PlaylistEntry &entry)
+{
+    const QString &fileName = entry.filePath;
+    QFileInfo fileinfo(fileName);
+    ui->labelFileName->setText(entry.isVirtual() ? entry.displayName() : fileinfo.fileName());
+    ui->seekSlider->setEnabled(true);
+    ui->seekSlider->setValue(0);
+    
+    // Immediately load and display metadata when the file can be parsed without the media backend
+    if (MetadataEditor::canReadTags(fileName)) {
+        MetadataEditor editor;
+        FlacMetadata flacMeta = editor.readMetadata(fileName);
+        
+        // Update UI with FLAC metadata immediately
+        if (entry.isVirtual()) {
+            ui->trackName->setText(entry.displayName());
+        } else {
+            ui->trackName->setText(flacMeta.title.isEmpty() ? fileinfo.completeBaseName() : flacMeta.title);
+        }
+        ui->albumArtist->setText(flacMeta.albumArtist.isEmpty() ? 
+            (flacMeta.artist.isEmpty() ? "Unknown Artist" : flacMeta.artist) : flacMeta.albumArtist);
+        ui->albumName->setText(flacMeta.album.isEmpty() ? "Unknown Album" : flacMeta.album);
+        ui->albumYear->setText(flacMeta.year.isEmpty() ? "----" : flacMeta.year);
+        
+        // Display album art if available
+        if (!flacMeta.albumArt.isNull()) {
+            QPixmap coverPixmap = QPixmap::fromImage(flacMeta.albumArt);
+            QSize labelSize = ui->albumArtLabel->size();
+            QPixmap scaledPixmap = coverPixmap.scaled(labelSize, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+            ui->albumArtLabel->setPixmap(scaledPixmap);
+            ui->albumArtLabel->setAlignment(Qt::AlignCenter);
+        } else {
+            ui->albumArtLabel->clear();
+            ui->albumArtLabel->setText("No Album Art");
+            ui->albumArtLabel->setAlignment(Qt::AlignCenter);
+        }
+        applyReplayGain(flacMeta.replayGain);
+    } else {
+        applyReplayGain(ReplayGainInfo());
+    }
+}
+
 //next song  display update, if there are no song left in the queue it will show no next track
 void MainWindow::updateNextTrackDisplay()
 {
@@ -360,26 +591,78 @@ void MainWindow::updateNextTrackDisplay()
     
     // Check if there's a next track in the current queue
     if (nextIndex < playlist.size()) {
-        QFileInfo nextFile(playlist[nextIndex]);
-        ui->nextinQueue->setText(QString("Next: %1").arg(nextFile.fileName()));
+        ui->nextinQueue->setText(QString("Next: %1").arg(playlist[nextIndex].displayName()));
     } else {
         // At the end of playlist - check repeat mode
         if (repeatMode == RepeatMode::One) {
             // Repeating current track
             if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
-                QFileInfo currentFile(playlist[currentTrackIndex]);
-                ui->nextinQueue->setText(QString("Repeating: %1").arg(currentFile.fileName()));
+                ui->nextinQueue->setText(QString("Repeating: %1").arg(playlist[currentTrackIndex].displayName()));
             } else {
                 ui->nextinQueue->setText("No next track");
             }
         } else if (repeatMode == RepeatMode::All && !playlist.isEmpty()) {
             // Will repeat from start
-            QFileInfo nextFile(playlist[0]);
-            ui->nextinQueue->setText(QString("Next: %1 (from start)").arg(nextFile.fileName()));
+            ui->nextinQueue->setText(QString("Next: %1 (from start)").arg(playlist[0].displayName()));
         } else {
             ui->nextinQueue->setText("No next track");
         }
     }
+    
+    // The native engine pre-opens whatever the label announces
+    queueNextForGapless();
+    prefetchTimer->start();
+}
+
+//entry played after the current one under the current repeat mode, -1 when playback stops
+int MainWindow::nextTrackIndex() const
+{
+    if (currentTrackIndex < 0 || currentTrackIndex >= playlist.size()) {
+        return -1;
+    }
+    if (repeatMode == RepeatMode::One) {
+        return currentTrackIndex;
+    }
+    if (currentTrackIndex + 1 < playlist.size()) {
+        return currentTrackIndex + 1;
+    }
+    return repeatMode == RepeatMode::All ? 0 : -1;
+}
+
+//hands the next entry to the native engine so it is decoded ahead and spliced on without a gap.
+//cue tracks inside the same image already play on continuously, and a current track that ends
+//inside its file is handed over by position, so neither is queued
+void MainWindow::queueNextForGapless()
+{
+    if (!useNativeEngine) {
+        return;
+    }
+
+    int next = nextTrackIndex();
+    bool queue = next >= 0 && playlist[currentTrackIndex].endMs() == 0;
+    if (queue) {
+        const PlaylistEntry &current = playlist[currentTrackIndex];
+        const PlaylistEntry &entry = playlist[next];
+        if (entry.filePath == current.filePath && (entry.isVirtual() || current.isVirtual())) {
+            queue = false;
+        }
+    }
+
+    if (!queue) {
+        gaplessIndex = -1;
+        nativeEngine->clearNextSource();
+        return;
+    }
+
+    // Already pre-opened, don't open the file again
+    if (next == gaplessIndex && playlist[next] == gaplessEntry && nativeEngine->hasNextSource()) {
+        return;
+    }
+
+    gaplessIndex = next;
+    gaplessEntry = playlist[next];
+    nativeEngine->setNextSource(QUrl::fromLocalFile(gaplessEntry.filePath), gaplessEntry.startMs(), gaplessEntry.endMs());
+    qCDebug(lcPlayback) << "Queued for gapless playback:" << gaplessEntry.displayName();
 }
 
 
@@ -389,16 +672,21 @@ void MainWindow::displayMetadata()
 {
     // For FLAC files, read metadata directly to ensure accuracy
     if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
-        QString currentFile = playlist[currentTrackIndex];
+        const PlaylistEntry &entry = playlist[currentTrackIndex];
+        QString currentFile = entry.filePath;
         
-        if (currentFile.toLower().endsWith(".flac")) {
-            // Use MetadataEditor for FLAC files to get accurate metadata
+        if (MetadataEditor::canReadTags(currentFile)) {
+            // Use MetadataEditor for FLAC/M4A/WAV files to get accurate metadata, served from its cache
             MetadataEditor editor;
             FlacMetadata flacMeta = editor.readMetadata(currentFile);
             QFileInfo fileInfo(currentFile);
             
             // Update all metadata fields from FLAC
-            ui->trackName->setText(flacMeta.title.isEmpty() ? fileInfo.completeBaseName() : flacMeta.title);
+            if (entry.isVirtual()) {
+                ui->trackName->setText(entry.displayName());
+            } else {
+                ui->trackName->setText(flacMeta.title.isEmpty() ? fileInfo.completeBaseName() : flacMeta.title);
+            }
             ui->albumArtist->setText(flacMeta.albumArtist.isEmpty() ? 
                 (flacMeta.artist.isEmpty() ? "Unknown Artist" : flacMeta.artist) : flacMeta.albumArtist);
             ui->albumName->setText(flacMeta.album.isEmpty() ? "Unknown Album" : flacMeta.album);
@@ -428,7 +716,7 @@ void MainWindow::displayMetadata()
     if (metadata.value(QMediaMetaData::Title).isValid()) {
         trackTitle = metadata.stringValue(QMediaMetaData::Title);
     } else if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
-        QFileInfo fileInfo(playlist[currentTrackIndex]);
+        QFileInfo fileInfo(playlist[currentTrackIndex].filePath);
         trackTitle = fileInfo.completeBaseName();
     }
     ui->trackName->setText(trackTitle);
@@ -511,12 +799,13 @@ void MainWindow::displayMetadata()
 void MainWindow::on_playPause_clicked()
 {
     if (isPlaying) {
-        MPlayer->pause();
+        playerPause();
         ui->playPause->setIcon(QIcon(":/icons/assets/play.png"));
         statusBar()->showMessage("Playback paused", 2000);
         isPlaying = false;
     } else {
-        MPlayer->play();
+        latencyTracker.begin(LatencyTracker::Play);
+        playerPlay();
         ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
         statusBar()->showMessage("Playback started", 2000);
         isPlaying = true;
@@ -535,9 +824,12 @@ void MainWindow::on_nextTrack_clicked()
     // Quick click - go to next track
     if (currentTrackIndex + 1 < playlist.size()) {
         bool wasPlaying = isPlaying;  // Save current playing state
+        if (wasPlaying) {
+            latencyTracker.begin(LatencyTracker::Next);  // Nothing to hear when paused
+        }
         loadTrack(currentTrackIndex + 1);
         if (wasPlaying) {
-            MPlayer->play();
+            playerPlay();
             isPlaying = true;
             ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
         }
@@ -559,16 +851,19 @@ void MainWindow::on_previousTrack_clicked()
     // Quick click - go to previous track
     if (currentTrackIndex > 0) {
         bool wasPlaying = isPlaying;  // Save current playing state
+        if (wasPlaying) {
+            latencyTracker.begin(LatencyTracker::Previous);  // Nothing to hear when paused
+        }
         loadTrack(currentTrackIndex - 1);
         if (wasPlaying) {
-            MPlayer->play();
+            playerPlay();
             isPlaying = true;
             ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
         }
         statusBar()->showMessage("Previous track", 2000);
     } else {
         // Already at first track, restart current track
-        MPlayer->setPosition(0);
+        playerSetPosition(currentTrackStartMs());
         statusBar()->showMessage("Restarting track", 2000);
     }
 }
@@ -592,7 +887,7 @@ void MainWindow::on_Shuffle_clicked()
         originalPlaylist = playlist;
         
         // Save the currently playing track
-        QString currentTrack;
+        PlaylistEntry currentTrack;
         if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
             currentTrack = playlist[currentTrackIndex];
         }
@@ -603,7 +898,7 @@ void MainWindow::on_Shuffle_clicked()
         std::shuffle(playlist.begin(), playlist.end(), rng);
         
         // Find and update the current track index after shuffle
-        if (!currentTrack.isEmpty()) {
+        if (!currentTrack.filePath.isEmpty()) {
             currentTrackIndex = playlist.indexOf(currentTrack);
         }
         
@@ -616,7 +911,7 @@ void MainWindow::on_Shuffle_clicked()
         // Restore the original playlist order
         if (!originalPlaylist.isEmpty()) {
             // Save the currently playing track
-            QString currentTrack;
+            PlaylistEntry currentTrack;
             if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
                 currentTrack = playlist[currentTrackIndex];
             }
@@ -626,7 +921,7 @@ void MainWindow::on_Shuffle_clicked()
             originalPlaylist.clear();
             
             // Find and update the current track index in restored playlist
-            if (!currentTrack.isEmpty()) {
+            if (!currentTrack.filePath.isEmpty()) {
                 currentTrackIndex = playlist.indexOf(currentTrack);
             }
             
@@ -637,22 +932,53 @@ void MainWindow::on_Shuffle_clicked()
     }
 }
 
-//seek forward 
-void MainWindow::seekForward()
+//hold-to-scrub: the position runs ahead (or back) of where the hold started at an accelerating
+//rate, every tick's target goes through the coalescer so playback follows without thrashing
+void MainWindow::startScrub(int direction)
 {
-    qint64 currentPos = MPlayer->position();
-    qint64 newPos = qMin(mediaDuration, currentPos + 10000);
-    MPlayer->setPosition(newPos);
-    statusBar()->showMessage("Seeking forward", 1000);
+    if (mediaDuration <= 0) {
+        return;
+    }
+    scrubDirection = direction;
+    scrubOriginMs = playerPosition();
+    scrubClock.start();
+    scrubTimer->start();
+    scrubTick();
 }
 
-//same for backwards
-void MainWindow::seekBackward()
+void MainWindow::scrubTick()
 {
-    qint64 currentPos = MPlayer->position();
-    qint64 newPos = qMax(qint64(0), currentPos - 10000);
-    MPlayer->setPosition(newPos);
-    statusBar()->showMessage("Seeking backward", 1000);
+    const qint64 start = currentTrackStartMs();
+    const qint64 target = qBound(start, scrubOriginMs + scrubDirection * Scrub::travel(scrubClock.elapsed()),
+                                 start + mediaDuration);
+    if (target != seekCoalescer->targetMs()) {
+        seekCoalescer->request(target);
+    }
+    
+    isSeeking = true;
+    ui->seekSlider->setValue(int(target - start));
+    isSeeking = false;
+    statusBar()->showMessage(QString("%1 %2x").arg(scrubDirection > 0 ? "Scrubbing forward" : "Scrubbing backward")
+        .arg(qRound(Scrub::rate(scrubClock.elapsed()))), 1000);
+}
+
+void MainWindow::stopScrub()
+{
+    if (scrubDirection == 0) {
+        return;
+    }
+    scrubTimer->stop();
+    scrubDirection = 0;
+    seekCoalescer->flush();
+}
+
+//the one place seeks from the slider and scrubbing reach the backend
+void MainWindow::onCoalescedSeek(qint64 position)
+{
+    if (playerIsPlaying()) {
+        latencyTracker.begin(LatencyTracker::Seek);
+    }
+    playerSetPosition(position);
 }
 
 //audio output controls
@@ -674,15 +1000,63 @@ void MainWindow::onMuteToggle()
 //volume control slider handler
 void MainWindow::on_volumeSlider_valueChanged(int value)
 {
-    audioOutput->setVolume(value / 100.0);
+    Q_UNUSED(value);
+    applyVolume();
 }
 
-//skimming through track using seek slider
+//slider level times the ReplayGain factor. outputs can't go above unity, so positive gains
+//only lift quiet tracks while the slider is below 100%
+void MainWindow::applyVolume()
+{
+    const double volume = qBound(0.0, ui->volumeSlider->value() / 100.0 * replayGainScale, 1.0);
+    audioOutput->setVolume(volume);
+    nativeEngine->setVolume(volume);
+}
+
+void MainWindow::applyReplayGain(const ReplayGainInfo &gain)
+{
+    currentGain = gain;
+    replayGainScale = 1.0;
+    
+    // Album mode falls back to the track values and the other way round
+    const bool useAlbum = (replayGainMode == ReplayGainMode::Album && gain.hasAlbum) || !gain.hasTrack;
+    if (replayGainMode != ReplayGainMode::Off && !gain.isEmpty()) {
+        const double gainDb = useAlbum ? gain.albumGain : gain.trackGain;
+        const double peak = useAlbum ? gain.albumPeak : gain.trackPeak;
+        replayGainScale = std::pow(10.0, gainDb / 20.0);
+        // Never push the true peak past full scale
+        if (peak > 0.0) {
+            replayGainScale = qMin(replayGainScale, 1.0 / peak);
+        }
+    }
+    applyVolume();
+}
+
+void MainWindow::setReplayGainMode(ReplayGainMode mode)
+{
+    replayGainMode = mode;
+    QSettings().setValue("playback/replayGain", int(mode));
+    applyReplayGain(currentGain);
+    
+    if (mode == ReplayGainMode::Off) {
+        statusBar()->showMessage("ReplayGain off", 2000);
+    } else if (currentGain.isEmpty()) {
+        statusBar()->showMessage("ReplayGain on - this track has no gain tags (Tools > Scan Loudness)", 3000);
+    } else {
+        statusBar()->showMessage(QString("ReplayGain: %1 dB")
+            .arg(20.0 * std::log10(replayGainScale), 0, 'f', 1), 2000);
+    }
+}
+
+//skimming through track using seek slider, the value is in ms from the track start. a drag
+//sends a value per mouse move, the coalescer turns that into a few seeks a second
 void MainWindow::on_seekSlider_valueChanged(int value)
 {
     if (!isSeeking && mediaDuration > 0) {
-        qint64 position = (value * mediaDuration) / 100;
-        MPlayer->setPosition(position);
+        seekCoalescer->request(currentTrackStartMs() + value);
+        if (!ui->seekSlider->isSliderDown()) {
+            seekCoalescer->flush();     // Clicks and keys are single steps, no need to wait
+        }
     }
 }
 
@@ -690,16 +1064,56 @@ void MainWindow::on_seekSlider_valueChanged(int value)
 //time and slider updates during playback
 void MainWindow::onPositionChanged(qint64 position)
 {
-    if (!ui->seekSlider->isSliderDown() && mediaDuration > 0) {
-        isSeeking = true;
-        int sliderPosition = (position * 100) / mediaDuration;
-        ui->seekSlider->setValue(sliderPosition);
-        isSeeking = false;
+    // Qt Multimedia has no stage signals, its first position update while playing is the
+    // closest thing to audio reaching the device
+    if (!useNativeEngine && latencyTracker.isOpen() && MPlayer->playbackState() == QMediaPlayer::PlayingState) {
+        latencyTracker.mark(LatencyTracker::FirstOutput);
+    }
+    
+    // Virtual cue tracks end inside the file, hand over to the next entry at the boundary
+    if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
+        const PlaylistEntry &entry = playlist[currentTrackIndex];
+        bool insideTrack = position >= entry.startMs() && (entry.endMs() == 0 || position < entry.endMs());
+        if (entry.isVirtual() && pendingStartPosition >= 0 && insideTrack) {
+            pendingStartPosition = -1;  // Seek to the track start has landed
+        }
+        // Stale positions from before the seek must not trigger another hand-over
+        if (entry.isVirtual() && entry.endMs() > 0 && position >= entry.endMs()
+            && pendingStartPosition < 0) {
+            advanceAfterTrackEnd();
+            return;
+        }
+    }
+    
+    // Positions are shown relative to the start of the (possibly virtual) track, on the next frame
+    displayPositionMs = qMax(qint64(0), position - currentTrackStartMs());
+    frameScheduler->markDirty(positionClient);
+}
+
+//seek bar and time label for the latest position, once per frame. the handle only moves when it
+//would land on another pixel and the label is only rebuilt when the second changes
+void MainWindow::updatePositionDisplay()
+{
+    const qint64 position = displayPositionMs;
+    
+    // The handle stays where the user put it until the seek there has been sent
+    if (!ui->seekSlider->isSliderDown() && scrubDirection == 0 && !seekCoalescer->isPending() && mediaDuration > 0) {
+        const int value = int(qMin(position, mediaDuration));
+        const qint64 msPerPixel = qMax<qint64>(1, mediaDuration / qMax(1, ui->seekSlider->width()));
+        if (qAbs(qint64(value) - ui->seekSlider->value()) >= msPerPixel || value == 0 || value == mediaDuration) {
+            isSeeking = true;
+            ui->seekSlider->setValue(value);
+            isSeeking = false;
+        }
     }
     
-    // Update timestamp label
     qint64 currentSeconds = position / 1000;
     qint64 totalSeconds = mediaDuration / 1000;
+    if (currentSeconds == shownSeconds && totalSeconds == shownTotalSeconds) {
+        return;
+    }
+    shownSeconds = currentSeconds;
+    shownTotalSeconds = totalSeconds;
     
     QString timeText = QString("%1:%2 / %3:%4")
         .arg(currentSeconds / 60, 2, 10, QChar('0'))
@@ -713,67 +1127,190 @@ void MainWindow::onPositionChanged(qint64 position)
 //track duration loaded handler
 void MainWindow::onDurationChanged(qint64 duration)
 {
-    mediaDuration = duration;
-    ui->seekSlider->setEnabled(duration > 0);
+    fileDuration = duration;
+    updateTrackDuration();
+}
+
+//track length is the cue range for virtual tracks, the whole file otherwise
+void MainWindow::updateTrackDuration()
+{
+    qint64 start = currentTrackStartMs();
+    qint64 end = fileDuration;
+    if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
+        const PlaylistEntry &entry = playlist[currentTrackIndex];
+        if (entry.endMs() > 0) {
+            end = fileDuration > 0 ? qMin(entry.endMs(), fileDuration) : entry.endMs();
+        }
+    }
+    mediaDuration = qMax(qint64(0), end - start);
+    isSeeking = true;
+    ui->seekSlider->setMaximum(int(qMin<qint64>(mediaDuration, INT_MAX)));
+    isSeeking = false;
+    ui->seekSlider->setEnabled(mediaDuration > 0);
+    frameScheduler->markDirty(positionClient);      // The label shows the length too
+    ui->seekSlider->setOverviewSpan(start, mediaDuration);
+}
+
+//overview of the loaded file is ready, a late one for a file already left behind is dropped
+void MainWindow::onWaveformReady(const QString &filePath, std::shared_ptr<const WaveformOverview> overview)
+{
+    if (filePath == loadedFilePath) {
+        ui->seekSlider->setOverview(overview);
+    }
+}
+
+qint64 MainWindow::currentTrackStartMs() const
+{
+    if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
+        return playlist[currentTrackIndex].startMs();
+    }
+    return 0;
 }
 
 //auto play next after current
 void MainWindow::onMediaStatusChanged(QMediaPlayer::MediaStatus status)
 {
+    if (status == QMediaPlayer::LoadedMedia && sourceLoadTimer.isValid()) {
+        qint64 loadUs = sourceLoadTimer.nsecsElapsed() / 1000;
+        sourceLoadTimer.invalidate();
+        qCDebug(lcPlayback) << "Source loaded in" << loadUs << "us:" << loadedFilePath;
+        PerfLog::record("playback", "load_source", loadUs, QFileInfo(loadedFilePath).size(), loadedFilePath);
+    }
+    
+    // Native engine doesn't emit metaDataChanged
+    if (status == QMediaPlayer::LoadedMedia && useNativeEngine) {
+        displayMetadata();
+    }
+    
+    // Seeks issued before the backend has loaded the file are dropped, apply them now
+    if (status == QMediaPlayer::LoadedMedia && pendingStartPosition >= 0) {
+        playerSetPosition(pendingStartPosition);
+        pendingStartPosition = -1;
+    }
+    
     if (status == QMediaPlayer::EndOfMedia) {
-        // Handle repeat one mode - replay current song
-        if (repeatMode == RepeatMode::One) {
-            MPlayer->setPosition(0);
-            MPlayer->play();
-            isPlaying = true;
-            ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
-            updateNextTrackDisplay();
-            statusBar()->showMessage("Repeating current track", 2000);
-            return;
-        }
-        
-        // Current track ended, auto-play next track
-        if (currentTrackIndex + 1 < playlist.size()) {
-            loadTrack(currentTrackIndex + 1);
-            MPlayer->play();
+        advanceAfterTrackEnd();
+    }
+}
+
+//repeat/next handling shared by end of file and the end of a virtual cue track
+void MainWindow::advanceAfterTrackEnd()
+{
+    // Handle repeat one mode - replay current song
+    if (repeatMode == RepeatMode::One) {
+        playerSetPosition(currentTrackStartMs());
+        playerPlay();
+        isPlaying = true;
+        ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
+        updateNextTrackDisplay();
+        statusBar()->showMessage("Repeating current track", 2000);
+        return;
+    }
+    
+    // Current track ended, auto-play next track
+    if (currentTrackIndex + 1 < playlist.size()) {
+        loadTrack(currentTrackIndex + 1);
+        playerPlay();
+        isPlaying = true;
+        ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
+        updateNextTrackDisplay();
+        statusBar()->showMessage("Playing next track", 2000);
+    } else {
+        // End of playlist - handle repeat all mode
+        if (repeatMode == RepeatMode::All && !playlist.isEmpty()) {
+            loadTrack(0);  // Start from beginning
+            playerPlay();
             isPlaying = true;
             ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
             updateNextTrackDisplay();
-            statusBar()->showMessage("Playing next track", 2000);
+            statusBar()->showMessage("Repeating playlist", 2000);
         } else {
-            // End of playlist - handle repeat all mode
-            if (repeatMode == RepeatMode::All && !playlist.isEmpty()) {
-                loadTrack(0);  // Start from beginning
-                MPlayer->play();
-                isPlaying = true;
-                ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
-                updateNextTrackDisplay();
-                statusBar()->showMessage("Repeating playlist", 2000);
-            } else {
-                // No repeat - stop at end of playlist
-                isPlaying = false;
-                ui->playPause->setIcon(QIcon(":/icons/assets/play.png"));
-                updateNextTrackDisplay();
-                statusBar()->showMessage("End of playlist", 2000);
+            // No repeat - stop at end of playlist (a cue track can end mid-file, so pause explicitly)
+            if (playerIsPlaying()) {
+                playerPause();
+                playerSetPosition(currentTrackStartMs());
+            }
+            isPlaying = false;
+            ui->playPause->setIcon(QIcon(":/icons/assets/play.png"));
+            updateNextTrackDisplay();
+            statusBar()->showMessage("End of playlist", 2000);
+        }
+    }
+}
+
+//files of the next queue entries in play order (the playlist itself is shuffled), without the current file
+QStringList MainWindow::upcomingFiles(int count) const
+{
+    QStringList files;
+    if (currentTrackIndex < 0 || currentTrackIndex >= playlist.size() || repeatMode == RepeatMode::One) {
+        return files;
+    }
+    
+    const QString &currentFile = playlist[currentTrackIndex].filePath;
+    int index = currentTrackIndex;
+    for (int step = 0; step < playlist.size() && files.size() < count; ++step) {
+        ++index;
+        if (index >= playlist.size()) {
+            if (repeatMode != RepeatMode::All) {
+                break;
             }
+            index = 0;
+        }
+        const QString &file = playlist[index].filePath;
+        if (file != currentFile && !files.contains(file)) {
+            files.append(file);
         }
     }
+    return files;
+}
+
+void MainWindow::prefetchUpcoming()
+{
+    // Only once playback is under way, otherwise try again later
+    if (!isPlaying) {
+        prefetchTimer->start();
+        return;
+    }
+    prefetcher->prefetch(upcomingFiles(prefetchDepth));
+}
+
+//the native engine has moved on to the queued entry by itself, catch the UI up with it
+void MainWindow::onGaplessTrackStarted(const QUrl &source)
+{
+    if (gaplessIndex < 0 || gaplessIndex >= playlist.size()
+        || playlist[gaplessIndex].filePath != source.toLocalFile()) {
+        return;
+    }
+
+    currentTrackIndex = gaplessIndex;
+    gaplessIndex = -1;
+    loadedFilePath = playlist[currentTrackIndex].filePath;
+    pendingStartPosition = -1;
+    ui->seekSlider->clearOverview();
+    waveformBuilder->request(loadedFilePath);
+
+    showTrackInfo(playlist[currentTrackIndex]);
+    updateNextTrackDisplay();
+    statusBar()->showMessage("Playing next track", 2000);
 }
 
 // Handle media player errors (corrupted files, unsupported formats, decoder failures)
 void MainWindow::onMediaPlayerError(QMediaPlayer::Error error, const QString &errorString)
 {
-    qDebug() << "[MainWindow] Media player error occurred:" << error << errorString;
+    qCWarning(lcPlayback) << "Media player error occurred:" << error << errorString;
     
     // Stop playback safely
-    MPlayer->stop();
+    playerStop();
     isPlaying = false;
     ui->playPause->setIcon(QIcon(":/icons/assets/play.png"));
     
+    // The backend dropped the source, the next load has to re-open the file
+    loadedFilePath.clear();
+    
     // Get current track name for error message
     QString trackName = "Unknown track";
     if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
-        trackName = QFileInfo(playlist[currentTrackIndex]).fileName();
+        trackName = playlist[currentTrackIndex].displayName();
     }
     
     // Show error message to user
@@ -804,7 +1341,7 @@ void MainWindow::onMediaPlayerError(QMediaPlayer::Error error, const QString &er
     if (currentTrackIndex + 1 < playlist.size()) {
         QTimer::singleShot(500, this, [this]() {
             loadTrack(currentTrackIndex + 1);
-            MPlayer->play();
+            playerPlay();
             isPlaying = true;
             ui->playPause->setIcon(QIcon(":/icons/assets/pause.png"));
             updateNextTrackDisplay();
@@ -815,33 +1352,27 @@ void MainWindow::onMediaPlayerError(QMediaPlayer::Error error, const QString &er
 
 
 
- //Tracks mouse position and triggers partial repaints for gradient rendering.
- // Optimized for 60fps with frame throttling and minimal repaint regions.
- // DO NOT MODIFY unless necessary - already optimized for performance.
+ //Tracks mouse position for the gradient, the repaint happens on the next frame so any number
+ //of moves in between cost one repaint of the old and new spots
  
 void MainWindow::mouseMoveEvent(QMouseEvent *event)
 {
-    qint64 currentTime = frameTimer.elapsed();
-    qint64 elapsed = currentTime - lastUpdateTime;
-    
-    // Throttle updates to maintain 60fps (16ms per frame)
-    // Allow updates if enough time has passed OR if mouse moved significantly
+    // Map the event position to central widget coordinates if available
     QPoint newPos = centralWidget() ? centralWidget()->mapFrom(this, event->pos()) : event->pos();
-    int distance = QPoint(newPos - mousePos).manhattanLength();
+    if (newPos != mousePos) {
+        mousePos = newPos;
+        frameScheduler->markDirty(gradientClient);
+    }
     
-    // Lower threshold for smoother movement, especially over buttons
-    if (elapsed < TARGET_FRAME_TIME - 2 && distance < 2) {
-        // Skip this update if we're updating too frequently and mouse barely moved
-        QMainWindow::mouseMoveEvent(event);
+    QMainWindow::mouseMoveEvent(event);
+}
+
+//repaints the gradient where it was last drawn and where the mouse is now
+void MainWindow::updateGradient()
+{
+    if (mousePos == lastMousePos) {
         return;
     }
-    
-    lastUpdateTime = currentTime;
-    
-    // Map the event position to central widget coordinates if available
-    lastMousePos = mousePos;
-    mousePos = newPos;
-    
     // Only update the region affected by the gradient (old and new positions)
     if (!lastMousePos.isNull()) {
         QPoint globalMousePos = centralWidget() ? centralWidget()->mapTo(this, mousePos) : mousePos;
@@ -853,8 +1384,7 @@ void MainWindow::mouseMoveEvent(QMouseEvent *event)
     } else {
         update();
     }
-    
-    QMainWindow::mouseMoveEvent(event);
+    lastMousePos = mousePos;
 }
 
 
@@ -883,20 +1413,16 @@ bool MainWindow::eventFilter(QObject *obj, QEvent *event)
             buttonPressTimer.start();
             isButtonHeld = false;
             
-            // Check after 500ms if button is still held
-            QTimer::singleShot(500, this, [this, obj]() {
-                if (buttonPressTimer.isValid() && buttonPressTimer.elapsed() >= 500) {
+            // Still down after the hold time: scrub until released
+            QTimer::singleShot(Scrub::HoldMs, this, [this, obj]() {
+                if (buttonPressTimer.isValid() && buttonPressTimer.elapsed() >= Scrub::HoldMs) {
                     isButtonHeld = true;
-                    // Start seeking
-                    if (obj == ui->nextTrack) {
-                        seekForward();
-                    } else if (obj == ui->previousTrack) {
-                        seekBackward();
-                    }
+                    startScrub(obj == ui->nextTrack ? 1 : -1);
                 }
             });
         } else if (event->type() == QEvent::MouseButtonRelease) {
             buttonPressTimer.invalidate();
+            stopScrub();
         }
     }
     
@@ -964,11 +1490,429 @@ void MainWindow::on_repeatToggle_clicked()
 
 void MainWindow::on_trackStop_clicked()
 {
-    // Stop playback and reset to beginning
-    MPlayer->stop();
+    // Stop playback and reset to beginning (of the cue track for album images)
+    playerStop();
+    if (currentTrackStartMs() > 0) {
+        playerSetPosition(currentTrackStartMs());
+    }
     isPlaying = false;
     ui->playPause->setIcon(QIcon(":/icons/assets/play.png"));
     ui->seekSlider->setValue(0);
     ui->timeStamp->setText("00:00:00");
+    shownSeconds = -1;      // The next position rewrites the label
     statusBar()->showMessage("Playback stopped", 2000);
-}
\ No newline at end of file
+}
+
+//switches between QMediaPlayer and the native engine, the current track carries on where it was
+void MainWindow::on_actionNativeEngine_triggered(bool checked)
+{
+    if (checked == useNativeEngine) {
+        return;
+    }
+    
+    qint64 position = playerPosition();
+    useNativeEngine = checked;
+    QSettings().setValue("playback/nativeEngine", checked);
+    statusBar()->showMessage(checked ? "Using native audio engine" : "Using Qt Multimedia playback", 2000);
+    reloadCurrentTrack(position);
+}
+
+//output format is chosen when the device opens, so the track is reopened for the change to apply
+void MainWindow::on_actionBitPerfect_triggered(bool checked)
+{
+    nativeEngine->setBitPerfect(checked);
+    QSettings().setValue("playback/bitPerfect", checked);
+    
+    if (!useNativeEngine) {
+        statusBar()->showMessage(checked ? "Bit-perfect output needs the native audio engine (Tools menu)"
+                                         : "Bit-perfect output off", 3000);
+        return;
+    }
+    if (!checked) {
+        statusBar()->showMessage("Bit-perfect output off", 2000);
+    }
+    reloadCurrentTrack(playerPosition());
+}
+
+void MainWindow::onBitPerfectStatus(bool honoured, const QString &detail)
+{
+    qCInfo(lcPlayback) << detail;
+    statusBar()->showMessage(detail, honoured ? 3000 : 5000);
+}
+
+//tears both players down and loads the current track again at position,
+//after a change that only takes effect when the output is opened
+void MainWindow::reloadCurrentTrack(qint64 position)
+{
+    bool wasPlaying = isPlaying;
+    MPlayer->stop();
+    MPlayer->setSource(QUrl());
+    nativeEngine->stop();
+    nativeEngine->setSource(QUrl());
+    loadedFilePath.clear();
+    
+    if (currentTrackIndex >= 0 && currentTrackIndex < playlist.size()) {
+        loadTrack(currentTrackIndex);
+        if (useNativeEngine) {
+            playerSetPosition(position);
+        } else {
+            pendingStartPosition = position;
+        }
+        if (wasPlaying) {
+            playerPlay();
+        }
+    }
+}
+
+//decoded PCM queue depth for the native engine, larger survives more system load, smaller seeks faster
+void MainWindow::on_actionBufferSize_triggered()
+{
+    bool ok = false;
+    int bufferMs = QInputDialog::getInt(this, "Audio Buffer Size",
+                                        "Decoded audio buffered ahead of playback (ms):",
+                                        nativeEngine->bufferDuration(), 50, 5000, 50, &ok);
+    if (!ok) {
+        return;
+    }
+    nativeEngine->setBufferDuration(bufferMs);
+    QSettings().setValue("playback/bufferMs", bufferMs);
+    statusBar()->showMessage(QString("Audio buffer set to %1 ms, applies from the next track").arg(bufferMs), 3000);
+}
+
+//read strategy for FFmpeg input, Auto picks per file system
+void MainWindow::on_actionInputStorage_triggered()
+{
+    QStringList names;
+    for (int i = int(InputStorage::Auto); i <= int(InputStorage::Network); ++i) {
+        names << MappedInput::storageName(InputStorage(i));
+    }
+    bool ok = false;
+    const QString choice = QInputDialog::getItem(this, "Input Storage",
+                                                 "Music is stored on (mapped reads for local disks, large reads for network mounts):",
+                                                 names, int(MappedInput::defaultStorage()), false, &ok);
+    if (!ok) {
+        return;
+    }
+    const InputStorage storage = InputStorage(names.indexOf(choice));
+    MappedInput::setDefaultStorage(storage);
+    QSettings().setValue("io/storage", int(storage));
+    statusBar()->showMessage(QString("Input storage: %1, applies to files opened from now on").arg(choice), 3000);
+}
+
+//overlap between queue entries, native engine only (QMediaPlayer has no way to mix two sources)
+void MainWindow::on_actionCrossfade_triggered()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Crossfade");
+    QFormLayout *layout = new QFormLayout(&dialog);
+    
+    QSpinBox *durationSpin = new QSpinBox(&dialog);
+    durationSpin->setRange(0, 12000);
+    durationSpin->setSingleStep(500);
+    durationSpin->setSuffix(" ms");
+    durationSpin->setSpecialValueText("Off (gapless)");
+    durationSpin->setValue(nativeEngine->crossfadeDuration());
+    layout->addRow("Duration:", durationSpin);
+    
+    QComboBox *curveCombo = new QComboBox(&dialog);
+    curveCombo->addItem("Linear", int(Dsp::FadeCurve::Linear));
+    curveCombo->addItem("Equal power", int(Dsp::FadeCurve::EqualPower));
+    curveCombo->addItem("S-curve", int(Dsp::FadeCurve::SCurve));
+    curveCombo->setCurrentIndex(curveCombo->findData(int(nativeEngine->crossfadeCurve())));
+    layout->addRow("Curve:", curveCombo);
+    
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addRow(buttons);
+    
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    
+    const int crossfadeMs = durationSpin->value();
+    const Dsp::FadeCurve curve = static_cast<Dsp::FadeCurve>(curveCombo->currentData().toInt());
+    nativeEngine->setCrossfade(crossfadeMs, curve);
+    QSettings settings;
+    settings.setValue("playback/crossfadeMs", crossfadeMs);
+    settings.setValue("playback/crossfadeCurve", int(curve));
+    
+    if (crossfadeMs > 0 && !useNativeEngine) {
+        statusBar()->showMessage("Crossfade needs the native audio engine (Tools menu)", 3000);
+    } else {
+        statusBar()->showMessage(crossfadeMs > 0 ? QString("Crossfade: %1 ms").arg(crossfadeMs) : "Crossfade off", 2000);
+    }
+}
+
+namespace {
+    // Device ids are opaque bytes and may contain '/', which QSettings treats as a group separator
+    QString deviceKey(const QString &group, const QAudioDevice &device)
+    {
+        return group + "/" + QString::fromLatin1(device.id().toHex());
+    }
+}
+
+void MainWindow::loadOutputDeviceSettings()
+{
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    QSettings settings;
+    const QByteArray saved = settings.value(deviceKey("equalizer", device)).toByteArray();
+    nativeEngine->equalizer().setPreset(saved.isEmpty() ? EqPreset::flat() : EqPreset::fromJson(saved));
+    nativeEngine->setTargetRate(settings.value(deviceKey("resampler/targetRate", device), 0).toInt());
+}
+
+//parametric EQ of the native engine, saved per output device
+void MainWindow::on_actionEqualizer_triggered()
+{
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    EqualizerDialog dialog(nativeEngine->equalizer(), device.description(), this);
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    
+    const EqPreset preset = dialog.preset();
+    QSettings().setValue(deviceKey("equalizer", device), preset.toJson());
+    
+    if (preset.enabled && !useNativeEngine) {
+        statusBar()->showMessage("The equalizer needs the native audio engine (Tools menu)", 3000);
+    } else if (preset.enabled && nativeEngine->isBitPerfectActive()) {
+        statusBar()->showMessage("Bit-perfect output is on, the equalizer is bypassed", 3000);
+    }
+}
+
+//FFT bars of the native engine's output, the analysis thread only runs while they are shown
+void MainWindow::on_actionSpectrum_triggered(bool checked)
+{
+    QSettings().setValue("view/spectrum", checked);
+    spectrumAnalyzer->resetStats();
+    nativeEngine->audioTap().resetStats();
+    spectrumAnalyzer->setActive(checked);
+    spectrumWidget->setVisible(checked);
+    frameScheduler->setContinuous(spectrumClient, checked);
+    
+    if (checked && !useNativeEngine) {
+        statusBar()->showMessage("The spectrum analyzer needs the native audio engine (Tools menu)", 3000);
+    }
+}
+
+//rate conversion quality for playback and conversion, and the rate this output device runs at
+void MainWindow::on_actionResampler_triggered()
+{
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    QDialog dialog(this);
+    dialog.setWindowTitle("Resampler");
+    QFormLayout *layout = new QFormLayout(&dialog);
+    
+    QComboBox *profileCombo = new QComboBox(&dialog);
+    for (ResamplerProfile profile : {ResamplerProfile::Fast, ResamplerProfile::Balanced,
+                                     ResamplerProfile::HighQuality, ResamplerProfile::Soxr}) {
+        QString name = Resampler::profileName(profile);
+        if (profile == ResamplerProfile::Soxr && !Resampler::soxrAvailable()) {
+            name += " - not in this FFmpeg build";
+        }
+        profileCombo->addItem(name, int(profile));
+    }
+    profileCombo->setCurrentIndex(profileCombo->findData(int(nativeEngine->resamplerProfile())));
+    layout->addRow("Quality:", profileCombo);
+    
+    QComboBox *rateCombo = new QComboBox(&dialog);
+    rateCombo->addItem("Source rate", 0);
+    for (int rate : {44100, 48000, 88200, 96000, 176400, 192000}) {
+        rateCombo->addItem(QString("%1 Hz").arg(rate), rate);
+    }
+    rateCombo->setCurrentIndex(qMax(0, rateCombo->findData(nativeEngine->targetRate())));
+    layout->addRow(QString("Output rate (%1):").arg(device.description()), rateCombo);
+    
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addRow(buttons);
+    
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    
+    const ResamplerProfile profile = static_cast<ResamplerProfile>(profileCombo->currentData().toInt());
+    const int targetRate = rateCombo->currentData().toInt();
+    nativeEngine->setResamplerProfile(profile);
+    nativeEngine->setTargetRate(targetRate);
+    QSettings settings;
+    settings.setValue("resampler/profile", int(profile));
+    settings.setValue(deviceKey("resampler/targetRate", device), targetRate);
+    statusBar()->showMessage(QString("Resampler: %1, applies from the next track").arg(Resampler::profileName(profile)), 3000);
+}
+
+void MainWindow::onEngineLatency(PlaybackEngine::LatencyKind kind, qint64 usecs)
+{
+    statusBar()->showMessage(QString("%1 latency: %2 ms")
+        .arg(kind == PlaybackEngine::StartLatency ? "Start" : "Seek")
+        .arg(usecs / 1000.0, 0, 'f', 1), 2000);
+}
+
+void MainWindow::onEngineLatencyStages(PlaybackEngine::LatencyKind kind, qint64 requestNs, qint64 decodedNs, qint64 outputNs)
+{
+    // Only the request the open trace is waiting for: issued after the click, and a seek must
+    // not complete a track change
+    if (!latencyTracker.isOpen() || requestNs < latencyTracker.openedNs()
+        || (kind == PlaybackEngine::SeekLatency) != (latencyTracker.openAction() == LatencyTracker::Seek)) {
+        return;
+    }
+    if (decodedNs > 0) {
+        latencyTracker.mark(LatencyTracker::FirstDecoded, decodedNs);
+    }
+    latencyTracker.mark(LatencyTracker::FirstOutput, outputNs);
+}
+
+//debug panel: percentiles of every stage interval per action, exportable for release comparisons
+void MainWindow::on_actionLatencyStats_triggered()
+{
+    QDialog dialog(this);
+    dialog.setWindowTitle("Latency Statistics");
+    dialog.resize(640, 420);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    
+    QTreeWidget *tree = new QTreeWidget(&dialog);
+    tree->setHeaderLabels({"Action / interval", "Count", "p50 ms", "p90 ms", "p99 ms", "Max ms"});
+    tree->setRootIsDecorated(true);
+    tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    layout->addWidget(tree);
+    
+    auto ms = [](qint64 us) { return QString::number(us / 1000.0, 'f', 1); };
+    auto populate = [this, tree, ms]() {
+        tree->clear();
+        for (int a = 0; a < LatencyTracker::ActionCount; ++a) {
+            const LatencyTracker::Action action = LatencyTracker::Action(a);
+            QTreeWidgetItem *actionItem = new QTreeWidgetItem(tree);
+            actionItem->setText(0, QString("%1 (%2 abandoned)")
+                .arg(LatencyTracker::actionName(action))
+                .arg(latencyTracker.abandoned(action)));
+            actionItem->setText(1, QString::number(latencyTracker.completed(action)));
+            const QMap<QString, LatencyHistogram> &histograms = latencyTracker.histograms(action);
+            for (auto it = histograms.cbegin(); it != histograms.cend(); ++it) {
+                QTreeWidgetItem *item = new QTreeWidgetItem(actionItem);
+                item->setText(0, it.key());
+                item->setText(1, QString::number(it.value().count()));
+                item->setText(2, ms(it.value().percentileUs(50)));
+                item->setText(3, ms(it.value().percentileUs(90)));
+                item->setText(4, ms(it.value().percentileUs(99)));
+                item->setText(5, ms(it.value().maxUs()));
+            }
+            actionItem->setExpanded(!histograms.isEmpty());
+        }
+        
+        // The UI's own frame clock, to see what the periodic updates cost the GUI thread
+        const FrameStats frames = frameScheduler->stats();
+        QTreeWidgetItem *framesItem = new QTreeWidgetItem(tree);
+        framesItem->setText(0, QString("UI frames every %1 ms (%2 late, %3 skipped while hidden)")
+            .arg(frames.intervalMs).arg(frames.late).arg(frames.hiddenSkips));
+        framesItem->setText(1, QString::number(frames.frames));
+        const QPair<QString, const LatencyHistogram *> frameHistograms[] = {
+            {"work", &frameScheduler->workHistogram()},
+            {"interval", &frameScheduler->intervalHistogram()},
+        };
+        for (const auto &histogram : frameHistograms) {
+            QTreeWidgetItem *item = new QTreeWidgetItem(framesItem);
+            item->setText(0, histogram.first);
+            item->setText(1, QString::number(histogram.second->count()));
+            item->setText(2, QString::number(histogram.second->percentileUs(50) / 1000.0, 'f', 2));
+            item->setText(3, QString::number(histogram.second->percentileUs(90) / 1000.0, 'f', 2));
+            item->setText(4, QString::number(histogram.second->percentileUs(99) / 1000.0, 'f', 2));
+            item->setText(5, QString::number(histogram.second->maxUs() / 1000.0, 'f', 2));
+        }
+        for (int c = 0; c < frameScheduler->clientCount(); ++c) {
+            QTreeWidgetItem *item = new QTreeWidgetItem(framesItem);
+            item->setText(0, QString("%1 updates").arg(frameScheduler->clientName(c)));
+            item->setText(1, QString::number(frameScheduler->clientRuns(c)));
+        }
+        framesItem->setExpanded(frames.frames > 0);
+    };
+    populate();
+    
+    QLabel *note = new QLabel(useNativeEngine
+        ? "Stages: UI event, source set, first decoded frame, first buffer pulled by the device"
+        : "Qt Multimedia backend: no decode stage, output is the first position update", &dialog);
+    note->setWordWrap(true);
+    layout->addWidget(note);
+    
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close, &dialog);
+    QPushButton *exportButton = buttons->addButton("Export JSON...", QDialogButtonBox::ActionRole);
+    QPushButton *resetButton = buttons->addButton("Reset", QDialogButtonBox::ResetRole);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(resetButton, &QPushButton::clicked, &dialog, [this, populate]() {
+        latencyTracker.clear();
+        frameScheduler->resetStats();
+        populate();
+    });
+    connect(exportButton, &QPushButton::clicked, &dialog, [this, &dialog]() {
+        QString path = QFileDialog::getSaveFileName(&dialog, "Export Latency Statistics",
+            QString("flacplayer-latency-%1.json").arg(QCoreApplication::applicationVersion()), "JSON (*.json)");
+        if (path.isEmpty()) {
+            return;
+        }
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(latencyTracker.toJson()) < 0) {
+            QMessageBox::warning(&dialog, "Export Failed", QString("Could not write %1: %2").arg(path, file.errorString()));
+        }
+    });
+    layout->addWidget(buttons);
+    
+    dialog.exec();
+}
+
+void MainWindow::playerSetSource(const QUrl &source)
+{
+    if (useNativeEngine) {
+        nativeEngine->setSource(source);
+    } else {
+        MPlayer->setSource(source);
+    }
+}
+
+void MainWindow::playerPlay()
+{
+    if (useNativeEngine) {
+        nativeEngine->play();
+    } else {
+        MPlayer->play();
+    }
+}
+
+void MainWindow::playerPause()
+{
+    if (useNativeEngine) {
+        nativeEngine->pause();
+    } else {
+        MPlayer->pause();
+    }
+}
+
+void MainWindow::playerStop()
+{
+    if (useNativeEngine) {
+        nativeEngine->stop();
+    } else {
+        MPlayer->stop();
+    }
+}
+
+void MainWindow::playerSetPosition(qint64 position)
+{
+    if (useNativeEngine) {
+        nativeEngine->setPosition(position);
+    } else {
+        MPlayer->setPosition(position);
+    }
+}
+
+qint64 MainWindow::playerPosition() const
+{
+    return useNativeEngine ? nativeEngine->position() : MPlayer->position();
+}
+
+bool MainWindow::playerIsPlaying() const
+{
+    if (useNativeEngine) {
+        return nativeEngine->playbackState() == QMediaPlayer::PlayingState;
+    }
+    return MPlayer->playbackState() == QMediaPlayer::PlayingState;
+}
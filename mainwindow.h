@@ -5,8 +5,18 @@
 #include <QMainWindow>
 #include <QMediaPlayer>
 #include <QAudioOutput>
+#include <QMediaDevices>
 #include <QElapsedTimer>
+#include <QTimer>
 #include "playlist.h"
+#include "playbackengine.h"
+#include "trackprefetcher.h"
+#include "audiomanager.h"
+#include "latencytracker.h"
+#include "waveformbuilder.h"
+#include "spectrumwidget.h"
+#include "seekcoalescer.h"
+#include "framescheduler.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -21,6 +31,13 @@ enum class RepeatMode {
     One         // Repeat current song
 };
 
+//which REPLAYGAIN_* pair scales the volume, values are stored in the settings
+enum class ReplayGainMode {
+    Off = 0,
+    Track = 1,  // Every track at the reference level
+    Album = 2   // Keeps the level differences inside an album
+};
+
 //window class, handles UI, plaback and the stupid gradient effect
 class MainWindow : public QMainWindow
 {
@@ -37,6 +54,17 @@ private slots:
     void on_trackQueue_clicked();         
     void on_actionEditMetadata_triggered();
     void on_actionConvertToMP3_triggered();
+    void on_actionVerifyAudio_triggered();
+    void on_actionLoudnessScan_triggered();
+    void on_actionNativeEngine_triggered(bool checked);
+    void on_actionBufferSize_triggered();
+    void on_actionInputStorage_triggered();
+    void on_actionCrossfade_triggered();
+    void on_actionBitPerfect_triggered(bool checked);
+    void on_actionEqualizer_triggered();
+    void on_actionSpectrum_triggered(bool checked);
+    void on_actionResampler_triggered();
+    void on_actionLatencyStats_triggered();
     
     //playback control slots
     void on_playPause_clicked();        
@@ -52,6 +80,13 @@ private slots:
     void onDurationChanged(qint64 duration);      
     void onMediaStatusChanged(QMediaPlayer::MediaStatus status);
     void onMediaPlayerError(QMediaPlayer::Error error, const QString &errorString); 
+    void onEngineLatency(PlaybackEngine::LatencyKind kind, qint64 usecs);
+    void onEngineLatencyStages(PlaybackEngine::LatencyKind kind, qint64 requestNs, qint64 decodedNs, qint64 outputNs);
+    void onGaplessTrackStarted(const QUrl &source);
+    void onBitPerfectStatus(bool honoured, const QString &detail);
+    void onWaveformReady(const QString &filePath, std::shared_ptr<const WaveformOverview> overview);
+    void onCoalescedSeek(qint64 position);
+    void scrubTick();
 
     void on_repeatToggle_clicked();
     void on_trackStop_clicked();
@@ -65,10 +100,35 @@ protected:
 private:
     //helpers for track loading, metadata display, seeking
     void loadTrack(int index);       
+    void reloadCurrentTrack(qint64 position);
+    void showTrackInfo(const PlaylistEntry &entry);
+    void appendToQueue(const QString &fileName);
+    void advanceAfterTrackEnd();
+    void updateTrackDuration();
+    qint64 currentTrackStartMs() const;
     void updateNextTrackDisplay();   
+    int nextTrackIndex() const;
+    void queueNextForGapless();
+    QStringList upcomingFiles(int count) const;
+    void prefetchUpcoming();
     void displayMetadata();
-    void seekForward();             
-    void seekBackward();            
+    void setReplayGainMode(ReplayGainMode mode);
+    void applyReplayGain(const ReplayGainInfo &gain);
+    void applyVolume();
+    void loadOutputDeviceSettings();
+    void startScrub(int direction);
+    void updatePositionDisplay();
+    void updateGradient();
+    void stopScrub();
+    
+    //playback calls go to QMediaPlayer or the native engine, whichever is selected
+    void playerSetSource(const QUrl &source);
+    void playerPlay();
+    void playerPause();
+    void playerStop();
+    void playerSetPosition(qint64 position);
+    qint64 playerPosition() const;
+    bool playerIsPlaying() const;
     
   
     Ui::MainWindow *ui;  ///< User interface pointer
@@ -76,16 +136,47 @@ private:
     // Media playback components
     QMediaPlayer *MPlayer;
     QAudioOutput *audioOutput; 
+    PlaybackEngine *nativeEngine;   ///< Own decode thread + ring buffer, used instead of MPlayer when enabled
+    bool useNativeEngine = false;
+    TrackPrefetcher *prefetcher;    ///< Warms the page cache for the next queue entries
+    QTimer *prefetchTimer;          ///< Starts a prefetch round once the current track plays steadily
+    int prefetchDepth = 3;          ///< Queue entries read ahead
+    WaveformBuilder *waveformBuilder;   ///< Seek bar overviews, computed once per file and cached on disk
+    SpectrumAnalyzer *spectrumAnalyzer; ///< FFT of the native engine's output on its own thread
+    SpectrumWidget *spectrumWidget;     ///< Its bars, next to the album art
+    QMediaDevices *mediaDevices;    ///< Output changes switch to that device's equalizer and rate
     // Playlist management
     Playlist playlist;         
     Playlist originalPlaylist;      ///< Store original playlist order before shuffling
     int currentTrackIndex = -1;     ///< Index of currently playing track (-1 = none)
+    int gaplessIndex = -1;          ///< Entry handed to the native engine as its next source (-1 = none)
+    PlaylistEntry gaplessEntry;     ///< What was queued, to notice reordering and removals
     
     // Playback state variables
     bool isPlaying = false;        
     bool isMuted = false;           
-    bool isSeeking = false;      
-    qint64 mediaDuration = 0;
+    ReplayGainMode replayGainMode = ReplayGainMode::Off;
+    ReplayGainInfo currentGain;     ///< Tags of the track being played
+    double replayGainScale = 1.0;   ///< Linear factor applied on top of the volume slider
+    bool isSeeking = false;         ///< Set while the slider is moved from code, not by the user
+    SeekCoalescer *seekCoalescer;   ///< Latest-wins throttle in front of playerSetPosition
+    QTimer *scrubTimer;             ///< Ticks while next/previous is held
+    QElapsedTimer scrubClock;       ///< Since the hold turned into scrubbing
+    qint64 scrubOriginMs = 0;       ///< Position the scrub started from
+    int scrubDirection = 0;         ///< 1 forward, -1 back, 0 not scrubbing
+    FrameScheduler *frameScheduler; ///< One frame clock for the periodic UI updates below
+    int positionClient = -1;
+    int gradientClient = -1;
+    int spectrumClient = -1;
+    qint64 displayPositionMs = 0;   ///< Latest backend position from the track start, shown on the next frame
+    qint64 shownSeconds = -1;       ///< What the time label shows, to skip rebuilding it
+    qint64 shownTotalSeconds = -1;
+    qint64 mediaDuration = 0;       ///< Duration of the current (possibly virtual) track in ms
+    qint64 fileDuration = 0;        ///< Duration of the whole loaded file in ms
+    QString loadedFilePath;         ///< File currently set as the backend source
+    qint64 pendingStartPosition = -1; ///< Track start not yet reached by the backend (-1 = none)
+    QElapsedTimer sourceLoadTimer;  ///< setSource() to LoadedMedia, for the playback log
+    LatencyTracker latencyTracker;  ///< Click to audible output, per action (Help > Latency Statistics)
     RepeatMode repeatMode = RepeatMode::Off;       ///< Total duration of current track in milliseconds
     bool isShuffleOn = false;      ///< Shuffle state (off by default)
     
@@ -95,10 +186,7 @@ private:
     
     // Mouse gradient effect variables
     QPoint mousePos;                
-    QPoint lastMousePos;            
-    QElapsedTimer frameTimer;       
-    qint64 lastUpdateTime;          
-    static constexpr int TARGET_FRAME_TIME = 16; ///< Target frame time in ms (~60 FPS)
+    QPoint lastMousePos;            ///< Where the gradient was last drawn
 };
 
 #endif // MAINWINDOW_H
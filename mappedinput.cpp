@@ -0,0 +1,295 @@
+#include "mappedinput.h"
+#include "logging.h"
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStorageInfo>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+#include <sys/mman.h>
+#endif
+
+extern "C" {
+#include <libavutil/mem.h>
+}
+
+namespace {
+    std::atomic<int> s_defaultStorage{int(InputStorage::Auto)};
+
+    QMutex s_storageMutex;
+    QHash<QString, InputStorage> s_storageByDir;
+
+    qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool isNetworkFileSystem(const QByteArray &type)
+    {
+        static const char *const network[] = {"nfs", "nfs4", "cifs", "smb", "smb2", "smb3", "smbfs",
+                                              "9p", "afs", "ceph", "glusterfs", "davfs", "fuse.sshfs",
+                                              "fuse.rclone", "fuse.smbnetfs"};
+        for (const char *name : network) {
+            if (type == name) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isRotational(const QByteArray &device)
+    {
+#ifdef Q_OS_LINUX
+        // /dev/sda1 -> /sys/class/block/sda1, whose parent (the whole disk) has the queue flags
+        const QString name = QFileInfo(QString::fromLocal8Bit(device)).fileName();
+        for (const QString &path : {"/sys/class/block/" + name + "/queue/rotational",
+                                    "/sys/class/block/" + name + "/../queue/rotational"}) {
+            QFile flag(path);
+            if (flag.open(QIODevice::ReadOnly)) {
+                return flag.read(1) == "1";
+            }
+        }
+#else
+        Q_UNUSED(device);
+#endif
+        return false;
+    }
+}
+
+MappedInput::MappedInput()
+{
+}
+
+MappedInput::~MappedInput()
+{
+    close();
+}
+
+bool MappedInput::open(const QString &filePath, InputStorage storage)
+{
+    close();
+
+    // Unbuffered: every unmapped read goes straight into FFmpeg's buffer
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        m_lastError = "Cannot open file: " + m_file.errorString();
+        return false;
+    }
+    m_filePath = filePath;
+    m_size = m_file.size();
+    m_position = 0;
+    m_storage = storage == InputStorage::Auto ? detectStorage(filePath) : storage;
+    m_stats = InputStats();
+
+    const InputTuning tuning = tuningFor(m_storage);
+    if (tuning.map && m_size > 0) {
+        m_map = m_file.map(0, m_size);
+        // Mapping can fail on odd file systems or a 32-bit address space, reads still work
+        if (m_map) {
+#ifdef Q_OS_LINUX
+            posix_madvise(const_cast<uchar *>(m_map), size_t(m_size),
+                          m_storage == InputStorage::Rotational ? POSIX_MADV_SEQUENTIAL : POSIX_MADV_NORMAL);
+#endif
+        } else {
+            qCDebug(lcPlayback) << "mmap failed, reading instead:" << filePath << m_file.errorString();
+        }
+    }
+    m_stats.mapped = m_map != nullptr;
+
+    unsigned char *buffer = static_cast<unsigned char *>(av_malloc(size_t(tuning.bufferSize)));
+    if (buffer) {
+        m_avio = avio_alloc_context(buffer, tuning.bufferSize, 0, this, &MappedInput::readPacket, nullptr,
+                                    &MappedInput::seekPacket);
+    }
+    if (!m_avio) {
+        av_free(buffer);
+        m_lastError = "Failed to allocate I/O context";
+        close();
+        return false;
+    }
+
+    m_lastError.clear();
+    return true;
+}
+
+bool MappedInput::openFormat(AVFormatContext **formatCtx, const AVInputFormat *format, AVDictionary **options)
+{
+    *formatCtx = nullptr;
+    if (!m_avio) {
+        m_lastError = "Input is not open";
+        return false;
+    }
+
+    AVFormatContext *ctx = avformat_alloc_context();
+    if (!ctx) {
+        m_lastError = "Failed to allocate format context";
+        return false;
+    }
+    ctx->pb = m_avio;
+    ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+    // The URL is still used to probe by extension and in FFmpeg's log lines.
+    // avformat_open_input() frees the context on failure, the AVIO context stays ours
+    if (avformat_open_input(&ctx, m_filePath.toUtf8().constData(), format, options) < 0) {
+        m_lastError = "Failed to open input file";
+        return false;
+    }
+    *formatCtx = ctx;
+    return true;
+}
+
+void MappedInput::close()
+{
+    if (m_avio) {
+        av_freep(&m_avio->buffer);
+        avio_context_free(&m_avio);
+        qCDebug(lcPlayback) << "Input closed:" << m_filePath << storageName(m_storage)
+                            << (m_stats.mapped ? "mapped" : "read") << m_stats.bytesRead << "bytes in"
+                            << m_stats.reads << "reads," << m_stats.syscalls << "syscalls,"
+                            << m_stats.readNs / 1000 << "us";
+        PerfLog::record("io", m_stats.mapped ? "input_mapped" : "input_read", m_stats.readNs / 1000,
+                        m_stats.bytesRead, m_filePath);
+    }
+    if (m_map) {
+        m_file.unmap(const_cast<uchar *>(m_map));
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_position = 0;
+}
+
+int MappedInput::readPacket(void *opaque, uint8_t *buffer, int size)
+{
+    MappedInput *input = static_cast<MappedInput *>(opaque);
+    const qint64 start = nowNs();
+
+    qint64 got = 0;
+    if (input->m_map) {
+        got = qBound<qint64>(0, input->m_size - input->m_position, size);
+        std::memcpy(buffer, input->m_map + input->m_position, size_t(got));
+    } else {
+        got = input->m_file.read(reinterpret_cast<char *>(buffer), size);
+        ++input->m_stats.syscalls;
+        if (got < 0) {
+            return AVERROR(EIO);
+        }
+    }
+
+    input->m_position += got;
+    input->m_stats.bytesRead += got;
+    input->m_stats.readNs += nowNs() - start;
+    ++input->m_stats.reads;
+    return got > 0 ? int(got) : AVERROR_EOF;
+}
+
+int64_t MappedInput::seekPacket(void *opaque, int64_t offset, int whence)
+{
+    MappedInput *input = static_cast<MappedInput *>(opaque);
+    if (whence & AVSEEK_SIZE) {
+        return input->m_size;
+    }
+
+    qint64 target = -1;
+    switch (whence & ~AVSEEK_FORCE) {
+        case SEEK_SET:
+            target = offset;
+            break;
+        case SEEK_CUR:
+            target = input->m_position + offset;
+            break;
+        case SEEK_END:
+            target = input->m_size + offset;
+            break;
+        default:
+            return AVERROR(EINVAL);
+    }
+    if (target < 0) {
+        return AVERROR(EINVAL);
+    }
+
+    // Past the end is allowed (reads then hit EOF), like lseek
+    if (!input->m_map && !input->m_file.seek(target)) {
+        return AVERROR(EIO);
+    }
+    input->m_position = target;
+    ++input->m_stats.seeks;
+    return target;
+}
+
+InputTuning MappedInput::tuningFor(InputStorage storage)
+{
+    InputTuning tuning;
+    switch (storage) {
+        case InputStorage::Auto:
+        case InputStorage::Local:
+            tuning.map = true;
+            tuning.bufferSize = 64 * 1024;
+            break;
+        case InputStorage::Rotational:
+            tuning.map = true;
+            tuning.bufferSize = 256 * 1024;
+            break;
+        case InputStorage::Network:
+            tuning.map = false;
+            tuning.bufferSize = 1024 * 1024;
+            break;
+    }
+    return tuning;
+}
+
+InputStorage MappedInput::detectStorage(const QString &filePath)
+{
+    const QString dir = QFileInfo(filePath).absolutePath();
+    {
+        QMutexLocker locker(&s_storageMutex);
+        auto it = s_storageByDir.constFind(dir);
+        if (it != s_storageByDir.constEnd()) {
+            return it.value();
+        }
+    }
+
+    const QStorageInfo info(dir);
+    InputStorage storage = InputStorage::Local;
+    if (isNetworkFileSystem(info.fileSystemType())) {
+        storage = InputStorage::Network;
+    } else if (isRotational(info.device())) {
+        storage = InputStorage::Rotational;
+    }
+    qCDebug(lcPlayback) << "Storage of" << dir << "is" << storageName(storage)
+                        << "(" << info.fileSystemType() << info.device() << ")";
+
+    QMutexLocker locker(&s_storageMutex);
+    s_storageByDir.insert(dir, storage);
+    return storage;
+}
+
+QString MappedInput::storageName(InputStorage storage)
+{
+    switch (storage) {
+        case InputStorage::Auto:
+            return "Auto";
+        case InputStorage::Local:
+            return "Local (SSD)";
+        case InputStorage::Rotational:
+            return "Rotational (HDD)";
+        case InputStorage::Network:
+            return "Network";
+    }
+    return "Auto";
+}
+
+void MappedInput::setDefaultStorage(InputStorage storage)
+{
+    s_defaultStorage.store(int(storage), std::memory_order_relaxed);
+}
+
+InputStorage MappedInput::defaultStorage()
+{
+    return static_cast<InputStorage>(s_defaultStorage.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,89 @@
+#ifndef MAPPEDINPUT_H
+#define MAPPEDINPUT_H
+
+#include <QFile>
+#include <QString>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+//what the input lives on, picks how it is read (see MappedInput::tuningFor). stored in the settings
+enum class InputStorage {
+    Auto = 0,           // detected per file system (network mounts, rotational disks on Linux)
+    Local = 1,          // SSD / NVMe: mapped, small FFmpeg buffer
+    Rotational = 2,     // spinning disk: mapped with sequential readahead, larger buffer
+    Network = 3         // NFS / SMB / FUSE: never mapped (a truncated file would SIGBUS), 1 MiB reads
+};
+
+struct InputTuning {
+    bool map = true;                // mmap the whole file, plain reads when false or when mapping fails
+    int bufferSize = 64 * 1024;     // FFmpeg's AVIO buffer, and so the size of one unmapped read()
+};
+
+//I/O done on behalf of FFmpeg by one MappedInput
+struct InputStats {
+    qint64 bytesRead = 0;           // handed to FFmpeg
+    qint64 readNs = 0;              // spent in the read callback, page faults included when mapped
+    int reads = 0;                  // read callbacks
+    int syscalls = 0;               // read() calls, 0 when mapped
+    int seeks = 0;
+    bool mapped = false;
+};
+
+//AVIOContext over a memory-mapped file, falling back to large reads straight into FFmpeg's
+//(aligned) buffer. replaces avformat_open_input's own file protocol, which does a read()
+//syscall per 32 KiB. one instance per open file and thread:
+//
+//  MappedInput input;
+//  if (input.open(path) && input.openFormat(&formatCtx)) { ... }
+//  avformat_close_input(&formatCtx);
+//  input.close();
+class MappedInput
+{
+public:
+    MappedInput();
+    ~MappedInput();
+
+    MappedInput(const MappedInput &) = delete;
+    MappedInput &operator=(const MappedInput &) = delete;
+
+    bool open(const QString &filePath, InputStorage storage = defaultStorage());
+    //avformat_open_input() reading through this input. on failure *formatCtx stays null
+    bool openFormat(AVFormatContext **formatCtx, const AVInputFormat *format = nullptr,
+                    AVDictionary **options = nullptr);
+    //only once the format context using it is closed. logs the stats to the perf log
+    void close();
+    bool isOpen() const { return m_avio != nullptr; }
+    QString filePath() const { return m_filePath; }
+
+    AVIOContext *context() const { return m_avio; }
+    InputStats stats() const { return m_stats; }
+    InputStorage storage() const { return m_storage; }
+    QString lastError() const { return m_lastError; }
+
+    static InputTuning tuningFor(InputStorage storage);
+    //cached per directory, the lookup parses the mount table
+    static InputStorage detectStorage(const QString &filePath);
+    static QString storageName(InputStorage storage);
+
+    //what open() uses unless told otherwise, any thread
+    static void setDefaultStorage(InputStorage storage);
+    static InputStorage defaultStorage();
+
+private:
+    static int readPacket(void *opaque, uint8_t *buffer, int size);
+    static int64_t seekPacket(void *opaque, int64_t offset, int whence);
+
+    QString m_filePath;
+    QFile m_file;
+    const uchar *m_map = nullptr;
+    qint64 m_size = 0;
+    qint64 m_position = 0;
+    AVIOContext *m_avio = nullptr;
+    InputStorage m_storage = InputStorage::Local;
+    InputStats m_stats;
+    QString m_lastError;
+};
+
+#endif // MAPPEDINPUT_H
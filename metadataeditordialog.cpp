@@ -0,0 +1,143 @@
+#include "metadataeditordialog.h"
+#include "ui_metadataeditor.h"
+#include "logging.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QPixmap>
+
+MetadataEditorDialog::MetadataEditorDialog(const QString &filePath, QWidget *parent)
+    : QDialog(parent)
+    , ui(new Ui::MetadataEditorDialog)
+    , m_filePath(filePath)
+{
+    qCDebug(lcMetadata) << "Constructor called for:" << filePath;
+    ui->setupUi(this);
+    qCDebug(lcMetadata) << "UI setup complete, loading metadata...";
+    loadMetadata();
+    qCDebug(lcMetadata) << "Metadata loaded, dialog ready";
+}
+
+MetadataEditorDialog::~MetadataEditorDialog()
+{
+    delete ui;
+}
+
+void MetadataEditorDialog::loadMetadata()
+{
+    qCDebug(lcMetadata) << "loadMetadata called for:" << m_filePath;
+    
+    // Validate file exists
+    if (!QFile::exists(m_filePath)) {
+        QMessageBox::critical(this, "Error", "File does not exist: " + m_filePath);
+        return;
+    }
+    
+    m_metadata = m_editor.readMetadata(m_filePath);
+    
+    if (!m_editor.lastError().isEmpty()) {
+        qCWarning(lcMetadata) << "Failed to read metadata:" << m_editor.lastError();
+        QMessageBox::warning(this, "Error", 
+            "Failed to read metadata: " + m_editor.lastError());
+        return;
+    }
+    qCDebug(lcMetadata) << "Metadata read successfully";
+    
+    // Populate fields
+    ui->titleEdit->setText(m_metadata.title);
+    ui->artistEdit->setText(m_metadata.artist);
+    ui->albumEdit->setText(m_metadata.album);
+    ui->albumArtistEdit->setText(m_metadata.albumArtist);
+    ui->yearEdit->setText(m_metadata.year);
+    ui->genreEdit->setText(m_metadata.genre);
+    ui->trackNumberEdit->setText(m_metadata.trackNumber);
+    ui->commentEdit->setPlainText(m_metadata.comment);
+    
+    // Update file info with technical details
+    QString info = QString("<b>File:</b> %1<br>").arg(QFileInfo(m_filePath).fileName());
+    if (m_metadata.sampleRate > 0) {
+        info += QString("<b>Format:</b> %1 Hz, %2 bit, %3 channels")
+            .arg(m_metadata.sampleRate)
+            .arg(m_metadata.bitsPerSample)
+            .arg(m_metadata.channels);
+    }
+    ui->fileInfoLabel->setText(info);
+    
+    updateAlbumArtDisplay();
+}
+
+void MetadataEditorDialog::updateAlbumArtDisplay()
+{
+    if (!m_metadata.albumArt.isNull()) {
+        QPixmap pixmap = QPixmap::fromImage(m_metadata.albumArt);
+        QPixmap scaled = pixmap.scaled(200, 200, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+        ui->albumArtLabel->setPixmap(scaled);
+        ui->removeArtButton->setEnabled(true);
+    } else {
+        ui->albumArtLabel->clear();
+        ui->albumArtLabel->setText("No album art");
+        ui->removeArtButton->setEnabled(false);
+    }
+}
+
+void MetadataEditorDialog::onSaveClicked()
+{
+    // Update metadata structure
+    m_metadata.title = ui->titleEdit->text();
+    m_metadata.artist = ui->artistEdit->text();
+    m_metadata.album = ui->albumEdit->text();
+    m_metadata.albumArtist = ui->albumArtistEdit->text();
+    m_metadata.year = ui->yearEdit->text();
+    m_metadata.genre = ui->genreEdit->text();
+    m_metadata.trackNumber = ui->trackNumberEdit->text();
+    m_metadata.comment = ui->commentEdit->toPlainText();
+    
+    // Write to file
+    if (m_editor.writeMetadata(m_filePath, m_metadata)) {
+        QMessageBox::information(this, "Success", "Metadata saved successfully!");
+        accept();
+    } else {
+        QMessageBox::critical(this, "Error", 
+            "Failed to save metadata: " + m_editor.lastError());
+    }
+}
+
+void MetadataEditorDialog::onCancelClicked()
+{
+    reject();
+}
+
+void MetadataEditorDialog::onLoadAlbumArtClicked()
+{
+    QString fileName = QFileDialog::getOpenFileName(
+        this,
+        "Select Album Art",
+        "",
+        "Images (*.png *.jpg *.jpeg *.bmp);;All Files (*)"
+    );
+    
+    if (fileName.isEmpty()) {
+        return;
+    }
+    
+    QImage image(fileName);
+    if (image.isNull()) {
+        QMessageBox::warning(this, "Error", "Failed to load image file.");
+        return;
+    }
+    
+    // Resize if too large (keep under 1000x1000)
+    if (image.width() > 1000 || image.height() > 1000) {
+        image = image.scaled(1000, 1000, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    }
+    
+    m_metadata.albumArt = image;
+    updateAlbumArtDisplay();
+}
+
+void MetadataEditorDialog::onRemoveAlbumArtClicked()
+{
+    m_metadata.albumArt = QImage();
+    updateAlbumArtDisplay();
+}
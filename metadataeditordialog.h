@@ -0,0 +1,38 @@
+#ifndef METADATAEDITORDIALOG_H
+#define METADATAEDITORDIALOG_H
+
+#include <QDialog>
+#include "audiomanager.h"
+
+QT_BEGIN_NAMESPACE
+namespace Ui {
+class MetadataEditorDialog;
+}
+QT_END_NAMESPACE
+
+//UI dialog for metadata editing
+class MetadataEditorDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit MetadataEditorDialog(const QString &filePath, QWidget *parent = nullptr);
+    ~MetadataEditorDialog();
+
+private slots:
+    void onSaveClicked();
+    void onCancelClicked();
+    void onLoadAlbumArtClicked();
+    void onRemoveAlbumArtClicked();
+
+private:
+    void loadMetadata();
+    void updateAlbumArtDisplay();
+
+    Ui::MetadataEditorDialog *ui;
+    QString m_filePath;
+    MetadataEditor m_editor;
+    FlacMetadata m_metadata;
+};
+
+#endif // METADATAEDITORDIALOG_H
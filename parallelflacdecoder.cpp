@@ -0,0 +1,183 @@
+#include "parallelflacdecoder.h"
+#include <QMutexLocker>
+#include <algorithm>
+
+ParallelFlacDecoder::~ParallelFlacDecoder()
+{
+    close();
+}
+
+bool ParallelFlacDecoder::open(const QString &filePath, int threads)
+{
+    close();
+    if (!m_file.open(filePath)) {
+        m_lastError = m_file.lastError();
+        return false;
+    }
+    m_threads = std::max(1, threads);
+    m_pool.setMaxThreadCount(m_threads);
+
+    const qint64 begin = m_file.audioOffset();
+    const qint64 end = m_file.mappedSize();
+    const qint64 chunkBytes = std::clamp((end - begin) / (m_threads * 4), MinChunkBytes, MaxChunkBytes);
+    m_chunks.reserve(size_t((end - begin + chunkBytes - 1) / chunkBytes));
+    for (qint64 at = begin; at < end; at += chunkBytes) {
+        Chunk chunk;
+        chunk.begin = at;
+        chunk.end = std::min(end, at + chunkBytes);
+        m_chunks.push_back(std::move(chunk));
+    }
+    m_lastError.clear();
+
+    if (m_threads > 1) {
+        QMutexLocker locker(&m_mutex);
+        queueChunks();
+    }
+    return true;
+}
+
+void ParallelFlacDecoder::close()
+{
+    // Running chunks notice the flag between frames
+    m_cancelled = true;
+    m_pool.waitForDone();
+    m_cancelled = false;
+
+    m_chunks.clear();
+    m_file.close();
+    m_nextQueued = 0;
+    m_nextRead = 0;
+    std::fill(std::begin(m_planes), std::end(m_planes), nullptr);
+    m_chunkFirstSample = 0;
+    m_chunkGaps.clear();
+    m_nextSample = 0;
+    m_skippedFrames = 0;
+    m_finished = false;
+}
+
+int ParallelFlacDecoder::next()
+{
+    if (!m_file.mappedData()) {
+        m_lastError = "Not open";
+        return -1;
+    }
+    // The chunk handed out last time has been consumed
+    if (m_nextRead > 0) {
+        std::vector<std::vector<int32_t>>().swap(m_chunks[m_nextRead - 1].planes);
+    }
+
+    while (m_nextRead < m_chunks.size()) {
+        Chunk &chunk = m_chunks[m_nextRead];
+        if (m_threads > 1) {
+            QMutexLocker locker(&m_mutex);
+            while (!chunk.done) {
+                m_chunkDone.wait(&m_mutex);
+            }
+            ++m_nextRead;
+            queueChunks();
+        } else {
+            decodeChunk(chunk);
+            ++m_nextRead;
+        }
+
+        if (chunk.failed) {
+            m_lastError = chunk.error;
+            return -1;
+        }
+        m_skippedFrames += chunk.gaps;
+        // A range can hold nothing but the middle of one long frame
+        if (chunk.samples == 0) {
+            continue;
+        }
+        if (chunk.firstSample != m_nextSample) {
+            ++m_skippedFrames;
+        }
+        m_nextSample = chunk.endSample;
+        m_chunkFirstSample = chunk.firstSample;
+        m_chunkGaps.swap(chunk.holes);
+        for (size_t ch = 0; ch < chunk.planes.size(); ++ch) {
+            m_planes[ch] = chunk.planes[ch].data();
+        }
+        return int(chunk.samples);
+    }
+
+    m_chunkGaps.clear();
+    if (!m_finished) {
+        m_finished = true;
+        if (m_file.totalSamples() > 0 && m_nextSample < m_file.totalSamples()) {
+            ++m_skippedFrames;
+        }
+    }
+    return 0;
+}
+
+void ParallelFlacDecoder::queueChunks()
+{
+    while (m_nextQueued < m_chunks.size() && m_nextQueued < m_nextRead + size_t(m_threads) * 2) {
+        Chunk *chunk = &m_chunks[m_nextQueued++];
+        m_pool.start([this, chunk]() {
+            decodeChunk(*chunk);
+            QMutexLocker locker(&m_mutex);
+            chunk->done = true;
+            m_chunkDone.wakeAll();
+        });
+    }
+}
+
+void ParallelFlacDecoder::decodeChunk(Chunk &chunk) const
+{
+    // Every worker gets its own copy, decodeFrame keeps its error string in there
+    FlacFrameDecoder decoder = m_file.frameDecoder();
+    const uchar *map = m_file.mappedData();
+    const qint64 size = m_file.mappedSize();
+    const int channels = decoder.channels();
+    const int blockSize = decoder.maxBlockSize();
+
+    // Roughly what the range holds at 2:1 compression, grown as needed
+    const qint64 bytesPerSample = qint64(channels) * ((decoder.bitsPerSample() + 7) / 8);
+    size_t capacity = size_t(std::max<qint64>(blockSize, 2 * (chunk.end - chunk.begin) / std::max<qint64>(1, bytesPerSample)));
+    chunk.planes.assign(size_t(channels), std::vector<int32_t>(capacity));
+    int32_t *pointers[FlacFrameDecoder::MaxChannels];
+
+    // A range's first header can sit anywhere in it, the frame before belongs to the previous range
+    qint64 offset = m_file.nextSync(chunk.begin);
+    while (offset < chunk.end && !m_cancelled.load(std::memory_order_relaxed)) {
+        if (size_t(chunk.samples + blockSize) > capacity) {
+            capacity = std::max(capacity * 2, size_t(chunk.samples + blockSize));
+            for (std::vector<int32_t> &plane : chunk.planes) {
+                plane.resize(capacity);
+            }
+        }
+        for (int ch = 0; ch < channels; ++ch) {
+            pointers[ch] = chunk.planes[size_t(ch)].data() + chunk.samples;
+        }
+
+        // The last frame of a range usually runs on into the next one
+        FlacFrameDecoder::Frame frame;
+        const FlacFrameDecoder::Status status = decoder.decodeFrame(map + offset, size - offset, pointers,
+                                                                    blockSize, &frame);
+        if (status == FlacFrameDecoder::Ok) {
+            if (chunk.samples == 0) {
+                chunk.firstSample = frame.firstSample;
+            } else if (frame.firstSample != chunk.endSample) {
+                ++chunk.gaps;
+                chunk.holes.push_back({int(chunk.samples), frame.firstSample - chunk.endSample});
+            }
+            chunk.samples += frame.blockSize;
+            chunk.endSample = frame.firstSample + frame.blockSize;
+            offset += frame.bytes;
+            continue;
+        }
+        if (status == FlacFrameDecoder::Unsupported) {
+            chunk.failed = true;
+            chunk.error = decoder.lastError();
+            return;
+        }
+        // Damaged, or a sync code that wasn't a header. the CRCs tell them apart from real frames
+        offset = m_file.nextSync(offset + 1);
+    }
+    if (m_cancelled.load(std::memory_order_relaxed)) {
+        chunk.failed = true;
+        chunk.error = "Cancelled";
+    }
+}
@@ -0,0 +1,105 @@
+#ifndef PARALLELFLACDECODER_H
+#define PARALLELFLACDECODER_H
+
+#include "flacdecoder.h"
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <atomic>
+#include <vector>
+
+//FlacFileDecoder spread over several cores, for offline jobs that read a file start to end
+//(conversion, verification, loudness). the audio is cut into byte ranges and a range owns every
+//frame whose header starts inside it, so ranges decode independently of each other. the results
+//come back in file order, one chunk of consecutive frames at a time:
+//
+//  ParallelFlacDecoder decoder;
+//  if (decoder.open(path, threads)) {
+//      while ((frames = decoder.next()) > 0) {
+//          decoder.planes()[ch][0..frames), starting at decoder.chunkFirstSample()
+//      }
+//  }
+//
+//damaged frames are dropped like FlacFileDecoder drops them. they are counted by the gaps they
+//leave in the sample numbering, a run of damaged frames is one skipped frame, same as a stream
+//that ends short of STREAMINFO's length. with threads <= 1 everything runs on the caller's thread
+class ParallelFlacDecoder
+{
+public:
+    ParallelFlacDecoder() = default;
+    ~ParallelFlacDecoder();
+
+    ParallelFlacDecoder(const ParallelFlacDecoder &) = delete;
+    ParallelFlacDecoder &operator=(const ParallelFlacDecoder &) = delete;
+
+    //fails wherever FlacFileDecoder::open fails, so callers can fall back to libavcodec
+    bool open(const QString &filePath, int threads);
+    void close();
+
+    //where damaged frames left a hole in the current chunk: the planes run on at index at, the
+    //frames before it are missing
+    struct Gap {
+        int at = 0;
+        qint64 frames = 0;
+    };
+
+    //frames in the next chunk, 0 at the end of the stream, -1 on an error lastError() explains.
+    //the planes and gaps stay valid until the next call
+    int next();
+    const int32_t *const *planes() const { return m_planes; }
+    qint64 chunkFirstSample() const { return m_chunkFirstSample; }
+    const std::vector<Gap> &chunkGaps() const { return m_chunkGaps; }
+
+    int sampleRate() const { return m_file.sampleRate(); }
+    int channels() const { return m_file.channels(); }
+    int bitsPerSample() const { return m_file.bitsPerSample(); }
+    int maxBlockSize() const { return m_file.maxBlockSize(); }
+    qint64 totalSamples() const { return m_file.totalSamples(); }
+    int threads() const { return m_threads; }
+    int chunkCount() const { return int(m_chunks.size()); }
+    int skippedFrames() const { return m_skippedFrames; }
+    QString lastError() const { return m_lastError; }
+
+private:
+    // Byte sizes of the ranges, about four per thread so a slow range doesn't hold the rest up
+    static constexpr qint64 MinChunkBytes = 256 * 1024;
+    static constexpr qint64 MaxChunkBytes = 2 * 1024 * 1024;
+
+    struct Chunk {
+        qint64 begin = 0;           // Byte range of the frame headers it owns
+        qint64 end = 0;
+        std::vector<std::vector<int32_t>> planes;
+        qint64 firstSample = 0;
+        qint64 samples = 0;
+        qint64 endSample = 0;       // After the last frame, firstSample + samples without gaps
+        int gaps = 0;               // Runs of damaged frames inside the chunk
+        std::vector<Gap> holes;     // Where they are
+        bool done = false;          // Guarded by m_mutex
+        bool failed = false;
+        QString error;
+    };
+
+    //fills one chunk, only reads the map so any number of them run at once
+    void decodeChunk(Chunk &chunk) const;
+    //keeps up to two chunks per thread decoding ahead of the reader, call with m_mutex held
+    void queueChunks();
+
+    FlacFileDecoder m_file;
+    std::vector<Chunk> m_chunks;    // Sized in open(), workers hold references into it
+    size_t m_nextQueued = 0;
+    size_t m_nextRead = 0;
+    int m_threads = 1;
+    const int32_t *m_planes[FlacFrameDecoder::MaxChannels] = {};
+    qint64 m_chunkFirstSample = 0;
+    std::vector<Gap> m_chunkGaps;
+    qint64 m_nextSample = 0;        // Where the next chunk should start
+    int m_skippedFrames = 0;
+    bool m_finished = false;
+    std::atomic<bool> m_cancelled{false};
+    QMutex m_mutex;
+    QWaitCondition m_chunkDone;
+    QThreadPool m_pool;
+    QString m_lastError;
+};
+
+#endif // PARALLELFLACDECODER_H
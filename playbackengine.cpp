@@ -0,0 +1,1128 @@
+#include "playbackengine.h"
+#include "audiodecoder.h"
+#include "logging.h"
+#include <QAudioSink>
+#include <QMediaDevices>
+#include <QAudioDevice>
+#include <chrono>
+#include <cstring>
+
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+namespace {
+    qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Crossfade mixing granularity, short enough for the per-block gain ramp to be smooth
+    constexpr qint64 MixBlockFrames = 256;
+
+    AVSampleFormat toAVSampleFormat(QAudioFormat::SampleFormat format)
+    {
+        switch (format) {
+            case QAudioFormat::Int16:
+                return AV_SAMPLE_FMT_S16;
+            case QAudioFormat::Int32:
+                return AV_SAMPLE_FMT_S32;
+            case QAudioFormat::Float:
+                return AV_SAMPLE_FMT_FLT;
+            default:
+                return AV_SAMPLE_FMT_NONE;
+        }
+    }
+
+    // Sink format that holds the decoder's samples as they are, Unknown if there is none
+    QAudioFormat::SampleFormat nativeSampleFormat(AVSampleFormat format)
+    {
+        switch (av_get_packed_sample_fmt(format)) {
+            case AV_SAMPLE_FMT_S16:
+                return QAudioFormat::Int16;
+            case AV_SAMPLE_FMT_S32:
+                return QAudioFormat::Int32;
+            case AV_SAMPLE_FMT_FLT:
+                return QAudioFormat::Float;
+            default:
+                return QAudioFormat::Unknown;
+        }
+    }
+
+    QString sampleFormatName(QAudioFormat::SampleFormat format)
+    {
+        switch (format) {
+            case QAudioFormat::Int16:
+                return "16-bit";
+            case QAudioFormat::Int32:
+                return "32-bit";
+            case QAudioFormat::Float:
+                return "float";
+            default:
+                return "unknown";
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// DecoderThread
+
+DecoderThread::DecoderThread(std::unique_ptr<AudioDecoder> decoder, PlaybackShared &shared,
+                             const QAudioFormat &format, qint64 startFrame, QObject *parent)
+    : QThread(parent)
+    , m_decoder(std::move(decoder))
+    , m_shared(shared)
+    , m_format(format)
+    , m_startFrame(startFrame)
+{
+    // Sized once here, the mixing itself never allocates
+    m_mixIn.resize(size_t(MixBlockFrames) * format.channelCount());
+    m_mixOut.resize(size_t(MixBlockFrames) * format.channelCount());
+}
+
+DecoderThread::~DecoderThread()
+{
+    m_shared.stopRequested = true;
+    wait();
+    Resampler::release(m_swr);
+}
+
+void DecoderThread::setNext(std::unique_ptr<AudioDecoder> decoder, qint64 startMs, qint64 endMs)
+{
+    QMutexLocker locker(&m_nextMutex);
+    m_nextDecoder = std::move(decoder);
+    m_nextStartMs = startMs;
+    m_nextEndMs = endMs;
+    m_nextQueued.store(m_nextDecoder != nullptr, std::memory_order_relaxed);
+}
+
+void DecoderThread::clearNext()
+{
+    QMutexLocker locker(&m_nextMutex);
+    m_nextDecoder.reset();
+    m_nextQueued.store(false, std::memory_order_relaxed);
+}
+
+bool DecoderThread::initResampler()
+{
+    AVChannelLayout outLayout;
+    av_channel_layout_default(&outLayout, m_format.channelCount());
+
+    m_swr = Resampler::acquire(&outLayout, toAVSampleFormat(m_format.sampleFormat()), m_format.sampleRate(),
+                               m_decoder->channelLayout(), m_decoder->sampleFormat(), m_decoder->sampleRate(),
+                               m_shared.resamplerProfile);
+    av_channel_layout_uninit(&outLayout);
+
+    if (!m_swr) {
+        m_error = "Failed to initialize resampler";
+        return false;
+    }
+    m_passthrough = canPassThrough(*m_decoder);
+    return true;
+}
+
+bool DecoderThread::canPassThrough(const AudioDecoder &decoder) const
+{
+    return decoder.sampleRate() == m_format.sampleRate()
+        && decoder.channels() == m_format.channelCount()
+        && nativeSampleFormat(decoder.sampleFormat()) == m_format.sampleFormat();
+}
+
+//integer copy of a frame already in the sink's sample format, only interleaving is left to do
+void DecoderThread::copyNative(const AVFrame *frame, char *out) const
+{
+    const AVSampleFormat format = static_cast<AVSampleFormat>(frame->format);
+    const int channels = frame->ch_layout.nb_channels;
+    const size_t frames = static_cast<size_t>(frame->nb_samples);
+    if (!av_sample_fmt_is_planar(format)) {
+        std::memcpy(out, frame->extended_data[0], frames * size_t(m_shared.bytesPerFrame));
+    } else if (av_get_bytes_per_sample(format) == 2) {
+        Dsp::interleave16(reinterpret_cast<const int16_t *const *>(frame->extended_data), channels, frames,
+                          reinterpret_cast<int16_t *>(out));
+    } else {
+        // S32P and FLTP, floats are copied as their bit patterns
+        Dsp::interleave32(reinterpret_cast<const int32_t *const *>(frame->extended_data), channels, frames,
+                          reinterpret_cast<int32_t *>(out));
+    }
+}
+
+qint64 DecoderThread::sourceEndFrame() const
+{
+    if (m_endFrame >= 0) {
+        return m_endFrame;
+    }
+    qint64 samples = m_decoder->totalSamples();
+    return samples > 0 ? av_rescale(samples, m_shared.sampleRate, m_decoder->sampleRate()) : -1;
+}
+
+void DecoderThread::run()
+{
+    if (!initResampler()) {
+        m_shared.decodeFinished = true;
+        return;
+    }
+
+    // Poll interval while the ring is full, an eighth of its depth keeps it topped up
+    const qint64 ringMs = qint64(m_shared.ring.capacity()) * 1000 / (qint64(m_shared.bytesPerFrame) * m_shared.sampleRate);
+    const unsigned long idleUs = static_cast<unsigned long>(qBound<qint64>(1000, ringMs * 1000 / 8, 20000));
+
+    m_sourceEndFrame = sourceEndFrame();
+    if (m_startFrame > 0) {
+        handleSeek(m_startFrame, 0);
+    }
+
+    bool inputDone = false;
+    while (!m_shared.stopRequested.load(std::memory_order_relaxed)) {
+        qint64 target = m_shared.seekTargetFrame.exchange(-1, std::memory_order_acq_rel);
+        if (target >= 0) {
+            handleSeek(target, m_shared.seekRequestNs.load(std::memory_order_relaxed));
+            inputDone = false;
+            continue;
+        }
+
+        // Push whatever is converted first, only decode more once it is all queued
+        if (m_pendingOffset < m_pending.size()) {
+            m_pendingOffset += m_shared.ring.write(m_pending.constData() + m_pendingOffset,
+                                                   static_cast<size_t>(m_pending.size() - m_pendingOffset));
+            if (m_pendingOffset < m_pending.size()) {
+                usleep(idleUs);
+            }
+            continue;
+        }
+        m_pending.resize(0);
+        m_pendingOffset = 0;
+
+        if (inputDone) {
+            // The next source ended inside the fade, the rest of the outgoing tail fades out alone
+            if (m_fadingIn) {
+                fadeOutRemainingTail();
+                continue;
+            }
+            // Everything of the current source is queued, carry straight on with the next one
+            if (switchToNext()) {
+                inputDone = false;
+                continue;
+            }
+            // Next source withdrawn after the tail was held back, play it as it is
+            if (!m_tail.isEmpty()) {
+                m_pending.append(m_tail);
+                m_tail.resize(0);
+                continue;
+            }
+            m_shared.decodeFinished.store(true, std::memory_order_release);
+            usleep(idleUs);
+            continue;
+        }
+
+        AVFrame *frame = m_decoder->decodeNextFrame();
+        if (!frame) {
+            drainResampler();
+            inputDone = true;
+            continue;
+        }
+        convertFrame(frame);
+        if (m_endFrame >= 0 && m_outFrame >= m_endFrame) {
+            inputDone = true;   // Ranged source (cue track) is complete
+        }
+    }
+}
+
+bool DecoderThread::switchToNext()
+{
+    std::unique_ptr<AudioDecoder> next;
+    qint64 startMs = 0;
+    qint64 endMs = 0;
+    {
+        QMutexLocker locker(&m_nextMutex);
+        if (!m_nextDecoder) {
+            return false;
+        }
+        // A bit-perfect sink can't take another format, that source gets its own pipeline
+        if (m_shared.bitPerfect && !canPassThrough(*m_nextDecoder)) {
+            return false;
+        }
+        next = std::move(m_nextDecoder);
+        startMs = m_nextStartMs;
+        endMs = m_nextEndMs;
+        m_nextQueued.store(false, std::memory_order_relaxed);
+    }
+
+    // The new source is converted to the running sink format, whatever its own rate and layout
+    m_decoder = std::move(next);
+    Resampler::release(m_swr);
+    if (!initResampler()) {
+        qCWarning(lcPlayback) << "Gapless hand-over failed:" << m_error;
+        return false;
+    }
+
+    const qint64 startFrame = startMs * m_shared.sampleRate / 1000;
+    m_endFrame = endMs > 0 ? endMs * m_shared.sampleRate / 1000 : -1;
+    m_sourceEndFrame = sourceEndFrame();
+    m_outFrame = startFrame;
+    m_trimTargetFrame = -1;
+    if (startFrame > 0 && m_decoder->seek(av_rescale(startFrame, m_decoder->sampleRate(), m_shared.sampleRate))) {
+        m_trimTargetFrame = startFrame;
+    }
+
+    // A held back tail is mixed under the first frames of the new source
+    m_fadingIn = !m_tail.isEmpty();
+    m_tailMixed = 0;
+    m_fadeCurve = static_cast<Dsp::FadeCurve>(m_shared.crossfadeCurve.load(std::memory_order_relaxed));
+
+    // Nothing of the new source is in the ring yet, so it starts exactly at the write index
+    m_shared.transitionBaseFrame.store(startFrame, std::memory_order_relaxed);
+    m_shared.transitionMark.store(m_shared.ring.writeIndex(), std::memory_order_relaxed);
+    m_shared.transitionSerial.fetch_add(1, std::memory_order_release);
+    m_shared.decodeFinished.store(false, std::memory_order_relaxed);
+    return true;
+}
+
+void DecoderThread::handleSeek(qint64 targetFrame, qint64 requestNs)
+{
+    const qint64 sourceSample = av_rescale(targetFrame, m_decoder->sampleRate(), m_shared.sampleRate);
+    if (!m_decoder->seek(sourceSample)) {
+        qCWarning(lcPlayback) << "Seek to frame" << targetFrame << "failed:" << m_decoder->lastError();
+        m_shared.seekInFlight = false;
+        return;
+    }
+
+    // Drop the resampler's delay line along with everything queued from the old position
+    swr_init(m_swr);
+    m_pending.resize(0);
+    m_pendingOffset = 0;
+    m_trimTargetFrame = targetFrame;
+    m_outFrame = targetFrame;
+    m_tail.resize(0);
+    m_tailMixed = 0;
+    m_fadingIn = false;
+
+    m_shared.decodeFinished.store(false, std::memory_order_relaxed);
+    m_shared.baseFrame.store(targetFrame, std::memory_order_relaxed);
+    if (requestNs > 0) {
+        m_shared.latencyKind.store(PlaybackEngine::SeekLatency, std::memory_order_relaxed);
+        m_shared.latencyDecodedNs.store(0, std::memory_order_relaxed);
+        m_shared.latencyStartNs.store(requestNs, std::memory_order_relaxed);
+        m_stampDecoded = true;
+    }
+    // Publishes the stores above to the audio thread
+    m_shared.ring.discardWritten();
+}
+
+bool DecoderThread::convertFrame(const AVFrame *frame)
+{
+    const int bytesPerFrame = m_shared.bytesPerFrame;
+    const int maxOut = swr_get_out_samples(m_swr, frame->nb_samples);
+    if (maxOut <= 0) {
+        return false;
+    }
+
+    // Output position of this frame, only needed to trim the first frames after a seek
+    qint64 frameOut = -1;
+    if (m_trimTargetFrame >= 0) {
+        qint64 start = m_decoder->frameStartSample(frame);
+        frameOut = start >= 0 ? av_rescale(start, m_shared.sampleRate, m_decoder->sampleRate()) : m_trimTargetFrame;
+    }
+
+    const qsizetype oldSize = m_pending.size();
+    int converted = frame->nb_samples;
+    if (m_passthrough) {
+        m_pending.resize(oldSize + qsizetype(converted) * bytesPerFrame);
+        copyNative(frame, m_pending.data() + oldSize);
+    } else {
+        m_pending.resize(oldSize + qsizetype(maxOut) * bytesPerFrame);
+        uint8_t *out = reinterpret_cast<uint8_t *>(m_pending.data() + oldSize);
+        converted = swr_convert(m_swr, &out, maxOut,
+                                const_cast<const uint8_t **>(frame->extended_data), frame->nb_samples);
+        if (converted < 0) {
+            m_pending.resize(oldSize);
+            return false;
+        }
+        m_pending.resize(oldSize + qsizetype(converted) * bytesPerFrame);
+    }
+
+    if (m_trimTargetFrame >= 0) {
+        qint64 drop = m_trimTargetFrame - frameOut;
+        if (drop >= converted) {
+            m_pending.resize(oldSize);   // Entirely before the target, keep trimming
+            return true;
+        }
+        if (drop > 0) {
+            m_pending.remove(oldSize, drop * bytesPerFrame);
+        }
+        m_trimTargetFrame = -1;
+    }
+
+    finishChunk(oldSize);
+    return true;
+}
+
+//cuts, holds back or mixes the frames just appended to m_pending from chunkStart on
+void DecoderThread::finishChunk(qsizetype chunkStart)
+{
+    const int bytesPerFrame = m_shared.bytesPerFrame;
+
+    // Ranged sources stop exactly on their end frame
+    qint64 produced = (m_pending.size() - chunkStart) / bytesPerFrame;
+    if (m_endFrame >= 0 && m_outFrame + produced > m_endFrame) {
+        produced = qMax<qint64>(m_endFrame - m_outFrame, 0);
+        m_pending.resize(chunkStart + produced * bytesPerFrame);
+    }
+
+    if (m_fadingIn) {
+        mixTail(chunkStart);
+    } else {
+        // Everything from the fade start on waits in m_tail for the next source. Once holding
+        // has started it carries on, even if the next source is withdrawn, to keep the order
+        const qint64 fadeFrames = m_shared.crossfadeFrames.load(std::memory_order_relaxed);
+        qint64 holdFrom = produced;
+        if (!m_tail.isEmpty()) {
+            holdFrom = 0;
+        } else if (fadeFrames > 0 && m_sourceEndFrame > 0 && m_nextQueued.load(std::memory_order_relaxed)) {
+            holdFrom = qBound<qint64>(0, m_sourceEndFrame - fadeFrames - m_outFrame, produced);
+        }
+        if (holdFrom < produced) {
+            if (m_tail.isEmpty()) {
+                m_tail.reserve(fadeFrames * bytesPerFrame);
+            }
+            m_tail.append(m_pending.constData() + chunkStart + holdFrom * bytesPerFrame,
+                          (produced - holdFrom) * bytesPerFrame);
+            m_pending.resize(chunkStart + holdFrom * bytesPerFrame);
+        }
+    }
+    m_outFrame += produced;
+
+    // Published to the audio thread by the ring write that carries this chunk
+    if (m_stampDecoded && produced > 0) {
+        m_stampDecoded = false;
+        m_shared.latencyDecodedNs.store(nowNs(), std::memory_order_relaxed);
+    }
+}
+
+//mixes m_pending from offset on with the unmixed part of the held back tail
+void DecoderThread::mixTail(qsizetype offset)
+{
+    const int bytesPerFrame = m_shared.bytesPerFrame;
+    const int channels = m_format.channelCount();
+    const QAudioFormat::SampleFormat format = m_format.sampleFormat();
+    const qint64 tailFrames = m_tail.size() / bytesPerFrame;
+
+    qint64 frames = qMin<qint64>((m_pending.size() - offset) / bytesPerFrame, tailFrames - m_tailMixed);
+    char *incoming = m_pending.data() + offset;
+    const char *outgoing = m_tail.constData() + m_tailMixed * bytesPerFrame;
+    while (frames > 0) {
+        const qint64 block = qMin(frames, MixBlockFrames);
+        const size_t samples = size_t(block) * channels;
+        const float t0 = float(m_tailMixed) / tailFrames;
+        const float t1 = float(m_tailMixed + block) / tailFrames;
+
+        Dsp::toFloat(format, incoming, m_mixIn.data(), samples);
+        Dsp::toFloat(format, outgoing, m_mixOut.data(), samples);
+        Dsp::crossfade(m_mixIn.data(), m_mixOut.data(), size_t(block), channels,
+                       Dsp::fadeInGain(m_fadeCurve, t0), Dsp::fadeInGain(m_fadeCurve, t1),
+                       Dsp::fadeOutGain(m_fadeCurve, t0), Dsp::fadeOutGain(m_fadeCurve, t1));
+        Dsp::fromFloat(format, m_mixIn.data(), incoming, samples, &m_dither);
+
+        incoming += block * bytesPerFrame;
+        outgoing += block * bytesPerFrame;
+        m_tailMixed += block;
+        frames -= block;
+    }
+
+    if (m_tailMixed >= tailFrames) {
+        m_tail.resize(0);   // Keeps its capacity for the next fade
+        m_tailMixed = 0;
+        m_fadingIn = false;
+    }
+}
+
+void DecoderThread::fadeOutRemainingTail()
+{
+    // Mixed against silence, only called with nothing pending
+    const qint64 remaining = m_tail.size() / m_shared.bytesPerFrame - m_tailMixed;
+    m_pending.resize(remaining * m_shared.bytesPerFrame);
+    std::memset(m_pending.data(), 0, static_cast<size_t>(m_pending.size()));
+    mixTail(0);
+}
+
+void DecoderThread::drainResampler()
+{
+    if (m_passthrough) {
+        return;     // Nothing buffered outside the decoder
+    }
+    const int bytesPerFrame = m_shared.bytesPerFrame;
+    const int maxOut = swr_get_out_samples(m_swr, 0);
+    if (maxOut <= 0) {
+        return;
+    }
+
+    const qsizetype oldSize = m_pending.size();
+    m_pending.resize(oldSize + qsizetype(maxOut) * bytesPerFrame);
+    uint8_t *out = reinterpret_cast<uint8_t *>(m_pending.data() + oldSize);
+    int converted = swr_convert(m_swr, &out, maxOut, nullptr, 0);
+    m_pending.resize(oldSize + qsizetype(qMax(converted, 0)) * bytesPerFrame);
+    finishChunk(oldSize);
+}
+
+// ---------------------------------------------------------------------------
+// PcmPullDevice
+
+PcmPullDevice::PcmPullDevice(PlaybackShared &shared, const QAudioFormat &format, QObject *parent)
+    : QIODevice(parent)
+    , m_shared(shared)
+    , m_format(format)
+{
+    if (m_shared.equalizer) {
+        m_eqScratch.resize(size_t(MixBlockFrames) * size_t(format.channelCount()));
+    }
+}
+
+//runs the equalizer over sink samples in place, a block at a time through the float scratch
+void PcmPullDevice::equalize(char *data, qint64 bytes)
+{
+    const int channels = m_format.channelCount();
+    if (!m_shared.equalizer->update(channels)) {
+        return;
+    }
+    const QAudioFormat::SampleFormat format = m_format.sampleFormat();
+    const int bytesPerFrame = m_shared.bytesPerFrame;
+    qint64 frames = bytes / bytesPerFrame;
+    while (frames > 0) {
+        const qint64 block = qMin(frames, MixBlockFrames);
+        const size_t samples = size_t(block) * channels;
+        Dsp::toFloat(format, data, m_eqScratch.data(), samples);
+        m_shared.equalizer->process(m_eqScratch.data(), size_t(block));
+        Dsp::fromFloat(format, m_eqScratch.data(), data, samples, &m_dither);
+        data += block * bytesPerFrame;
+        frames -= block;
+    }
+}
+
+qint64 PcmPullDevice::readData(char *data, qint64 maxSize)
+{
+    const int bytesPerFrame = m_shared.bytesPerFrame;
+    const qint64 wanted = maxSize - maxSize % bytesPerFrame;
+    if (wanted <= 0) {
+        return 0;
+    }
+
+    bool discarded = false;
+    const qint64 got = static_cast<qint64>(m_shared.ring.read(data, static_cast<size_t>(wanted), &discarded));
+    if (discarded) {
+        m_shared.framesConsumed.store(0, std::memory_order_relaxed);
+        m_shared.drained.store(false, std::memory_order_relaxed);
+        m_shared.seekInFlight.store(false, std::memory_order_release);
+    }
+
+    // Gapless hand-over: once the read passes the transition mark the timeline restarts
+    // at the next source, only the frames after the mark count towards it
+    qint64 framesPlayed = got / bytesPerFrame;
+    const unsigned transition = m_shared.transitionSerial.load(std::memory_order_acquire);
+    if (transition != m_seenTransitionSerial) {
+        const size_t readEnd = m_shared.ring.readIndex();
+        const size_t mark = m_shared.transitionMark.load(std::memory_order_relaxed);
+        const std::ptrdiff_t pastMark = static_cast<std::ptrdiff_t>(readEnd - mark);
+        if (pastMark >= 0) {
+            m_seenTransitionSerial = transition;
+            if (!discarded) {
+                m_shared.baseFrame.store(m_shared.transitionBaseFrame.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                m_shared.framesConsumed.store(0, std::memory_order_relaxed);
+                framesPlayed = qMin<qint64>(pastMark, got) / bytesPerFrame;
+            }
+            m_shared.transitionsPlayed.store(transition, std::memory_order_release);
+        }
+    }
+
+    if (got > 0) {
+        if (m_shared.equalizer) {
+            equalize(data, got);
+        }
+        if (m_shared.tap && m_shared.tap->isEnabled()) {
+            m_shared.tap->push(m_format, data, got / bytesPerFrame);
+        }
+        m_shared.framesConsumed.fetch_add(framesPlayed, std::memory_order_relaxed);
+
+        qint64 requested = m_shared.latencyStartNs.exchange(0, std::memory_order_acq_rel);
+        if (requested > 0) {
+            m_shared.lastLatencyKind.store(m_shared.latencyKind.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            m_shared.lastLatencyRequestNs.store(requested, std::memory_order_relaxed);
+            m_shared.lastLatencyDecodedNs.store(m_shared.latencyDecodedNs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            m_shared.lastLatencyOutputNs.store(nowNs(), std::memory_order_relaxed);
+            m_shared.latencySerial.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    if (got == wanted) {
+        return got;
+    }
+
+    // Short read at the end of the stream, 0 once everything has been played
+    if (m_shared.decodeFinished.load(std::memory_order_acquire) && m_shared.ring.available() == 0) {
+        if (got == 0 && !m_shared.seekInFlight.load(std::memory_order_relaxed)) {
+            m_shared.drained.store(true, std::memory_order_relaxed);
+        }
+        return got;
+    }
+
+    // Underrun: pad with silence so the sink keeps its clock running
+    std::memset(data + got, 0, static_cast<size_t>(wanted - got));
+    m_shared.underruns.fetch_add(1, std::memory_order_relaxed);
+    return wanted;
+}
+
+// ---------------------------------------------------------------------------
+// PlaybackEngine
+
+PlaybackEngine::PlaybackEngine(QObject *parent)
+    : QObject(parent)
+{
+    m_pollTimer.setInterval(30);
+    connect(&m_pollTimer, &QTimer::timeout, this, &PlaybackEngine::poll);
+    m_openPool.setMaxThreadCount(1);
+}
+
+PlaybackEngine::~PlaybackEngine()
+{
+    // Opens still queued see the new serial and skip, a running one finishes before the engine goes
+    ++m_sourceSerial;
+    ++m_nextSerial;
+    m_openPool.waitForDone();
+    stopPipeline();
+}
+
+void PlaybackEngine::setSource(const QUrl &source)
+{
+    stopPipeline();
+    m_idleDecoder.reset();
+    ++m_sourceSerial;
+    m_sourceOpening = false;
+    m_playWhenOpened = false;
+    clearNextSource();
+    m_source = source;
+    m_startPositionMs = 0;
+    m_lastReportedPosition = -1;
+    setState(QMediaPlayer::StoppedState);
+
+    if (source.isEmpty()) {
+        m_duration = 0;
+        emit durationChanged(0);
+        setStatus(QMediaPlayer::NoMedia);
+        return;
+    }
+
+    // LoadedMedia and the duration follow from onSourceOpened()
+    setStatus(QMediaPlayer::LoadingMedia);
+    requestSourceDecoder(false);
+}
+
+void PlaybackEngine::setNextSource(const QUrl &source, qint64 startMs, qint64 endMs)
+{
+    clearNextSource();
+    if (source.isEmpty()) {
+        return;
+    }
+
+    m_next = QueuedSource{source, startMs, endMs, 0};
+    m_hasNext = true;
+    requestNextDecoder();
+}
+
+void PlaybackEngine::clearNextSource()
+{
+    m_hasNext = false;
+    ++m_nextSerial;
+    m_nextOpening = false;
+    m_nextDecoder.reset();
+    if (m_decoderThread) {
+        m_decoderThread->clearNext();
+    }
+}
+
+//opens filePath on the pool and hands the decoder (null with the error when it can't be opened)
+//to done on the GUI thread. requests that went stale while queued are skipped
+void PlaybackEngine::openOnPool(const QString &filePath, std::function<bool()> stale, OpenedCallback done)
+{
+    m_openPool.start([this, filePath, stale, done]() {
+        if (stale()) {
+            return;
+        }
+        // Shared so the decoder is freed even when the engine is gone before the call is delivered
+        auto decoder = std::make_shared<std::unique_ptr<AudioDecoder>>(std::make_unique<AudioDecoder>());
+        qint64 durationMs = 0;
+        QString error;
+        if ((*decoder)->open(filePath)) {
+            const qint64 samples = (*decoder)->totalSamples();
+            durationMs = samples > 0 ? samples * 1000 / (*decoder)->sampleRate() : 0;
+        } else {
+            error = (*decoder)->lastError();
+            decoder->reset();
+        }
+        QMetaObject::invokeMethod(this, [decoder, durationMs, error, done]() {
+            done(std::move(*decoder), durationMs, error);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void PlaybackEngine::requestSourceDecoder(bool playWhenOpened)
+{
+    m_playWhenOpened = playWhenOpened;
+    if (m_sourceOpening) {
+        return; // The open in flight serves this request as well
+    }
+    const unsigned serial = m_sourceSerial.load(std::memory_order_relaxed);
+    m_sourceOpening = true;
+    openOnPool(m_source.toLocalFile(), [this, serial]() { return m_sourceSerial.load(std::memory_order_relaxed) != serial; },
+               [this, serial](std::unique_ptr<AudioDecoder> decoder, qint64 durationMs, const QString &error) {
+                   onSourceOpened(serial, std::move(decoder), durationMs, error);
+               });
+}
+
+void PlaybackEngine::onSourceOpened(unsigned serial, std::unique_ptr<AudioDecoder> decoder, qint64 durationMs,
+                                    const QString &error)
+{
+    if (serial != m_sourceSerial.load(std::memory_order_relaxed)) {
+        return; // Another source was set meanwhile
+    }
+    m_sourceOpening = false;
+    const bool playNow = m_playWhenOpened;
+    m_playWhenOpened = false;
+    if (!decoder) {
+        setState(QMediaPlayer::StoppedState);
+        fail(QMediaPlayer::ResourceError, error);
+        return;
+    }
+
+    m_idleDecoder = std::move(decoder);
+    // Reopening after stop() or for a restart, the source is loaded already
+    if (m_status == QMediaPlayer::LoadingMedia) {
+        m_duration = durationMs;
+        emit durationChanged(m_duration);
+        emit positionChanged(m_startPositionMs);
+        setStatus(QMediaPlayer::LoadedMedia);
+    }
+    if (playNow && !startPipeline(m_startPositionMs)) {
+        setState(QMediaPlayer::StoppedState);
+    }
+}
+
+void PlaybackEngine::requestNextDecoder()
+{
+    const unsigned serial = m_nextSerial.load(std::memory_order_relaxed);
+    m_nextOpening = true;
+    openOnPool(m_next.url.toLocalFile(), [this, serial]() { return m_nextSerial.load(std::memory_order_relaxed) != serial; },
+               [this, serial](std::unique_ptr<AudioDecoder> decoder, qint64 durationMs, const QString &error) {
+                   onNextDecoderOpened(serial, std::move(decoder), durationMs, error);
+               });
+}
+
+void PlaybackEngine::onNextDecoderOpened(unsigned serial, std::unique_ptr<AudioDecoder> decoder, qint64 durationMs,
+                                         const QString &error)
+{
+    if (serial != m_nextSerial.load(std::memory_order_relaxed)) {
+        return; // Replaced or cleared meanwhile
+    }
+    m_nextOpening = false;
+    if (!decoder) {
+        // Not playable, the usual end of media handling takes over
+        qCWarning(lcPlayback) << "Cannot pre-open next source" << m_next.url << error;
+        m_hasNext = false;
+        return;
+    }
+
+    m_next.durationMs = durationMs;
+    if (m_decoderThread) {
+        m_decoderThread->setNext(std::move(decoder), m_next.startMs, m_next.endMs);
+    } else {
+        m_nextDecoder = std::move(decoder);
+    }
+}
+
+bool PlaybackEngine::transitionPending() const
+{
+    return m_shared && m_shared->transitionSerial.load(std::memory_order_acquire)
+                       != m_shared->transitionsPlayed.load(std::memory_order_acquire);
+}
+
+void PlaybackEngine::play()
+{
+    if (m_status == QMediaPlayer::NoMedia || m_status == QMediaPlayer::InvalidMedia) {
+        return;
+    }
+    if (m_state == QMediaPlayer::PlayingState) {
+        return;
+    }
+    if (m_state == QMediaPlayer::PausedState && m_sink) {
+        // Resuming plays what is already queued, so there is no decode stage to time
+        m_shared->latencyKind.store(StartLatency, std::memory_order_relaxed);
+        m_shared->latencyDecodedNs.store(0, std::memory_order_relaxed);
+        m_shared->latencyStartNs.store(nowNs(), std::memory_order_release);
+        m_sink->resume();
+        m_pollTimer.start();
+        setState(QMediaPlayer::PlayingState);
+        return;
+    }
+    if (!m_idleDecoder) {
+        // Still opening, or its decoder went with the last pipeline. playing starts once it is open
+        requestSourceDecoder(true);
+        setState(QMediaPlayer::PlayingState);
+        return;
+    }
+    if (!startPipeline(m_startPositionMs)) {
+        return;
+    }
+    setState(QMediaPlayer::PlayingState);
+}
+
+void PlaybackEngine::pause()
+{
+    if (m_state != QMediaPlayer::PlayingState) {
+        return;
+    }
+    if (m_sink) {
+        m_sink->suspend();
+    }
+    // Without a sink the source is still opening, it stays open but doesn't start
+    m_playWhenOpened = false;
+    setState(QMediaPlayer::PausedState);
+}
+
+void PlaybackEngine::stop()
+{
+    stopPipeline();
+    m_startPositionMs = 0;
+    m_playWhenOpened = false;
+    setState(QMediaPlayer::StoppedState);
+    if (m_status != QMediaPlayer::NoMedia && m_status != QMediaPlayer::InvalidMedia
+        && m_status != QMediaPlayer::LoadingMedia) {
+        setStatus(QMediaPlayer::LoadedMedia);
+    }
+    m_lastReportedPosition = 0;
+    emit positionChanged(0);
+}
+
+void PlaybackEngine::setPosition(qint64 position)
+{
+    position = qMax<qint64>(position, 0);
+    if (m_duration > 0) {
+        position = qMin(position, m_duration);
+    }
+
+    // The next source is already spliced into the queue, only a restart gets back to this one.
+    // paused, the reopened source waits for play()
+    if (transitionPending()) {
+        const bool playing = (m_state == QMediaPlayer::PlayingState);
+        stopPipeline();
+        m_startPositionMs = position;
+        requestSourceDecoder(playing);
+        m_lastReportedPosition = position;
+        emit positionChanged(position);
+        return;
+    }
+
+    if (m_shared) {
+        m_seekTargetMs = position;
+        m_shared->seekInFlight.store(true, std::memory_order_relaxed);
+        m_shared->seekRequestNs.store(nowNs(), std::memory_order_relaxed);
+        m_shared->seekTargetFrame.store(position * m_shared->sampleRate / 1000, std::memory_order_release);
+    } else {
+        m_startPositionMs = position;
+    }
+
+    m_lastReportedPosition = position;
+    emit positionChanged(position);
+}
+
+qint64 PlaybackEngine::position() const
+{
+    if (!m_shared) {
+        return m_startPositionMs;
+    }
+    if (m_shared->seekInFlight.load(std::memory_order_acquire)) {
+        return m_seekTargetMs;
+    }
+
+    const qint64 base = m_shared->baseFrame.load(std::memory_order_relaxed);
+    qint64 frames = base + m_shared->framesConsumed.load(std::memory_order_relaxed);
+
+    // What the sink holds hasn't been heard yet
+    if (m_sink) {
+        frames -= qMax<qint64>(m_sink->bufferSize() - m_sink->bytesFree(), 0) / m_shared->bytesPerFrame;
+    }
+    return qMax(frames, base) * 1000 / m_shared->sampleRate;
+}
+
+void PlaybackEngine::setVolume(float volume)
+{
+    const bool wasUnity = (m_volume >= 1.0f);
+    m_volume = volume;
+    if (m_sink) {
+        m_sink->setVolume(volume);
+        // Attenuation scales the samples, say so rather than silently dropping bit-perfect
+        if (m_bitPerfectActive && wasUnity != (volume >= 1.0f)) {
+            reportBitPerfect();
+        }
+    }
+}
+
+void PlaybackEngine::setBufferDuration(int ms)
+{
+    m_bufferMs = qBound(20, ms, 10000);
+}
+
+void PlaybackEngine::setCrossfade(int ms, Dsp::FadeCurve curve)
+{
+    m_crossfadeMs = qBound(0, ms, 12000);
+    m_crossfadeCurve = curve;
+    if (m_shared) {
+        m_shared->crossfadeCurve.store(static_cast<int>(curve), std::memory_order_relaxed);
+        // Mixing two sources is exactly what bit-perfect output rules out
+        const qint64 frames = m_bitPerfectActive ? 0 : qint64(m_crossfadeMs) * m_shared->sampleRate / 1000;
+        m_shared->crossfadeFrames.store(frames, std::memory_order_relaxed);
+    }
+}
+
+void PlaybackEngine::setBitPerfect(bool enabled)
+{
+    m_bitPerfect = enabled;
+    if (!enabled) {
+        m_bitPerfectIssue.clear();
+    }
+}
+
+int PlaybackEngine::underrunCount() const
+{
+    return m_shared ? m_shared->underruns.load(std::memory_order_relaxed) : 0;
+}
+
+bool PlaybackEngine::startPipeline(qint64 startMs)
+{
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    const QAudioFormat format = negotiateFormat(device, *m_idleDecoder);
+    m_format = format;
+
+    m_shared = std::make_unique<PlaybackShared>();
+    m_seenLatencySerial = 0;
+    m_seenTransitions = 0;
+    m_shared->bytesPerFrame = format.bytesPerFrame();
+    m_shared->sampleRate = format.sampleRate();
+    m_shared->bitPerfect = m_bitPerfectActive;
+    m_shared->resamplerProfile = m_resamplerProfile;
+    m_shared->ring.reset(static_cast<size_t>(format.bytesForDuration(qint64(m_bufferMs) * 1000)));
+    m_shared->crossfadeCurve = static_cast<int>(m_crossfadeCurve);
+    m_shared->crossfadeFrames = m_bitPerfectActive ? 0 : qint64(m_crossfadeMs) * format.sampleRate() / 1000;
+    if (!m_bitPerfectActive) {
+        m_equalizer.setFormat(format.sampleRate(), format.channelCount());
+        m_shared->equalizer = &m_equalizer;
+    }
+    m_tap.setSampleRate(format.sampleRate());
+    m_shared->tap = &m_tap;
+
+    const qint64 startFrame = startMs * format.sampleRate() / 1000;
+    m_shared->baseFrame = startFrame;
+    m_shared->latencyKind = StartLatency;
+    m_shared->latencyStartNs = nowNs();
+
+    m_decoderThread = new DecoderThread(std::move(m_idleDecoder), *m_shared, format, startFrame, this);
+    if (m_hasNext) {
+        // The previous pipeline took its pre-opened decoder with it, so that one is opened again
+        if (m_nextDecoder) {
+            m_decoderThread->setNext(std::move(m_nextDecoder), m_next.startMs, m_next.endMs);
+        } else if (!m_nextOpening) {
+            requestNextDecoder();
+        }
+    }
+    m_decoderThread->start(QThread::HighPriority);
+
+    m_device = new PcmPullDevice(*m_shared, format, this);
+    m_device->open(QIODevice::ReadOnly);
+
+    m_sink = new QAudioSink(device, format, this);
+    m_sink->setVolume(m_volume);
+    m_sink->start(m_device);
+    if (m_sink->error() != QAudio::NoError) {
+        stopPipeline();
+        fail(QMediaPlayer::ResourceError, "Audio output could not be started");
+        return false;
+    }
+    // What the sink has pulled but not played yet, the spectrum display looks that far back
+    m_tap.setDelayFrames(int(m_sink->bufferSize() / format.bytesPerFrame()));
+
+    qCDebug(lcPlayback) << "Native pipeline started:" << format << "buffer" << m_bufferMs << "ms"
+                        << (m_bitPerfectActive ? QString("bit-perfect") : Resampler::profileName(m_resamplerProfile));
+    reportBitPerfect();
+    m_pollTimer.start();
+    setStatus(QMediaPlayer::BufferedMedia);
+    return true;
+}
+
+QAudioFormat PlaybackEngine::negotiateFormat(const QAudioDevice &device, const AudioDecoder &decoder)
+{
+    QAudioFormat format;
+    format.setSampleRate(decoder.sampleRate());
+    format.setChannelCount(decoder.channels());
+    format.setChannelConfig(QAudioFormat::defaultChannelConfigForChannelCount(format.channelCount()));
+
+    m_bitPerfectActive = false;
+    m_bitPerfectIssue.clear();
+    if (m_bitPerfect) {
+        // Exactly what the decoder produces or nothing, no rate, channel or depth conversion
+        const QAudioFormat::SampleFormat native = nativeSampleFormat(decoder.sampleFormat());
+        if (native == QAudioFormat::Unknown) {
+            m_bitPerfectIssue = QString("%1 samples have no matching output format")
+                                    .arg(av_get_sample_fmt_name(decoder.sampleFormat()));
+        } else {
+            format.setSampleFormat(native);
+            if (device.isFormatSupported(format)) {
+                m_bitPerfectActive = true;
+                return format;
+            }
+            m_bitPerfectIssue = QString("%1 does not accept %2 Hz, %3 channels, %4-bit")
+                                    .arg(device.description())
+                                    .arg(format.sampleRate())
+                                    .arg(format.channelCount())
+                                    .arg(decoder.bitsPerSample());
+        }
+    }
+
+    // Prefer the configured rate for this device, else the source's own rate and channel
+    // count, let the device pick otherwise
+    format.setSampleFormat(QAudioFormat::Float);
+    if (m_targetRate > 0) {
+        QAudioFormat target = format;
+        target.setSampleRate(m_targetRate);
+        if (device.isFormatSupported(target)) {
+            return target;
+        }
+        qCWarning(lcPlayback) << device.description() << "does not accept" << m_targetRate << "Hz, using the source rate";
+    }
+    if (!device.isFormatSupported(format)) {
+        const QAudioFormat preferred = device.preferredFormat();
+        format.setSampleRate(preferred.sampleRate());
+        format.setChannelCount(preferred.channelCount());
+        format.setChannelConfig(QAudioFormat::defaultChannelConfigForChannelCount(preferred.channelCount()));
+        if (!device.isFormatSupported(format) && toAVSampleFormat(preferred.sampleFormat()) != AV_SAMPLE_FMT_NONE) {
+            format.setSampleFormat(preferred.sampleFormat());
+        }
+    }
+    return format;
+}
+
+void PlaybackEngine::reportBitPerfect()
+{
+    if (!m_bitPerfect) {
+        return;
+    }
+    if (!m_bitPerfectActive) {
+        emit bitPerfectStatus(false, "Bit-perfect unavailable: " + m_bitPerfectIssue);
+    } else if (m_volume < 1.0f) {
+        emit bitPerfectStatus(false, "Bit-perfect suspended: volume is below 100%");
+    } else {
+        emit bitPerfectStatus(true, QString("Bit-perfect: %1 Hz, %2 channels, %3")
+                                        .arg(m_format.sampleRate())
+                                        .arg(m_format.channelCount())
+                                        .arg(sampleFormatName(m_format.sampleFormat())));
+    }
+}
+
+void PlaybackEngine::stopPipeline()
+{
+    m_pollTimer.stop();
+    if (m_sink) {
+        m_sink->stop();
+        delete m_sink;
+        m_sink = nullptr;
+    }
+    if (m_decoderThread) {
+        // The decoder goes with the thread, the next play() reopens the source
+        delete m_decoderThread;
+        m_decoderThread = nullptr;
+    }
+    if (m_device) {
+        delete m_device;
+        m_device = nullptr;
+    }
+    m_shared.reset();
+}
+
+void PlaybackEngine::poll()
+{
+    if (!m_shared) {
+        return;
+    }
+
+    // The spliced source is now audible, it becomes the current one
+    unsigned played = m_shared->transitionsPlayed.load(std::memory_order_acquire);
+    if (played != m_seenTransitions) {
+        m_seenTransitions = played;
+        if (m_hasNext) {
+            m_hasNext = false;
+            m_source = m_next.url;
+            m_duration = m_next.durationMs;
+            qCDebug(lcPlayback) << "Gapless transition to" << m_source;
+            emit nextSourceStarted(m_source);
+            emit durationChanged(m_duration);
+        }
+    }
+
+    qint64 pos = position();
+    if (pos != m_lastReportedPosition) {
+        m_lastReportedPosition = pos;
+        emit positionChanged(pos);
+    }
+
+    unsigned serial = m_shared->latencySerial.load(std::memory_order_acquire);
+    if (serial != m_seenLatencySerial) {
+        m_seenLatencySerial = serial;
+        LatencyKind kind = static_cast<LatencyKind>(m_shared->lastLatencyKind.load(std::memory_order_relaxed));
+        const qint64 requestNs = m_shared->lastLatencyRequestNs.load(std::memory_order_relaxed);
+        const qint64 decodedNs = m_shared->lastLatencyDecodedNs.load(std::memory_order_relaxed);
+        const qint64 outputNs = m_shared->lastLatencyOutputNs.load(std::memory_order_relaxed);
+        qint64 usecs = (outputNs - requestNs) / 1000;
+        qCDebug(lcPlayback) << (kind == StartLatency ? "Start" : "Seek") << "latency" << usecs << "us";
+        PerfLog::record("playback", kind == StartLatency ? "start_latency" : "seek_latency", usecs, 0, m_source.toLocalFile());
+        emit latencyMeasured(kind, usecs);
+        emit latencyStages(kind, requestNs, decodedNs, outputNs);
+    }
+
+    if (m_decoderThread && m_decoderThread->isFinished() && !m_decoderThread->lastError().isEmpty()) {
+        QString error = m_decoderThread->lastError();
+        stopPipeline();
+        setState(QMediaPlayer::StoppedState);
+        fail(QMediaPlayer::FormatError, error);
+        return;
+    }
+
+    // End of stream once the device has handed over the last byte and the sink has played it
+    if (m_shared->drained.load(std::memory_order_relaxed) && m_sink
+        && (m_sink->state() == QAudio::IdleState || m_sink->bytesFree() == m_sink->bufferSize())) {
+        stopPipeline();
+        m_startPositionMs = 0;
+        setState(QMediaPlayer::StoppedState);
+        m_lastReportedPosition = m_duration;
+        emit positionChanged(m_duration);
+        setStatus(QMediaPlayer::EndOfMedia);
+    }
+}
+
+void PlaybackEngine::setState(QMediaPlayer::PlaybackState state)
+{
+    if (m_state != state) {
+        m_state = state;
+        emit playbackStateChanged(state);
+    }
+}
+
+void PlaybackEngine::setStatus(QMediaPlayer::MediaStatus status)
+{
+    if (m_status != status) {
+        m_status = status;
+        emit mediaStatusChanged(status);
+    }
+}
+
+void PlaybackEngine::fail(QMediaPlayer::Error error, const QString &message)
+{
+    qCWarning(lcPlayback) << "Native engine error:" << message;
+    setStatus(QMediaPlayer::InvalidMedia);
+    emit errorOccurred(error, message);
+}
@@ -0,0 +1,309 @@
+#ifndef PLAYBACKENGINE_H
+#define PLAYBACKENGINE_H
+
+#include <QObject>
+#include <QUrl>
+#include <QTimer>
+#include <QThread>
+#include <QIODevice>
+#include <QAudioFormat>
+#include <QMediaPlayer>
+#include <QMutex>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "ringbuffer.h"
+#include "dspkernels.h"
+#include "equalizer.h"
+#include "audiotap.h"
+#include "resampler.h"
+
+class QAudioSink;
+class QAudioDevice;
+class AudioDecoder;
+struct AVFrame;
+struct SwrContext;
+
+//state shared between the GUI thread, the decoder thread and the audio thread.
+//everything crossing threads is atomic, the PCM itself goes through the SPSC ring
+struct PlaybackShared {
+    SpscRingBuffer<char> ring;
+    int bytesPerFrame = 0;
+    int sampleRate = 0;                             // output rate
+    bool bitPerfect = false;                        // sink opened in the source's own format, never convert
+    Equalizer *equalizer = nullptr;                 // run on the audio thread, null when bit-perfect
+    AudioTap *tap = nullptr;                        // fed on the audio thread while it is enabled
+    ResamplerProfile resamplerProfile = ResamplerProfile::Balanced;
+
+    // GUI -> decoder
+    std::atomic<qint64> seekTargetFrame{-1};        // output frames, -1 = none
+    std::atomic<qint64> seekRequestNs{0};
+    std::atomic<bool> stopRequested{false};
+    std::atomic<qint64> crossfadeFrames{0};         // 0 = gapless hand-over
+    std::atomic<int> crossfadeCurve{0};             // Dsp::FadeCurve
+
+    // decoder -> audio
+    std::atomic<qint64> baseFrame{0};               // output frame of the first byte after the last discard
+    std::atomic<bool> decodeFinished{false};        // everything up to EOF is in the ring
+    std::atomic<qint64> latencyStartNs{0};          // armed request, cleared on the first real audio
+    std::atomic<int> latencyKind{0};
+    std::atomic<qint64> latencyDecodedNs{0};        // first converted audio for the armed request, 0 = none
+    // gapless hand-over: the next source starts at ring index transitionMark
+    std::atomic<size_t> transitionMark{0};
+    std::atomic<qint64> transitionBaseFrame{0};
+    std::atomic<unsigned> transitionSerial{0};
+
+    // audio -> GUI
+    std::atomic<qint64> framesConsumed{0};          // since the last discard
+    std::atomic<bool> seekInFlight{false};
+    std::atomic<bool> drained{false};
+    std::atomic<int> underruns{0};
+    std::atomic<qint64> lastLatencyRequestNs{0};
+    std::atomic<qint64> lastLatencyDecodedNs{0};
+    std::atomic<qint64> lastLatencyOutputNs{0};
+    std::atomic<int> lastLatencyKind{0};
+    std::atomic<unsigned> latencySerial{0};
+    std::atomic<unsigned> transitionsPlayed{0};    // last transitionSerial the sink has reached
+};
+
+//decodes and converts to the sink format ahead of the audio thread, sleeps while the ring is full
+class DecoderThread : public QThread
+{
+public:
+    DecoderThread(std::unique_ptr<AudioDecoder> decoder, PlaybackShared &shared,
+                  const QAudioFormat &format, qint64 startFrame, QObject *parent = nullptr);
+    ~DecoderThread();
+
+    QString lastError() const { return m_error; }
+
+    //source spliced on, sample-contiguously, once the current one runs out. any thread
+    void setNext(std::unique_ptr<AudioDecoder> decoder, qint64 startMs, qint64 endMs);
+    void clearNext();
+
+protected:
+    void run() override;
+
+private:
+    bool initResampler();
+    bool canPassThrough(const AudioDecoder &decoder) const;
+    void copyNative(const AVFrame *frame, char *out) const;
+    qint64 sourceEndFrame() const;
+    bool switchToNext();
+    void handleSeek(qint64 targetFrame, qint64 requestNs);
+    bool convertFrame(const AVFrame *frame);
+    void drainResampler();
+    void finishChunk(qsizetype chunkStart);
+    void mixTail(qsizetype offset);
+    void fadeOutRemainingTail();
+
+    std::unique_ptr<AudioDecoder> m_decoder;
+    PlaybackShared &m_shared;
+    QAudioFormat m_format;
+    qint64 m_startFrame;
+    SwrContext *m_swr = nullptr;
+    bool m_passthrough = false;         // decoder output is already in the sink format, swr is skipped
+    bool m_stampDecoded = true;         // the armed latency request still waits for its first audio
+
+    QByteArray m_pending;               // converted but not yet in the ring
+    qsizetype m_pendingOffset = 0;
+    qint64 m_trimTargetFrame = -1;      // after a seek, output frames before this are dropped
+    qint64 m_outFrame = 0;              // output frame the next converted sample lands on
+    qint64 m_endFrame = -1;             // output stops here for ranged sources, -1 = EOF
+    qint64 m_sourceEndFrame = -1;       // where the current source runs out, -1 = unknown (no crossfade)
+    QString m_error;
+
+    // Crossfade: the end of the outgoing source is held back here and mixed under the head of
+    // the next one, block by block through the float scratch buffers
+    QByteArray m_tail;
+    qint64 m_tailMixed = 0;
+    bool m_fadingIn = false;
+    Dsp::FadeCurve m_fadeCurve = Dsp::FadeCurve::EqualPower;
+    std::vector<float> m_mixIn;
+    std::vector<float> m_mixOut;
+    Dsp::DitherState m_dither;          // mixed 16-bit output is requantised with TPDF dither
+
+    QMutex m_nextMutex;
+    std::unique_ptr<AudioDecoder> m_nextDecoder;
+    qint64 m_nextStartMs = 0;
+    qint64 m_nextEndMs = 0;
+    std::atomic<bool> m_nextQueued{false};
+};
+
+//QAudioSink pull device, runs on the audio thread and never blocks or allocates
+class PcmPullDevice : public QIODevice
+{
+public:
+    PcmPullDevice(PlaybackShared &shared, const QAudioFormat &format, QObject *parent = nullptr);
+
+    bool isSequential() const override { return true; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    void equalize(char *data, qint64 bytes);
+
+    PlaybackShared &m_shared;
+    QAudioFormat m_format;
+    unsigned m_seenTransitionSerial = 0;
+    std::vector<float> m_eqScratch;     // one block, sized up front so the audio thread never allocates
+    Dsp::DitherState m_dither;
+};
+
+//alternative to QMediaPlayer with its own decode thread and PCM buffering.
+//mirrors the part of the QMediaPlayer API MainWindow uses so the two are interchangeable
+class PlaybackEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum LatencyKind {
+        StartLatency = 1,   // play() (or resume) to the first decoded audio handed to the sink
+        SeekLatency = 2     // setPosition() to the first audio from the new position
+    };
+    Q_ENUM(LatencyKind)
+
+    explicit PlaybackEngine(QObject *parent = nullptr);
+    ~PlaybackEngine();
+
+    //returns at once, the file is opened in the background and the status goes from LoadingMedia
+    //to LoadedMedia (or InvalidMedia). play() and setPosition() before that apply once it is open
+    void setSource(const QUrl &source);
+    QUrl source() const { return m_source; }
+
+    //gapless: source decoded straight after the current one ends, limited to [startMs, endMs)
+    //when endMs > 0. nextSourceStarted() fires when it is actually heard. the file is opened in
+    //the background, hasNextSource() is true from the call on and turns false if it can't be
+    void setNextSource(const QUrl &source, qint64 startMs = 0, qint64 endMs = 0);
+    void clearNextSource();
+    bool hasNextSource() const { return m_hasNext; }
+
+    void play();
+    void pause();
+    void stop();
+    void setPosition(qint64 position);
+
+    qint64 position() const;
+    qint64 duration() const { return m_duration; }
+    QMediaPlayer::PlaybackState playbackState() const { return m_state; }
+    QMediaPlayer::MediaStatus mediaStatus() const { return m_status; }
+
+    void setVolume(float volume);
+    float volume() const { return m_volume; }
+
+    //depth of the decoded PCM queue, applied from the next source
+    void setBufferDuration(int ms);
+    int bufferDuration() const { return m_bufferMs; }
+
+    //overlap between a track and the queued next source, 0 = plain gapless. takes effect immediately
+    void setCrossfade(int ms, Dsp::FadeCurve curve);
+    int crossfadeDuration() const { return m_crossfadeMs; }
+    Dsp::FadeCurve crossfadeCurve() const { return m_crossfadeCurve; }
+
+    //open the device at the source's own rate, channel count and sample format and hand it
+    //the decoded samples untouched. crossfade is off and sources in another format are not
+    //spliced on. applies from the next source, bitPerfectStatus() tells whether it held
+    void setBitPerfect(bool enabled);
+    bool bitPerfect() const { return m_bitPerfect; }
+    bool isBitPerfectActive() const { return m_bitPerfectActive; }
+
+    //rate conversion quality, and the rate the output device is opened at (0 = the source's
+    //own rate). both apply from the next source, bit-perfect output ignores them
+    void setResamplerProfile(ResamplerProfile profile) { m_resamplerProfile = profile; }
+    ResamplerProfile resamplerProfile() const { return m_resamplerProfile; }
+    void setTargetRate(int hz) { m_targetRate = qMax(0, hz); }
+    int targetRate() const { return m_targetRate; }
+
+    int underrunCount() const;
+
+    //applied on the audio thread right before the sink, so edits are heard within a period.
+    //bypassed while bit-perfect output is active
+    Equalizer &equalizer() { return m_equalizer; }
+    //mono copy of the output after the equalizer, for the spectrum display. bit-perfect output
+    //is tapped as well, reading the samples leaves them untouched
+    AudioTap &audioTap() { return m_tap; }
+
+signals:
+    void positionChanged(qint64 position);
+    void durationChanged(qint64 duration);
+    void playbackStateChanged(QMediaPlayer::PlaybackState state);
+    void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void errorOccurred(QMediaPlayer::Error error, const QString &errorString);
+    void latencyMeasured(PlaybackEngine::LatencyKind kind, qint64 usecs);
+    //the same measurement by stage, steady clock ns (LatencyTracker::nowNs). decodedNs is 0
+    //when the audio was decoded before the request, e.g. resuming from pause
+    void latencyStages(PlaybackEngine::LatencyKind kind, qint64 requestNs, qint64 decodedNs, qint64 outputNs);
+    void nextSourceStarted(const QUrl &source);
+    void bitPerfectStatus(bool honoured, const QString &detail);
+
+private:
+    using OpenedCallback = std::function<void(std::unique_ptr<AudioDecoder>, qint64, const QString &)>;
+    void openOnPool(const QString &filePath, std::function<bool()> stale, OpenedCallback done);
+    void requestSourceDecoder(bool playWhenOpened);
+    void onSourceOpened(unsigned serial, std::unique_ptr<AudioDecoder> decoder, qint64 durationMs,
+                        const QString &error);
+    bool startPipeline(qint64 startMs);
+    void stopPipeline();
+    void poll();
+    void setState(QMediaPlayer::PlaybackState state);
+    void setStatus(QMediaPlayer::MediaStatus status);
+    void fail(QMediaPlayer::Error error, const QString &message);
+    QAudioFormat negotiateFormat(const QAudioDevice &device, const AudioDecoder &decoder);
+    void reportBitPerfect();
+    bool transitionPending() const;
+    void requestNextDecoder();
+    void onNextDecoderOpened(unsigned serial, std::unique_ptr<AudioDecoder> decoder, qint64 durationMs,
+                             const QString &error);
+
+    struct QueuedSource {
+        QUrl url;
+        qint64 startMs = 0;
+        qint64 endMs = 0;
+        qint64 durationMs = 0;
+    };
+
+    QUrl m_source;
+    std::unique_ptr<AudioDecoder> m_idleDecoder;    // opened after setSource(), handed to the pipeline on play()
+    bool m_hasNext = false;
+    QueuedSource m_next;
+    // Opening probes the file (avformat_find_stream_info), which can take a while on network or
+    // cold storage, so it runs here rather than on the GUI thread
+    QThreadPool m_openPool;
+    std::atomic<unsigned> m_sourceSerial{0};        // bumped by setSource(), opens of an older source are dropped
+    bool m_sourceOpening = false;
+    bool m_playWhenOpened = false;                  // play() came while the source was still opening
+    std::atomic<unsigned> m_nextSerial{0};          // bumped by every set/clear, stale opens are dropped
+    bool m_nextOpening = false;
+    std::unique_ptr<AudioDecoder> m_nextDecoder;    // opened while no pipeline runs, handed over on play()
+    unsigned m_seenTransitions = 0;
+    std::unique_ptr<PlaybackShared> m_shared;
+    DecoderThread *m_decoderThread = nullptr;
+    PcmPullDevice *m_device = nullptr;
+    QAudioSink *m_sink = nullptr;
+    QAudioFormat m_format;
+    QTimer m_pollTimer;
+
+    QMediaPlayer::PlaybackState m_state = QMediaPlayer::StoppedState;
+    QMediaPlayer::MediaStatus m_status = QMediaPlayer::NoMedia;
+    qint64 m_duration = 0;
+    qint64 m_startPositionMs = 0;       // where play() starts when no pipeline is running
+    qint64 m_seekTargetMs = 0;          // reported while a seek is in flight
+    qint64 m_lastReportedPosition = -1;
+    unsigned m_seenLatencySerial = 0;
+    float m_volume = 1.0f;
+    int m_bufferMs = 500;
+    int m_crossfadeMs = 0;
+    bool m_bitPerfect = false;
+    bool m_bitPerfectActive = false;    // the running sink really is in the source format
+    QString m_bitPerfectIssue;          // why it isn't, for bitPerfectStatus()
+    Dsp::FadeCurve m_crossfadeCurve = Dsp::FadeCurve::EqualPower;
+    Equalizer m_equalizer;
+    AudioTap m_tap;
+    ResamplerProfile m_resamplerProfile = ResamplerProfile::Balanced;
+    int m_targetRate = 0;
+};
+
+#endif // PLAYBACKENGINE_H
@@ -0,0 +1,445 @@
+#include "playerdaemon.h"
+#include "audiomanager.h"
+#include "mappedinput.h"
+#include "logging.h"
+#include <QAudioDevice>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QMediaDevices>
+#include <QSettings>
+#include <QTimer>
+
+namespace {
+    // The window's per-device keys, see MainWindow::loadOutputDeviceSettings
+    QString deviceKey(const QString &group, const QAudioDevice &device)
+    {
+        return group + "/" + QString::fromLatin1(device.id().toHex());
+    }
+
+    QString stateName(QMediaPlayer::PlaybackState state)
+    {
+        switch (state) {
+        case QMediaPlayer::PlayingState: return "playing";
+        case QMediaPlayer::PausedState: return "paused";
+        default: return "stopped";
+        }
+    }
+}
+
+QString PlayerDaemon::defaultSocketName()
+{
+    return "flacplayerd";
+}
+
+PlayerDaemon::PlayerDaemon(QObject *parent)
+    : QObject(parent)
+{
+    applySettings();
+    connect(&m_engine, &PlaybackEngine::mediaStatusChanged, this, &PlayerDaemon::onMediaStatusChanged);
+    connect(&m_engine, &PlaybackEngine::positionChanged, this, &PlayerDaemon::onPositionChanged);
+    connect(&m_engine, &PlaybackEngine::nextSourceStarted, this, &PlayerDaemon::onNextSourceStarted);
+    connect(&m_engine, &PlaybackEngine::errorOccurred, this, [](QMediaPlayer::Error, const QString &message) {
+        qCWarning(lcPlayback) << "Playback error:" << message;
+    });
+    connect(&m_server, &QLocalServer::newConnection, this, &PlayerDaemon::onNewConnection);
+}
+
+//the same playback settings the window saved, so both play a track the same way
+void PlayerDaemon::applySettings()
+{
+    QSettings settings;
+    m_engine.setBufferDuration(settings.value("playback/bufferMs", 500).toInt());
+    m_engine.setCrossfade(settings.value("playback/crossfadeMs", 0).toInt(),
+        static_cast<Dsp::FadeCurve>(settings.value("playback/crossfadeCurve", int(Dsp::FadeCurve::EqualPower)).toInt()));
+    m_engine.setBitPerfect(settings.value("playback/bitPerfect", false).toBool());
+    m_engine.setResamplerProfile(static_cast<ResamplerProfile>(
+        qBound(0, settings.value("resampler/profile", int(ResamplerProfile::Balanced)).toInt(), int(ResamplerProfile::Soxr))));
+    MappedInput::setDefaultStorage(static_cast<InputStorage>(
+        qBound(0, settings.value("io/storage", int(InputStorage::Auto)).toInt(), int(InputStorage::Network))));
+
+    const QAudioDevice device = QMediaDevices::defaultAudioOutput();
+    const QByteArray preset = settings.value(deviceKey("equalizer", device)).toByteArray();
+    m_engine.equalizer().setPreset(preset.isEmpty() ? EqPreset::flat() : EqPreset::fromJson(preset));
+    m_engine.setTargetRate(settings.value(deviceKey("resampler/targetRate", device), 0).toInt());
+}
+
+bool PlayerDaemon::listen(const QString &name)
+{
+    // Only this user may drive the player
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (m_server.listen(name)) {
+        return true;
+    }
+
+    // Left over from a daemon that didn't shut down, unless something still answers on it
+    if (m_server.serverError() == QAbstractSocket::AddressInUseError) {
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(500)) {
+            m_lastError = QString("another daemon is listening on %1").arg(name);
+            return false;
+        }
+        QLocalServer::removeServer(name);
+        if (m_server.listen(name)) {
+            return true;
+        }
+    }
+    m_lastError = QString("cannot listen on %1: %2").arg(name, m_server.errorString());
+    return false;
+}
+
+void PlayerDaemon::onNewConnection()
+{
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void PlayerDaemon::onReadyRead(QLocalSocket *socket)
+{
+    while (socket->canReadLine()) {
+        const QString line = QString::fromUtf8(socket->readLine()).trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        socket->write(execute(line) + '\n');
+    }
+    if (socket->bytesAvailable() > MaxLineBytes) {
+        socket->write(error("line too long") + '\n');
+        socket->disconnectFromServer();
+    }
+}
+
+QByteArray PlayerDaemon::execute(const QString &line)
+{
+    const QString trimmed = line.trimmed();
+    const int space = trimmed.indexOf(' ');
+    const QString command = (space < 0 ? trimmed : trimmed.left(space)).toLower();
+    const QString argument = space < 0 ? QString() : trimmed.mid(space + 1).trimmed();
+
+    if (command == "status") {
+        QJsonObject fields;
+        fields["state"] = stateName(m_engine.playbackState());
+        fields["index"] = m_current;
+        fields["position"] = m_current >= 0 ? qMax<qint64>(0, m_engine.position() - trackStartMs()) : 0;
+        fields["duration"] = trackDurationMs();
+        fields["queue"] = m_playlist.size();
+        fields["volume"] = qRound(m_engine.volume() * 100.0f);
+        fields["underruns"] = m_engine.underrunCount();
+        if (m_current >= 0) {
+            fields["track"] = entryJson(m_current);
+        }
+        return ok(fields);
+    }
+
+    if (command == "enqueue") {
+        if (argument.isEmpty()) {
+            return error("usage: enqueue <path>");
+        }
+        // Resolving it here would use the daemon's working directory, not the client's
+        if (QDir::isRelativePath(argument)) {
+            return error(QString("path must be absolute: %1").arg(argument));
+        }
+        const QString filePath = QDir::cleanPath(argument);
+        if (!QFileInfo(filePath).isFile()) {
+            return error(QString("no such file: %1").arg(filePath));
+        }
+        const int added = enqueue(filePath);
+        if (m_current < 0) {
+            loadTrack(0);
+        } else {
+            queueNextForGapless();
+        }
+        QJsonObject fields;
+        fields["added"] = added;
+        fields["queue"] = m_playlist.size();
+        return ok(fields);
+    }
+
+    if (command == "play") {
+        if (m_playlist.isEmpty()) {
+            return error("queue is empty");
+        }
+        if (!argument.isEmpty()) {
+            bool valid = false;
+            const int index = argument.toInt(&valid);
+            if (!valid || index < 0 || index >= m_playlist.size()) {
+                return error(QString("no queue entry %1").arg(argument));
+            }
+            loadTrack(index);
+        }
+        m_engine.play();
+        return ok();
+    }
+
+    if (command == "pause") {
+        m_engine.pause();
+        return ok();
+    }
+
+    if (command == "stop") {
+        m_engine.stop();
+        if (trackStartMs() > 0) {
+            m_engine.setPosition(trackStartMs());
+        }
+        return ok();
+    }
+
+    if (command == "next" || command == "previous") {
+        const int index = m_current + (command == "next" ? 1 : -1);
+        if (index < 0 || index >= m_playlist.size()) {
+            return error(command == "next" ? "at the end of the queue" : "at the start of the queue");
+        }
+        const bool playing = m_engine.playbackState() == QMediaPlayer::PlayingState;
+        loadTrack(index);
+        if (playing) {
+            m_engine.play();
+        }
+        return ok();
+    }
+
+    if (command == "seek") {
+        bool valid = false;
+        const qint64 value = argument.toLongLong(&valid);
+        if (!valid) {
+            return error("usage: seek <ms> | +ms | -ms");
+        }
+        if (m_current < 0) {
+            return error("nothing loaded");
+        }
+        const bool relative = argument.startsWith('+') || argument.startsWith('-');
+        const qint64 current = qMax<qint64>(0, m_engine.position() - trackStartMs());
+        const qint64 duration = trackDurationMs();
+        qint64 target = qMax<qint64>(0, relative ? current + value : value);
+        if (duration > 0) {
+            target = qMin(target, duration);
+        }
+        m_engine.setPosition(trackStartMs() + target);
+        QJsonObject fields;
+        fields["position"] = target;
+        return ok(fields);
+    }
+
+    if (command == "volume") {
+        bool valid = false;
+        const int volume = argument.toInt(&valid);
+        if (!valid || volume < 0 || volume > 100) {
+            return error("usage: volume <0-100>");
+        }
+        m_engine.setVolume(volume / 100.0f);
+        return ok();
+    }
+
+    if (command == "queue") {
+        QJsonArray entries;
+        for (int i = 0; i < m_playlist.size(); ++i) {
+            entries.append(entryJson(i));
+        }
+        QJsonObject fields;
+        fields["index"] = m_current;
+        fields["entries"] = entries;
+        return ok(fields);
+    }
+
+    if (command == "clear") {
+        m_engine.stop();
+        m_engine.clearNextSource();
+        m_engine.setSource(QUrl());
+        m_playlist.clear();
+        m_titles.clear();
+        m_current = -1;
+        m_gaplessIndex = -1;
+        m_loadedFile.clear();
+        m_pendingStartMs = -1;
+        return ok();
+    }
+
+    if (command == "quit") {
+        // The reply goes out before the event loop ends
+        QTimer::singleShot(0, this, &PlayerDaemon::quitRequested);
+        return ok();
+    }
+
+    return error(QString("unknown command: %1").arg(command));
+}
+
+//queues a file, album images with an embedded CUESHEET become one virtual entry per track.
+//returns the number of entries added
+int PlayerDaemon::enqueue(const QString &filePath)
+{
+    if (filePath.toLower().endsWith(".flac")) {
+        MetadataEditor editor;
+        int sampleRate = 0;
+        const QList<CueTrack> cueTracks = editor.readCueTracks(filePath, &sampleRate);
+        if (!cueTracks.isEmpty() && sampleRate > 0) {
+            for (int i = 0; i < cueTracks.size(); ++i) {
+                PlaylistEntry entry(filePath);
+                entry.startSample = cueTracks[i].startSample;
+                // Last track runs to the end of the file so EndOfMedia still fires for it
+                entry.endSample = (i == cueTracks.size() - 1) ? 0 : cueTracks[i].endSample;
+                entry.sampleRate = sampleRate;
+                entry.cueTrack = cueTracks[i].number;
+                m_playlist.append(entry);
+            }
+            return int(cueTracks.size());
+        }
+    }
+    if (!m_titles.contains(filePath)) {
+        QString title;
+        if (MetadataEditor::canReadTags(filePath)) {
+            // Tags only, pictures are left in the file
+            MetadataEditor editor;
+            title = editor.readMetadata(filePath, MetadataEditor::FieldTags).title;
+        }
+        m_titles.insert(filePath, title.isEmpty() ? QFileInfo(filePath).completeBaseName() : title);
+    }
+    m_playlist.append(filePath);
+    return 1;
+}
+
+//the window's loadTrack without the display: cue tracks of the open image are seeks
+void PlayerDaemon::loadTrack(int index)
+{
+    m_current = index;
+    const PlaylistEntry &entry = m_playlist[index];
+    if (entry.isVirtual() && entry.filePath == m_loadedFile) {
+        if (qAbs(m_engine.position() - entry.startMs()) > 500) {
+            m_pendingStartMs = entry.startMs();     // Cleared once the engine reports the new range
+            m_engine.setPosition(entry.startMs());
+        } else {
+            m_pendingStartMs = -1;
+        }
+    } else {
+        m_loadedFile = entry.filePath;
+        m_pendingStartMs = entry.startMs() > 0 ? entry.startMs() : -1;
+        m_engine.setSource(QUrl::fromLocalFile(entry.filePath));
+    }
+    qCInfo(lcPlayback) << "Daemon loaded" << entry.displayName();
+    queueNextForGapless();
+}
+
+//hands the next entry to the engine so it is spliced on without a gap, see MainWindow::queueNextForGapless
+void PlayerDaemon::queueNextForGapless()
+{
+    const int next = m_current + 1;
+    bool queue = m_current >= 0 && next < m_playlist.size() && m_playlist[m_current].endMs() == 0;
+    if (queue) {
+        const PlaylistEntry &current = m_playlist[m_current];
+        const PlaylistEntry &entry = m_playlist[next];
+        queue = !(entry.filePath == current.filePath && (entry.isVirtual() || current.isVirtual()));
+    }
+    if (!queue) {
+        m_gaplessIndex = -1;
+        m_engine.clearNextSource();
+        return;
+    }
+    if (next == m_gaplessIndex && m_engine.hasNextSource()) {
+        return;
+    }
+    m_gaplessIndex = next;
+    const PlaylistEntry &entry = m_playlist[next];
+    m_engine.setNextSource(QUrl::fromLocalFile(entry.filePath), entry.startMs(), entry.endMs());
+}
+
+void PlayerDaemon::onMediaStatusChanged(QMediaPlayer::MediaStatus status)
+{
+    // Seeks issued before the engine has loaded the file are dropped, apply them now
+    if (status == QMediaPlayer::LoadedMedia && m_pendingStartMs >= 0) {
+        m_engine.setPosition(m_pendingStartMs);
+        m_pendingStartMs = -1;
+    }
+    if (status == QMediaPlayer::EndOfMedia) {
+        advanceAfterTrackEnd();
+    }
+}
+
+void PlayerDaemon::onPositionChanged(qint64 position)
+{
+    if (m_current < 0 || m_current >= m_playlist.size()) {
+        return;
+    }
+    // Virtual cue tracks end inside the file, hand over to the next entry at the boundary
+    const PlaylistEntry &entry = m_playlist[m_current];
+    const bool insideTrack = position >= entry.startMs() && (entry.endMs() == 0 || position < entry.endMs());
+    if (entry.isVirtual() && m_pendingStartMs >= 0 && insideTrack) {
+        m_pendingStartMs = -1;
+    }
+    if (entry.isVirtual() && entry.endMs() > 0 && position >= entry.endMs() && m_pendingStartMs < 0) {
+        advanceAfterTrackEnd();
+    }
+}
+
+void PlayerDaemon::onNextSourceStarted(const QUrl &source)
+{
+    if (m_gaplessIndex < 0 || m_gaplessIndex >= m_playlist.size()
+        || QUrl::fromLocalFile(m_playlist[m_gaplessIndex].filePath) != source) {
+        return;
+    }
+    m_current = m_gaplessIndex;
+    m_loadedFile = m_playlist[m_current].filePath;
+    m_pendingStartMs = -1;
+    m_gaplessIndex = -1;
+    qCInfo(lcPlayback) << "Daemon continued gaplessly with" << m_playlist[m_current].displayName();
+    queueNextForGapless();
+}
+
+void PlayerDaemon::advanceAfterTrackEnd()
+{
+    if (m_current + 1 < m_playlist.size()) {
+        loadTrack(m_current + 1);
+        m_engine.play();
+        return;
+    }
+    // End of the queue, a cue track can end mid-file so pause explicitly
+    if (m_engine.playbackState() == QMediaPlayer::PlayingState) {
+        m_engine.pause();
+        m_engine.setPosition(trackStartMs());
+    }
+}
+
+qint64 PlayerDaemon::trackStartMs() const
+{
+    return m_current >= 0 && m_current < m_playlist.size() ? m_playlist[m_current].startMs() : 0;
+}
+
+qint64 PlayerDaemon::trackDurationMs() const
+{
+    if (m_current < 0 || m_current >= m_playlist.size()) {
+        return 0;
+    }
+    const PlaylistEntry &entry = m_playlist[m_current];
+    const qint64 end = entry.endMs() > 0 ? entry.endMs() : m_engine.duration();
+    return qMax<qint64>(0, end - entry.startMs());
+}
+
+QJsonObject PlayerDaemon::entryJson(int index) const
+{
+    const PlaylistEntry &entry = m_playlist[index];
+    QJsonObject json;
+    json["file"] = entry.filePath;
+    QString title = entry.isVirtual() ? entry.displayName() : m_titles.value(entry.filePath);
+    json["title"] = title.isEmpty() ? QFileInfo(entry.filePath).completeBaseName() : title;
+    if (entry.isVirtual()) {
+        json["cueTrack"] = entry.cueTrack;
+    }
+    return json;
+}
+
+QByteArray PlayerDaemon::ok(const QJsonObject &fields)
+{
+    QJsonObject reply = fields;
+    reply["ok"] = true;
+    return QJsonDocument(reply).toJson(QJsonDocument::Compact);
+}
+
+QByteArray PlayerDaemon::error(const QString &message)
+{
+    QJsonObject reply;
+    reply["ok"] = false;
+    reply["error"] = message;
+    return QJsonDocument(reply).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,87 @@
+#ifndef PLAYERDAEMON_H
+#define PLAYERDAEMON_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QString>
+#include "playlist.h"
+#include "playbackengine.h"
+
+class QLocalSocket;
+
+//headless player behind a local socket (a Unix domain socket on Linux and macOS), for running on
+//an audio server without a display. one command per line, one JSON object per reply line:
+//
+//   enqueue <path>      add a file, album images with a CUESHEET become one entry per track. the
+//                       path must be absolute, the daemon's working directory is not the client's
+//   play [index]        start or resume, or jump to a queue entry
+//   pause | stop | next | previous | clear
+//   seek <ms>           from the start of the current track, +ms / -ms from the current position
+//   volume <0-100>
+//   status              state, current entry, position, length and queue size
+//   queue               the entries in order
+//   quit                stops the daemon
+//
+//replies are {"ok":true,...} or {"ok":false,"error":"..."}. playback is the native engine with the
+//window's saved settings and the same gapless hand-over, nothing is pushed, clients poll status
+class PlayerDaemon : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int MaxLineBytes = 64 * 1024;     // a client sending more without a newline is dropped
+
+    //"flacplayerd", QLocalServer puts it in the temp directory
+    static QString defaultSocketName();
+
+    explicit PlayerDaemon(QObject *parent = nullptr);
+
+    //a stale socket left by a crashed daemon is removed, a live one is not taken over
+    bool listen(const QString &name = defaultSocketName());
+    QString serverName() const { return m_server.fullServerName(); }
+    QString lastError() const { return m_lastError; }
+
+    //runs one command line and returns the reply without the newline
+    QByteArray execute(const QString &line);
+
+    const Playlist &playlist() const { return m_playlist; }
+    int currentIndex() const { return m_current; }
+    PlaybackEngine &engine() { return m_engine; }
+
+signals:
+    void quitRequested();
+
+private:
+    void onNewConnection();
+    void onReadyRead(QLocalSocket *socket);
+    void onMediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void onPositionChanged(qint64 position);
+    void onNextSourceStarted(const QUrl &source);
+
+    void applySettings();
+    int enqueue(const QString &filePath);
+    void loadTrack(int index);
+    void queueNextForGapless();
+    void advanceAfterTrackEnd();
+    qint64 trackStartMs() const;
+    qint64 trackDurationMs() const;
+    QJsonObject entryJson(int index) const;
+
+    static QByteArray ok(const QJsonObject &fields = QJsonObject());
+    static QByteArray error(const QString &message);
+
+    PlaybackEngine m_engine;
+    QLocalServer m_server;
+    Playlist m_playlist;
+    int m_current = -1;
+    QString m_loadedFile;           // file the engine has open, cue tracks inside it are seeks
+    qint64 m_pendingStartMs = -1;   // track start to seek to once the file has loaded
+    int m_gaplessIndex = -1;        // entry queued on the engine for a gapless hand-over
+    QHash<QString, QString> m_titles;   // tag title by path, read once on enqueue since clients poll status
+    QString m_lastError;
+};
+
+#endif // PLAYERDAEMON_H
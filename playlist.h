@@ -2,7 +2,52 @@
 #define PLAYLIST_H
 
 #include <QString>
+#include <QFileInfo>
 #include <stdexcept>
+
+//one queue entry, either a whole file or a virtual track cut out of a single-file album image
+//by its embedded CUESHEET. sample positions are in the file's own sample rate
+struct PlaylistEntry {
+    QString filePath;
+    quint64 startSample = 0;   //first sample of the track
+    quint64 endSample = 0;     //one past the last sample, 0 = until end of file
+    int sampleRate = 0;        //needed to turn the sample range into a playback position
+    int cueTrack = 0;          //CUESHEET track number, 0 = whole file
+    QString title;             //display name for virtual tracks
+
+    PlaylistEntry() = default;
+    PlaylistEntry(const QString &path) : filePath(path) {}
+    PlaylistEntry(const char *path) : filePath(QString::fromUtf8(path)) {}
+
+    bool isVirtual() const {
+        return cueTrack > 0;
+    }
+
+    //start/end of the track in milliseconds, end is 0 when the track runs to the end of the file
+    qint64 startMs() const {
+        return sampleRate > 0 ? static_cast<qint64>((startSample * 1000) / sampleRate) : 0;
+    }
+    qint64 endMs() const {
+        return (sampleRate > 0 && endSample > 0) ? static_cast<qint64>((endSample * 1000) / sampleRate) : 0;
+    }
+
+    //text shown in the queue and the "next" label
+    QString displayName() const {
+        QString fileName = QFileInfo(filePath).fileName();
+        if (!isVirtual()) {
+            return fileName;
+        }
+        return title.isEmpty() ? QString("Track %1 - %2").arg(cueTrack, 2, 10, QChar('0')).arg(fileName) : title;
+    }
+
+    bool operator==(const PlaylistEntry &other) const {
+        return filePath == other.filePath && startSample == other.startSample && endSample == other.endSample;
+    }
+    bool operator!=(const PlaylistEntry &other) const {
+        return !(*this == other);
+    }
+};
+
  //dynamic array based playlist implementation ,  when full it should double its capacity
 class Playlist {
 public:
@@ -43,8 +88,8 @@ public:
         return *this;
     }
     
-  // add a new file path to the playlist
-    void append(const QString& path) {
+  // add a new file path (or virtual cue track) to the playlist
+    void append(const PlaylistEntry& path) {
         if (m_size >= m_capacity) {
             // Double capacity (or start with 4 if empty)
             int newCapacity = (m_capacity == 0) ? 4 : m_capacity * 2;
@@ -64,22 +109,22 @@ public:
     }
     
      //accessing elements by index with bounds checking
-    const QString& operator[](int index) const {
+    const PlaylistEntry& operator[](int index) const {
         if (index < 0 || index >= m_size) {
             throw std::out_of_range("Playlist index out of range");
         }
         return m_data[index];
     }
 //non-const version of above
-     QString& operator[](int index) {
+     PlaylistEntry& operator[](int index) {
         if (index < 0 || index >= m_size) {
             throw std::out_of_range("Playlist index out of range");
         }
         return m_data[index];
     }
     
-    //path search function
-    int indexOf(const QString& path) const {
+    //entry search function, virtual tracks of the same file are told apart by their sample range
+    int indexOf(const PlaylistEntry& path) const {
         for (int i = 0; i < m_size; ++i) {
             if (m_data[i] == path) {
                 return i;
@@ -90,12 +135,12 @@ public:
     
 
     //iterator support for std::shuffle
-    QString* begin() {
+    PlaylistEntry* begin() {
         return m_data;
     }
     
     //end iterator pointitng to one past the last element, clearing the playlist
-    QString* end() {
+    PlaylistEntry* end() {
         return m_data + m_size;
     }
     void clear() {
@@ -109,7 +154,7 @@ private:
             return;
         }
         
-        QString* newData = new QString[newCapacity];
+        PlaylistEntry* newData = new PlaylistEntry[newCapacity];
         
         // Copy existing elements
         for (int i = 0; i < m_size; ++i) {
@@ -121,7 +166,7 @@ private:
         m_capacity = newCapacity;
     }
     
-    QString* m_data;       //Dynamic array of file paths
+    PlaylistEntry* m_data; //Dynamic array of queue entries
     int m_size;            //Current number of elements
     int m_capacity;        // Allocated capacity
 };
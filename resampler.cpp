@@ -0,0 +1,199 @@
+#include "resampler.h"
+#include "logging.h"
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+
+extern "C" {
+#include <libswresample/swresample.h>
+#include <libavutil/opt.h>
+}
+
+namespace {
+    struct CachedContext {
+        QString key;
+        SwrContext *swr;
+    };
+
+    constexpr int MaxIdle = 4;     // a sinc table at 44.1 <-> 48 kHz is a few hundred kB
+
+    QMutex s_mutex;
+    QList<CachedContext> s_idle;    // most recently released first
+    QList<CachedContext> s_inUse;
+    int s_hits = 0;
+    int s_misses = 0;
+
+    QString layoutName(const AVChannelLayout *layout)
+    {
+        char name[128] = {};
+        av_channel_layout_describe(layout, name, sizeof(name));
+        return QString::fromLatin1(name);
+    }
+
+    // Everything the filter bank and the conversion depend on
+    QString contextKey(const AVChannelLayout *outLayout, AVSampleFormat outFormat, int outRate,
+                       const AVChannelLayout *inLayout, AVSampleFormat inFormat, int inRate,
+                       ResamplerProfile profile)
+    {
+        return QString("%1/%2/%3>%4/%5/%6:%7")
+            .arg(layoutName(inLayout)).arg(int(inFormat)).arg(inRate)
+            .arg(layoutName(outLayout)).arg(int(outFormat)).arg(outRate)
+            .arg(int(profile));
+    }
+
+    bool applyProfile(SwrContext *swr, ResamplerProfile profile)
+    {
+        switch (profile) {
+            case ResamplerProfile::Fast:
+                return av_opt_set_int(swr, "filter_size", 8, 0) >= 0
+                    && av_opt_set_int(swr, "phase_shift", 6, 0) >= 0
+                    && av_opt_set_int(swr, "linear_interp", 1, 0) >= 0;
+            case ResamplerProfile::Balanced:
+                return true;
+            case ResamplerProfile::HighQuality:
+                return av_opt_set_int(swr, "filter_size", 64, 0) >= 0
+                    && av_opt_set_int(swr, "phase_shift", 12, 0) >= 0
+                    && av_opt_set_int(swr, "linear_interp", 0, 0) >= 0
+                    && av_opt_set_double(swr, "cutoff", 0.98, 0) >= 0;
+            case ResamplerProfile::Soxr:
+                return av_opt_set_int(swr, "resampler", SWR_ENGINE_SOXR, 0) >= 0
+                    && av_opt_set_int(swr, "precision", 28, 0) >= 0
+                    && av_opt_set_int(swr, "cheby", 1, 0) >= 0;
+        }
+        return true;
+    }
+
+    SwrContext *createContext(const AVChannelLayout *outLayout, AVSampleFormat outFormat, int outRate,
+                              const AVChannelLayout *inLayout, AVSampleFormat inFormat, int inRate,
+                              ResamplerProfile profile)
+    {
+        SwrContext *swr = nullptr;
+        if (swr_alloc_set_opts2(&swr, outLayout, outFormat, outRate, inLayout, inFormat, inRate, 0, nullptr) < 0) {
+            return nullptr;
+        }
+        if (!applyProfile(swr, profile) || swr_init(swr) < 0) {
+            swr_free(&swr);
+        }
+        return swr;
+    }
+}
+
+SwrContext *Resampler::acquire(const AVChannelLayout *outLayout, AVSampleFormat outFormat, int outRate,
+                               const AVChannelLayout *inLayout, AVSampleFormat inFormat, int inRate,
+                               ResamplerProfile profile)
+{
+    if (profile == ResamplerProfile::Soxr && !soxrAvailable()) {
+        profile = ResamplerProfile::HighQuality;
+    }
+    const QString key = contextKey(outLayout, outFormat, outRate, inLayout, inFormat, inRate, profile);
+
+    {
+        QMutexLocker locker(&s_mutex);
+        for (int i = 0; i < s_idle.size(); ++i) {
+            if (s_idle[i].key == key) {
+                CachedContext cached = s_idle.takeAt(i);
+                // Parameters unchanged, so this only resets the delay line and buffers
+                if (swr_init(cached.swr) < 0) {
+                    swr_free(&cached.swr);
+                    break;
+                }
+                ++s_hits;
+                s_inUse.append(cached);
+                return cached.swr;
+            }
+        }
+        ++s_misses;
+    }
+
+    // Building the filter bank is the slow part, done without holding the lock
+    QElapsedTimer timer;
+    timer.start();
+    SwrContext *swr = createContext(outLayout, outFormat, outRate, inLayout, inFormat, inRate, profile);
+    if (!swr) {
+        return nullptr;
+    }
+    qCDebug(lcPlayback) << "Resampler built:" << key << profileName(profile)
+                        << timer.nsecsElapsed() / 1000 << "us";
+
+    QMutexLocker locker(&s_mutex);
+    s_inUse.append({key, swr});
+    return swr;
+}
+
+void Resampler::release(SwrContext *&swr)
+{
+    if (!swr) {
+        return;
+    }
+    SwrContext *evicted = nullptr;
+    {
+        QMutexLocker locker(&s_mutex);
+        for (int i = 0; i < s_inUse.size(); ++i) {
+            if (s_inUse[i].swr == swr) {
+                s_idle.prepend(s_inUse.takeAt(i));
+                if (s_idle.size() > MaxIdle) {
+                    evicted = s_idle.takeLast().swr;
+                }
+                swr = nullptr;
+                break;
+            }
+        }
+    }
+    // Not one of ours, or pushed out of the cache
+    swr_free(&evicted);
+    swr_free(&swr);
+}
+
+QString Resampler::profileName(ResamplerProfile profile)
+{
+    switch (profile) {
+        case ResamplerProfile::Fast:
+            return "Fast";
+        case ResamplerProfile::Balanced:
+            return "Balanced";
+        case ResamplerProfile::HighQuality:
+            return "High quality";
+        case ResamplerProfile::Soxr:
+            return "SoX (very high quality)";
+    }
+    return "Balanced";
+}
+
+bool Resampler::soxrAvailable()
+{
+    // FFmpeg builds without libsoxr reject the engine at swr_init
+    static const bool available = []() {
+        AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+        SwrContext *swr = createContext(&stereo, AV_SAMPLE_FMT_FLT, 48000,
+                                        &stereo, AV_SAMPLE_FMT_FLT, 44100, ResamplerProfile::Soxr);
+        const bool ok = swr != nullptr;
+        swr_free(&swr);
+        if (!ok) {
+            qCInfo(lcPlayback) << "libswresample has no soxr engine, the SoX profile uses High quality";
+        }
+        return ok;
+    }();
+    return available;
+}
+
+int Resampler::cacheHits()
+{
+    QMutexLocker locker(&s_mutex);
+    return s_hits;
+}
+
+int Resampler::cacheMisses()
+{
+    QMutexLocker locker(&s_mutex);
+    return s_misses;
+}
+
+void Resampler::clearCache()
+{
+    QMutexLocker locker(&s_mutex);
+    for (CachedContext &cached : s_idle) {
+        swr_free(&cached.swr);
+    }
+    s_idle.clear();
+}
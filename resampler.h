@@ -0,0 +1,44 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <QString>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/samplefmt.h>
+}
+
+struct SwrContext;
+
+//quality/speed trade-off of rate conversion, values are stored in the settings
+enum class ResamplerProfile {
+    Fast = 0,           // 8-tap linear-interpolated polyphase, for weak machines
+    Balanced = 1,       // libswresample's defaults (32 taps)
+    HighQuality = 2,    // 64-tap Kaiser sinc with 4096 phases, no interpolation between them
+    Soxr = 3            // libsoxr very high quality, falls back to HighQuality when FFmpeg lacks it
+};
+
+//the one place playback and conversion get their SwrContext from. contexts are configured for
+//a profile and, once released, kept idle for reuse: swr_init() on a context that already holds
+//the filter bank for the same ratio keeps it, so the next track at the same rates (or the next
+//conversion) skips building the table, which is most of the setup cost of the sinc profiles
+class Resampler
+{
+public:
+    //ready to convert, nullptr on failure. from the cache when a matching context is idle
+    static SwrContext *acquire(const AVChannelLayout *outLayout, AVSampleFormat outFormat, int outRate,
+                               const AVChannelLayout *inLayout, AVSampleFormat inFormat, int inRate,
+                               ResamplerProfile profile);
+    //hands the context back (flushed state, filter kept) and clears the pointer. null is fine
+    static void release(SwrContext *&swr);
+
+    static QString profileName(ResamplerProfile profile);
+    static bool soxrAvailable();
+
+    //contexts served from the cache / built from scratch since startup
+    static int cacheHits();
+    static int cacheMisses();
+    static void clearCache();
+};
+
+#endif // RESAMPLER_H
@@ -0,0 +1,151 @@
+#ifndef RINGBUFFER_H
+#define RINGBUFFER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+//lock-free single producer / single consumer ring buffer.
+//indices only ever grow (unsigned wraparound is fine), capacity is a power of two so the
+//position in the storage is index & mask. one thread may write, one other thread may read.
+//
+//seeking needs the reader to drop everything queued before the seek without the writer
+//touching the read index, so the writer publishes a discard mark instead: the reader skips
+//up to the mark the next time it reads
+template <typename T>
+class SpscRingBuffer
+{
+public:
+    explicit SpscRingBuffer(size_t minCapacity = 0)
+    {
+        reset(minCapacity);
+    }
+
+    SpscRingBuffer(const SpscRingBuffer &) = delete;
+    SpscRingBuffer &operator=(const SpscRingBuffer &) = delete;
+
+    //resizes and empties the buffer, only while neither side is running
+    void reset(size_t minCapacity)
+    {
+        size_t capacity = 1;
+        while (capacity < minCapacity) {
+            capacity <<= 1;
+        }
+        m_buffer.assign(capacity, T());
+        m_mask = capacity - 1;
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        m_discardMark.store(0, std::memory_order_relaxed);
+        m_discardSerial.store(0, std::memory_order_relaxed);
+        m_seenDiscardSerial = 0;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // Producer side
+
+    size_t freeSpace() const
+    {
+        return capacity() - (m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_acquire));
+    }
+
+    //copies up to count items in, returns how many fit
+    size_t write(const T *data, size_t count)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        const size_t space = capacity() - (head - tail);
+        if (count > space) {
+            count = space;
+        }
+        copyIn(head, data, count);
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    //total items ever written, marks a point in the stream for the reader
+    size_t writeIndex() const { return m_head.load(std::memory_order_relaxed); }
+
+    //everything written so far is dropped by the reader on its next read
+    void discardWritten()
+    {
+        m_discardMark.store(m_head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_discardSerial.fetch_add(1, std::memory_order_release);
+    }
+
+    // Consumer side
+
+    size_t available() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed);
+    }
+
+    //total items ever consumed (including discarded ones)
+    size_t readIndex() const { return m_tail.load(std::memory_order_relaxed); }
+
+    //copies up to count items out, discarded sets *discarded when a pending discard was applied
+    size_t read(T *data, size_t count, bool *discarded = nullptr)
+    {
+        // Head first: if it already covers data written after a discard, the discard is visible too
+        size_t head = m_head.load(std::memory_order_acquire);
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        unsigned serial = m_discardSerial.load(std::memory_order_acquire);
+        while (serial != m_seenDiscardSerial) {
+            m_seenDiscardSerial = serial;
+            // The writer may have written and discarded after head was loaded, so the mark can be
+            // past it. reloading head after the serial covers the mark, the clamp covers a mark
+            // from a discard newer still, whose serial the next pass of the loop picks up
+            head = m_head.load(std::memory_order_acquire);
+            size_t mark = m_discardMark.load(std::memory_order_relaxed);
+            if (static_cast<std::ptrdiff_t>(mark - head) > 0) {
+                mark = head;
+            }
+            if (static_cast<std::ptrdiff_t>(mark - tail) > 0) {
+                tail = mark;
+            }
+            if (discarded) {
+                *discarded = true;
+            }
+            serial = m_discardSerial.load(std::memory_order_acquire);
+        }
+
+        const size_t avail = head - tail;
+        if (count > avail) {
+            count = avail;
+        }
+        copyOut(tail, data, count);
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    void copyIn(size_t index, const T *data, size_t count)
+    {
+        const size_t start = index & m_mask;
+        const size_t first = count < capacity() - start ? count : capacity() - start;
+        std::memcpy(m_buffer.data() + start, data, first * sizeof(T));
+        std::memcpy(m_buffer.data(), data + first, (count - first) * sizeof(T));
+    }
+
+    void copyOut(size_t index, T *data, size_t count) const
+    {
+        const size_t start = index & m_mask;
+        const size_t first = count < capacity() - start ? count : capacity() - start;
+        std::memcpy(data, m_buffer.data() + start, first * sizeof(T));
+        std::memcpy(data + first, m_buffer.data(), (count - first) * sizeof(T));
+    }
+
+    std::vector<T> m_buffer;
+    size_t m_mask = 0;
+
+    // Each index is written by one side only, keep them on separate cache lines
+    alignas(64) std::atomic<size_t> m_head{0};      // producer
+    alignas(64) std::atomic<size_t> m_tail{0};      // consumer
+    alignas(64) std::atomic<size_t> m_discardMark{0};
+    std::atomic<unsigned> m_discardSerial{0};
+    unsigned m_seenDiscardSerial = 0;                // consumer only
+};
+
+#endif // RINGBUFFER_H
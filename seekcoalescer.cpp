@@ -0,0 +1,81 @@
+#include "seekcoalescer.h"
+#include <cmath>
+
+SeekCoalescer::SeekCoalescer(QObject *parent)
+    : QObject(parent)
+{
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(IntervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &SeekCoalescer::onIntervalElapsed);
+}
+
+void SeekCoalescer::request(qint64 positionMs)
+{
+    ++m_requests;
+    m_targetMs = positionMs;
+    if (m_timer.isActive()) {
+        m_pendingMs = positionMs;
+        return;
+    }
+    send(positionMs);
+}
+
+void SeekCoalescer::flush()
+{
+    m_timer.stop();
+    if (m_pendingMs >= 0) {
+        const qint64 position = m_pendingMs;
+        m_pendingMs = -1;
+        ++m_seeks;
+        emit seekRequested(position);
+    }
+}
+
+void SeekCoalescer::cancel()
+{
+    m_timer.stop();
+    m_pendingMs = -1;
+}
+
+//opens the interval, requests inside it wait for its end
+void SeekCoalescer::send(qint64 positionMs)
+{
+    m_pendingMs = -1;
+    ++m_seeks;
+    m_timer.start();
+    emit seekRequested(positionMs);
+}
+
+void SeekCoalescer::onIntervalElapsed()
+{
+    if (m_pendingMs >= 0) {
+        send(m_pendingMs);
+    }
+}
+
+namespace Scrub {
+    namespace {
+        // Where the doubling reaches MaxRate, and the travel up to there
+        const double RampMs = DoublingMs * std::log2(MaxRate / BaseRate);
+        const double RampTravel = BaseRate * DoublingMs / std::log(2.0) * (MaxRate / BaseRate - 1.0);
+    }
+
+    double rate(qint64 heldMs)
+    {
+        if (heldMs <= 0) {
+            return BaseRate;
+        }
+        return heldMs >= RampMs ? MaxRate : BaseRate * std::exp2(double(heldMs) / DoublingMs);
+    }
+
+    qint64 travel(qint64 heldMs)
+    {
+        if (heldMs <= 0) {
+            return 0;
+        }
+        if (heldMs >= RampMs) {
+            return qint64(RampTravel + MaxRate * (double(heldMs) - RampMs));
+        }
+        return qint64(BaseRate * DoublingMs / std::log(2.0) * (std::exp2(double(heldMs) / DoublingMs) - 1.0));
+    }
+}
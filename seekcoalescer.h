@@ -0,0 +1,63 @@
+#ifndef SEEKCOALESCER_H
+#define SEEKCOALESCER_H
+
+#include <QObject>
+#include <QTimer>
+
+//latest-wins throttle between the seek controls and the backend. the first request of a burst
+//goes out at once, the ones after it inside IntervalMs only replace the pending target, which is
+//sent when the interval is up. dragging the seek bar so turns into at most 1000 / IntervalMs seeks
+//a second instead of one per mouse move, and always ends where the handle was let go
+class SeekCoalescer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int IntervalMs = 40;
+
+    explicit SeekCoalescer(QObject *parent = nullptr);
+
+    void request(qint64 positionMs);
+    //sends the pending target straight away, e.g. when the handle is released
+    void flush();
+    //forgets the pending target, for a track change under a drag
+    void cancel();
+
+    bool isPending() const { return m_pendingMs >= 0; }
+    //where the last request pointed, sent or not, -1 before the first one
+    qint64 targetMs() const { return m_targetMs; }
+    qint64 requestCount() const { return m_requests; }
+    qint64 seekCount() const { return m_seeks; }
+
+signals:
+    void seekRequested(qint64 positionMs);
+
+private:
+    void send(qint64 positionMs);
+    void onIntervalElapsed();
+
+    QTimer m_timer;
+    qint64 m_pendingMs = -1;
+    qint64 m_targetMs = -1;
+    qint64 m_requests = 0;
+    qint64 m_seeks = 0;
+};
+
+//hold-to-scrub of the next/previous buttons: the position moves by Scrub::rate() times real time,
+//starting at BaseRate and doubling every DoublingMs of holding up to MaxRate. each tick's
+//target goes through the coalescer, so the audio keeps playing a snippet of every stop
+namespace Scrub {
+    constexpr int HoldMs = 500;         // press to scrub, shorter is a click
+    constexpr int TickMs = 50;
+    constexpr double BaseRate = 8.0;
+    constexpr double MaxRate = 128.0;
+    constexpr int DoublingMs = 1000;
+
+    //track ms per ms after heldMs of scrubbing
+    double rate(qint64 heldMs);
+    //track ms covered after heldMs of scrubbing, the rate integrated, so it doesn't depend on
+    //how evenly the ticks come
+    qint64 travel(qint64 heldMs);
+}
+
+#endif // SEEKCOALESCER_H
@@ -0,0 +1,252 @@
+#include "spectrumanalyzer.h"
+#include "dspkernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    constexpr double Pi = 3.14159265358979323846;
+
+    qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SpectrumTransform
+
+SpectrumTransform::SpectrumTransform()
+    : m_window(FftSize)
+    , m_bitReverse(FftSize)
+    , m_twRe(FftSize - 1)
+    , m_twIm(FftSize - 1)
+    , m_re(FftSize)
+    , m_im(FftSize)
+    , m_power(FftSize / 2 + 1)
+    , m_bandFirst(BandCount)
+    , m_bandEnd(BandCount)
+{
+    int bits = 0;
+    while ((1 << bits) < FftSize) {
+        ++bits;
+    }
+    double windowEnergy = 0.0;
+    for (int n = 0; n < FftSize; ++n) {
+        m_window[size_t(n)] = float(0.5 - 0.5 * std::cos(2.0 * Pi * n / FftSize));
+        windowEnergy += double(m_window[size_t(n)]) * m_window[size_t(n)];
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            reversed |= ((n >> b) & 1) << (bits - 1 - b);
+        }
+        m_bitReverse[size_t(n)] = uint16_t(reversed);
+    }
+    for (int half = 1; half < FftSize; half *= 2) {
+        for (int k = 0; k < half; ++k) {
+            m_twRe[size_t(half - 1 + k)] = float(std::cos(-Pi * k / half));
+            m_twIm[size_t(half - 1 + k)] = float(std::sin(-Pi * k / half));
+        }
+    }
+    // A sine of amplitude A leaves N * A^2 / 4 * sum(w^2) in the positive half of the spectrum
+    m_scale = float(4.0 / (double(FftSize) * windowEnergy));
+    setSampleRate(44100);
+}
+
+void SpectrumTransform::setSampleRate(int sampleRate)
+{
+    if (sampleRate <= 0 || sampleRate == m_sampleRate) {
+        return;
+    }
+    m_sampleRate = sampleRate;
+    m_topFrequency = qMin(MaxFrequency, sampleRate * 0.45);
+
+    // Low bands narrower than a bin take the bin their centre falls in
+    const double binHz = double(sampleRate) / FftSize;
+    for (int b = 0; b < BandCount; ++b) {
+        int first = int(std::ceil(bandLow(b) / binHz));
+        int end = int(std::ceil(bandHigh(b) / binHz));
+        if (end <= first) {
+            first = int(std::lround(std::sqrt(bandLow(b) * bandHigh(b)) / binHz));
+            end = first + 1;
+        }
+        m_bandFirst[size_t(b)] = qBound(1, first, FftSize / 2);
+        m_bandEnd[size_t(b)] = qBound(m_bandFirst[size_t(b)] + 1, end, FftSize / 2 + 1);
+    }
+}
+
+double SpectrumTransform::bandLow(int band) const
+{
+    return MinFrequency * std::pow(m_topFrequency / MinFrequency, double(band) / BandCount);
+}
+
+double SpectrumTransform::bandHigh(int band) const
+{
+    return bandLow(band + 1);
+}
+
+void SpectrumTransform::analyze(const float *samples, float *levels)
+{
+    float *re = m_re.data();
+    float *im = m_im.data();
+    for (int n = 0; n < FftSize; ++n) {
+        re[m_bitReverse[size_t(n)]] = samples[n] * m_window[size_t(n)];
+    }
+    std::memset(im, 0, sizeof(float) * FftSize);
+    for (int half = 1; half < FftSize; half *= 2) {
+        Dsp::fftPass(re, im, FftSize, size_t(half), m_twRe.data() + half - 1, m_twIm.data() + half - 1);
+    }
+
+    float *power = m_power.data();
+    for (size_t k = 0; k < m_power.size(); ++k) {
+        power[k] = re[k] * re[k] + im[k] * im[k];
+    }
+    for (int b = 0; b < BandCount; ++b) {
+        float sum = 0.0f;
+        for (int k = m_bandFirst[size_t(b)]; k < m_bandEnd[size_t(b)]; ++k) {
+            sum += power[k];
+        }
+        const float db = sum > 0.0f ? 10.0f * std::log10(sum * m_scale) : FloorDb;
+        levels[b] = qMax(FloorDb, db);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// SpectrumAnalyzer
+
+SpectrumAnalyzer::SpectrumAnalyzer(AudioTap &tap, QObject *parent)
+    : QThread(parent)
+    , m_tap(tap)
+    , m_history(HistorySize, 0.0f)
+    , m_incoming(AudioTap::Capacity)
+    , m_levels(BandCount, SpectrumTransform::FloorDb)
+{
+    m_statsSinceNs.store(nowNs(), std::memory_order_relaxed);
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    setActive(false);
+}
+
+void SpectrumAnalyzer::setActive(bool active)
+{
+    if (active == isRunning()) {
+        return;
+    }
+    m_tap.setEnabled(active);
+    if (active) {
+        start(QThread::LowPriority);
+    } else {
+        requestInterruption();
+        wait();
+    }
+}
+
+// Same hand-over as Equalizer::publish and Equalizer::update, with the roles of the threads swapped
+void SpectrumAnalyzer::publish(const float *levels)
+{
+    std::memcpy(m_slots[m_writeSlot].db, levels, sizeof(float) * BandCount);
+    m_writeSlot = m_middleSlot.exchange(m_writeSlot | FreshBit, std::memory_order_acq_rel) & 3;
+}
+
+bool SpectrumAnalyzer::latest(float *levels)
+{
+    if (!(m_middleSlot.load(std::memory_order_relaxed) & FreshBit)) {
+        return false;
+    }
+    m_readSlot = m_middleSlot.exchange(m_readSlot, std::memory_order_acq_rel) & 3;
+    std::memcpy(levels, m_slots[m_readSlot].db, sizeof(float) * BandCount);
+    return true;
+}
+
+//moves everything queued in the tap onto the end of the history, true when anything came
+bool SpectrumAnalyzer::pull()
+{
+    bool fresh = false;
+    size_t got;
+    while ((got = m_tap.read(m_incoming.data(), m_incoming.size())) > 0) {
+        if (got >= HistorySize) {
+            std::memcpy(m_history.data(), m_incoming.data() + (got - HistorySize), sizeof(float) * HistorySize);
+        } else {
+            std::memmove(m_history.data(), m_history.data() + got, sizeof(float) * (HistorySize - got));
+            std::memcpy(m_history.data() + (HistorySize - got), m_incoming.data(), sizeof(float) * got);
+        }
+        fresh = true;
+    }
+    return fresh;
+}
+
+void SpectrumAnalyzer::run()
+{
+    // Whatever queued up while nobody was reading is stale
+    while (m_tap.read(m_incoming.data(), m_incoming.size()) > 0) {
+    }
+    std::fill(m_history.begin(), m_history.end(), 0.0f);
+
+    const qint64 frameNs = 1000000000 / MaxFps;
+    qint64 nextNs = nowNs();
+    while (!isInterruptionRequested()) {
+        const qint64 start = nowNs();
+        if (start < nextNs) {
+            // A frame at a time, a long budget wait still notices a stop request
+            usleep(static_cast<unsigned long>(qMin(nextNs - start, frameNs) / 1000) + 1);
+            continue;
+        }
+
+        // Paused or stopped: nothing new, nothing to analyse, the display lets the bars fall
+        bool analysed = false;
+        if (pull()) {
+            m_transform.setSampleRate(m_tap.sampleRate());
+            const size_t delay = size_t(qBound(0, m_tap.delayFrames(), MaxDelayFrames));
+            m_transform.analyze(m_history.data() + (HistorySize - SpectrumTransform::FftSize - delay),
+                                m_levels.data());
+            publish(m_levels.data());
+            analysed = true;
+        }
+
+        const qint64 elapsed = nowNs() - start;
+        m_busyNs.fetch_add(elapsed, std::memory_order_relaxed);
+        qint64 pause = frameNs;
+        if (analysed) {
+            m_analyses.fetch_add(1, std::memory_order_relaxed);
+            if (elapsed > m_maxNs.load(std::memory_order_relaxed)) {
+                m_maxNs.store(elapsed, std::memory_order_relaxed);
+            }
+            // The budget: on a machine too slow for MaxFps the rate drops instead of the load rising
+            const qint64 budgetWait = qint64(double(elapsed) / MaxLoad);
+            if (budgetWait > pause) {
+                pause = budgetWait;
+                m_throttled.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        nextNs = start + pause;
+    }
+}
+
+SpectrumStats SpectrumAnalyzer::stats() const
+{
+    SpectrumStats stats;
+    stats.analyses = m_analyses.load(std::memory_order_relaxed);
+    stats.throttled = m_throttled.load(std::memory_order_relaxed);
+    const qint64 busyNs = m_busyNs.load(std::memory_order_relaxed);
+    stats.maxUs = m_maxNs.load(std::memory_order_relaxed) / 1000.0;
+    if (stats.analyses > 0) {
+        stats.averageUs = busyNs / 1000.0 / stats.analyses;
+    }
+    const qint64 wallNs = nowNs() - m_statsSinceNs.load(std::memory_order_relaxed);
+    if (wallNs > 0) {
+        stats.load = double(busyNs) / double(wallNs);
+    }
+    return stats;
+}
+
+void SpectrumAnalyzer::resetStats()
+{
+    m_analyses.store(0, std::memory_order_relaxed);
+    m_throttled.store(0, std::memory_order_relaxed);
+    m_busyNs.store(0, std::memory_order_relaxed);
+    m_maxNs.store(0, std::memory_order_relaxed);
+    m_statsSinceNs.store(nowNs(), std::memory_order_relaxed);
+}
@@ -0,0 +1,121 @@
+#ifndef SPECTRUMANALYZER_H
+#define SPECTRUMANALYZER_H
+
+#include <QThread>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "audiotap.h"
+
+//the analysis on its own: Hann window, FFT through Dsp::fftPass, power summed into log-spaced
+//bands. no threads, the analyzer below, the tests and the benchmark drive it directly
+class SpectrumTransform
+{
+public:
+    static constexpr int FftSize = 4096;
+    static constexpr int BandCount = 40;
+    static constexpr double MinFrequency = 40.0;
+    static constexpr double MaxFrequency = 16000.0;
+    static constexpr float FloorDb = -90.0f;
+
+    SpectrumTransform();
+
+    void setSampleRate(int sampleRate);
+    int sampleRate() const { return m_sampleRate; }
+    //edges of a band in Hz, the top one is lowered for rates whose Nyquist is below MaxFrequency
+    double bandLow(int band) const;
+    double bandHigh(int band) const;
+
+    //FftSize mono samples, oldest first, to BandCount levels in dB. a full-scale sine reads 0 dB
+    //in its band, nothing goes below FloorDb
+    void analyze(const float *samples, float *levels);
+
+private:
+    int m_sampleRate = 0;
+    double m_topFrequency = MaxFrequency;
+    float m_scale = 1.0f;                   // band power relative to a full-scale sine's
+    std::vector<float> m_window;
+    std::vector<uint16_t> m_bitReverse;
+    std::vector<float> m_twRe;              // all passes, the one with half h starts at h - 1
+    std::vector<float> m_twIm;
+    std::vector<float> m_re;
+    std::vector<float> m_im;
+    std::vector<float> m_power;
+    std::vector<int> m_bandFirst;           // bins [first, end) of every band, at least one
+    std::vector<int> m_bandEnd;
+};
+
+//cumulative cost of the analysis since the last reset
+struct SpectrumStats {
+    qint64 analyses = 0;
+    qint64 throttled = 0;       // analyses followed by a longer wait to stay under MaxLoad
+    double averageUs = 0.0;     // per analysis, draining the tap included
+    double maxUs = 0.0;
+    double load = 0.0;          // worker time over wall time, 0.01 = 1 % of a core
+};
+
+//FFT spectrum of what the native engine plays. the audio thread feeds a mono mixdown through the
+//AudioTap, this thread drains it at display rate, analyses the newest FftSize samples (minus the
+//sink's delay, so the bars line up with what is heard) and publishes the band levels through a
+//triple buffer like the equalizer's coefficients: the GUI polls latest() and nobody ever waits.
+//the thread paces itself by what an analysis costs, the pause after one is at least 1 / MaxLoad
+//times as long as it took, so it stays under MaxLoad of one core on any machine
+class SpectrumAnalyzer : public QThread
+{
+public:
+    static constexpr int BandCount = SpectrumTransform::BandCount;
+    static constexpr int MaxFps = 60;
+    static constexpr double MaxLoad = 0.02;
+    static constexpr int MaxDelayFrames = 16384;
+
+    explicit SpectrumAnalyzer(AudioTap &tap, QObject *parent = nullptr);
+    ~SpectrumAnalyzer();
+
+    // GUI thread
+    //starts and stops the thread and the tap with it
+    void setActive(bool active);
+    bool isActive() const { return isRunning(); }
+    //copies the newest BandCount levels, false when nothing was published since the last call
+    bool latest(float *levels);
+    SpectrumStats stats() const;
+    void resetStats();
+    //what feeding it costs the audio thread
+    TapStats tapStats() const { return m_tap.stats(); }
+
+protected:
+    void run() override;
+
+private:
+    struct Levels {
+        float db[BandCount];
+    };
+
+    static constexpr int FreshBit = 4;
+    static constexpr size_t HistorySize = size_t(SpectrumTransform::FftSize) + MaxDelayFrames;
+
+    bool pull();
+    void publish(const float *levels);
+
+    AudioTap &m_tap;
+
+    // Worker side
+    SpectrumTransform m_transform;
+    std::vector<float> m_history;           // newest samples of the tap, oldest first
+    std::vector<float> m_incoming;
+    std::vector<float> m_levels;
+    int m_writeSlot = 0;
+
+    Levels m_slots[3] = {};
+    std::atomic<int> m_middleSlot{1};       // slot index, | FreshBit when the worker published into it
+
+    // GUI side
+    int m_readSlot = 2;
+
+    std::atomic<qint64> m_analyses{0};
+    std::atomic<qint64> m_throttled{0};
+    std::atomic<qint64> m_busyNs{0};
+    std::atomic<qint64> m_maxNs{0};
+    std::atomic<qint64> m_statsSinceNs{0};
+};
+
+#endif // SPECTRUMANALYZER_H
@@ -0,0 +1,110 @@
+#include "spectrumwidget.h"
+#include <QPainter>
+#include <algorithm>
+
+namespace {
+    const QColor BarColor(76, 175, 80, 200);            // The seek bar's played part
+    const QColor PeakColor(255, 255, 255, 160);
+
+    // A paused track stops the analyses, after this long the bars are let down
+    constexpr qint64 StaleMs = 150;
+    constexpr int ToolTipTicks = SpectrumAnalyzer::MaxFps;
+}
+
+SpectrumWidget::SpectrumWidget(SpectrumAnalyzer *analyzer, QWidget *parent)
+    : QWidget(parent)
+    , m_analyzer(analyzer)
+{
+    for (int b = 0; b < BandCount; ++b) {
+        m_incoming[b] = -RangeDb;
+        m_target[b] = -RangeDb;
+        m_levels[b] = -RangeDb;
+        m_peaks[b] = -RangeDb;
+    }
+}
+
+void SpectrumWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    m_clock.start();
+    m_lastTickMs = 0;
+    updateToolTip();
+}
+
+void SpectrumWidget::tick()
+{
+    const qint64 nowMs = m_clock.elapsed();
+    const float seconds = float(nowMs - m_lastTickMs) / 1000.0f;
+    m_lastTickMs = nowMs;
+
+    if (m_analyzer->latest(m_incoming)) {
+        m_lastDataMs = nowMs;
+        for (int b = 0; b < BandCount; ++b) {
+            m_target[b] = qMax(-RangeDb, m_incoming[b]);
+        }
+    } else if (nowMs - m_lastDataMs > StaleMs) {
+        std::fill(m_target, m_target + BandCount, -RangeDb);
+    }
+
+    bool moving = false;
+    for (int b = 0; b < BandCount; ++b) {
+        const float level = qMax(m_target[b], m_levels[b] - FallDbPerSecond * seconds);
+        const float peak = qMax(level, m_peaks[b] - PeakFallDbPerSecond * seconds);
+        moving = moving || level != m_levels[b] || peak != m_peaks[b];
+        m_levels[b] = level;
+        m_peaks[b] = peak;
+    }
+    if (moving) {
+        update();
+    }
+
+    if (++m_ticks >= ToolTipTicks) {
+        m_ticks = 0;
+        updateToolTip();
+    }
+}
+
+void SpectrumWidget::paintEvent(QPaintEvent *)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QPainter painter(this);
+    const qreal width = qreal(this->width()) / BandCount;
+    const qreal height = this->height();
+    auto y = [height](float db) { return height * qreal(-db) / RangeDb; };
+    for (int b = 0; b < BandCount; ++b) {
+        const qreal left = b * width;
+        const qreal top = y(m_levels[b]);
+        if (top < height) {
+            painter.fillRect(QRectF(left + 1.0, top, width - 2.0, height - top), BarColor);
+        }
+        const qreal peak = y(m_peaks[b]);
+        if (peak < height - 1.0) {
+            painter.fillRect(QRectF(left + 1.0, peak, width - 2.0, 2.0), PeakColor);
+        }
+    }
+
+    ++m_paints;
+    m_paintNs += timer.nsecsElapsed();
+}
+
+void SpectrumWidget::updateToolTip()
+{
+    const SpectrumStats stats = m_analyzer->stats();
+    const TapStats tap = m_analyzer->tapStats();
+    if (stats.analyses == 0) {
+        setToolTip("Spectrum: nothing to analyse (needs the native engine and a playing track)");
+        return;
+    }
+    setToolTip(QString("Analysis: %1 us per frame (max %2 us), %3% of a core, capped at %4%%5\n"
+                       "Audio thread tap: %6% of realtime\n"
+                       "Drawing: %7 us per frame")
+        .arg(stats.averageUs, 0, 'f', 1)
+        .arg(stats.maxUs, 0, 'f', 1)
+        .arg(stats.load * 100.0, 0, 'f', 3)
+        .arg(SpectrumAnalyzer::MaxLoad * 100.0, 0, 'f', 0)
+        .arg(stats.throttled > 0 ? QString(", %1 frames slowed down").arg(stats.throttled) : QString())
+        .arg(tap.load * 100.0, 0, 'f', 3)
+        .arg(m_paints > 0 ? m_paintNs / 1000.0 / m_paints : 0.0, 0, 'f', 1));
+}
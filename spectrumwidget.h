@@ -0,0 +1,49 @@
+#ifndef SPECTRUMWIDGET_H
+#define SPECTRUMWIDGET_H
+
+#include <QWidget>
+#include <QElapsedTimer>
+#include "spectrumanalyzer.h"
+
+//bars of a SpectrumAnalyzer, polled and redrawn once per tick() while the widget is visible, the
+//window's FrameScheduler drives it as a continuous client.
+//a bar jumps up to a new level and falls at FallDbPerSecond, a peak mark above it falls slower.
+//nothing is repainted once everything has settled at the bottom. the tooltip shows what the
+//display costs: the analysis thread, the tap on the audio thread and the painting
+class SpectrumWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    static constexpr float RangeDb = 72.0f;             // bottom of the bars is -RangeDb
+    static constexpr float FallDbPerSecond = 60.0f;
+    static constexpr float PeakFallDbPerSecond = 18.0f;
+
+    explicit SpectrumWidget(SpectrumAnalyzer *analyzer, QWidget *parent = nullptr);
+
+    //one display frame: takes the latest levels, moves the bars and repaints if any of them moved
+    void tick();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+
+private:
+    void updateToolTip();
+
+    static constexpr int BandCount = SpectrumAnalyzer::BandCount;
+
+    SpectrumAnalyzer *m_analyzer;
+    QElapsedTimer m_clock;
+    qint64 m_lastTickMs = 0;
+    qint64 m_lastDataMs = 0;
+    float m_incoming[BandCount];
+    float m_target[BandCount];
+    float m_levels[BandCount];
+    float m_peaks[BandCount];
+    int m_ticks = 0;
+    qint64 m_paints = 0;
+    qint64 m_paintNs = 0;
+};
+
+#endif // SPECTRUMWIDGET_H
@@ -0,0 +1,157 @@
+// Sample format conversion throughput, the Dsp kernels at every SIMD level against swresample.
+//
+//   bench_convert [--seconds N]
+//
+// Converts N seconds (default 60) of synthetic 44.1 kHz stereo in the shapes the player sees:
+// S16 / S32 packed and planar into FLTP (the converter's format-only path), and FLT back to
+// S16 with and without dither (the engine's mix stage). Prints ns per sample and the speed
+// against realtime; swresample is run with the same formats and no resampling.
+
+#include "../../dspkernels.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+extern "C" {
+#include <libswresample/swresample.h>
+#include <libavutil/channel_layout.h>
+}
+
+namespace {
+    constexpr int SampleRate = 44100;
+    constexpr int Channels = 2;
+    constexpr int Block = 4096;     // frames per call, about a decoded FLAC frame
+
+    // Best of three runs over every block, in ns per sample
+    double timeBlocks(size_t frames, const std::function<void(size_t offset, size_t count)> &convert)
+    {
+        double best = 0.0;
+        for (int run = 0; run < 3; ++run) {
+            QElapsedTimer timer;
+            timer.start();
+            for (size_t offset = 0; offset < frames; offset += Block) {
+                convert(offset, std::min<size_t>(Block, frames - offset));
+            }
+            const double ns = double(timer.nsecsElapsed()) / double(frames * Channels);
+            best = run == 0 ? ns : std::min(best, ns);
+        }
+        return best;
+    }
+
+    SwrContext *formatOnlySwr(AVSampleFormat out, AVSampleFormat in)
+    {
+        AVChannelLayout layout = AV_CHANNEL_LAYOUT_STEREO;
+        SwrContext *swr = nullptr;
+        if (swr_alloc_set_opts2(&swr, &layout, out, SampleRate, &layout, in, SampleRate, 0, nullptr) < 0
+            || swr_init(swr) < 0) {
+            swr_free(&swr);
+        }
+        return swr;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    int seconds = 60;
+    const QStringList args = app.arguments();
+    const int secondsIndex = args.indexOf("--seconds");
+    if (secondsIndex >= 0 && secondsIndex + 1 < args.size()) {
+        seconds = qMax(1, args[secondsIndex + 1].toInt());
+    }
+
+    const size_t frames = size_t(seconds) * SampleRate;
+    const size_t samples = frames * Channels;
+    std::vector<float> packedFloat(samples);
+    std::vector<int16_t> packed16(samples);
+    std::vector<int32_t> packed32(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        packedFloat[i] = 0.8f * std::sin(float(i / Channels) * 0.0313f + float(i % Channels));
+        packed16[i] = int16_t(std::lrintf(packedFloat[i] * 32767.0f));
+        packed32[i] = int32_t(packed16[i]) << 16;
+    }
+    std::vector<int16_t> planar16(samples);
+    for (size_t i = 0; i < frames; ++i) {
+        planar16[i] = packed16[i * 2];
+        planar16[frames + i] = packed16[i * 2 + 1];
+    }
+
+    std::vector<float> left(frames), right(frames), scratch(size_t(Block) * Channels);
+    std::vector<int16_t> out16(samples);
+    const double realtimeNs = 1e9 / (double(SampleRate) * Channels);
+
+    auto report = [&](const QString &name, double ns) {
+        out << QString("  %1 %2 ns/sample  %3x realtime")
+            .arg(name, -24)
+            .arg(ns, 6, 'f', 3)
+            .arg(realtimeNs / ns, 0, 'f', 0) << Qt::endl;
+    };
+
+    out << QString("%1 s of %2 Hz stereo, %3 frame blocks").arg(seconds).arg(SampleRate).arg(Block) << Qt::endl;
+
+    const Dsp::SimdLevel best = Dsp::detectedSimdLevel();
+    for (int level = 0; level <= int(best); ++level) {
+        Dsp::setSimdLevel(Dsp::SimdLevel(level));
+        out << Dsp::simdLevelName(Dsp::SimdLevel(level)) << Qt::endl;
+
+        report("s16 -> fltp", timeBlocks(frames, [&](size_t offset, size_t count) {
+            Dsp::int16ToFloat(packed16.data() + offset * Channels, scratch.data(), count * Channels);
+            float *planes[Channels] = {left.data() + offset, right.data() + offset};
+            Dsp::deinterleave(scratch.data(), Channels, count, planes);
+        }));
+        report("s16p -> fltp", timeBlocks(frames, [&](size_t offset, size_t count) {
+            Dsp::int16ToFloat(planar16.data() + offset, left.data() + offset, count);
+            Dsp::int16ToFloat(planar16.data() + frames + offset, right.data() + offset, count);
+        }));
+        report("s32 -> fltp", timeBlocks(frames, [&](size_t offset, size_t count) {
+            Dsp::int32ToFloat(packed32.data() + offset * Channels, scratch.data(), count * Channels);
+            float *planes[Channels] = {left.data() + offset, right.data() + offset};
+            Dsp::deinterleave(scratch.data(), Channels, count, planes);
+        }));
+        report("flt -> s16", timeBlocks(frames, [&](size_t offset, size_t count) {
+            Dsp::floatToInt16(packedFloat.data() + offset * Channels, out16.data() + offset * Channels,
+                              count * Channels);
+        }));
+        Dsp::DitherState dither;
+        report("flt -> s16 dithered", timeBlocks(frames, [&](size_t offset, size_t count) {
+            Dsp::floatToInt16(packedFloat.data() + offset * Channels, out16.data() + offset * Channels,
+                              count * Channels, &dither);
+        }));
+    }
+    Dsp::setSimdLevel(best);
+
+    out << "swresample" << Qt::endl;
+    auto reportSwr = [&](const QString &name, AVSampleFormat outFormat, AVSampleFormat inFormat,
+                         const uint8_t *in, int bytesPerFrame, bool planarOut) {
+        SwrContext *swr = formatOnlySwr(outFormat, inFormat);
+        if (!swr) {
+            out << "  " << name << ": swr_init failed" << Qt::endl;
+            return;
+        }
+        report(name, timeBlocks(frames, [&](size_t offset, size_t count) {
+            const uint8_t *src[1] = {in + offset * bytesPerFrame};
+            if (planarOut) {
+                uint8_t *dst[Channels] = {reinterpret_cast<uint8_t *>(left.data() + offset),
+                                          reinterpret_cast<uint8_t *>(right.data() + offset)};
+                swr_convert(swr, dst, int(count), src, int(count));
+            } else {
+                uint8_t *dst[1] = {reinterpret_cast<uint8_t *>(out16.data() + offset * Channels)};
+                swr_convert(swr, dst, int(count), src, int(count));
+            }
+        }));
+        swr_free(&swr);
+    };
+    reportSwr("s16 -> fltp", AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S16,
+              reinterpret_cast<const uint8_t *>(packed16.data()), Channels * 2, true);
+    reportSwr("s32 -> fltp", AV_SAMPLE_FMT_FLTP, AV_SAMPLE_FMT_S32,
+              reinterpret_cast<const uint8_t *>(packed32.data()), Channels * 4, true);
+    reportSwr("flt -> s16", AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_FLT,
+              reinterpret_cast<const uint8_t *>(packedFloat.data()), Channels * 4, false);
+    return 0;
+}
@@ -0,0 +1,190 @@
+// FLAC decoding throughput, the native frame decoder at every SIMD level against libavcodec.
+//
+//   bench_flacdecode [--runs N] file-or-directory...
+//
+// Directories are searched recursively for .flac files. Every file is decoded N times (default
+// 3, the best run counts) with FlacFileDecoder into int32 planes and with AudioDecoder, which
+// is what playback and the converter used before, plus once with ParallelFlacDecoder on every
+// core. Prints the input rate in MB/s and the speed against realtime per file and for the whole
+// corpus. Run it once first so the page cache is warm.
+
+#include "../../audiodecoder.h"
+#include "../../dspkernels.h"
+#include "../../flacdecoder.h"
+#include "../../parallelflacdecoder.h"
+#include <QCoreApplication>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+#include <vector>
+
+namespace {
+    struct Totals {
+        qint64 bytes = 0;
+        qint64 samples = 0;     // per channel
+        qint64 ns = 0;
+    };
+
+    //samples per channel, or -1
+    qint64 decodeNative(const QString &file)
+    {
+        FlacFileDecoder decoder;
+        if (!decoder.open(file)) {
+            return -1;
+        }
+        std::vector<std::vector<int32_t>> planes(size_t(decoder.channels()),
+                                                 std::vector<int32_t>(size_t(decoder.maxBlockSize())));
+        std::vector<int32_t *> pointers;
+        for (std::vector<int32_t> &plane : planes) {
+            pointers.push_back(plane.data());
+        }
+        qint64 samples = 0;
+        int frames;
+        while ((frames = decoder.decodeNext(pointers.data(), decoder.maxBlockSize())) > 0) {
+            samples += frames;
+        }
+        return frames < 0 ? -1 : samples;
+    }
+
+    qint64 decodeParallel(const QString &file)
+    {
+        ParallelFlacDecoder decoder;
+        if (!decoder.open(file, QThread::idealThreadCount())) {
+            return -1;
+        }
+        qint64 samples = 0;
+        int frames;
+        while ((frames = decoder.next()) > 0) {
+            samples += frames;
+        }
+        return frames < 0 ? -1 : samples;
+    }
+
+    qint64 decodeLibav(const QString &file)
+    {
+        AudioDecoder decoder;
+        if (!decoder.open(file)) {
+            return -1;
+        }
+        qint64 samples = 0;
+        while (AVFrame *frame = decoder.decodeNextFrame()) {
+            samples += frame->nb_samples;
+        }
+        return samples;
+    }
+
+    QString columnName(int column, int columns)
+    {
+        if (column == columns - 1) {
+            return "libavcodec";
+        }
+        if (column == columns - 2) {
+            return QString("%1 thr").arg(QThread::idealThreadCount());
+        }
+        return Dsp::simdLevelName(Dsp::SimdLevel(column));
+    }
+
+    QString rates(const Totals &totals, int sampleRate)
+    {
+        if (totals.ns <= 0) {
+            return "-";
+        }
+        const double seconds = totals.ns / 1e9;
+        return QString("%1 MB/s %2x").arg(totals.bytes / seconds / 1e6, 7, 'f', 1)
+            .arg(double(totals.samples) / sampleRate / seconds, 6, 'f', 0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    int runs = 3;
+    QStringList paths = app.arguments().mid(1);
+    const int runsIndex = paths.indexOf("--runs");
+    if (runsIndex >= 0 && runsIndex + 1 < paths.size()) {
+        runs = qMax(1, paths[runsIndex + 1].toInt());
+        paths.remove(runsIndex, 2);
+    }
+    QStringList files;
+    for (const QString &path : paths) {
+        if (QFileInfo(path).isDir()) {
+            QDirIterator it(path, {"*.flac", "*.FLAC"}, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                files.append(it.next());
+            }
+        } else {
+            files.append(path);
+        }
+    }
+    if (files.isEmpty()) {
+        out << "usage: bench_flacdecode [--runs N] file-or-directory..." << Qt::endl;
+        return 2;
+    }
+
+    const Dsp::SimdLevel best = Dsp::detectedSimdLevel();
+    // One column per SIMD level, then the parallel decoder at the best one, libavcodec last
+    const int columns = int(best) + 3;
+    std::vector<Totals> corpus(size_t(columns));
+    int corpusRate = 0;
+
+    for (const QString &file : files) {
+        FlacFileDecoder probe;
+        if (!probe.open(file)) {
+            out << QFileInfo(file).fileName() << ": " << probe.lastError() << Qt::endl;
+            continue;
+        }
+        const int sampleRate = probe.sampleRate();
+        const qint64 bytes = QFileInfo(file).size();
+        corpusRate = corpusRate == 0 || corpusRate == sampleRate ? sampleRate : -1;
+        out << QString("%1 (%2 bit, %3 Hz, %4 ch)").arg(QFileInfo(file).fileName())
+            .arg(probe.bitsPerSample()).arg(sampleRate).arg(probe.channels()) << Qt::endl;
+        probe.close();
+
+        for (int column = 0; column < columns; ++column) {
+            const bool libav = column == columns - 1;
+            const bool parallel = column == columns - 2;
+            Dsp::setSimdLevel(libav || parallel ? best : Dsp::SimdLevel(column));
+            Totals totals;
+            totals.bytes = bytes;
+            totals.ns = -1;
+            for (int run = 0; run < runs; ++run) {
+                QElapsedTimer timer;
+                timer.start();
+                const qint64 samples = libav ? decodeLibav(file) : parallel ? decodeParallel(file) : decodeNative(file);
+                const qint64 ns = timer.nsecsElapsed();
+                if (samples < 0) {
+                    break;
+                }
+                totals.samples = samples;
+                totals.ns = totals.ns < 0 ? ns : std::min(totals.ns, ns);
+            }
+            const QString name = columnName(column, columns);
+            if (totals.ns < 0) {
+                out << QString("  %1: decode failed").arg(name, -10) << Qt::endl;
+                continue;
+            }
+            out << QString("  %1 %2").arg(name, -10).arg(rates(totals, sampleRate)) << Qt::endl;
+            corpus[size_t(column)].bytes += totals.bytes;
+            corpus[size_t(column)].samples += totals.samples;
+            corpus[size_t(column)].ns += totals.ns;
+        }
+        Dsp::setSimdLevel(best);
+    }
+
+    // Realtime only adds up when every file has the same rate
+    out << "corpus" << Qt::endl;
+    for (int column = 0; column < columns; ++column) {
+        const QString name = columnName(column, columns);
+        const double seconds = corpus[size_t(column)].ns / 1e9;
+        out << QString("  %1 %2").arg(name, -10)
+            .arg(corpusRate > 0 ? rates(corpus[size_t(column)], corpusRate)
+                 : QString("%1 MB/s").arg(seconds > 0 ? corpus[size_t(column)].bytes / seconds / 1e6 : 0.0, 7, 'f', 1))
+            << Qt::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,171 @@
+// Metadata parser throughput over a generated corpus.
+//
+//   bench_metadata [--files N] [--tags N] [--art PX] [--passes N] [--write-corpus DIR]
+//
+// Reports files/s and MB/s of metadata for three modes:
+//   file/all   readMetadata() from disk with every field (pictures decoded)
+//   file/tags  readMetadata() from disk with FieldTags, pictures are seeked over
+//   memory     parseMetadata() on buffers already in memory, parser cost only
+// The metadata cache is cleared before every pass so each read really parses.
+
+#include "../../audiomanager.h"
+#include "../flacfixture.h"
+#include <QBuffer>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+namespace {
+    struct Options {
+        int files = 500;
+        int tags = 24;
+        int artSize = 500;
+        int passes = 3;
+        QString corpusDir;
+    };
+
+    struct Corpus {
+        QStringList paths;
+        QList<QByteArray> streams;
+        qint64 metadataBytes = 0;
+    };
+
+    QByteArray makeCoverArt(int size)
+    {
+        QImage image(size, size, QImage::Format_RGB32);
+        QRandomGenerator rng(42);
+        for (int y = 0; y < size; ++y) {
+            QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < size; ++x) {
+                line[x] = qRgb(x * 255 / size, y * 255 / size, rng.bounded(64));
+            }
+        }
+        QByteArray png;
+        QBuffer buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer, "PNG");
+        return png;
+    }
+
+    Corpus generateCorpus(const Options &options, const QString &dir)
+    {
+        Corpus corpus;
+        const QByteArray cover = makeCoverArt(options.artSize);
+        QRandomGenerator rng(1234);
+
+        for (int i = 0; i < options.files; ++i) {
+            QList<QPair<QString, QString>> tags;
+            tags << qMakePair(QString("TITLE"), QString("Track %1").arg(i))
+                 << qMakePair(QString("ARTIST"), QString("Benchmark Artist"))
+                 << qMakePair(QString("ALBUM"), QString("Benchmark Album %1").arg(i / 12));
+            for (int t = tags.size(); t < options.tags; ++t) {
+                tags << qMakePair(QString("CUSTOM_%1").arg(t), QString(40, QChar('a' + t % 26)));
+            }
+
+            QByteArray seekTable(18 * 32, '\0');
+            QList<FlacFixture::Block> blocks {
+                {FlacFixture::StreamInfo, FlacFixture::streamInfo(44100, 2, 16, 44100ULL * (180 + i % 120))},
+                {FlacFixture::SeekTable, seekTable},
+                {FlacFixture::VorbisComment, FlacFixture::vorbisComment(tags)},
+                {FlacFixture::Picture, FlacFixture::picture(cover)},
+                {FlacFixture::Padding, QByteArray(8192, '\0')}
+            };
+            QByteArray metadata = FlacFixture::flacStream(blocks);
+
+            // A little fake audio so files look like files, it is never touched by the parser
+            QByteArray audio(64 * 1024, '\0');
+            for (char &c : audio) {
+                c = static_cast<char>(rng.bounded(256));
+            }
+
+            QString path = QDir(dir).filePath(QString("bench_%1.flac").arg(i, 5, 10, QChar('0')));
+            QFile file(path);
+            if (file.open(QIODevice::WriteOnly)) {
+                file.write(metadata);
+                file.write(audio);
+            }
+
+            corpus.paths << path;
+            corpus.streams << metadata;
+            corpus.metadataBytes += metadata.size();
+        }
+        return corpus;
+    }
+
+    void report(QTextStream &out, const QString &mode, int files, qint64 bytes, qint64 nsecs)
+    {
+        double seconds = qMax<qint64>(nsecs, 1) / 1e9;
+        out << QString("%1 %2 files  %3 s  %4 files/s  %5 MB/s")
+            .arg(mode, -10)
+            .arg(files, 6)
+            .arg(seconds, 8, 'f', 3)
+            .arg(files / seconds, 10, 'f', 0)
+            .arg(bytes / (1024.0 * 1024.0) / seconds, 8, 'f', 1) << Qt::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    Options options;
+    const QStringList args = app.arguments();
+    for (int i = 1; i + 1 < args.size(); i += 2) {
+        if (args[i] == "--files") {
+            options.files = args[i + 1].toInt();
+        } else if (args[i] == "--tags") {
+            options.tags = args[i + 1].toInt();
+        } else if (args[i] == "--art") {
+            options.artSize = args[i + 1].toInt();
+        } else if (args[i] == "--passes") {
+            options.passes = args[i + 1].toInt();
+        } else if (args[i] == "--write-corpus") {
+            options.corpusDir = args[i + 1];
+        }
+    }
+
+    QTemporaryDir tempDir;
+    QString dir = options.corpusDir.isEmpty() ? tempDir.path() : options.corpusDir;
+    QDir().mkpath(dir);
+
+    Corpus corpus = generateCorpus(options, dir);
+    out << QString("corpus: %1 files, %2 MB of metadata in %3")
+        .arg(corpus.paths.size())
+        .arg(corpus.metadataBytes / (1024.0 * 1024.0), 0, 'f', 1)
+        .arg(dir) << Qt::endl;
+
+    MetadataEditor editor;
+    QElapsedTimer timer;
+
+    for (int pass = 0; pass < options.passes; ++pass) {
+        out << "pass " << (pass + 1) << Qt::endl;
+
+        MetadataEditor::clearCache();
+        timer.start();
+        for (const QString &path : corpus.paths) {
+            editor.readMetadata(path, MetadataEditor::FieldAll);
+        }
+        report(out, "file/all", corpus.paths.size(), corpus.metadataBytes, timer.nsecsElapsed());
+
+        MetadataEditor::clearCache();
+        timer.start();
+        for (const QString &path : corpus.paths) {
+            editor.readMetadata(path, MetadataEditor::FieldStreamInfo | MetadataEditor::FieldTags);
+        }
+        report(out, "file/tags", corpus.paths.size(), corpus.metadataBytes, timer.nsecsElapsed());
+
+        timer.start();
+        for (const QByteArray &stream : corpus.streams) {
+            editor.parseMetadata(stream, MetadataEditor::FieldStreamInfo | MetadataEditor::FieldTags);
+        }
+        report(out, "memory", corpus.streams.size(), corpus.metadataBytes, timer.nsecsElapsed());
+    }
+
+    return 0;
+}
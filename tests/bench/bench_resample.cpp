@@ -0,0 +1,105 @@
+// Rate conversion cost of every resampler profile.
+//
+//   bench_resample [--seconds N]
+//
+// Converts N seconds (default 30) of synthetic stereo float between the rate pairs the player
+// meets (CD material to a 48 kHz device, hi-res down to CD/48k, CD up to 96k) and prints the CPU
+// time per second of audio. Setup is timed twice: cold, which builds the filter bank, and from
+// the Resampler cache after a release, which is what the next track at the same rates pays.
+
+#include "../../resampler.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+namespace {
+    constexpr int Channels = 2;
+    constexpr int Block = 4096;
+
+    struct RatePair {
+        int in;
+        int out;
+    };
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    int seconds = 30;
+    const QStringList args = app.arguments();
+    const int secondsIndex = args.indexOf("--seconds");
+    if (secondsIndex >= 0 && secondsIndex + 1 < args.size()) {
+        seconds = qMax(1, args[secondsIndex + 1].toInt());
+    }
+
+    out << QString("%1 s of stereo float, %2 frame blocks, soxr %3")
+        .arg(seconds).arg(Block).arg(Resampler::soxrAvailable() ? "available" : "not available") << Qt::endl;
+
+    const RatePair pairs[] = {{44100, 48000}, {96000, 44100}, {192000, 48000}, {44100, 96000}};
+    AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+
+    for (const RatePair &pair : pairs) {
+        out << QString("%1 -> %2 Hz").arg(pair.in).arg(pair.out) << Qt::endl;
+
+        const size_t frames = size_t(seconds) * pair.in;
+        std::vector<float> input(frames * Channels);
+        for (size_t i = 0; i < frames; ++i) {
+            input[i * 2] = 0.5f * std::sin(float(i) * 0.0713f);
+            input[i * 2 + 1] = 0.5f * std::sin(float(i) * 0.0291f);
+        }
+        const int outCapacity = int(int64_t(Block) * pair.out / pair.in) + 256;
+        std::vector<float> output(size_t(outCapacity) * Channels);
+
+        for (ResamplerProfile profile : {ResamplerProfile::Fast, ResamplerProfile::Balanced,
+                                         ResamplerProfile::HighQuality, ResamplerProfile::Soxr}) {
+            if (profile == ResamplerProfile::Soxr && !Resampler::soxrAvailable()) {
+                continue;
+            }
+            Resampler::clearCache();
+
+            QElapsedTimer timer;
+            timer.start();
+            SwrContext *swr = Resampler::acquire(&stereo, AV_SAMPLE_FMT_FLT, pair.out,
+                                                 &stereo, AV_SAMPLE_FMT_FLT, pair.in, profile);
+            const double coldUs = timer.nsecsElapsed() / 1000.0;
+            if (!swr) {
+                out << "  " << Resampler::profileName(profile) << ": swr_init failed" << Qt::endl;
+                continue;
+            }
+
+            timer.restart();
+            for (size_t offset = 0; offset < frames; offset += Block) {
+                const int count = int(std::min<size_t>(Block, frames - offset));
+                const uint8_t *src[1] = {reinterpret_cast<const uint8_t *>(input.data() + offset * Channels)};
+                uint8_t *dst[1] = {reinterpret_cast<uint8_t *>(output.data())};
+                swr_convert(swr, dst, outCapacity, src, count);
+            }
+            const double msPerSecond = timer.nsecsElapsed() / 1e6 / seconds;
+
+            Resampler::release(swr);
+            timer.restart();
+            swr = Resampler::acquire(&stereo, AV_SAMPLE_FMT_FLT, pair.out,
+                                     &stereo, AV_SAMPLE_FMT_FLT, pair.in, profile);
+            const double cachedUs = timer.nsecsElapsed() / 1000.0;
+            Resampler::release(swr);
+
+            out << QString("  %1 %2 ms CPU per s (%3% of a core)  init %4 us cold, %5 us cached")
+                .arg(Resampler::profileName(profile), -24)
+                .arg(msPerSecond, 7, 'f', 2)
+                .arg(msPerSecond / 10.0, 0, 'f', 2)
+                .arg(coldUs, 0, 'f', 0)
+                .arg(cachedUs, 0, 'f', 0) << Qt::endl;
+        }
+    }
+    Resampler::clearCache();
+    return 0;
+}
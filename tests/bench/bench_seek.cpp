@@ -0,0 +1,89 @@
+// Seek latency on real files, the path the native engine takes for every setPosition().
+//
+//   bench_seek [--seeks N] file...
+//
+// For each file, N random positions are sought with AudioDecoder::seek() and decoded up to
+// the frame holding the target, which is the work done before the first audio can be queued.
+// Prints p50 / p95 / max per file; FLAC goes through FlacSeeker, everything else through
+// the demuxer's timestamp seek. Run it twice to compare cold and warm page cache.
+
+#include "../../audiodecoder.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <algorithm>
+#include <vector>
+
+namespace {
+    double percentile(std::vector<qint64> &values, double p)
+    {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        size_t index = static_cast<size_t>(p * (values.size() - 1));
+        return values[index] / 1000.0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    int seeks = 200;
+    QStringList files = app.arguments().mid(1);
+    int seeksIndex = files.indexOf("--seeks");
+    if (seeksIndex >= 0 && seeksIndex + 1 < files.size()) {
+        seeks = files[seeksIndex + 1].toInt();
+        files.remove(seeksIndex, 2);
+    }
+    if (files.isEmpty()) {
+        out << "usage: bench_seek [--seeks N] file..." << Qt::endl;
+        return 2;
+    }
+
+    QRandomGenerator rng(7);
+    for (const QString &file : files) {
+        AudioDecoder decoder;
+        if (!decoder.open(file)) {
+            out << file << ": " << decoder.lastError() << Qt::endl;
+            continue;
+        }
+        const qint64 total = decoder.totalSamples();
+        if (total <= 0) {
+            out << file << ": unknown length, skipped" << Qt::endl;
+            continue;
+        }
+
+        std::vector<qint64> latencies;
+        int failures = 0;
+        QElapsedTimer timer;
+        for (int i = 0; i < seeks; ++i) {
+            const qint64 target = static_cast<qint64>(rng.bounded(static_cast<double>(total)));
+            timer.start();
+            if (!decoder.seek(target)) {
+                ++failures;
+                continue;
+            }
+            while (AVFrame *frame = decoder.decodeNextFrame()) {
+                const qint64 start = decoder.frameStartSample(frame);
+                if (start < 0 || start + frame->nb_samples > target) {
+                    break;
+                }
+            }
+            latencies.push_back(timer.nsecsElapsed() / 1000);
+        }
+
+        out << QString("%1: p50 %2 ms  p95 %3 ms  max %4 ms  (%5 seeks, %6 failed)")
+            .arg(QFileInfo(file).fileName())
+            .arg(percentile(latencies, 0.50), 0, 'f', 2)
+            .arg(percentile(latencies, 0.95), 0, 'f', 2)
+            .arg(percentile(latencies, 1.0), 0, 'f', 2)
+            .arg(latencies.size())
+            .arg(failures) << Qt::endl;
+    }
+    return 0;
+}
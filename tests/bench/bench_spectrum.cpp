@@ -0,0 +1,113 @@
+// Cost of the spectrum display's two halves: the analysis thread and the tap on the audio thread.
+//
+//   bench_spectrum [--frames N]
+//
+// Runs N analyses (default 2000) of music-like noise at every SIMD level and prints the time per
+// analysis and what that comes to at the display's frame rate, against the analyzer's load cap.
+// The tap is fed 60 s of 48 kHz stereo in the engine's sink formats in 1024-frame reads, a reader
+// draining it alongside, and its share of the audio thread's realtime is printed.
+
+#include "../../spectrumanalyzer.h"
+#include "../../dspkernels.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+    constexpr int SampleRate = 48000;
+    constexpr int Channels = 2;
+    constexpr int ReadFrames = 1024;    // a typical sink pull
+
+    std::vector<float> testSignal(size_t count)
+    {
+        std::vector<float> samples(count);
+        uint32_t noise = 12345;
+        for (size_t i = 0; i < count; ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            const float hiss = (float(noise >> 8) / float(1 << 24) - 0.5f) * 0.1f;
+            samples[i] = 0.4f * std::sin(float(i) * 0.0571f) + 0.2f * std::sin(float(i) * 0.3123f) + hiss;
+        }
+        return samples;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    int frames = 2000;
+    const QStringList args = app.arguments();
+    const int framesIndex = args.indexOf("--frames");
+    if (framesIndex >= 0 && framesIndex + 1 < args.size()) {
+        frames = qMax(1, args[framesIndex + 1].toInt());
+    }
+
+    out << QString("%1-point FFT, %2 bands, %3 analyses per level, cap %4% of a core at %5 fps")
+        .arg(SpectrumTransform::FftSize).arg(SpectrumTransform::BandCount).arg(frames)
+        .arg(SpectrumAnalyzer::MaxLoad * 100.0, 0, 'f', 0).arg(SpectrumAnalyzer::MaxFps) << Qt::endl;
+
+    const std::vector<float> signal = testSignal(size_t(SpectrumTransform::FftSize) * 8);
+    std::vector<float> levels(SpectrumTransform::BandCount);
+    const Dsp::SimdLevel best = Dsp::detectedSimdLevel();
+    for (int l = 0; l <= int(best); ++l) {
+        const Dsp::SimdLevel level = Dsp::SimdLevel(l);
+        Dsp::setSimdLevel(level);
+        SpectrumTransform transform;
+        transform.setSampleRate(SampleRate);
+
+        QElapsedTimer timer;
+        timer.start();
+        for (int f = 0; f < frames; ++f) {
+            // Hop through the signal like the display does, by a frame's worth of samples
+            const size_t offset = size_t(f % 8) * (signal.size() - SpectrumTransform::FftSize) / 8;
+            transform.analyze(signal.data() + offset, levels.data());
+        }
+        const double us = timer.nsecsElapsed() / 1000.0 / frames;
+        out << QString("  %1 %2 us per analysis, %3% of a core at %4 fps")
+            .arg(Dsp::simdLevelName(level), -8)
+            .arg(us, 7, 'f', 1)
+            .arg(us * SpectrumAnalyzer::MaxFps / 1e4, 0, 'f', 3)
+            .arg(SpectrumAnalyzer::MaxFps) << Qt::endl;
+    }
+    Dsp::setSimdLevel(best);
+
+    out << "Tap, 60 s of 48 kHz stereo" << Qt::endl;
+    const std::vector<float> mono = testSignal(size_t(SampleRate));
+    std::vector<float> interleaved(mono.size() * Channels);
+    for (size_t i = 0; i < mono.size(); ++i) {
+        interleaved[i * 2] = mono[i];
+        interleaved[i * 2 + 1] = -mono[i];
+    }
+    std::vector<float> drained(AudioTap::Capacity);
+    for (QAudioFormat::SampleFormat sampleFormat : {QAudioFormat::Int16, QAudioFormat::Int32, QAudioFormat::Float}) {
+        QAudioFormat format;
+        format.setSampleRate(SampleRate);
+        format.setChannelCount(Channels);
+        format.setSampleFormat(sampleFormat);
+        std::vector<char> sink(interleaved.size() * size_t(format.bytesPerSample()));
+        Dsp::fromFloat(sampleFormat, interleaved.data(), sink.data(), interleaved.size());
+
+        AudioTap tap;
+        tap.setSampleRate(SampleRate);
+        tap.setEnabled(true);
+        const qint64 reads = qint64(mono.size()) / ReadFrames;
+        for (int second = 0; second < 60; ++second) {
+            for (qint64 r = 0; r < reads; ++r) {
+                tap.push(format, sink.data() + r * ReadFrames * format.bytesPerFrame(), ReadFrames);
+                if (tap.available() > AudioTap::Capacity / 2) {
+                    tap.read(drained.data(), drained.size());
+                }
+            }
+        }
+        const TapStats stats = tap.stats();
+        out << QString("  %1 %2% of realtime, %3 dropped")
+            .arg(sampleFormat == QAudioFormat::Int16 ? "int16" : sampleFormat == QAudioFormat::Int32 ? "int32" : "float", -8)
+            .arg(stats.load * 100.0, 0, 'f', 4)
+            .arg(stats.dropped) << Qt::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,238 @@
+#ifndef FLACFIXTURE_H
+#define FLACFIXTURE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <cmath>
+
+// Builds synthetic FLAC streams (header + metadata blocks + fake audio) in memory, and plain
+// PCM WAV files for tests that need audio ffmpeg can actually decode.
+// Shared by the parser tests, the fuzz harness seed corpus and the metadata benchmark
+namespace FlacFixture {
+
+enum BlockType : quint8 {
+    StreamInfo = 0,
+    Padding = 1,
+    SeekTable = 3,
+    VorbisComment = 4,
+    CueSheet = 5,
+    Picture = 6
+};
+
+struct Block {
+    quint8 type;
+    QByteArray data;
+};
+
+inline void appendBE(QByteArray &out, quint64 value, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; --i) {
+        out.append(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+inline void appendLE32(QByteArray &out, quint32 value)
+{
+    for (int i = 0; i < 4; ++i) {
+        out.append(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+inline QByteArray streamInfo(int sampleRate = 44100, int channels = 2, int bitsPerSample = 16,
+                             quint64 totalSamples = 441000)
+{
+    QByteArray data;
+    appendBE(data, 4096, 2);    // min block size
+    appendBE(data, 4096, 2);    // max block size
+    appendBE(data, 0, 3);       // min frame size
+    appendBE(data, 0, 3);       // max frame size
+    quint64 packed = (static_cast<quint64>(sampleRate) << 44)
+                   | (static_cast<quint64>(channels - 1) << 41)
+                   | (static_cast<quint64>(bitsPerSample - 1) << 36)
+                   | (totalSamples & 0xFFFFFFFFFULL);
+    appendBE(data, packed, 8);
+    data.append(QByteArray(16, '\0')); // no MD5
+    return data;
+}
+
+inline QByteArray vorbisComment(const QList<QPair<QString, QString>> &tags,
+                                const QByteArray &vendor = "flacfixture")
+{
+    QByteArray data;
+    appendLE32(data, vendor.size());
+    data.append(vendor);
+    appendLE32(data, tags.size());
+    for (const auto &tag : tags) {
+        QByteArray entry = (tag.first + "=" + tag.second).toUtf8();
+        appendLE32(data, entry.size());
+        data.append(entry);
+    }
+    return data;
+}
+
+inline QByteArray picture(const QByteArray &imageData, const QByteArray &mime = "image/png")
+{
+    QByteArray data;
+    appendBE(data, 3, 4);           // front cover
+    appendBE(data, mime.size(), 4);
+    data.append(mime);
+    appendBE(data, 0, 4);           // empty description
+    appendBE(data, 0, 16);          // width, height, depth, colors (unused by the parser)
+    appendBE(data, imageData.size(), 4);
+    data.append(imageData);
+    return data;
+}
+
+inline QByteArray flacStream(const QList<Block> &blocks, const QByteArray &audio = QByteArray())
+{
+    QByteArray out("fLaC");
+    for (int i = 0; i < blocks.size(); ++i) {
+        bool last = (i == blocks.size() - 1);
+        out.append(static_cast<char>(blocks[i].type | (last ? 0x80 : 0x00)));
+        appendBE(out, blocks[i].data.size(), 3);
+        out.append(blocks[i].data);
+    }
+    out.append(audio);
+    return out;
+}
+
+struct CueSheetTrack {
+    quint64 offset;                             // samples
+    quint8 number;                              // 170 (CD-DA) or 255 for the lead-out
+    QList<QPair<quint8, quint64>> indices;      // (index number, offset from the track)
+    bool audio = true;
+    QByteArray isrc;
+};
+
+// CUESHEET of the given tracks, lead-out included. trackCount overrides the count byte
+inline QByteArray cueSheet(const QList<CueSheetTrack> &tracks, int trackCount = -1)
+{
+    QByteArray data(128, '\0');                 // no catalog number
+    appendBE(data, 88200, 8);                   // lead-in
+    data.append(static_cast<char>(0x80));       // CD-DA
+    data.append(QByteArray(258, '\0'));
+    data.append(static_cast<char>(trackCount < 0 ? tracks.size() : trackCount));
+    for (const CueSheetTrack &track : tracks) {
+        appendBE(data, track.offset, 8);
+        data.append(static_cast<char>(track.number));
+        data.append(track.isrc.leftJustified(12, '\0', true));
+        data.append(static_cast<char>(track.audio ? 0x00 : 0x80));
+        data.append(QByteArray(13, '\0'));
+        data.append(static_cast<char>(track.indices.size()));
+        for (const auto &index : track.indices) {
+            appendBE(data, index.second, 8);
+            data.append(static_cast<char>(index.first));
+            data.append(QByteArray(3, '\0'));
+        }
+    }
+    return data;
+}
+
+// SEEKTABLE with one point per (sample, offset) pair, offsets relative to the first frame
+inline QByteArray seekTable(const QList<QPair<quint64, quint64>> &points, int frameSamples = 4096)
+{
+    QByteArray data;
+    for (const auto &point : points) {
+        appendBE(data, point.first, 8);
+        appendBE(data, point.second, 8);
+        appendBE(data, frameSamples, 2);
+    }
+    return data;
+}
+
+inline quint8 crc8(const QByteArray &data)
+{
+    quint8 crc = 0;
+    for (char c : data) {
+        crc ^= static_cast<quint8>(c);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 0x80) ? static_cast<quint8>((crc << 1) ^ 0x07) : static_cast<quint8>(crc << 1);
+        }
+    }
+    return crc;
+}
+
+// Frame/sample number in the UTF-8 style coding of frame headers
+inline void appendCodedNumber(QByteArray &out, quint64 value)
+{
+    if (value < 0x80) {
+        out.append(static_cast<char>(value));
+        return;
+    }
+    int extra = 1;
+    while (extra < 6 && value >= (1ULL << (6 * extra + 6 - extra))) {
+        ++extra;
+    }
+    const quint8 lead = static_cast<quint8>(0xFF00 >> (extra + 1));
+    out.append(static_cast<char>(lead | (value >> (6 * extra))));
+    for (int i = extra - 1; i >= 0; --i) {
+        out.append(static_cast<char>(0x80 | ((value >> (6 * i)) & 0x3F)));
+    }
+}
+
+// Fixed block size frame header: 4096 samples, 44.1 kHz, stereo, 16-bit (matches streamInfo())
+inline QByteArray frameHeader(quint64 frameNumber)
+{
+    QByteArray header;
+    header.append(static_cast<char>(0xFF));
+    header.append(static_cast<char>(0xF8));
+    header.append(static_cast<char>((12 << 4) | 9));
+    header.append(static_cast<char>((1 << 4) | (4 << 1)));
+    appendCodedNumber(header, frameNumber);
+    header.append(static_cast<char>(crc8(header)));
+    return header;
+}
+
+// Frames of fake audio behind valid headers, offsets gets each frame's offset from the first.
+// Every payload opens with a sync code whose header is invalid, like real audio data does now and then
+inline QByteArray fakeFrames(int count, QList<qint64> *offsets = nullptr)
+{
+    QByteArray audio;
+    for (int i = 0; i < count; ++i) {
+        if (offsets) {
+            offsets->append(audio.size());
+        }
+        audio.append(frameHeader(i));
+        audio.append("\xFF\xF8\xC9\x18\x00\x00", 6);
+        audio.append(QByteArray(200 + (i * 37) % 300, static_cast<char>(0x55 + i % 7)));
+    }
+    return audio;
+}
+
+// 16-bit stereo PCM WAV, a quarter-scale 1 kHz sine
+inline QByteArray pcmWav(int sampleRate, int frames)
+{
+    QByteArray pcm;
+    for (int i = 0; i < frames; ++i) {
+        const qint16 sample = qint16(8192.0 * std::sin(6.283185307179586 * 1000.0 * i / sampleRate));
+        for (int channel = 0; channel < 2; ++channel) {
+            pcm.append(char(sample & 0xFF));
+            pcm.append(char((sample >> 8) & 0xFF));
+        }
+    }
+    auto le = [](QByteArray &out, quint32 value, int bytes) {
+        for (int i = 0; i < bytes; ++i) {
+            out.append(char((value >> (8 * i)) & 0xFF));
+        }
+    };
+    QByteArray out("RIFF");
+    le(out, 36 + quint32(pcm.size()), 4);
+    out.append("WAVEfmt ");
+    le(out, 16, 4);
+    le(out, 1, 2);                          // PCM
+    le(out, 2, 2);
+    le(out, quint32(sampleRate), 4);
+    le(out, quint32(sampleRate) * 4, 4);
+    le(out, 4, 2);
+    le(out, 16, 2);
+    out.append("data");
+    le(out, quint32(pcm.size()), 4);
+    out.append(pcm);
+    return out;
+}
+
+} // namespace FlacFixture
+
+#endif // FLACFIXTURE_H
@@ -0,0 +1,99 @@
+// Fuzz harness for the FLAC metadata parser (readMetadataBlocks and every block parser).
+//
+// libFuzzer:  cmake -DFLACPLAYER_BUILD_FUZZERS=ON -DCMAKE_CXX_COMPILER=clang++ ...
+//             ./fuzz_metadata corpus/
+// AFL:        cmake -DFLACPLAYER_BUILD_FUZZERS=ON -DFLACPLAYER_FUZZ_ENGINE=standalone -DCMAKE_CXX_COMPILER=afl-clang-fast++ ...
+//             afl-fuzz -i corpus -o findings -- ./fuzz_metadata @@
+// The standalone build also replays crash files: ./fuzz_metadata crash-1234
+//
+// A seed corpus can be written by the metadata benchmark: bench_metadata --write-corpus corpus/
+
+#include "../../audiomanager.h"
+#include <QByteArray>
+#include <QFile>
+#include <QtGlobal>
+#include <cstdint>
+#include <cstdio>
+
+namespace {
+    void silentMessageHandler(QtMsgType, const QMessageLogContext &, const QString &)
+    {
+    }
+
+    // Real FLAC files (seed corpus) are parsed as they are. Otherwise the first byte picks the
+    // mode so the fuzzer doesn't have to discover the stream layout:
+    //   bit 7 set   -> the rest is a whole stream ("fLaC" is prepended if missing)
+    //   bit 7 clear -> the rest is the body of a single block of type (byte % 7)
+    QByteArray buildStream(const uint8_t *data, size_t size)
+    {
+        QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char *>(data), static_cast<qsizetype>(size));
+        if (raw.startsWith("fLaC")) {
+            return QByteArray(raw.constData(), raw.size());
+        }
+
+        const quint8 mode = data[0];
+        QByteArray body(reinterpret_cast<const char *>(data + 1), static_cast<qsizetype>(size - 1));
+
+        if (mode & 0x80) {
+            return body.startsWith("fLaC") ? body : QByteArray("fLaC") + body;
+        }
+
+        // Block lengths are 24-bit, anything longer is cut to what the header can describe
+        body.truncate(0xFFFFFF);
+        QByteArray stream("fLaC");
+        stream.append(static_cast<char>(0x80 | (mode % 7)));
+        stream.append(static_cast<char>((body.size() >> 16) & 0xFF));
+        stream.append(static_cast<char>((body.size() >> 8) & 0xFF));
+        stream.append(static_cast<char>(body.size() & 0xFF));
+        stream.append(body);
+        return stream;
+    }
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static const bool quiet = [] {
+        qInstallMessageHandler(silentMessageHandler);
+        return true;
+    }();
+    Q_UNUSED(quiet);
+
+    if (size == 0) {
+        return 0;
+    }
+
+    MetadataEditor editor;
+    editor.parseMetadata(buildStream(data, size), MetadataEditor::FieldAll);
+    return 0;
+}
+
+#ifdef FLACPLAYER_FUZZ_STANDALONE
+// Replays files given on the command line, or stdin when there are none
+int main(int argc, char *argv[])
+{
+#ifdef __AFL_LOOP
+    while (__AFL_LOOP(1000)) {
+#endif
+    if (argc < 2) {
+        QFile input;
+        if (!input.open(stdin, QIODevice::ReadOnly)) {
+            return 1;
+        }
+        QByteArray bytes = input.readAll();
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(bytes.constData()), bytes.size());
+    }
+    for (int i = 1; i < argc; ++i) {
+        QFile input(QString::fromLocal8Bit(argv[i]));
+        if (!input.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "cannot open %s\n", argv[i]);
+            continue;
+        }
+        QByteArray bytes = input.readAll();
+        LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t *>(bytes.constData()), bytes.size());
+    }
+#ifdef __AFL_LOOP
+    }
+#endif
+    return 0;
+}
+#endif
@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QTemporaryDir>
+#include <QTimer>
+#include "../clicommands.h"
+#include "../batchconverter.h"
+#include "flacfixture.h"
+
+/**
+ * Test suite for flacplayer-cli: argument handling, exit codes, tagging and conversion planning
+ */
+namespace {
+    struct CliRun {
+        int code = -1;
+        QString out;
+        QString err;
+    };
+
+    CliRun runCli(const QStringList &args)
+    {
+        CliRun run;
+        QTextStream out(&run.out);
+        QTextStream err(&run.err);
+        run.code = Cli::run(args, out, err);
+        out.flush();
+        err.flush();
+        return run;
+    }
+
+    //the JSON lines of a run, optionally only those of one event
+    QList<QJsonObject> events(const CliRun &run, const QString &event = QString())
+    {
+        QList<QJsonObject> result;
+        for (const QString &line : run.out.split('\n', Qt::SkipEmptyParts)) {
+            const QJsonObject object = QJsonDocument::fromJson(line.toUtf8()).object();
+            if (event.isEmpty() || object["event"].toString() == event) {
+                result.append(object);
+            }
+        }
+        return result;
+    }
+
+    QString writeFile(const QString &path, const QByteArray &data)
+    {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(data);
+        }
+        return path;
+    }
+}
+
+TEST(CliTest, UsageErrorsExitWithTwo) {
+    QTemporaryDir empty;
+    ASSERT_TRUE(empty.isValid());
+
+    const QList<QStringList> bad = {
+        {},
+        {"frobnicate"},
+        {"verify"},
+        {"verify", "--jobs"},
+        {"verify", "--jobs", "-1", empty.path()},
+        {"verify", empty.path()},                   // Nothing to verify in it
+        {"verify", "--fast", empty.path()},
+        {"convert", "--bitrate", "100", empty.path()},
+        {"convert", "--resampler", "best", empty.path()},
+        {"scan", "--jobs", "many", empty.path()},
+        {"tag"},
+        {"tag", "rename", "x.flac"},
+    };
+    for (const QStringList &args : bad) {
+        const CliRun run = runCli(args);
+        EXPECT_EQ(run.code, Cli::UsageError) << args.join(' ').toStdString();
+        EXPECT_TRUE(run.err.contains("usage:")) << args.join(' ').toStdString();
+    }
+
+    const CliRun help = runCli({"help"});
+    EXPECT_EQ(help.code, Cli::Success);
+    EXPECT_TRUE(help.out.contains("convert"));
+}
+
+TEST(CliTest, SetsAndGetsTags) {
+    using namespace FlacFixture;
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = writeFile(dir.filePath("song.flac"),
+        flacStream({{StreamInfo, streamInfo()}, {VorbisComment, vorbisComment({{"TITLE", "Old"}, {"ARTIST", "Band"}})}},
+                   QByteArray(4096, '\0')));
+
+    const CliRun set = runCli({"tag", "set", path, "TITLE=New Title", "year=1999", "COMMENT=a=b"});
+    ASSERT_EQ(set.code, Cli::Success) << set.err.toStdString();
+    EXPECT_EQ(QJsonDocument::fromJson(set.out.toUtf8()).object()["event"].toString(), "done");
+
+    // Aliases answer under the name that was asked for
+    const CliRun get = runCli({"tag", "get", path, "title", "YEAR", "artist", "comment"});
+    ASSERT_EQ(get.code, Cli::Success) << get.err.toStdString();
+    const QJsonObject tags = QJsonDocument::fromJson(get.out.toUtf8()).object()["tags"].toObject();
+    EXPECT_EQ(tags.size(), 4);
+    EXPECT_EQ(tags["TITLE"].toString(), "New Title");
+    EXPECT_EQ(tags["YEAR"].toString(), "1999");
+    EXPECT_EQ(tags["ARTIST"].toString(), "Band");
+    EXPECT_EQ(tags["COMMENT"].toString(), "a=b");
+
+    const QJsonObject all = QJsonDocument::fromJson(runCli({"tag", "get", path}).out.toUtf8()).object();
+    EXPECT_EQ(all["sample_rate"].toInt(), 44100);
+    EXPECT_EQ(all["tags"].toObject()["DATE"].toString(), "1999");
+
+    // Unknown fields are a usage error and leave the file alone
+    EXPECT_EQ(runCli({"tag", "set", path, "MOOD=happy"}).code, Cli::UsageError);
+    EXPECT_EQ(runCli({"tag", "set", path, "novalue"}).code, Cli::UsageError);
+    EXPECT_EQ(runCli({"tag", "get", path, "MOOD"}).code, Cli::UsageError);
+    EXPECT_EQ(runCli({"tag", "get", dir.filePath("missing.flac")}).code, Cli::Failures);
+}
+
+TEST(CliTest, PlansConversionsPerTree) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString source = dir.filePath("flac");
+    writeFile(source + "/top.flac", "x");
+    writeFile(source + "/Artist/Album/01 Song.flac", "x");
+    writeFile(source + "/Artist/Album/cover.jpg", "x");
+    const QString single = writeFile(dir.filePath("single.wav"), "x");
+
+    const QString output = dir.filePath("mp3");
+    QMap<QString, QString> targets;
+    for (const BatchConverter::Job &job : BatchConverter::planJobs({source}, output)) {
+        targets.insert(QDir(source).relativeFilePath(job.input), QDir(output).relativeFilePath(job.output));
+    }
+    ASSERT_EQ(targets.size(), 2);
+    EXPECT_EQ(targets.value("top.flac"), "top.mp3");
+    EXPECT_EQ(targets.value("Artist/Album/01 Song.flac"), "Artist/Album/01 Song.mp3");
+
+    // Without an output folder the MP3 goes next to its source
+    const QList<BatchConverter::Job> beside = BatchConverter::planJobs({single});
+    ASSERT_EQ(beside.size(), 1);
+    EXPECT_EQ(beside[0].output, dir.filePath("single.mp3"));
+    EXPECT_TRUE(BatchConverter::planJobs({dir.filePath("nothing")}, output).isEmpty());
+}
+
+TEST(CliTest, PlanKeepsOutputsApart) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString source = dir.filePath("in");
+    writeFile(source + "/song.flac", "x");
+    writeFile(source + "/song.wav", "x");
+    writeFile(source + "/other.flac", "x");
+
+    // Two sources of one name get one output each, whatever order the folder lists them in
+    QMap<QString, QString> targets;
+    for (const BatchConverter::Job &job : BatchConverter::planJobs({source})) {
+        targets.insert(QFileInfo(job.input).fileName(), QFileInfo(job.output).fileName());
+    }
+    ASSERT_EQ(targets.size(), 3);
+    EXPECT_EQ(targets.value("song.flac"), "song.flac.mp3");
+    EXPECT_EQ(targets.value("song.wav"), "song.wav.mp3");
+    EXPECT_EQ(targets.value("other.flac"), "other.mp3");
+
+    EXPECT_EQ(BatchConverter::planJobs({source, source + "/other.flac"}).size(), 3);
+
+    // An MP3 is never converted onto itself, into another folder it is fine
+    const QString mp3 = writeFile(dir.filePath("already.mp3"), "x");
+    EXPECT_TRUE(BatchConverter::planJobs({mp3}).isEmpty());
+    EXPECT_EQ(BatchConverter::planJobs({mp3}, dir.filePath("out")).size(), 1);
+}
+
+TEST(CliTest, ConvertsThenSkipsWhatIsThere) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString tone = writeFile(dir.filePath("in/tone.wav"), FlacFixture::pcmWav(44100, 22050));
+    const QString output = dir.filePath("out");
+
+    const CliRun first = runCli({"convert", "--bitrate", "128", "--jobs", "2", "--output", output, tone});
+    ASSERT_EQ(first.code, Cli::Success) << first.out.toStdString() << first.err.toStdString();
+    const QList<QJsonObject> files = events(first, "file");
+    ASSERT_EQ(files.size(), 1);
+    EXPECT_EQ(files[0]["status"].toString(), "OK");
+    EXPECT_EQ(events(first, "done").value(0)["problems"].toInt(), 0);
+    // The partial file was renamed into place
+    EXPECT_GT(QFileInfo(output + "/tone.mp3").size(), 0);
+    EXPECT_EQ(QDir(output).entryList({"*.part.mp3"}, QDir::Files).size(), 0);
+
+    const CliRun again = runCli({"convert", "--output", output, tone});
+    EXPECT_EQ(again.code, Cli::Success);
+    EXPECT_EQ(events(again, "file").value(0)["status"].toString(), "SKIPPED");
+    EXPECT_EQ(events(again, "file").value(0)["message"].toString(), "output exists");
+
+    const CliRun overwrite = runCli({"convert", "--overwrite", "--output", output, tone});
+    EXPECT_EQ(overwrite.code, Cli::Success);
+    EXPECT_EQ(events(overwrite, "file").value(0)["status"].toString(), "OK");
+}
+
+TEST(CliTest, FailedAndInterruptedRunsHaveTheirExitCodes) {
+    using namespace FlacFixture;
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString broken = writeFile(dir.filePath("broken.wav"), QByteArray("RIFF\0\0\0\0WAVEjunk", 16));
+    const CliRun failed = runCli({"convert", "--output", dir.filePath("out"), broken});
+    EXPECT_EQ(failed.code, Cli::Failures);
+    EXPECT_EQ(events(failed, "file").value(0)["status"].toString(), "ERROR");
+    EXPECT_FALSE(QFileInfo::exists(dir.filePath("out/broken.mp3")));
+    EXPECT_EQ(QDir(dir.filePath("out")).entryList({"*.part.mp3"}, QDir::Files).size(), 0);
+
+    // Valid headers in front of frames that don't decode
+    const QString damaged = writeFile(dir.filePath("damaged.flac"), flacStream({{StreamInfo, streamInfo()}}, fakeFrames(6)));
+    const CliRun verify = runCli({"verify", damaged});
+    EXPECT_EQ(verify.code, Cli::Failures);
+    EXPECT_NE(events(verify, "file").value(0)["status"].toString(), "OK");
+    EXPECT_EQ(events(verify, "done").value(0)["problems"].toInt(), 1);
+
+    // Interrupted once the command's event loop runs, whatever the files came to
+    const QString tone = writeFile(dir.filePath("tone.wav"), pcmWav(44100, 44100));
+    QTimer::singleShot(0, []() { Cli::interrupt(); });
+    const CliRun interrupted = runCli({"convert", "--overwrite", "--output", dir.filePath("stopped"), tone});
+    EXPECT_EQ(interrupted.code, Cli::Interrupted);
+    EXPECT_TRUE(events(interrupted, "done").value(0)["interrupted"].toBool());
+    EXPECT_EQ(QDir(dir.filePath("stopped")).entryList({"*.part.mp3"}, QDir::Files).size(), 0);
+}
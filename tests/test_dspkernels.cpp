@@ -0,0 +1,312 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../dspkernels.h"
+
+/**
+ * Test suite for the sample kernels behind the crossfade stage
+ */
+TEST(DspKernelsTest, CurvesStartAndEndAtUnity) {
+    for (Dsp::FadeCurve curve : {Dsp::FadeCurve::Linear, Dsp::FadeCurve::EqualPower, Dsp::FadeCurve::SCurve}) {
+        EXPECT_NEAR(Dsp::fadeInGain(curve, 0.0f), 0.0f, 1e-6f);
+        EXPECT_NEAR(Dsp::fadeInGain(curve, 1.0f), 1.0f, 1e-6f);
+        EXPECT_NEAR(Dsp::fadeOutGain(curve, 0.0f), 1.0f, 1e-6f);
+        EXPECT_NEAR(Dsp::fadeOutGain(curve, 1.0f), 0.0f, 1e-6f);
+    }
+}
+
+TEST(DspKernelsTest, EqualPowerKeepsPowerConstant) {
+    for (int i = 0; i <= 10; ++i) {
+        float t = i / 10.0f;
+        float in = Dsp::fadeInGain(Dsp::FadeCurve::EqualPower, t);
+        float out = Dsp::fadeOutGain(Dsp::FadeCurve::EqualPower, t);
+        EXPECT_NEAR(in * in + out * out, 1.0f, 1e-5f);
+    }
+}
+
+TEST(DspKernelsTest, CrossfadeRampsBetweenSources) {
+    const int frames = 4;
+    std::vector<float> incoming(frames * 2, 1.0f);
+    std::vector<float> outgoing(frames * 2, -1.0f);
+
+    // Incoming fully in at the end of the block, outgoing fully in at the start
+    Dsp::crossfade(incoming.data(), outgoing.data(), frames, 2, 0.0f, 1.0f, 1.0f, 0.0f);
+    EXPECT_NEAR(incoming.front(), -1.0f, 1e-6f);
+    for (size_t i = 1; i < incoming.size(); ++i) {
+        EXPECT_GT(incoming[i], incoming[i - 1]);
+    }
+    EXPECT_LT(incoming.back(), 1.0f);
+}
+
+TEST(DspKernelsTest, Int16RoundTripAndClipping) {
+    const int16_t samples[4] = {0, 1000, -32768, 32767};
+    float scratch[4];
+    Dsp::toFloat(QAudioFormat::Int16, samples, scratch, 4);
+    EXPECT_FLOAT_EQ(scratch[2], -1.0f);
+
+    int16_t back[4];
+    Dsp::fromFloat(QAudioFormat::Int16, scratch, back, 4);
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_EQ(back[i], samples[i]);
+    }
+
+    const float loud[2] = {1.5f, -1.5f};
+    Dsp::fromFloat(QAudioFormat::Int16, loud, back, 2);
+    EXPECT_EQ(back[0], 32767);
+    EXPECT_EQ(back[1], -32768);
+}
+
+TEST(DspKernelsTest, Int32ClipsWithoutOverflow) {
+    const float loud[3] = {1.0f, -1.0f, 0.5f};
+    int32_t out[3];
+    Dsp::fromFloat(QAudioFormat::Int32, loud, out, 3);
+    EXPECT_EQ(out[0], INT32_MAX);
+    EXPECT_EQ(out[1], INT32_MIN);
+    EXPECT_EQ(out[2], 1 << 30);
+}
+
+TEST(DspKernelsTest, InterleaveCopiesSamplesExactly) {
+    // 24-bit values in S32 containers and the extremes must come through bit for bit
+    const int32_t left[3] = {INT32_MIN, 0x12345600, -256};
+    const int32_t right[3] = {INT32_MAX, -0x7654300, 256};
+    const int32_t *planes[2] = {left, right};
+    int32_t out[6];
+    Dsp::interleave32(planes, 2, 3, out);
+    const int32_t expected[6] = {INT32_MIN, INT32_MAX, 0x12345600, -0x7654300, -256, 256};
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_EQ(out[i], expected[i]);
+    }
+
+    const int16_t a[2] = {1, 4}, b[2] = {2, 5}, c[2] = {3, 6};
+    const int16_t *planes16[3] = {a, b, c};
+    int16_t out16[6];
+    Dsp::interleave16(planes16, 3, 2, out16);
+    for (int i = 0; i < 6; ++i) {
+        EXPECT_EQ(out16[i], i + 1);
+    }
+}
+
+namespace {
+    // Runs body once per level this CPU supports, restoring the default afterwards
+    template <typename Body>
+    void forEachSimdLevel(Body body)
+    {
+        const Dsp::SimdLevel best = Dsp::detectedSimdLevel();
+        for (int level = 0; level <= int(best); ++level) {
+            Dsp::setSimdLevel(Dsp::SimdLevel(level));
+            body(Dsp::SimdLevel(level));
+        }
+        Dsp::setSimdLevel(best);
+    }
+}
+
+TEST(DspKernelsTest, SimdLevelsMatchScalar) {
+    // Odd length so every level also runs its scalar tail
+    const size_t count = 1003;
+    std::vector<float> in(count);
+    std::vector<int16_t> in16(count);
+    std::vector<int32_t> in32(count);
+    for (size_t i = 0; i < count; ++i) {
+        in[i] = 1.2f * std::sin(float(i) * 0.37f);
+        in16[i] = int16_t((int(i) * 7919) % 65536 - 32768);
+        in32[i] = int32_t(uint32_t(i) * 2654435761u);
+    }
+
+    std::vector<float> scaled, float16, float32;
+    std::vector<int16_t> dithered, plain16;
+    std::vector<int32_t> plain32;
+    std::vector<float> left, right;
+    forEachSimdLevel([&](Dsp::SimdLevel level) {
+        std::vector<float> s = in;
+        Dsp::scale(s.data(), count, 0.5f);
+        std::vector<float> f16(count), f32(count);
+        Dsp::int16ToFloat(in16.data(), f16.data(), count, 0.25f);
+        Dsp::int32ToFloat(in32.data(), f32.data(), count);
+        std::vector<int16_t> d(count), p16(count);
+        Dsp::DitherState dither(42);
+        Dsp::floatToInt16(in.data(), d.data(), count, &dither);
+        Dsp::floatToInt16(in.data(), p16.data(), count);
+        std::vector<int32_t> p32(count);
+        Dsp::floatToInt32(in.data(), p32.data(), count);
+        std::vector<float> l(count / 2), r(count / 2);
+        float *const planes[] = {l.data(), r.data()};
+        Dsp::deinterleave(in.data(), 2, count / 2, planes);
+
+        if (level == Dsp::SimdLevel::Scalar) {
+            scaled = s;
+            float16 = f16;
+            float32 = f32;
+            dithered = d;
+            plain16 = p16;
+            plain32 = p32;
+            left = l;
+            right = r;
+            return;
+        }
+        EXPECT_EQ(l, left) << Dsp::simdLevelName(level);
+        EXPECT_EQ(r, right) << Dsp::simdLevelName(level);
+        for (size_t i = 0; i < count; ++i) {
+            EXPECT_EQ(s[i], scaled[i]) << Dsp::simdLevelName(level) << " " << i;
+            EXPECT_EQ(f16[i], float16[i]) << Dsp::simdLevelName(level) << " " << i;
+            EXPECT_EQ(f32[i], float32[i]) << Dsp::simdLevelName(level) << " " << i;
+            EXPECT_NEAR(d[i], dithered[i], 1) << Dsp::simdLevelName(level) << " " << i;
+            EXPECT_EQ(p16[i], plain16[i]) << Dsp::simdLevelName(level) << " " << i;
+            EXPECT_EQ(p32[i], plain32[i]) << Dsp::simdLevelName(level) << " " << i;
+        }
+    });
+}
+
+TEST(DspKernelsTest, DitherIsSmallAndUnbiased) {
+    // A constant halfway between two codes comes out as both, averaging back to the input
+    const size_t count = 1 << 16;
+    std::vector<float> in(count, 100.5f / 32768.0f);
+    std::vector<int16_t> out(count);
+    forEachSimdLevel([&](Dsp::SimdLevel level) {
+        Dsp::DitherState dither;
+        Dsp::floatToInt16(in.data(), out.data(), count, &dither);
+        double sum = 0.0;
+        for (int16_t sample : out) {
+            EXPECT_GE(sample, 99);
+            EXPECT_LE(sample, 102);
+            sum += sample;
+        }
+        EXPECT_NEAR(sum / count, 100.5, 0.02) << Dsp::simdLevelName(level);
+    });
+}
+
+TEST(DspKernelsTest, Int32ExtremesAtEveryLevel) {
+    std::vector<float> loud(16);
+    for (size_t i = 0; i < loud.size(); ++i) {
+        loud[i] = i % 2 ? -2.0f : 2.0f;
+    }
+    loud[4] = 1.0f;
+    loud[5] = -1.0f;
+    std::vector<int32_t> out(loud.size());
+    forEachSimdLevel([&](Dsp::SimdLevel level) {
+        Dsp::floatToInt32(loud.data(), out.data(), out.size());
+        for (size_t i = 0; i < out.size(); ++i) {
+            EXPECT_EQ(out[i], i % 2 ? INT32_MIN : INT32_MAX) << Dsp::simdLevelName(level) << " " << i;
+        }
+    });
+}
+
+TEST(DspKernelsTest, BiquadCascadeTreatsChannelsIndependently) {
+    // Stereo through the fixed-width path must match each channel run on its own
+    Dsp::Biquad sections[2];
+    sections[0] = {0.2f, 0.4f, 0.2f, -0.5f, 0.3f};
+    sections[1] = {1.1f, -1.8f, 0.8f, -1.7f, 0.75f};
+    const size_t frames = 300;
+    std::vector<float> stereo(frames * 2), left(frames), right(frames);
+    for (size_t i = 0; i < frames; ++i) {
+        left[i] = stereo[2 * i] = std::sin(float(i) * 0.1f);
+        right[i] = stereo[2 * i + 1] = i % 7 == 0 ? 1.0f : 0.0f;
+    }
+
+    std::vector<float> state(2 * 2 * 2, 0.0f), monoState(2 * 2, 0.0f);
+    Dsp::biquadCascade(stereo.data(), 2, frames, sections, 2, state.data());
+    Dsp::biquadCascade(left.data(), 1, frames, sections, 2, monoState.data());
+    std::fill(monoState.begin(), monoState.end(), 0.0f);
+    Dsp::biquadCascade(right.data(), 1, frames, sections, 2, monoState.data());
+    for (size_t i = 0; i < frames; ++i) {
+        EXPECT_FLOAT_EQ(stereo[2 * i], left[i]) << i;
+        EXPECT_FLOAT_EQ(stereo[2 * i + 1], right[i]) << i;
+    }
+}
+
+TEST(DspKernelsTest, LpcRestoreInvertsPrediction) {
+    // Residuals computed with the same predictor must give the signal back at every level,
+    // narrow and wide, for orders on both sides of the vectorised taps
+    const size_t count = 1001;
+    std::vector<int32_t> signal(count);
+    for (size_t i = 0; i < count; ++i) {
+        signal[i] = int32_t(8000000.0 * std::sin(double(i) * 0.021) + double((i * 7919) % 97) - 48.0);
+    }
+    for (int order : {1, 3, 4, 7, 12, 32}) {
+        std::vector<int32_t> coeffs(static_cast<size_t>(order));
+        for (int j = 0; j < order; ++j) {
+            coeffs[size_t(j)] = (j == 0 ? 1800 : 0) - 150 * ((j * 37) % 5) + 70 * (j % 3);
+        }
+        const int shift = 10;
+        for (bool wide : {false, true}) {
+            // Narrow sums have to fit 32 bits, so that case runs on 16-bit material
+            const int32_t scale = wide ? 1 : 256;
+            std::vector<int32_t> input(count);
+            for (size_t i = 0; i < count; ++i) {
+                input[i] = signal[i] / scale;
+            }
+            std::vector<int32_t> residual = input;
+            for (size_t i = size_t(order); i < count; ++i) {
+                int64_t sum = 0;
+                for (int j = 0; j < order; ++j) {
+                    sum += int64_t(coeffs[size_t(j)]) * input[i - 1 - size_t(j)];
+                }
+                residual[i] = input[i] - int32_t(sum >> shift);
+            }
+            forEachSimdLevel([&](Dsp::SimdLevel level) {
+                std::vector<int32_t> restored = residual;
+                Dsp::lpcRestore(restored.data(), count, coeffs.data(), order, shift, wide);
+                EXPECT_EQ(restored, input) << Dsp::simdLevelName(level) << " order " << order << " wide " << wide;
+            });
+        }
+    }
+}
+
+TEST(DspKernelsTest, DownmixAveragesTheChannels) {
+    const float stereo[6] = {1.0f, 0.0f, 0.5f, -0.5f, -1.0f, -0.25f};
+    float mono[3];
+    Dsp::downmix(stereo, 2, 3, mono);
+    EXPECT_FLOAT_EQ(mono[0], 0.5f);
+    EXPECT_FLOAT_EQ(mono[1], 0.0f);
+    EXPECT_FLOAT_EQ(mono[2], -0.625f);
+
+    const float surround[6] = {0.3f, 0.6f, 0.9f, -0.3f, 0.0f, 0.0f};
+    Dsp::downmix(surround, 3, 2, mono);
+    EXPECT_FLOAT_EQ(mono[0], 0.6f);
+    EXPECT_FLOAT_EQ(mono[1], -0.1f);
+}
+
+TEST(DspKernelsTest, FftPassesMatchTheDft) {
+    // Every pass width from the scalar ones up to past the AVX2 lanes
+    constexpr double TwoPi = 6.283185307179586;
+    const size_t n = 64;
+    std::vector<float> inRe(n), inIm(n);
+    for (size_t i = 0; i < n; ++i) {
+        inRe[i] = std::sin(float(i) * 0.7f) + (i % 5 == 0 ? 0.5f : 0.0f);
+        inIm[i] = std::cos(float(i) * 0.23f) * 0.3f;
+    }
+    std::vector<float> twRe(n - 1), twIm(n - 1);
+    for (size_t half = 1; half < n; half *= 2) {
+        for (size_t k = 0; k < half; ++k) {
+            twRe[half - 1 + k] = float(std::cos(-TwoPi * double(k) / double(2 * half)));
+            twIm[half - 1 + k] = float(std::sin(-TwoPi * double(k) / double(2 * half)));
+        }
+    }
+
+    forEachSimdLevel([&](Dsp::SimdLevel level) {
+        std::vector<float> re(n), im(n);
+        for (size_t i = 0; i < n; ++i) {
+            size_t reversed = 0;
+            for (size_t bit = 1, r = n >> 1; bit < n; bit <<= 1, r >>= 1) {
+                if (i & bit) {
+                    reversed |= r;
+                }
+            }
+            re[reversed] = inRe[i];
+            im[reversed] = inIm[i];
+        }
+        for (size_t half = 1; half < n; half *= 2) {
+            Dsp::fftPass(re.data(), im.data(), n, half, twRe.data() + half - 1, twIm.data() + half - 1);
+        }
+        for (size_t k = 0; k < n; ++k) {
+            double sumRe = 0.0, sumIm = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                const double angle = -TwoPi * double(k * i) / double(n);
+                sumRe += inRe[i] * std::cos(angle) - inIm[i] * std::sin(angle);
+                sumIm += inRe[i] * std::sin(angle) + inIm[i] * std::cos(angle);
+            }
+            EXPECT_NEAR(re[k], sumRe, 1e-4) << Dsp::simdLevelName(level) << " bin " << k;
+            EXPECT_NEAR(im[k], sumIm, 1e-4) << Dsp::simdLevelName(level) << " bin " << k;
+        }
+    });
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../equalizer.h"
+
+namespace {
+    constexpr double TwoPi = 6.283185307179586;
+    constexpr int SampleRate = 48000;
+
+    // Steady-state level of a stereo sine after the equalizer, the first half is settling
+    double gainAt(Equalizer &eq, double frequency)
+    {
+        const size_t frames = SampleRate / 2;
+        std::vector<float> samples(frames * 2);
+        for (size_t i = 0; i < frames; ++i) {
+            samples[2 * i] = samples[2 * i + 1] = float(0.25 * std::sin(TwoPi * frequency * double(i) / SampleRate));
+        }
+        EXPECT_TRUE(eq.update(2));
+        for (size_t done = 0; done < frames; done += 256) {
+            eq.process(samples.data() + done * 2, std::min<size_t>(256, frames - done));
+        }
+        // RMS rather than the sample peak, which misses the crest at high frequencies
+        double sum = 0.0;
+        for (size_t i = frames / 2; i < frames; ++i) {
+            sum += double(samples[2 * i + 1]) * samples[2 * i + 1];
+        }
+        return 20.0 * std::log10(std::sqrt(sum / double(frames - frames / 2)) / (0.25 / std::sqrt(2.0)));
+    }
+
+    EqPreset singleBand(EqBand::Type type, double frequency, double gainDb)
+    {
+        EqPreset preset;
+        preset.enabled = true;
+        EqBand band;
+        band.type = type;
+        band.frequency = frequency;
+        band.gainDb = gainDb;
+        preset.bands.append(band);
+        return preset;
+    }
+}
+
+/**
+ * Test suite for the parametric equalizer stage
+ */
+TEST(EqualizerTest, FlatOrDisabledIsBypassed) {
+    Equalizer eq;
+    eq.setFormat(SampleRate, 2);
+    EXPECT_FALSE(eq.update(2));
+
+    EqPreset preset = singleBand(EqBand::Peak, 1000.0, 6.0);
+    preset.enabled = false;
+    eq.setPreset(preset);
+    EXPECT_FALSE(eq.update(2));
+
+    preset.enabled = true;
+    eq.setPreset(preset);
+    EXPECT_TRUE(eq.update(2));
+    EXPECT_FALSE(eq.update(6));    // Coefficients are for another layout
+}
+
+TEST(EqualizerTest, PeakHitsItsGainAtTheCentre) {
+    Equalizer eq;
+    eq.setFormat(SampleRate, 2);
+    eq.setPreset(singleBand(EqBand::Peak, 1000.0, 6.0));
+    EXPECT_NEAR(gainAt(eq, 1000.0), 6.0, 0.2);
+    EXPECT_NEAR(gainAt(eq, 100.0), 0.0, 0.3);
+    EXPECT_NEAR(gainAt(eq, 12000.0), 0.0, 0.3);
+}
+
+TEST(EqualizerTest, ShelvesAndPreampCombine) {
+    Equalizer eq;
+    eq.setFormat(SampleRate, 2);
+    EqPreset preset = singleBand(EqBand::LowShelf, 200.0, -9.0);
+    preset.preampDb = -3.0;
+    eq.setPreset(preset);
+    EXPECT_NEAR(gainAt(eq, 40.0), -12.0, 0.5);
+    EXPECT_NEAR(gainAt(eq, 8000.0), -3.0, 0.2);
+}
+
+TEST(EqualizerTest, LatestPresetWinsAcrossUpdates) {
+    // Several edits between two audio blocks, only the last one is heard
+    Equalizer eq;
+    eq.setFormat(SampleRate, 2);
+    for (double gain : {3.0, -6.0, 9.0, 4.0}) {
+        eq.setPreset(singleBand(EqBand::Peak, 2000.0, gain));
+    }
+    EXPECT_NEAR(gainAt(eq, 2000.0), 4.0, 0.2);
+    EXPECT_NEAR(gainAt(eq, 2000.0), 4.0, 0.2);
+}
+
+TEST(EqualizerTest, PresetSurvivesJson) {
+    EqPreset preset = EqPreset::builtIns().at(1);
+    preset.bands[2].type = EqBand::HighShelf;
+    preset.bands[2].q = 0.7;
+    preset.bands[3].enabled = false;
+
+    const EqPreset back = EqPreset::fromJson(preset.toJson());
+    EXPECT_EQ(back.name, preset.name);
+    EXPECT_EQ(back.enabled, preset.enabled);
+    EXPECT_DOUBLE_EQ(back.preampDb, preset.preampDb);
+    ASSERT_EQ(back.bands.size(), preset.bands.size());
+    for (int i = 0; i < back.bands.size(); ++i) {
+        EXPECT_EQ(back.bands[i].type, preset.bands[i].type);
+        EXPECT_DOUBLE_EQ(back.bands[i].frequency, preset.bands[i].frequency);
+        EXPECT_DOUBLE_EQ(back.bands[i].gainDb, preset.bands[i].gainDb);
+        EXPECT_DOUBLE_EQ(back.bands[i].q, preset.bands[i].q);
+        EXPECT_EQ(back.bands[i].enabled, preset.bands[i].enabled);
+    }
+}
@@ -0,0 +1,392 @@
+#include <gtest/gtest.h>
+#include <QFile>
+#include <QTemporaryDir>
+#include <cmath>
+#include <vector>
+#include "flacfixture.h"
+#include "../flacdecoder.h"
+#include "../parallelflacdecoder.h"
+#include "../dspkernels.h"
+#include "../flacverifier.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/channel_layout.h>
+#include <libavutil/dict.h>
+}
+
+/**
+ * Test suite for the native FLAC frame decoder and its frame-parallel front end. Streams come
+ * from libavcodec's encoder, so since FLAC is lossless the decoded planes have to equal the
+ * encoder's input exactly
+ */
+namespace {
+    using Planes = std::vector<std::vector<int32_t>>;
+
+    struct Encoded {
+        QByteArray streamInfo;
+        QList<QByteArray> frames;
+    };
+
+    // Correlated stereo so the side modes pay off, a silent stretch (constant subframes) and a
+    // burst of full-scale noise (verbatim ones), right-justified at the given depth
+    Planes testSignal(int bits, int frames)
+    {
+        const int32_t peak = (1 << (bits - 1)) - 1;
+        Planes planes(2, std::vector<int32_t>(size_t(frames)));
+        uint32_t noise = 12345;
+        for (int i = 0; i < frames; ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            const double tone = 0.6 * std::sin(i * 0.031) + 0.2 * std::sin(i * 0.0071);
+            int32_t left = int32_t(peak * tone) + int32_t(noise >> 28) - 8;
+            int32_t right = int32_t(peak * 0.9 * tone) - int32_t(noise >> 29);
+            if (i >= 5000 && i < 9500) {
+                left = right = 0;
+            } else if (i >= 12000 && i < 13000) {
+                left = int32_t(noise >> (33 - bits)) - (peak + 1) / 2;
+                right = -left;
+            }
+            planes[0][size_t(i)] = qBound(-peak - 1, left, peak);
+            planes[1][size_t(i)] = qBound(-peak - 1, right, peak);
+        }
+        return planes;
+    }
+
+    Encoded encode(const Planes &planes, int bits, const char *options)
+    {
+        Encoded encoded;
+        const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_FLAC);
+        AVCodecContext *ctx = codec ? avcodec_alloc_context3(codec) : nullptr;
+        if (!ctx) {
+            return encoded;
+        }
+        ctx->sample_rate = 44100;
+        ctx->sample_fmt = bits > 16 ? AV_SAMPLE_FMT_S32 : AV_SAMPLE_FMT_S16;
+        ctx->bits_per_raw_sample = bits;
+        // Orders above 12 are outside the streamable subset
+        ctx->strict_std_compliance = FF_COMPLIANCE_UNOFFICIAL;
+        av_channel_layout_default(&ctx->ch_layout, int(planes.size()));
+        AVDictionary *dict = nullptr;
+        av_dict_parse_string(&dict, options, "=", ":", 0);
+        const bool opened = avcodec_open2(ctx, codec, &dict) >= 0;
+        av_dict_free(&dict);
+        if (!opened) {
+            avcodec_free_context(&ctx);
+            return encoded;
+        }
+        encoded.streamInfo = QByteArray(reinterpret_cast<const char *>(ctx->extradata), ctx->extradata_size);
+
+        AVFrame *frame = av_frame_alloc();
+        AVPacket *packet = av_packet_alloc();
+        const int total = int(planes[0].size());
+        auto drain = [&]() {
+            while (avcodec_receive_packet(ctx, packet) >= 0) {
+                encoded.frames.append(QByteArray(reinterpret_cast<const char *>(packet->data), packet->size));
+                av_packet_unref(packet);
+            }
+        };
+        for (int offset = 0; offset < total; offset += ctx->frame_size) {
+            av_frame_unref(frame);
+            frame->nb_samples = qMin(ctx->frame_size, total - offset);
+            frame->format = ctx->sample_fmt;
+            frame->sample_rate = ctx->sample_rate;
+            av_channel_layout_copy(&frame->ch_layout, &ctx->ch_layout);
+            if (av_frame_get_buffer(frame, 0) < 0) {
+                break;
+            }
+            // Interleaved, 24-bit left-justified in S32
+            for (int i = 0; i < frame->nb_samples; ++i) {
+                for (size_t ch = 0; ch < planes.size(); ++ch) {
+                    const int32_t sample = planes[ch][size_t(offset + i)];
+                    const size_t index = size_t(i) * planes.size() + ch;
+                    if (bits > 16) {
+                        reinterpret_cast<int32_t *>(frame->data[0])[index] = int32_t(uint32_t(sample) << 8);
+                    } else {
+                        reinterpret_cast<int16_t *>(frame->data[0])[index] = int16_t(sample);
+                    }
+                }
+            }
+            avcodec_send_frame(ctx, frame);
+            drain();
+        }
+        avcodec_send_frame(ctx, nullptr);
+        drain();
+
+        av_packet_free(&packet);
+        av_frame_free(&frame);
+        avcodec_free_context(&ctx);
+        return encoded;
+    }
+
+    //every frame through one decoder, appended to the returned planes
+    Planes decodeAll(const Encoded &encoded, int channels)
+    {
+        FlacFrameDecoder decoder;
+        EXPECT_TRUE(decoder.setStreamInfo(reinterpret_cast<const uchar *>(encoded.streamInfo.constData()),
+                                          encoded.streamInfo.size()));
+        EXPECT_EQ(decoder.channels(), channels);
+
+        Planes out(size_t(channels));
+        Planes block(size_t(channels), std::vector<int32_t>(size_t(decoder.maxBlockSize())));
+        int32_t *pointers[FlacFrameDecoder::MaxChannels];
+        for (int ch = 0; ch < channels; ++ch) {
+            pointers[ch] = block[size_t(ch)].data();
+        }
+        qint64 expectedFirst = 0;
+        for (const QByteArray &data : encoded.frames) {
+            FlacFrameDecoder::Frame frame;
+            const FlacFrameDecoder::Status status = decoder.decodeFrame(
+                reinterpret_cast<const uchar *>(data.constData()), data.size(), pointers, decoder.maxBlockSize(), &frame);
+            EXPECT_EQ(status, FlacFrameDecoder::Ok) << decoder.lastError().toStdString();
+            if (status != FlacFrameDecoder::Ok) {
+                break;
+            }
+            EXPECT_EQ(frame.bytes, data.size());
+            EXPECT_EQ(frame.firstSample, expectedFirst);
+            expectedFirst += frame.blockSize;
+            for (int ch = 0; ch < channels; ++ch) {
+                out[size_t(ch)].insert(out[size_t(ch)].end(), pointers[ch], pointers[ch] + frame.blockSize);
+            }
+        }
+        return out;
+    }
+}
+
+TEST(FlacDecoderTest, EncodedStreamsDecodeExactly) {
+    const char *const options[] = {
+        "lpc_type=fixed",
+        "lpc_type=levinson:max_prediction_order=8:ch_mode=mid_side",
+        "lpc_type=levinson:max_prediction_order=32:ch_mode=left_side",
+        "lpc_type=cholesky:max_prediction_order=12:ch_mode=right_side",
+        "lpc_type=levinson:max_prediction_order=12:ch_mode=indep:exact_rice_parameters=1",
+    };
+    const Dsp::SimdLevel best = Dsp::detectedSimdLevel();
+    for (int bits : {16, 24}) {
+        const Planes input = testSignal(bits, 15000);
+        for (const char *option : options) {
+            SCOPED_TRACE(std::to_string(bits) + " bit, " + option);
+            const Encoded encoded = encode(input, bits, option);
+            ASSERT_FALSE(encoded.frames.isEmpty());
+            // Every LPC kernel has to restore the same samples
+            for (int level = 0; level <= int(best); ++level) {
+                Dsp::setSimdLevel(Dsp::SimdLevel(level));
+                EXPECT_EQ(decodeAll(encoded, 2), input) << Dsp::simdLevelName(Dsp::SimdLevel(level));
+            }
+            Dsp::setSimdLevel(best);
+        }
+    }
+}
+
+TEST(FlacDecoderTest, FileDecoderSkipsDamagedFrames) {
+    const Planes input = testSignal(16, 15000);
+    const Encoded encoded = encode(input, 16, "lpc_type=levinson");
+    ASSERT_GE(encoded.frames.size(), 3);
+
+    // The second frame gets a flipped bit in its residual, the file ends in an ID3v1 tag
+    QByteArray audio;
+    for (int i = 0; i < encoded.frames.size(); ++i) {
+        QByteArray frame = encoded.frames[i];
+        if (i == 1) {
+            frame[frame.size() / 2] = char(frame[frame.size() / 2] ^ 0x10);
+        }
+        audio.append(frame);
+    }
+    audio.append("TAG");
+    audio.append(QByteArray(125, ' '));
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = dir.filePath("damaged.flac");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(FlacFixture::flacStream({{FlacFixture::StreamInfo, encoded.streamInfo}}, audio));
+    file.close();
+
+    FlacFileDecoder decoder;
+    ASSERT_TRUE(decoder.open(path)) << decoder.lastError().toStdString();
+    EXPECT_EQ(decoder.sampleRate(), 44100);
+    EXPECT_EQ(decoder.channels(), 2);
+    EXPECT_EQ(decoder.bitsPerSample(), 16);
+
+    std::vector<int32_t> left(size_t(decoder.maxBlockSize())), right(size_t(decoder.maxBlockSize()));
+    int32_t *planes[] = {left.data(), right.data()};
+    const int blockSize = decoder.maxBlockSize();
+    QList<qint64> starts;
+    int frames;
+    while ((frames = decoder.decodeNext(planes, blockSize)) > 0) {
+        const qint64 first = decoder.position() - frames;
+        starts.append(first);
+        for (int i = 0; i < frames; ++i) {
+            ASSERT_EQ(left[size_t(i)], input[0][size_t(first + i)]);
+            ASSERT_EQ(right[size_t(i)], input[1][size_t(first + i)]);
+        }
+    }
+    EXPECT_EQ(frames, 0);
+    EXPECT_EQ(decoder.skippedFrames(), 1);
+    ASSERT_EQ(starts.size(), encoded.frames.size() - 1);
+    EXPECT_EQ(starts[0], 0);
+    EXPECT_EQ(starts[1], 2 * blockSize);
+}
+
+TEST(FlacDecoderTest, TruncatedAndUnsupportedFrames) {
+    const Encoded encoded = encode(testSignal(16, 5000), 16, "lpc_type=levinson");
+    ASSERT_FALSE(encoded.frames.isEmpty());
+    FlacFrameDecoder decoder;
+    ASSERT_TRUE(decoder.setStreamInfo(reinterpret_cast<const uchar *>(encoded.streamInfo.constData()),
+                                      encoded.streamInfo.size()));
+    std::vector<int32_t> left(size_t(decoder.maxBlockSize())), right(size_t(decoder.maxBlockSize()));
+    int32_t *planes[] = {left.data(), right.data()};
+    FlacFrameDecoder::Frame frame;
+
+    const QByteArray &first = encoded.frames.first();
+    const uchar *data = reinterpret_cast<const uchar *>(first.constData());
+    EXPECT_EQ(decoder.decodeFrame(data, first.size() - 10, planes, decoder.maxBlockSize(), &frame),
+              FlacFrameDecoder::NeedMoreData);
+    EXPECT_EQ(decoder.decodeFrame(data, first.size(), planes, 100, &frame), FlacFrameDecoder::Unsupported);
+    EXPECT_EQ(decoder.decodeFrame(data + 1, first.size() - 1, planes, decoder.maxBlockSize(), &frame),
+              FlacFrameDecoder::Corrupt);
+
+    // A valid 32-bit frame header is turned down before anything is decoded
+    decoder.setStreamInfo(44100, 2, 32, 4096);
+    QByteArray header = FlacFixture::frameHeader(0);
+    header[3] = char((1 << 4) | (7 << 1));
+    header.chop(1);
+    header.append(char(FlacFixture::crc8(header)));
+    header.append(QByteArray(64, '\0'));
+    EXPECT_EQ(decoder.decodeFrame(reinterpret_cast<const uchar *>(header.constData()), header.size(), planes,
+                                  4096, &frame), FlacFrameDecoder::Unsupported);
+}
+
+TEST(FlacDecoderTest, ParallelDecoderReassemblesInOrder) {
+    // Long enough for several chunks at a few threads
+    const Planes input = testSignal(24, 600000);
+    const Encoded encoded = encode(input, 24, "lpc_type=levinson:max_prediction_order=12");
+    ASSERT_GE(encoded.frames.size(), 100);
+
+    // One damaged frame near the start and a run of two in the middle, each run is one gap
+    const int middle = int(encoded.frames.size() / 2);
+    QByteArray audio;
+    for (int i = 0; i < encoded.frames.size(); ++i) {
+        QByteArray frame = encoded.frames[i];
+        if (i == 1 || i == middle || i == middle + 1) {
+            frame[frame.size() / 2] = char(frame[frame.size() / 2] ^ 0x10);
+        }
+        audio.append(frame);
+    }
+    audio.append("TAG");
+    audio.append(QByteArray(125, ' '));
+
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = dir.filePath("parallel.flac");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(FlacFixture::flacStream({{FlacFixture::StreamInfo, encoded.streamInfo}}, audio));
+    file.close();
+
+    // What the sequential decoder makes of it
+    FlacFileDecoder sequential;
+    ASSERT_TRUE(sequential.open(path)) << sequential.lastError().toStdString();
+    Planes expected(2);
+    Planes block(2, std::vector<int32_t>(size_t(sequential.maxBlockSize())));
+    int32_t *pointers[] = {block[0].data(), block[1].data()};
+    int frames;
+    while ((frames = sequential.decodeNext(pointers, sequential.maxBlockSize())) > 0) {
+        for (int ch = 0; ch < 2; ++ch) {
+            expected[size_t(ch)].insert(expected[size_t(ch)].end(), pointers[ch], pointers[ch] + frames);
+        }
+    }
+    ASSERT_EQ(frames, 0);
+    ASSERT_EQ(expected[0].size(), input[0].size() - size_t(3 * sequential.maxBlockSize()));
+
+    for (int threads : {1, 2, 4, 7}) {
+        SCOPED_TRACE(std::to_string(threads) + " threads");
+        ParallelFlacDecoder decoder;
+        ASSERT_TRUE(decoder.open(path, threads)) << decoder.lastError().toStdString();
+        EXPECT_EQ(decoder.channels(), 2);
+        EXPECT_EQ(decoder.bitsPerSample(), 24);
+        if (threads > 1) {
+            EXPECT_GT(decoder.chunkCount(), 1);
+        }
+
+        Planes out(2);
+        qint64 previous = -1;
+        // Holes between and inside chunks add up to the three damaged frames
+        qint64 position = 0;
+        qint64 missing = 0;
+        while ((frames = decoder.next()) > 0) {
+            EXPECT_GT(decoder.chunkFirstSample(), previous);
+            previous = decoder.chunkFirstSample();
+            missing += decoder.chunkFirstSample() - position;
+            position = decoder.chunkFirstSample() + frames;
+            for (const ParallelFlacDecoder::Gap &gap : decoder.chunkGaps()) {
+                EXPECT_GT(gap.at, 0);
+                EXPECT_LT(gap.at, frames);
+                missing += gap.frames;
+                position += gap.frames;
+            }
+            for (int ch = 0; ch < 2; ++ch) {
+                out[size_t(ch)].insert(out[size_t(ch)].end(), decoder.planes()[ch], decoder.planes()[ch] + frames);
+            }
+        }
+        EXPECT_EQ(frames, 0);
+        EXPECT_EQ(out, expected);
+        EXPECT_EQ(decoder.skippedFrames(), 2);
+        EXPECT_EQ(missing, 3 * sequential.maxBlockSize());
+        EXPECT_EQ(position, qint64(input[0].size()));
+    }
+}
+
+TEST(FlacDecoderTest, ParallelDecoderOpenAndClose) {
+    ParallelFlacDecoder decoder;
+    EXPECT_EQ(decoder.next(), -1);
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    EXPECT_FALSE(decoder.open(dir.filePath("missing.flac"), 4));
+    EXPECT_FALSE(decoder.lastError().isEmpty());
+
+    // Closing with chunks still decoding waits for them
+    const Encoded encoded = encode(testSignal(16, 200000), 16, "lpc_type=levinson");
+    QByteArray audio;
+    for (const QByteArray &frame : encoded.frames) {
+        audio.append(frame);
+    }
+    const QString path = dir.filePath("short.flac");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(FlacFixture::flacStream({{FlacFixture::StreamInfo, encoded.streamInfo}}, audio));
+    file.close();
+    ASSERT_TRUE(decoder.open(path, 4));
+    EXPECT_GT(decoder.next(), 0);
+    decoder.close();
+    EXPECT_EQ(decoder.next(), -1);
+}
+
+TEST(FlacDecoderTest, NetworkStorageIsNeverMapped) {
+    const Encoded encoded = encode(testSignal(16, 50000), 16, "lpc_type=levinson");
+    QByteArray audio;
+    for (const QByteArray &frame : encoded.frames) {
+        audio.append(frame);
+    }
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = dir.filePath("share.flac");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(FlacFixture::flacStream({{FlacFixture::StreamInfo, encoded.streamInfo}}, audio));
+    file.close();
+
+    FlacFileDecoder decoder;
+    EXPECT_FALSE(decoder.open(path, InputStorage::Network));
+    EXPECT_TRUE(decoder.lastError().contains("Network")) << decoder.lastError().toStdString();
+    EXPECT_EQ(decoder.mappedData(), nullptr);
+    EXPECT_TRUE(decoder.open(path, InputStorage::Local)) << decoder.lastError().toStdString();
+
+    // Configured for the whole app the native decoders refuse, and the callers read through libavcodec
+    MappedInput::setDefaultStorage(InputStorage::Network);
+    ParallelFlacDecoder parallel;
+    EXPECT_FALSE(parallel.open(path, 2));
+    const VerifyResult result = FlacVerifier::verifyFile(path);
+    MappedInput::setDefaultStorage(InputStorage::Auto);
+    EXPECT_NE(result.status, VerifyResult::DecodeError) << result.message.toStdString();
+}
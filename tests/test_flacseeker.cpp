@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include <QBuffer>
+#include "../flacseeker.h"
+#include "flacfixture.h"
+
+/**
+ * Test suite for FlacSeeker: seek table lookup and frame header bisection on synthetic streams
+ */
+class FlacSeekerTest : public ::testing::Test {
+protected:
+    static constexpr int FrameCount = 1000;
+    static constexpr qint64 BlockSize = 4096;
+
+    // Opens a stream of FrameCount fake frames, with a seek point every seekEvery frames (0 = none)
+    void openStream(int seekEvery)
+    {
+        offsets.clear();
+        const QByteArray audio = FlacFixture::fakeFrames(FrameCount, &offsets);
+
+        QList<FlacFixture::Block> blocks {
+            {FlacFixture::StreamInfo, FlacFixture::streamInfo(44100, 2, 16, FrameCount * BlockSize)}
+        };
+        if (seekEvery > 0) {
+            QList<QPair<quint64, quint64>> points;
+            for (int i = 0; i < FrameCount; i += seekEvery) {
+                points.append(qMakePair(quint64(i * BlockSize), quint64(offsets[i])));
+            }
+            blocks.append(FlacFixture::Block{FlacFixture::SeekTable, FlacFixture::seekTable(points)});
+        }
+        blocks.append(FlacFixture::Block{FlacFixture::Padding, QByteArray(64, '\0')});
+
+        stream = FlacFixture::flacStream(blocks, audio);
+        audioOffset = stream.size() - audio.size();
+        buffer.setBuffer(&stream);
+        buffer.open(QIODevice::ReadOnly);
+        ASSERT_TRUE(seeker.open(&buffer)) << seeker.lastError().toStdString();
+    }
+
+    void expectFrameFor(qint64 sample)
+    {
+        FlacFramePosition frame;
+        ASSERT_TRUE(seeker.locate(sample, &frame)) << "sample " << sample;
+        const int index = static_cast<int>(sample / BlockSize);
+        EXPECT_EQ(frame.offset, audioOffset + offsets[index]) << "sample " << sample;
+        EXPECT_EQ(frame.sample, index * BlockSize);
+        EXPECT_EQ(frame.blockSize, BlockSize);
+    }
+
+    QByteArray stream;
+    QBuffer buffer;
+    QList<qint64> offsets;
+    qint64 audioOffset = 0;
+    FlacSeeker seeker;
+};
+
+TEST_F(FlacSeekerTest, ReadsStreamInfoAndAudioOffset) {
+    openStream(0);
+    EXPECT_EQ(seeker.sampleRate(), 44100);
+    EXPECT_EQ(seeker.totalSamples(), FrameCount * BlockSize);
+    EXPECT_EQ(seeker.audioOffset(), audioOffset);
+    EXPECT_EQ(seeker.seekPointCount(), 0);
+}
+
+TEST_F(FlacSeekerTest, BisectsFrameHeadersWithoutSeekTable) {
+    openStream(0);
+    for (qint64 sample : {qint64(0), BlockSize - 1, BlockSize, 123 * BlockSize + 17,
+                          500 * BlockSize, (FrameCount - 1) * BlockSize + 4095}) {
+        expectFrameFor(sample);
+    }
+}
+
+TEST_F(FlacSeekerTest, UsesSeekTablePoints) {
+    openStream(50);
+    EXPECT_EQ(seeker.seekPointCount(), FrameCount / 50);
+
+    for (qint64 sample : {qint64(10), 50 * BlockSize, 777 * BlockSize + 1000, (FrameCount - 1) * BlockSize}) {
+        expectFrameFor(sample);
+    }
+
+    // Seek point right at the target, no header search beyond the point's frame
+    FlacFramePosition frame;
+    ASSERT_TRUE(seeker.locate(600 * BlockSize, &frame));
+    EXPECT_LE(seeker.lastBytesRead(), 64 * 1024 + 16);
+}
+
+TEST_F(FlacSeekerTest, EveryFrameIsReachable) {
+    openStream(0);
+    for (int i = 0; i < FrameCount; i += 7) {
+        expectFrameFor(i * BlockSize + (i * 131) % BlockSize);
+    }
+}
+
+TEST_F(FlacSeekerTest, PositionPastEndFails) {
+    openStream(0);
+    FlacFramePosition frame;
+    EXPECT_FALSE(seeker.locate(FrameCount * BlockSize, &frame));
+}
+
+TEST_F(FlacSeekerTest, RejectsNonFlacInput) {
+    QByteArray data("RIFF\0\0\0\0WAVEfmt ", 16);
+    QBuffer wav(&data);
+    wav.open(QIODevice::ReadOnly);
+    EXPECT_FALSE(seeker.open(&wav));
+}
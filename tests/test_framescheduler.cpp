@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <QTest>
+#include <QWidget>
+#include "../framescheduler.h"
+
+/**
+ * Test suite for the frame clock batching the main window's periodic updates
+ */
+TEST(FrameSchedulerTest, DirtyClientsRunOncePerFrame) {
+    FrameScheduler scheduler(nullptr);
+    int positionRuns = 0;
+    int idleRuns = 0;
+    const int position = scheduler.addClient("position", [&positionRuns]() { ++positionRuns; });
+    const int idle = scheduler.addClient("idle", [&idleRuns]() { ++idleRuns; });
+    EXPECT_FALSE(scheduler.isRunning());
+
+    // A burst of backend ticks between two frames is one update
+    for (int i = 0; i < 100; ++i) {
+        scheduler.markDirty(position);
+    }
+    EXPECT_TRUE(scheduler.isRunning());
+    QTest::qWait(scheduler.intervalMs() * 4);
+    EXPECT_EQ(positionRuns, 1);
+    EXPECT_EQ(idleRuns, 0);
+    EXPECT_FALSE(scheduler.isDirty(position));
+
+    // Nothing changed since, the clock has gone quiet
+    EXPECT_FALSE(scheduler.isRunning());
+    EXPECT_EQ(scheduler.clientRuns(position), 1);
+    EXPECT_EQ(scheduler.clientName(idle), "idle");
+    EXPECT_EQ(scheduler.stats().frames, 1);
+    EXPECT_EQ(scheduler.workHistogram().count(), 1);
+}
+
+TEST(FrameSchedulerTest, ContinuousClientsRunEveryFrame) {
+    FrameScheduler scheduler(nullptr);
+    int runs = 0;
+    const int spectrum = scheduler.addClient("spectrum", [&runs]() { ++runs; });
+    scheduler.setContinuous(spectrum, true);
+    QTest::qWait(scheduler.intervalMs() * 10);
+    EXPECT_GE(runs, 3);
+    EXPECT_TRUE(scheduler.isRunning());
+
+    const FrameStats stats = scheduler.stats();
+    EXPECT_EQ(stats.frames, runs);
+    EXPECT_GT(stats.intervalMs, 0);
+    EXPECT_EQ(scheduler.intervalHistogram().count(), runs - 1);
+
+    scheduler.setContinuous(spectrum, false);
+    QTest::qWait(scheduler.intervalMs() * 3);
+    EXPECT_FALSE(scheduler.isRunning());
+    const int stopped = runs;
+    QTest::qWait(scheduler.intervalMs() * 3);
+    EXPECT_EQ(runs, stopped);
+
+    scheduler.resetStats();
+    EXPECT_EQ(scheduler.stats().frames, 0);
+    EXPECT_EQ(scheduler.clientRuns(spectrum), 0);
+}
+
+TEST(FrameSchedulerTest, HiddenWindowWaitsUntilShown) {
+    QWidget window;
+    FrameScheduler scheduler(&window);
+    int runs = 0;
+    const int position = scheduler.addClient("position", [&runs]() { ++runs; });
+
+    scheduler.markDirty(position);
+    QTest::qWait(scheduler.intervalMs() * 4);
+    EXPECT_EQ(runs, 0);
+    EXPECT_FALSE(scheduler.isRunning());
+    EXPECT_TRUE(scheduler.isDirty(position));
+
+    // What piled up while hidden is drawn once the window is back
+    window.show();
+    QTest::qWait(scheduler.intervalMs() * 4);
+    EXPECT_EQ(runs, 1);
+    EXPECT_FALSE(scheduler.isDirty(position));
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "../latencytracker.h"
+
+namespace {
+    constexpr qint64 Ms = 1000000;  // ns
+}
+
+/**
+ * Test suite for the playback latency histograms and stage traces
+ */
+TEST(LatencyTrackerTest, HistogramBucketsAndPercentiles) {
+    EXPECT_EQ(LatencyHistogram::bucketUpperUs(0), 50);
+    EXPECT_EQ(LatencyHistogram::bucketUpperUs(2), 100);
+    EXPECT_EQ(LatencyHistogram::bucketFor(0), 0);
+    EXPECT_EQ(LatencyHistogram::bucketFor(50), 0);
+    EXPECT_EQ(LatencyHistogram::bucketFor(51), 1);
+    EXPECT_EQ(LatencyHistogram::bucketFor(qint64(1) << 40), LatencyHistogram::BucketCount - 1);
+
+    // 90 fast samples and 10 slow ones
+    LatencyHistogram histogram;
+    for (int i = 0; i < 90; ++i) {
+        histogram.add(2000);
+    }
+    for (int i = 0; i < 10; ++i) {
+        histogram.add(150000);
+    }
+    EXPECT_EQ(histogram.count(), 100);
+    EXPECT_EQ(histogram.minUs(), 2000);
+    EXPECT_EQ(histogram.maxUs(), 150000);
+    EXPECT_DOUBLE_EQ(histogram.meanUs(), (90 * 2000.0 + 10 * 150000.0) / 100.0);
+
+    // Bucket edges are sqrt(2) apart, so a percentile is at most ~41% above the true value
+    EXPECT_GE(histogram.percentileUs(50), 2000);
+    EXPECT_LE(histogram.percentileUs(50), 2829);
+    EXPECT_GE(histogram.percentileUs(90), 2000);
+    EXPECT_LE(histogram.percentileUs(90), 2829);
+    EXPECT_EQ(histogram.percentileUs(99), 150000);    // clamped to the largest sample
+
+    histogram.clear();
+    EXPECT_EQ(histogram.count(), 0);
+    EXPECT_EQ(histogram.percentileUs(50), 0);
+}
+
+TEST(LatencyTrackerTest, TraceRecordsIntervalsBetweenStages) {
+    LatencyTracker tracker;
+    const qint64 t0 = 1000 * Ms;
+    tracker.begin(LatencyTracker::Next, t0);
+    tracker.addSpan(LatencyTracker::BackendSetup, 3000);
+    tracker.mark(LatencyTracker::SourceSet, t0 + 4 * Ms);
+    tracker.addSpan(LatencyTracker::Metadata, 1500);
+    tracker.mark(LatencyTracker::FirstDecoded, t0 + 20 * Ms);
+    EXPECT_TRUE(tracker.isOpen());
+    tracker.mark(LatencyTracker::FirstOutput, t0 + 45 * Ms);
+    EXPECT_FALSE(tracker.isOpen());
+
+    EXPECT_EQ(tracker.completed(LatencyTracker::Next), 1);
+    const QMap<QString, LatencyHistogram> &histograms = tracker.histograms(LatencyTracker::Next);
+    EXPECT_EQ(histograms.value("ui_to_source").maxUs(), 4000);
+    EXPECT_EQ(histograms.value("source_to_decoded").maxUs(), 16000);
+    EXPECT_EQ(histograms.value("decoded_to_output").maxUs(), 25000);
+    EXPECT_EQ(histograms.value("total").maxUs(), 45000);
+    EXPECT_EQ(histograms.value("metadata").maxUs(), 1500);
+    EXPECT_EQ(histograms.value("backend_setup").maxUs(), 3000);
+    EXPECT_TRUE(tracker.histograms(LatencyTracker::Play).isEmpty());
+}
+
+TEST(LatencyTrackerTest, MissingStagesAreSkipped) {
+    // A seek has no source stage, the gap runs from the UI event to the first decoded frame
+    LatencyTracker tracker;
+    tracker.begin(LatencyTracker::Seek, 10 * Ms);
+    tracker.mark(LatencyTracker::FirstDecoded, 16 * Ms);
+    tracker.mark(LatencyTracker::FirstOutput, 18 * Ms);
+
+    const QMap<QString, LatencyHistogram> &histograms = tracker.histograms(LatencyTracker::Seek);
+    EXPECT_EQ(histograms.value("ui_to_decoded").maxUs(), 6000);
+    EXPECT_EQ(histograms.value("decoded_to_output").maxUs(), 2000);
+    EXPECT_FALSE(histograms.contains("ui_to_source"));
+    EXPECT_FALSE(histograms.contains("metadata"));
+}
+
+TEST(LatencyTrackerTest, StaleStampsAndAbandonedTraces) {
+    LatencyTracker tracker;
+    // Stamps without an open trace go nowhere
+    tracker.mark(LatencyTracker::FirstOutput, 5 * Ms);
+    EXPECT_EQ(tracker.completed(LatencyTracker::Play), 0);
+
+    tracker.begin(LatencyTracker::Play, 100 * Ms);
+    // Audio from a request made before the click doesn't count
+    tracker.mark(LatencyTracker::FirstOutput, 90 * Ms);
+    EXPECT_TRUE(tracker.isOpen());
+
+    // A second click before any audio abandons the first trace
+    tracker.begin(LatencyTracker::Next, 200 * Ms);
+    EXPECT_EQ(tracker.abandoned(LatencyTracker::Play), 1);
+    tracker.mark(LatencyTracker::FirstOutput, 230 * Ms);
+    tracker.mark(LatencyTracker::FirstOutput, 260 * Ms);
+    EXPECT_EQ(tracker.completed(LatencyTracker::Next), 1);
+    EXPECT_EQ(tracker.histograms(LatencyTracker::Next).value("total").count(), 1);
+    EXPECT_EQ(tracker.histograms(LatencyTracker::Next).value("total").maxUs(), 30000);
+
+    tracker.clear();
+    EXPECT_EQ(tracker.completed(LatencyTracker::Next), 0);
+    EXPECT_EQ(tracker.abandoned(LatencyTracker::Play), 0);
+    EXPECT_FALSE(tracker.isOpen());
+}
+
+TEST(LatencyTrackerTest, ExportContainsEveryAction) {
+    LatencyTracker tracker;
+    tracker.begin(LatencyTracker::Seek, 10 * Ms);
+    tracker.mark(LatencyTracker::FirstOutput, 13 * Ms);
+
+    const QByteArray json = tracker.toJson();
+    for (const char *key : {"\"play\"", "\"next\"", "\"previous\"", "\"seek\"", "\"total\"",
+                            "\"p99_us\"", "\"buckets\"", "\"version\""}) {
+        EXPECT_TRUE(json.contains(key)) << key;
+    }
+}
@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "../loudnessmeter.h"
+
+namespace {
+    constexpr double TwoPi = 6.283185307179586;
+
+    // Stereo sine with both channels identical, fed in odd-sized chunks so hops get split
+    void feedSine(LoudnessMeter &meter, int sampleRate, double frequency, double amplitude,
+                  double seconds, double phase = 0.0)
+    {
+        const size_t total = static_cast<size_t>(seconds * sampleRate);
+        std::vector<float> left(1237);
+        std::vector<float> right(1237);
+        size_t done = 0;
+        while (done < total) {
+            const size_t count = std::min(left.size(), total - done);
+            for (size_t i = 0; i < count; ++i) {
+                left[i] = right[i] = float(amplitude * std::sin(TwoPi * frequency * double(done + i) / sampleRate + phase));
+            }
+            const float *planes[2] = {left.data(), right.data()};
+            meter.addPlanar(planes, count);
+            done += count;
+        }
+    }
+
+    double dbfs(double dB)
+    {
+        return std::pow(10.0, dB / 20.0);
+    }
+}
+
+/**
+ * Test suite for the BS.1770 / EBU R128 loudness measurement
+ */
+TEST(LoudnessMeterTest, ReferenceToneReadsItsLevel) {
+    // EBU Tech 3341 case 1: stereo 1 kHz at -23 dBFS is -23 LUFS
+    for (int rate : {44100, 48000, 96000}) {
+        LoudnessMeter meter(rate, 2);
+        feedSine(meter, rate, 1000.0, dbfs(-23.0), 20.0);
+        EXPECT_NEAR(meter.integratedLoudness(), -23.0, 0.1) << rate;
+    }
+}
+
+TEST(LoudnessMeterTest, SilenceIsGatedOut) {
+    LoudnessMeter silent(48000, 2);
+    feedSine(silent, 48000, 1000.0, 0.0, 5.0);
+    EXPECT_TRUE(std::isinf(silent.integratedLoudness()));
+    EXPECT_DOUBLE_EQ(silent.loudnessRange(), 0.0);
+
+    // The silent half must not drag the tone down
+    LoudnessMeter meter(48000, 2);
+    feedSine(meter, 48000, 1000.0, dbfs(-20.0), 10.0);
+    feedSine(meter, 48000, 1000.0, 0.0, 10.0);
+    EXPECT_NEAR(meter.integratedLoudness(), -20.0, 0.1);
+}
+
+TEST(LoudnessMeterTest, LoudnessRangeOfTwoLevels) {
+    // EBU Tech 3342 case 1: 20 s at -20 dBFS then 20 s at -30 dBFS is 10 LU
+    LoudnessMeter meter(48000, 2);
+    feedSine(meter, 48000, 1000.0, dbfs(-20.0), 20.0);
+    feedSine(meter, 48000, 1000.0, dbfs(-30.0), 20.0);
+    EXPECT_NEAR(meter.loudnessRange(), 10.0, 1.0);
+}
+
+TEST(LoudnessMeterTest, TruePeakFindsPeaksBetweenSamples) {
+    // fs/8 with a pi/8 offset: no sample lands on a crest, the best one is sin(3pi/8)
+    LoudnessMeter meter(48000, 2);
+    feedSine(meter, 48000, 6000.0, 1.0, 1.0, TwoPi / 16.0);
+    EXPECT_NEAR(meter.samplePeak(), std::sin(3.0 * TwoPi / 16.0), 1e-3);
+    EXPECT_NEAR(meter.truePeak(), 1.0, 0.02);
+}
+
+TEST(LoudnessMeterTest, AlbumPoolsGatingBlocks) {
+    LoudnessMeter loud(48000, 2);
+    feedSine(loud, 48000, 1000.0, dbfs(-14.0), 10.0);
+    LoudnessMeter quiet(48000, 2);
+    feedSine(quiet, 48000, 1000.0, dbfs(-20.0), 10.0);
+
+    std::vector<double> album = loud.gatingBlocks();
+    const std::vector<double> quietBlocks = quiet.gatingBlocks();
+    album.insert(album.end(), quietBlocks.begin(), quietBlocks.end());
+
+    // Power average of equal-length tracks, not the mean of the two LUFS values
+    const double expected = 10.0 * std::log10((std::pow(10.0, -1.4) + std::pow(10.0, -2.0)) / 2.0);
+    EXPECT_NEAR(LoudnessMeter::gatedLoudness(album), expected, 0.1);
+}
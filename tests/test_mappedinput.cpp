@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <QFile>
+#include <QTemporaryDir>
+#include "../mappedinput.h"
+#include "../audiodecoder.h"
+#include "flacfixture.h"
+
+/**
+ * Test suite for the mmap / large-read AVIOContext behind every FFmpeg input
+ */
+class MappedInputTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(dir.isValid());
+    }
+
+    QString writeFile(const QString &name, const QByteArray &data) {
+        QString path = dir.filePath(name);
+        QFile file(path);
+        EXPECT_TRUE(file.open(QIODevice::WriteOnly));
+        file.write(data);
+        return path;
+    }
+
+    // Every byte differs from its neighbours so a wrong offset shows up
+    static QByteArray pattern(int size) {
+        QByteArray data(size, '\0');
+        for (int i = 0; i < size; ++i) {
+            data[i] = char((i * 7 + i / 251) & 0xFF);
+        }
+        return data;
+    }
+
+    QTemporaryDir dir;
+};
+
+TEST_F(MappedInputTest, ReadsAndSeeksMatchTheFile) {
+    const QByteArray data = pattern(3 * 1024 * 1024 + 123);
+    const QString path = writeFile("data.bin", data);
+
+    for (InputStorage storage : {InputStorage::Local, InputStorage::Rotational, InputStorage::Network}) {
+        SCOPED_TRACE(MappedInput::storageName(storage).toStdString());
+        MappedInput input;
+        ASSERT_TRUE(input.open(path, storage)) << input.lastError().toStdString();
+        AVIOContext *avio = input.context();
+        ASSERT_NE(avio, nullptr);
+        EXPECT_EQ(avio_size(avio), data.size());
+
+        // Sequential read of the whole file
+        QByteArray all(data.size(), '\0');
+        EXPECT_EQ(avio_read(avio, reinterpret_cast<unsigned char *>(all.data()), int(all.size())), data.size());
+        EXPECT_EQ(all, data);
+
+        // Backwards and forwards, across buffer boundaries
+        for (qint64 offset : {qint64(0), qint64(1000003), qint64(data.size() - 10), qint64(65535)}) {
+            ASSERT_EQ(avio_seek(avio, offset, SEEK_SET), offset);
+            unsigned char bytes[10];
+            ASSERT_EQ(avio_read(avio, bytes, 10), 10);
+            EXPECT_EQ(QByteArray(reinterpret_cast<char *>(bytes), 10), data.mid(offset, 10));
+        }
+
+        const InputStats stats = input.stats();
+        EXPECT_EQ(stats.mapped, MappedInput::tuningFor(storage).map);
+        EXPECT_GE(stats.bytesRead, data.size());
+        EXPECT_GT(stats.reads, 0);
+        if (stats.mapped) {
+            EXPECT_EQ(stats.syscalls, 0);
+        } else {
+            // One read() per megabyte-sized buffer, not per 32 KiB
+            EXPECT_LE(stats.syscalls, 12);
+        }
+        input.close();
+        EXPECT_FALSE(input.isOpen());
+    }
+}
+
+TEST_F(MappedInputTest, EmptyAndMissingFiles) {
+    MappedInput input;
+    EXPECT_FALSE(input.open(dir.filePath("missing.flac"), InputStorage::Local));
+    EXPECT_FALSE(input.lastError().isEmpty());
+
+    // Nothing to map, falls back to reads and reports EOF straight away
+    ASSERT_TRUE(input.open(writeFile("empty.flac", QByteArray()), InputStorage::Local));
+    EXPECT_FALSE(input.stats().mapped);
+    unsigned char byte;
+    EXPECT_LE(avio_read(input.context(), &byte, 1), 0);
+    AVFormatContext *formatCtx = nullptr;
+    EXPECT_FALSE(input.openFormat(&formatCtx));
+    EXPECT_EQ(formatCtx, nullptr);
+}
+
+TEST_F(MappedInputTest, DecoderReadsThroughEveryStorage) {
+    const int rate = 44100;
+    const QString path = writeFile("tone.wav", FlacFixture::pcmWav(rate, rate));
+
+    for (InputStorage storage : {InputStorage::Local, InputStorage::Network}) {
+        SCOPED_TRACE(MappedInput::storageName(storage).toStdString());
+        MappedInput::setDefaultStorage(storage);
+        AudioDecoder decoder;
+        ASSERT_TRUE(decoder.open(path)) << decoder.lastError().toStdString();
+        EXPECT_EQ(decoder.sampleRate(), rate);
+        EXPECT_EQ(decoder.channels(), 2);
+
+        qint64 samples = 0;
+        while (AVFrame *frame = decoder.decodeNextFrame()) {
+            samples += frame->nb_samples;
+        }
+        EXPECT_EQ(samples, rate);
+        EXPECT_EQ(decoder.decodeErrors(), 0);
+        EXPECT_EQ(decoder.inputStats().mapped, storage != InputStorage::Network);
+
+        // Seeking goes through the same context
+        ASSERT_TRUE(decoder.seek(rate / 2));
+        ASSERT_NE(decoder.decodeNextFrame(), nullptr);
+        EXPECT_GT(decoder.inputStats().seeks, 0);
+    }
+    MappedInput::setDefaultStorage(InputStorage::Auto);
+}
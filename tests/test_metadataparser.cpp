@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include <QBuffer>
+#include <QFile>
+#include <QImage>
+#include <QTemporaryDir>
+#include "../audiomanager.h"
+#include "flacfixture.h"
+
+using FlacFixture::Block;
+
+namespace {
+    // 441000 samples in three audio tracks and a data track, the second with a pregap
+    QList<FlacFixture::CueSheetTrack> albumTracks()
+    {
+        return {
+            {0, 1, {{1, 0}}, true, "USABC0000001"},
+            {88200, 2, {{0, 0}, {1, 588}}, true, ""},
+            {200000, 3, {{1, 0}}, false, ""},
+            {300000, 4, {{1, 0}, {2, 4410}}, true, ""},
+            {441000, 170, {}, true, ""},
+        };
+    }
+
+    QList<CueTrack> parseCue(MetadataEditor &editor, const QByteArray &cueSheet)
+    {
+        return editor.parseMetadata(FlacFixture::flacStream({
+            {FlacFixture::StreamInfo, FlacFixture::streamInfo()},
+            {FlacFixture::CueSheet, cueSheet}
+        })).cueTracks;
+    }
+}
+
+/**
+ * Regression tests for the FLAC metadata block parsers.
+ * Lengths inside the blocks are attacker controlled, every case here used to
+ * either read past the block or overflow the offset arithmetic
+ */
+class MetadataParserTest : public ::testing::Test {
+protected:
+    MetadataEditor editor;
+};
+
+TEST_F(MetadataParserTest, ParsesStreamInfoAndTags) {
+    QByteArray stream = FlacFixture::flacStream({
+        {FlacFixture::StreamInfo, FlacFixture::streamInfo(48000, 2, 24, 96000)},
+        {FlacFixture::VorbisComment, FlacFixture::vorbisComment({{"TITLE", "Song"}, {"ARTIST", "Band"}})}
+    });
+
+    FlacMetadata metadata = editor.parseMetadata(stream);
+    EXPECT_TRUE(editor.lastError().isEmpty());
+    EXPECT_EQ(metadata.sampleRate, 48000);
+    EXPECT_EQ(metadata.channels, 2);
+    EXPECT_EQ(metadata.bitsPerSample, 24);
+    EXPECT_EQ(metadata.totalSamples, 96000u);
+    EXPECT_EQ(metadata.title, "Song");
+    EXPECT_EQ(metadata.artist, "Band");
+}
+
+TEST_F(MetadataParserTest, RejectsNonFlacInput) {
+    editor.parseMetadata(QByteArray("ID3\x04 not a flac file"));
+    EXPECT_FALSE(editor.lastError().isEmpty());
+}
+
+TEST_F(MetadataParserTest, VendorLengthPastEndIsIgnored) {
+    QByteArray comment;
+    FlacFixture::appendLE32(comment, 0xFFFFFFF0u);  // would wrap a 32-bit offset
+    FlacFixture::appendLE32(comment, 1);
+    comment.append("TITLE=x");
+
+    FlacMetadata metadata = editor.parseMetadata(FlacFixture::flacStream({{FlacFixture::VorbisComment, comment}}));
+    EXPECT_TRUE(metadata.title.isEmpty());
+}
+
+TEST_F(MetadataParserTest, CommentLengthPastEndStopsParsing) {
+    QByteArray comment = FlacFixture::vorbisComment({{"TITLE", "kept"}});
+    // Claim one more comment with a length far beyond the block
+    comment[comment.indexOf("flacfixture") + 11] = 2;
+    FlacFixture::appendLE32(comment, 0x7FFFFFFFu);
+    comment.append("ARTIST=dropped");
+
+    FlacMetadata metadata = editor.parseMetadata(FlacFixture::flacStream({{FlacFixture::VorbisComment, comment}}));
+    EXPECT_EQ(metadata.title, "kept");
+    EXPECT_TRUE(metadata.artist.isEmpty());
+}
+
+TEST_F(MetadataParserTest, PictureMimeLengthPastEndIsIgnored) {
+    QByteArray block;
+    FlacFixture::appendBE(block, 3, 4);
+    FlacFixture::appendBE(block, 0xFFFFFFFCu, 4);   // mime length
+    block.append(QByteArray(40, 'A'));
+
+    FlacMetadata metadata = editor.parseMetadata(FlacFixture::flacStream({{FlacFixture::Picture, block}}));
+    EXPECT_TRUE(metadata.albumArt.isNull());
+}
+
+TEST_F(MetadataParserTest, PictureDescriptionLengthPastEndIsIgnored) {
+    QByteArray block = FlacFixture::picture(QByteArray(64, 'B'));
+    // Description length sits after type (4), mime length (4) and "image/png" (9)
+    block[17] = static_cast<char>(0x7F);
+
+    FlacMetadata metadata = editor.parseMetadata(FlacFixture::flacStream({{FlacFixture::Picture, block}}));
+    EXPECT_TRUE(metadata.albumArt.isNull());
+}
+
+TEST_F(MetadataParserTest, PictureRoundTrip) {
+    QImage image(8, 8, QImage::Format_RGB32);
+    image.fill(Qt::red);
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    image.save(&buffer, "PNG");
+
+    FlacMetadata metadata = editor.parseMetadata(FlacFixture::flacStream({{FlacFixture::Picture, FlacFixture::picture(png)}}));
+    ASSERT_FALSE(metadata.albumArt.isNull());
+    EXPECT_EQ(metadata.albumArt.size(), QSize(8, 8));
+}
+
+TEST_F(MetadataParserTest, TruncatedBlockDoesNotCrash) {
+    QByteArray stream = FlacFixture::flacStream({
+        {FlacFixture::StreamInfo, FlacFixture::streamInfo()},
+        {FlacFixture::VorbisComment, FlacFixture::vorbisComment({{"TITLE", "cut"}})}
+    });
+    stream.chop(5);
+
+    FlacMetadata metadata = editor.parseMetadata(stream);
+    EXPECT_EQ(metadata.sampleRate, 44100);
+    EXPECT_TRUE(metadata.title.isEmpty());
+}
+
+TEST_F(MetadataParserTest, CueSheetTracksAndRanges) {
+    const QList<CueTrack> tracks = parseCue(editor, FlacFixture::cueSheet(albumTracks()));
+    ASSERT_EQ(tracks.size(), 3);
+
+    EXPECT_EQ(tracks[0].number, 1);
+    EXPECT_EQ(tracks[0].startSample, 0u);
+    EXPECT_EQ(tracks[0].isrc, "USABC0000001");
+    // The pregap (INDEX 00) is still the previous track, the next one starts at its INDEX 01
+    EXPECT_EQ(tracks[0].endSample, 88788u);
+    EXPECT_EQ(tracks[1].number, 2);
+    EXPECT_EQ(tracks[1].startSample, 88788u);
+    EXPECT_TRUE(tracks[1].isrc.isEmpty());
+    // The data track ends the one before it and is left out itself
+    EXPECT_EQ(tracks[1].endSample, 200000u);
+    EXPECT_EQ(tracks[2].number, 4);
+    EXPECT_EQ(tracks[2].startSample, 300000u);
+    EXPECT_EQ(tracks[2].endSample, 441000u);
+}
+
+TEST_F(MetadataParserTest, CueSheetLeadOutAndIndexPoints) {
+    const QList<CueTrack> tracks = parseCue(editor, FlacFixture::cueSheet({
+        {0, 1, {{0, 0}, {2, 300}, {1, 150}}, true, ""},  // INDEX 01 wherever it is listed
+        {48000, 2, {{0, 0}, {2, 600}}, true, ""},       // none at all, the first point counts
+        {96000, 3, {{1, 0}}, true, ""},                 // nothing left before the lead-out
+        {96000, 255, {}, true, ""},
+    }));
+    ASSERT_EQ(tracks.size(), 2);
+    EXPECT_EQ(tracks[0].startSample, 150u);
+    EXPECT_EQ(tracks[0].endSample, 48000u);
+    EXPECT_EQ(tracks[1].startSample, 48000u);
+    EXPECT_EQ(tracks[1].endSample, 96000u);
+
+    // Only the declared tracks are read, the last of them is the lead-out
+    const QList<CueTrack> first = parseCue(editor, FlacFixture::cueSheet(albumTracks(), 2));
+    ASSERT_EQ(first.size(), 1);
+    EXPECT_EQ(first[0].endSample, 88200u);
+}
+
+TEST_F(MetadataParserTest, CueSheetCountsPastEndAreRejected) {
+    const QByteArray cueSheet = FlacFixture::cueSheet(albumTracks());
+    ASSERT_EQ(parseCue(editor, cueSheet).size(), 3);
+
+    // More tracks than the block holds
+    EXPECT_TRUE(parseCue(editor, FlacFixture::cueSheet(albumTracks(), 7)).isEmpty());
+    EXPECT_TRUE(parseCue(editor, FlacFixture::cueSheet(albumTracks(), 255)).isEmpty());
+
+    // More index points than the block holds, on the first track
+    QByteArray indices = cueSheet;
+    indices[396 + 35] = static_cast<char>(200);
+    EXPECT_TRUE(parseCue(editor, indices).isEmpty());
+
+    // Cut inside the lead-out, inside an index point and inside the header
+    for (int size : {int(cueSheet.size()) - 20, int(cueSheet.size()) - 40, 300}) {
+        EXPECT_TRUE(parseCue(editor, cueSheet.left(size)).isEmpty()) << size;
+    }
+}
+
+TEST_F(MetadataParserTest, ReadsCueTracksFromFile) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = dir.filePath("album.flac");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(FlacFixture::flacStream({
+        {FlacFixture::StreamInfo, FlacFixture::streamInfo(48000, 2, 16, 441000)},
+        {FlacFixture::VorbisComment, FlacFixture::vorbisComment({{"TITLE", "Album"}})},
+        {FlacFixture::CueSheet, FlacFixture::cueSheet(albumTracks())}
+    }, FlacFixture::fakeFrames(2)));
+    file.close();
+
+    int sampleRate = 0;
+    const QList<CueTrack> tracks = editor.readCueTracks(path, &sampleRate);
+    EXPECT_EQ(sampleRate, 48000);
+    ASSERT_EQ(tracks.size(), 3);
+    EXPECT_EQ(tracks[1].startSample, 88788u);
+    EXPECT_EQ(tracks[2].endSample, 441000u);
+
+    EXPECT_TRUE(editor.readCueTracks(dir.filePath("missing.flac")).isEmpty());
+}
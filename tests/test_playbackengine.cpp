@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QUrl>
+#include "../playbackengine.h"
+#include "flacfixture.h"
+
+/**
+ * Test suite for the engine's source opens, which run off the calling thread for the current
+ * source and for the gapless queue
+ */
+namespace {
+    //runs the event loop until done() or the timeout
+    template <typename Done>
+    bool waitFor(Done done, int timeoutMs = 2000)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (!done() && timer.elapsed() < timeoutMs) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 20);
+        }
+        return done();
+    }
+}
+
+TEST(PlaybackEngineTest, OpensTheNextSourceInTheBackground) {
+    PlaybackEngine engine;
+    engine.setNextSource(QUrl::fromLocalFile("/no/such/file.flac"));
+    // Queued right away, that it can't be opened only shows once the background open is back
+    EXPECT_TRUE(engine.hasNextSource());
+    EXPECT_TRUE(waitFor([&engine]() { return !engine.hasNextSource(); }));
+}
+
+TEST(PlaybackEngineTest, ClearedRequestsDontComeBack) {
+    PlaybackEngine engine;
+    engine.setNextSource(QUrl::fromLocalFile("/no/such/first.flac"));
+    engine.setNextSource(QUrl::fromLocalFile("/no/such/second.flac"));
+    engine.clearNextSource();
+    EXPECT_FALSE(engine.hasNextSource());
+
+    // Whatever the pool still had in flight is dropped, it doesn't turn the queue back on
+    waitFor([]() { return false; }, 200);
+    EXPECT_FALSE(engine.hasNextSource());
+}
+
+TEST(PlaybackEngineTest, OpensTheSourceInTheBackground) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString path = dir.filePath("tone.wav");
+    QFile file(path);
+    ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+    file.write(FlacFixture::pcmWav(44100, 44100));
+    file.close();
+
+    PlaybackEngine engine;
+    QSignalSpy durations(&engine, &PlaybackEngine::durationChanged);
+    QSignalSpy errors(&engine, &PlaybackEngine::errorOccurred);
+
+    // A source that can't be opened, replaced before its open is back, never reports its failure
+    engine.setSource(QUrl::fromLocalFile("/no/such/file.flac"));
+    EXPECT_EQ(engine.mediaStatus(), QMediaPlayer::LoadingMedia);
+    engine.setSource(QUrl::fromLocalFile(path));
+    // Returned before the open, nothing is known about the file yet
+    EXPECT_EQ(engine.mediaStatus(), QMediaPlayer::LoadingMedia);
+    EXPECT_EQ(durations.count(), 0);
+
+    ASSERT_TRUE(waitFor([&engine]() { return engine.mediaStatus() != QMediaPlayer::LoadingMedia; }));
+    EXPECT_EQ(engine.mediaStatus(), QMediaPlayer::LoadedMedia);
+    EXPECT_EQ(engine.duration(), 1000);
+    ASSERT_EQ(durations.count(), 1);
+    EXPECT_EQ(durations[0][0].toLongLong(), 1000);
+    waitFor([]() { return false; }, 200);
+    EXPECT_EQ(errors.count(), 0);
+
+    engine.setSource(QUrl::fromLocalFile("/no/such/file.flac"));
+    EXPECT_EQ(engine.mediaStatus(), QMediaPlayer::LoadingMedia);
+    EXPECT_TRUE(waitFor([&engine]() { return engine.mediaStatus() == QMediaPlayer::InvalidMedia; }));
+    EXPECT_EQ(errors.count(), 1);
+}
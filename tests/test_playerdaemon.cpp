@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include "../playerdaemon.h"
+#include "flacfixture.h"
+
+/**
+ * Test suite for the headless daemon's command protocol, on its own and over the socket
+ */
+namespace {
+    QJsonObject reply(PlayerDaemon &daemon, const QString &line)
+    {
+        return QJsonDocument::fromJson(daemon.execute(line)).object();
+    }
+
+    QString writeTrack(const QTemporaryDir &dir, const QString &name, const QString &title)
+    {
+        using namespace FlacFixture;
+        const QString path = dir.filePath(name);
+        QFile file(path);
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(flacStream({{StreamInfo, streamInfo()}, {VorbisComment, vorbisComment({{"TITLE", title}})}},
+                                  QByteArray(4096, '\0')));
+        }
+        return path;
+    }
+}
+
+TEST(PlayerDaemonTest, RejectsWhatItCannotDo) {
+    PlayerDaemon daemon;
+    const QJsonObject status = reply(daemon, "status");
+    EXPECT_TRUE(status["ok"].toBool());
+    EXPECT_EQ(status["state"].toString(), "stopped");
+    EXPECT_EQ(status["index"].toInt(), -1);
+    EXPECT_EQ(status["queue"].toInt(), 0);
+
+    for (const QString &line : {"frobnicate", "enqueue", "enqueue /no/such/file.flac", "enqueue relative.flac", "play", "play 3",
+                                "seek", "seek 1000", "volume 101", "volume loud", "next"}) {
+        const QJsonObject answer = reply(daemon, line);
+        EXPECT_FALSE(answer["ok"].toBool()) << line.toStdString();
+        EXPECT_FALSE(answer["error"].toString().isEmpty()) << line.toStdString();
+    }
+    EXPECT_TRUE(reply(daemon, "volume 40")["ok"].toBool());
+    EXPECT_EQ(reply(daemon, "STATUS")["volume"].toInt(), 40);
+}
+
+TEST(PlayerDaemonTest, QueuesAndNamesTracks) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    const QString first = writeTrack(dir, "one.flac", "First Song");
+    const QString second = writeTrack(dir, "two with spaces.flac", "Second Song");
+
+    PlayerDaemon daemon;
+    EXPECT_EQ(reply(daemon, "enqueue " + first)["queue"].toInt(), 1);
+    // The rest of the line is the path, spaces and all
+    const QJsonObject added = reply(daemon, "enqueue " + second);
+    ASSERT_TRUE(added["ok"].toBool()) << added["error"].toString().toStdString();
+    EXPECT_EQ(added["added"].toInt(), 1);
+    EXPECT_EQ(daemon.playlist().size(), 2);
+    EXPECT_EQ(daemon.currentIndex(), 0);    // The first file is loaded right away
+
+    const QJsonObject queue = reply(daemon, "queue");
+    const QJsonArray entries = queue["entries"].toArray();
+    ASSERT_EQ(entries.size(), 2);
+    EXPECT_EQ(entries[0].toObject()["title"].toString(), "First Song");
+    EXPECT_EQ(entries[1].toObject()["title"].toString(), "Second Song");
+    EXPECT_EQ(entries[1].toObject()["file"].toString(), second);
+    EXPECT_EQ(reply(daemon, "status")["track"].toObject()["title"].toString(), "First Song");
+
+    // Titles are read on enqueue, polling doesn't go back to the file
+    writeTrack(dir, "one.flac", "Retagged");
+    EXPECT_EQ(reply(daemon, "status")["track"].toObject()["title"].toString(), "First Song");
+
+    EXPECT_TRUE(reply(daemon, "clear")["ok"].toBool());
+    EXPECT_EQ(daemon.playlist().size(), 0);
+    EXPECT_EQ(daemon.currentIndex(), -1);
+}
+
+TEST(PlayerDaemonTest, AnswersOnTheSocket) {
+    const QString name = QString("flacplayerd-test-%1").arg(QCoreApplication::applicationPid());
+    PlayerDaemon daemon;
+    ASSERT_TRUE(daemon.listen(name)) << daemon.lastError().toStdString();
+
+    // A second daemon doesn't take the socket from a live one
+    PlayerDaemon intruder;
+    EXPECT_FALSE(intruder.listen(name));
+
+    QSignalSpy quit(&daemon, &PlayerDaemon::quitRequested);
+    QLocalSocket socket;
+    socket.connectToServer(name);
+    ASSERT_TRUE(socket.waitForConnected(2000));
+
+    // Two commands in one write, one reply line each
+    socket.write("status\nbogus\n");
+    QList<QJsonObject> replies;
+    for (int i = 0; i < 50 && replies.size() < 2; ++i) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 20);
+        socket.waitForReadyRead(20);
+        while (socket.canReadLine()) {
+            replies.append(QJsonDocument::fromJson(socket.readLine()).object());
+        }
+    }
+    ASSERT_EQ(replies.size(), 2);
+    EXPECT_TRUE(replies[0]["ok"].toBool());
+    EXPECT_EQ(replies[0]["state"].toString(), "stopped");
+    EXPECT_FALSE(replies[1]["ok"].toBool());
+
+    socket.write("quit\n");
+    EXPECT_TRUE(quit.wait(2000));
+}
@@ -149,3 +149,46 @@ TEST_F(PlaylistTest, SubscriptOperatorAllowsModification) {
     EXPECT_EQ(playlist[1], "/path/modified.flac");
     EXPECT_EQ(playlist.size(), 2); // Size should not change
 }
+
+// Test virtual cue tracks of one album image are separate entries
+TEST_F(PlaylistTest, VirtualTracksOfSameFileAreDistinct) {
+    PlaylistEntry first("/path/album.flac");
+    first.startSample = 0;
+    first.endSample = 441000;
+    first.sampleRate = 44100;
+    first.cueTrack = 1;
+    
+    PlaylistEntry second("/path/album.flac");
+    second.startSample = 441000;
+    second.sampleRate = 44100;
+    second.cueTrack = 2;
+    
+    playlist.append(first);
+    playlist.append(second);
+    
+    EXPECT_EQ(playlist.size(), 2);
+    EXPECT_EQ(playlist.indexOf(first), 0);
+    EXPECT_EQ(playlist.indexOf(second), 1);
+    EXPECT_EQ(playlist.indexOf("/path/album.flac"), -1); // Whole-file entry was never queued
+}
+
+// Test sample ranges convert to playback positions
+TEST_F(PlaylistTest, VirtualTrackRangeInMilliseconds) {
+    PlaylistEntry entry("/path/album.flac");
+    entry.startSample = 88200;
+    entry.endSample = 220500;
+    entry.sampleRate = 44100;
+    entry.cueTrack = 3;
+    
+    EXPECT_TRUE(entry.isVirtual());
+    EXPECT_EQ(entry.startMs(), 2000);
+    EXPECT_EQ(entry.endMs(), 5000);
+    EXPECT_EQ(entry.displayName(), "Track 03 - album.flac");
+    
+    // Plain files have no range
+    PlaylistEntry plain("/path/song.flac");
+    EXPECT_FALSE(plain.isVirtual());
+    EXPECT_EQ(plain.startMs(), 0);
+    EXPECT_EQ(plain.endMs(), 0);
+    EXPECT_EQ(plain.displayName(), "song.flac");
+}
@@ -0,0 +1,112 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+#include "../resampler.h"
+
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+namespace {
+    constexpr double TwoPi = 6.283185307179586;
+
+    // One second of a stereo 1 kHz sine through the profile, returns the interleaved output
+    std::vector<float> resampleSine(ResamplerProfile profile, int inRate, int outRate, double amplitude)
+    {
+        AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+        SwrContext *swr = Resampler::acquire(&stereo, AV_SAMPLE_FMT_FLT, outRate,
+                                             &stereo, AV_SAMPLE_FMT_FLT, inRate, profile);
+        if (!swr) {
+            return {};
+        }
+
+        std::vector<float> input(size_t(inRate) * 2);
+        for (int i = 0; i < inRate; ++i) {
+            input[size_t(i) * 2] = input[size_t(i) * 2 + 1] = float(amplitude * std::sin(TwoPi * 1000.0 * i / inRate));
+        }
+
+        std::vector<float> output;
+        std::vector<float> block(8192 * 2);
+        constexpr int Chunk = 4096;
+        for (int offset = 0; offset <= inRate; offset += Chunk) {
+            // Last round drains the filter
+            const bool flush = offset >= inRate;
+            const int count = flush ? 0 : std::min(Chunk, inRate - offset);
+            const uint8_t *src[1] = {reinterpret_cast<const uint8_t *>(input.data() + size_t(offset) * 2)};
+            uint8_t *dst[1] = {reinterpret_cast<uint8_t *>(block.data())};
+            const int produced = swr_convert(swr, dst, 8192, flush ? nullptr : src, count);
+            if (produced > 0) {
+                output.insert(output.end(), block.begin(), block.begin() + produced * 2);
+            }
+        }
+        Resampler::release(swr);
+        return output;
+    }
+
+    double rms(const std::vector<float> &samples, size_t skip)
+    {
+        double sum = 0.0;
+        for (size_t i = skip; i < samples.size() - skip; ++i) {
+            sum += double(samples[i]) * samples[i];
+        }
+        return std::sqrt(sum / double(samples.size() - 2 * skip));
+    }
+}
+
+/**
+ * Test suite for the shared resampling stage
+ */
+TEST(ResamplerTest, EveryProfileKeepsLengthAndLevel) {
+    const double amplitude = 0.5;
+    for (ResamplerProfile profile : {ResamplerProfile::Fast, ResamplerProfile::Balanced,
+                                     ResamplerProfile::HighQuality, ResamplerProfile::Soxr}) {
+        const std::vector<float> output = resampleSine(profile, 44100, 48000, amplitude);
+        ASSERT_FALSE(output.empty()) << Resampler::profileName(profile).toStdString();
+
+        // One second in is one second out, give or take the filter's edges
+        const int frames = int(output.size() / 2);
+        EXPECT_NEAR(frames, 48000, 64) << Resampler::profileName(profile).toStdString();
+
+        // 1 kHz is far inside the passband of every profile, skip the fade-in of the filter
+        EXPECT_NEAR(rms(output, 2048), amplitude / std::sqrt(2.0), 0.01)
+            << Resampler::profileName(profile).toStdString();
+    }
+}
+
+TEST(ResamplerTest, ReleasedContextIsReused) {
+    Resampler::clearCache();
+    AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+    SwrContext *first = Resampler::acquire(&stereo, AV_SAMPLE_FMT_S16, 96000,
+                                           &stereo, AV_SAMPLE_FMT_S32, 44100, ResamplerProfile::HighQuality);
+    ASSERT_NE(first, nullptr);
+    SwrContext *kept = first;
+    Resampler::release(first);
+    EXPECT_EQ(first, nullptr);
+
+    const int hits = Resampler::cacheHits();
+    SwrContext *second = Resampler::acquire(&stereo, AV_SAMPLE_FMT_S16, 96000,
+                                            &stereo, AV_SAMPLE_FMT_S32, 44100, ResamplerProfile::HighQuality);
+    EXPECT_EQ(second, kept);
+    EXPECT_EQ(Resampler::cacheHits(), hits + 1);
+
+    // A different profile for the same rates needs its own filter
+    const int misses = Resampler::cacheMisses();
+    SwrContext *other = Resampler::acquire(&stereo, AV_SAMPLE_FMT_S16, 96000,
+                                           &stereo, AV_SAMPLE_FMT_S32, 44100, ResamplerProfile::Fast);
+    EXPECT_NE(other, second);
+    EXPECT_EQ(Resampler::cacheMisses(), misses + 1);
+
+    Resampler::release(second);
+    Resampler::release(other);
+    Resampler::clearCache();
+}
+
+TEST(ResamplerTest, SoxrProfileAlwaysGivesAContext) {
+    // Without libsoxr the profile quietly becomes High quality instead of failing playback
+    AVChannelLayout mono = AV_CHANNEL_LAYOUT_MONO;
+    SwrContext *swr = Resampler::acquire(&mono, AV_SAMPLE_FMT_FLT, 48000,
+                                         &mono, AV_SAMPLE_FMT_S16, 44100, ResamplerProfile::Soxr);
+    EXPECT_NE(swr, nullptr) << "soxr available: " << Resampler::soxrAvailable();
+    Resampler::release(swr);
+    EXPECT_EQ(swr, nullptr);
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <QtGlobal>
+#include "../ringbuffer.h"
+
+/**
+ * Test suite for the lock-free SPSC ring buffer behind the native playback engine
+ */
+TEST(RingBufferTest, CapacityRoundsUpToPowerOfTwo) {
+    SpscRingBuffer<char> ring(1000);
+    EXPECT_EQ(ring.capacity(), 1024u);
+    EXPECT_EQ(ring.freeSpace(), 1024u);
+    EXPECT_EQ(ring.available(), 0u);
+}
+
+TEST(RingBufferTest, WriteStopsWhenFull) {
+    SpscRingBuffer<int> ring(4);
+    int data[6] = {1, 2, 3, 4, 5, 6};
+    EXPECT_EQ(ring.write(data, 6), 4u);
+    EXPECT_EQ(ring.freeSpace(), 0u);
+
+    int out[6] = {};
+    EXPECT_EQ(ring.read(out, 6), 4u);
+    EXPECT_EQ(out[0], 1);
+    EXPECT_EQ(out[3], 4);
+}
+
+TEST(RingBufferTest, WrapsAroundTheEnd) {
+    SpscRingBuffer<int> ring(8);
+    int out[8];
+    for (int round = 0; round < 10; ++round) {
+        int data[5] = {round, round + 1, round + 2, round + 3, round + 4};
+        ASSERT_EQ(ring.write(data, 5), 5u);
+        ASSERT_EQ(ring.read(out, 5), 5u);
+        for (int i = 0; i < 5; ++i) {
+            EXPECT_EQ(out[i], round + i);
+        }
+    }
+}
+
+TEST(RingBufferTest, DiscardDropsOnlyDataWrittenBeforeIt) {
+    SpscRingBuffer<char> ring(16);
+    ring.write("oldold", 6);
+    char out[16];
+    EXPECT_EQ(ring.read(out, 2), 2u);
+
+    ring.discardWritten();
+    ring.write("new", 3);
+
+    bool discarded = false;
+    size_t got = ring.read(out, sizeof(out), &discarded);
+    EXPECT_TRUE(discarded);
+    ASSERT_EQ(got, 3u);
+    EXPECT_EQ(std::string(out, got), "new");
+
+    discarded = false;
+    ring.read(out, sizeof(out), &discarded);
+    EXPECT_FALSE(discarded);
+}
+
+TEST(RingBufferTest, ConcurrentProducerConsumerKeepOrder) {
+    SpscRingBuffer<quint32> ring(256);
+    const quint32 total = 200000;
+
+    std::thread producer([&ring, total]() {
+        quint32 next = 0;
+        quint32 chunk[37];
+        while (next < total) {
+            size_t count = 0;
+            while (count < 37 && next + count < total) {
+                chunk[count] = next + static_cast<quint32>(count);
+                ++count;
+            }
+            size_t written = 0;
+            while (written < count) {
+                written += ring.write(chunk + written, count - written);
+            }
+            next += static_cast<quint32>(count);
+        }
+    });
+
+    quint32 expected = 0;
+    bool inOrder = true;
+    std::vector<quint32> out(53);
+    while (expected < total) {
+        size_t got = ring.read(out.data(), out.size());
+        for (size_t i = 0; i < got; ++i) {
+            inOrder = inOrder && out[i] == expected;
+            ++expected;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(inOrder);
+}
+
+TEST(RingBufferTest, DiscardWhileReaderDrains) {
+    // Each sample is its generation (bumped on every discard) above its write index
+    SpscRingBuffer<quint64> ring(64);
+    const quint64 total = 100000;
+    std::atomic<bool> done{false};
+
+    std::thread producer([&ring, &done, total]() {
+        quint64 generation = 0;
+        quint64 chunk[13];
+        int writes = 0;
+        while (ring.writeIndex() < total) {
+            const quint64 index = ring.writeIndex();
+            for (size_t i = 0; i < 13; ++i) {
+                chunk[i] = (generation << 32) | (index + i);
+            }
+            if (ring.write(chunk, 13) == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            // Discard right after writing, the window the reader has to cope with
+            if (++writes % 7 == 0) {
+                ring.discardWritten();
+                ++generation;
+            }
+        }
+        done = true;
+    });
+
+    bool ok = true;
+    bool indicesOk = true;
+    quint64 lastGeneration = 0;
+    quint64 lastIndex = 0;
+    bool haveLast = false;
+    bool discardSinceLast = false;
+    std::vector<quint64> out(29);
+    while (!done || ring.available() > 0) {
+        bool discarded = false;
+        const size_t got = ring.read(out.data(), out.size(), &discarded);
+        indicesOk = indicesOk && ring.readIndex() <= ring.writeIndex();
+        discardSinceLast = discardSinceLast || discarded;
+        if (got == 0) {
+            std::this_thread::yield();
+        }
+        for (size_t i = 0; i < got; ++i) {
+            const quint64 generation = out[i] >> 32;
+            const quint64 index = out[i] & 0xffffffffu;
+            if (haveLast) {
+                if (discardSinceLast) {
+                    // Nothing written before the discard may come through
+                    ok = ok && generation > lastGeneration && index > lastIndex;
+                } else {
+                    ok = ok && generation == lastGeneration && index == lastIndex + 1;
+                }
+            }
+            lastGeneration = generation;
+            lastIndex = index;
+            haveLast = true;
+            discardSinceLast = false;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(indicesOk);
+    EXPECT_TRUE(ok);
+    EXPECT_LE(ring.readIndex(), ring.writeIndex());
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <QSignalSpy>
+#include <QTest>
+#include "../seekcoalescer.h"
+
+/**
+ * Test suite for the seek coalescer in front of the backend and the hold-to-scrub speed curve
+ */
+TEST(SeekCoalescerTest, BurstSendsFirstAndLast) {
+    SeekCoalescer coalescer;
+    QSignalSpy spy(&coalescer, &SeekCoalescer::seekRequested);
+
+    // A drag: one value per mouse move, all inside the interval
+    for (qint64 position = 1000; position <= 2000; position += 100) {
+        coalescer.request(position);
+    }
+    ASSERT_EQ(spy.count(), 1);
+    EXPECT_EQ(spy[0][0].toLongLong(), 1000);
+    EXPECT_TRUE(coalescer.isPending());
+    EXPECT_EQ(coalescer.targetMs(), 2000);
+
+    // Only the latest one goes out when the interval is up
+    EXPECT_TRUE(spy.wait(SeekCoalescer::IntervalMs * 10));
+    ASSERT_EQ(spy.count(), 2);
+    EXPECT_EQ(spy[1][0].toLongLong(), 2000);
+    EXPECT_FALSE(coalescer.isPending());
+    EXPECT_EQ(coalescer.requestCount(), 11);
+    EXPECT_EQ(coalescer.seekCount(), 2);
+
+    // Nothing left, the next interval ends quietly
+    QTest::qWait(SeekCoalescer::IntervalMs * 3);
+    EXPECT_EQ(spy.count(), 2);
+}
+
+TEST(SeekCoalescerTest, FlushAndCancel) {
+    SeekCoalescer coalescer;
+    QSignalSpy spy(&coalescer, &SeekCoalescer::seekRequested);
+
+    // Releasing the handle doesn't wait for the interval
+    coalescer.request(100);
+    coalescer.request(200);
+    coalescer.flush();
+    ASSERT_EQ(spy.count(), 2);
+    EXPECT_EQ(spy[1][0].toLongLong(), 200);
+    coalescer.flush();
+    EXPECT_EQ(spy.count(), 2);
+
+    // The interval was closed by the flush, the next request goes straight out
+    coalescer.request(300);
+    ASSERT_EQ(spy.count(), 3);
+
+    // A track change drops what's pending for the old one
+    coalescer.request(400);
+    coalescer.cancel();
+    EXPECT_FALSE(coalescer.isPending());
+    QTest::qWait(SeekCoalescer::IntervalMs * 3);
+    EXPECT_EQ(spy.count(), 3);
+    EXPECT_EQ(spy[2][0].toLongLong(), 300);
+}
+
+TEST(SeekCoalescerTest, ScrubAcceleratesUpToTheCap) {
+    EXPECT_EQ(Scrub::travel(0), 0);
+    EXPECT_DOUBLE_EQ(Scrub::rate(0), Scrub::BaseRate);
+    EXPECT_NEAR(Scrub::rate(Scrub::DoublingMs), Scrub::BaseRate * 2.0, 1e-9);
+    EXPECT_DOUBLE_EQ(Scrub::rate(60000), Scrub::MaxRate);
+
+    // The first tick moves by about BaseRate ticks' worth, the travel never goes back
+    EXPECT_NEAR(double(Scrub::travel(Scrub::TickMs)), Scrub::BaseRate * Scrub::TickMs, Scrub::BaseRate * Scrub::TickMs * 0.05);
+    qint64 previous = 0;
+    for (qint64 held = Scrub::TickMs; held <= 20000; held += Scrub::TickMs) {
+        const qint64 travel = Scrub::travel(held);
+        EXPECT_GT(travel, previous) << held;
+        // Each tick covers no more than MaxRate allows
+        EXPECT_LE(travel - previous, qint64(Scrub::MaxRate * Scrub::TickMs) + 1) << held;
+        previous = travel;
+    }
+
+    // Past the ramp it's a straight line at the cap
+    EXPECT_NEAR(double(Scrub::travel(30000) - Scrub::travel(20000)), Scrub::MaxRate * 10000.0, 1.0);
+}
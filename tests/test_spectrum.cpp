@@ -0,0 +1,172 @@
+#include <gtest/gtest.h>
+#include <QElapsedTimer>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include "../spectrumanalyzer.h"
+#include "../dspkernels.h"
+
+/**
+ * Test suite for the spectrum display's back end: the band levels of the transform, the tap on
+ * the audio thread and the analysis thread between them
+ */
+namespace {
+    constexpr double TwoPi = 6.283185307179586;
+
+    std::vector<float> sine(double frequency, int sampleRate, float amplitude, size_t count)
+    {
+        std::vector<float> samples(count);
+        for (size_t i = 0; i < count; ++i) {
+            samples[i] = amplitude * float(std::sin(TwoPi * frequency * double(i) / sampleRate));
+        }
+        return samples;
+    }
+
+    int loudestBand(const std::vector<float> &levels)
+    {
+        return int(std::max_element(levels.begin(), levels.end()) - levels.begin());
+    }
+}
+
+TEST(SpectrumTest, SineLandsInItsBand) {
+    const int band = 25;
+    for (int rate : {44100, 48000, 96000}) {
+        SpectrumTransform transform;
+        transform.setSampleRate(rate);
+        const double frequency = std::sqrt(transform.bandLow(band) * transform.bandHigh(band));
+        const std::vector<float> samples = sine(frequency, rate, 0.5f, SpectrumTransform::FftSize);
+
+        std::vector<float> levels(SpectrumTransform::BandCount);
+        transform.analyze(samples.data(), levels.data());
+        EXPECT_EQ(loudestBand(levels), band) << rate;
+        // Half scale is 6 dB down, the bands further out only see the window's sidelobes
+        EXPECT_NEAR(levels[band], -6.02f, 0.5f) << rate;
+        for (int b = 0; b < SpectrumTransform::BandCount; ++b) {
+            if (std::abs(b - band) >= 3) {
+                EXPECT_LT(levels[size_t(b)], -60.0f) << rate << " band " << b;
+            }
+        }
+    }
+}
+
+TEST(SpectrumTest, BandsCoverTheRange) {
+    SpectrumTransform transform;
+    transform.setSampleRate(22050);
+    EXPECT_DOUBLE_EQ(transform.bandLow(0), SpectrumTransform::MinFrequency);
+    // Nyquist is below MaxFrequency here, the top band stops short of it
+    EXPECT_LT(transform.bandHigh(SpectrumTransform::BandCount - 1), 11025.0);
+    for (int b = 1; b < SpectrumTransform::BandCount; ++b) {
+        EXPECT_DOUBLE_EQ(transform.bandLow(b), transform.bandHigh(b - 1));
+        EXPECT_GT(transform.bandHigh(b), transform.bandLow(b));
+    }
+
+    // Silence bottoms out instead of going to -inf
+    const std::vector<float> silence(SpectrumTransform::FftSize, 0.0f);
+    std::vector<float> levels(SpectrumTransform::BandCount, 1.0f);
+    transform.analyze(silence.data(), levels.data());
+    for (float level : levels) {
+        EXPECT_EQ(level, SpectrumTransform::FloorDb);
+    }
+}
+
+TEST(SpectrumTest, SimdLevelsGiveTheSameBands) {
+    std::vector<float> samples = sine(1234.5, 48000, 0.3f, SpectrumTransform::FftSize);
+    const std::vector<float> second = sine(6789.0, 48000, 0.1f, SpectrumTransform::FftSize);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i] += second[i];
+    }
+
+    std::vector<float> scalar(SpectrumTransform::BandCount);
+    const Dsp::SimdLevel best = Dsp::detectedSimdLevel();
+    for (int l = 0; l <= int(best); ++l) {
+        Dsp::setSimdLevel(Dsp::SimdLevel(l));
+        SpectrumTransform transform;
+        transform.setSampleRate(48000);
+        std::vector<float> levels(SpectrumTransform::BandCount);
+        transform.analyze(samples.data(), levels.data());
+        if (l == 0) {
+            scalar = levels;
+            continue;
+        }
+        for (size_t b = 0; b < levels.size(); ++b) {
+            EXPECT_NEAR(levels[b], scalar[b], 0.01f) << Dsp::simdLevelName(Dsp::SimdLevel(l)) << " band " << b;
+        }
+    }
+    Dsp::setSimdLevel(best);
+}
+
+TEST(SpectrumTest, TapMixesDownAndDropsWhenFull) {
+    QAudioFormat format;
+    format.setSampleRate(48000);
+    format.setChannelCount(2);
+    format.setSampleFormat(QAudioFormat::Int16);
+
+    AudioTap tap;
+    tap.setSampleRate(48000);
+    const int frames = 1000;
+    std::vector<int16_t> pcm(size_t(frames) * 2);
+    for (int i = 0; i < frames; ++i) {
+        pcm[size_t(i) * 2] = int16_t(i * 16);
+        pcm[size_t(i) * 2 + 1] = int16_t(-i * 8);
+    }
+    tap.push(format, reinterpret_cast<const char *>(pcm.data()), frames);
+    ASSERT_EQ(tap.available(), size_t(frames));
+    std::vector<float> mono(frames);
+    ASSERT_EQ(tap.read(mono.data(), mono.size()), size_t(frames));
+    for (int i = 0; i < frames; ++i) {
+        EXPECT_FLOAT_EQ(mono[size_t(i)], float(i * 4) / 32768.0f) << i;
+    }
+
+    // Nobody reading: the ring fills up and the rest is counted, not waited for
+    const qint64 pushes = qint64(AudioTap::Capacity) / frames + 5;
+    for (qint64 p = 0; p < pushes; ++p) {
+        tap.push(format, reinterpret_cast<const char *>(pcm.data()), frames);
+    }
+    EXPECT_EQ(tap.available(), AudioTap::Capacity);
+    const TapStats stats = tap.stats();
+    EXPECT_EQ(stats.frames, qint64(frames) * (pushes + 1));
+    EXPECT_EQ(stats.dropped, qint64(frames) * pushes - qint64(AudioTap::Capacity));
+    EXPECT_GE(stats.load, 0.0);
+}
+
+TEST(SpectrumTest, AnalyzerPublishesWhatTheTapCarries) {
+    QAudioFormat format;
+    format.setSampleRate(48000);
+    format.setChannelCount(1);
+    format.setSampleFormat(QAudioFormat::Float);
+
+    AudioTap tap;
+    tap.setSampleRate(48000);
+    SpectrumAnalyzer analyzer(tap);
+    analyzer.setActive(true);
+    EXPECT_TRUE(tap.isEnabled());
+
+    // The probe sits in the middle of a band, the audio thread's side is played by this loop
+    SpectrumTransform transform;
+    transform.setSampleRate(48000);
+    const int band = 30;
+    const std::vector<float> tone = sine(std::sqrt(transform.bandLow(band) * transform.bandHigh(band)),
+                                         48000, 0.8f, 48000);
+    std::vector<float> levels(SpectrumAnalyzer::BandCount, SpectrumTransform::FloorDb);
+    bool published = false;
+    QElapsedTimer timer;
+    timer.start();
+    size_t offset = 0;
+    while (!published && timer.elapsed() < 5000) {
+        tap.push(format, reinterpret_cast<const char *>(tone.data() + offset), 480);
+        offset = (offset + 480) % (tone.size() - 480);
+        QThread::msleep(10);
+        published = analyzer.latest(levels.data()) && levels[size_t(band)] > -10.0f;
+    }
+    analyzer.setActive(false);
+    EXPECT_FALSE(tap.isEnabled());
+    ASSERT_TRUE(published);
+    EXPECT_EQ(loudestBand(levels), band);
+
+    const SpectrumStats stats = analyzer.stats();
+    EXPECT_GT(stats.analyses, 0);
+    EXPECT_GT(stats.averageUs, 0.0);
+    EXPECT_LT(stats.load, SpectrumAnalyzer::MaxLoad * 2.0);
+}
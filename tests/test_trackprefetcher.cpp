@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+#include "../trackprefetcher.h"
+
+/**
+ * Test suite for the read-ahead of upcoming queue entries
+ */
+class TrackPrefetcherTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ASSERT_TRUE(dir.isValid());
+        QObject::connect(&prefetcher, &TrackPrefetcher::fileWarmed, &receiver,
+                         [this](const QString &filePath, qint64 bytes, qint64) {
+            warmed.append(qMakePair(filePath, bytes));
+        });
+    }
+
+    QString makeFile(const QString &name, qint64 size) {
+        QString path = dir.filePath(name);
+        QFile file(path);
+        EXPECT_TRUE(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray(size, 'x'));
+        return path;
+    }
+
+    // Results arrive queued from the prefetch thread
+    bool waitForFiles(int count, int timeoutMs = 5000) {
+        QElapsedTimer timer;
+        timer.start();
+        while (warmed.size() < count && timer.elapsed() < timeoutMs) {
+            QCoreApplication::processEvents();
+            QThread::msleep(5);
+        }
+        return warmed.size() >= count;
+    }
+
+    QTemporaryDir dir;
+    TrackPrefetcher prefetcher;
+    QObject receiver;
+    QList<QPair<QString, qint64>> warmed;
+};
+
+TEST_F(TrackPrefetcherTest, WarmsFilesInOrderWithinBudget) {
+    const qint64 mib = 1024 * 1024;
+    QString first = makeFile("a.flac", 3 * mib);
+    QString second = makeFile("b.flac", 3 * mib);
+    QString third = makeFile("c.flac", 3 * mib);
+
+    prefetcher.setBudget(4 * mib);
+    prefetcher.prefetch({first, second, third});
+    ASSERT_TRUE(waitForFiles(2));
+
+    EXPECT_EQ(warmed[0].first, first);
+    EXPECT_EQ(warmed[0].second, 3 * mib);
+    EXPECT_EQ(warmed[1].first, second);
+    EXPECT_EQ(warmed[1].second, 1 * mib);   // Rest of the budget only
+
+    // Budget used up, the third file is skipped
+    EXPECT_FALSE(waitForFiles(3, 300));
+}
+
+TEST_F(TrackPrefetcherTest, SkipsFilesAlreadyWarmed) {
+    QString first = makeFile("a.flac", 4096);
+    QString second = makeFile("b.flac", 4096);
+
+    prefetcher.prefetch({first});
+    ASSERT_TRUE(waitForFiles(1));
+
+    prefetcher.prefetch({first, second});
+    ASSERT_TRUE(waitForFiles(2));
+    EXPECT_EQ(warmed[1].first, second);
+    EXPECT_FALSE(waitForFiles(3, 300));
+}
+
+TEST_F(TrackPrefetcherTest, ThrottlingHoldsReadsBack) {
+    QString file = makeFile("a.flac", 4096);
+
+    prefetcher.setThrottled(true);
+    prefetcher.prefetch({file});
+    EXPECT_FALSE(waitForFiles(1, 300));
+
+    prefetcher.setThrottled(false);
+    EXPECT_TRUE(waitForFiles(1));
+}
+
+TEST_F(TrackPrefetcherTest, MissingFilesAreIgnored) {
+    QString file = makeFile("a.flac", 4096);
+    prefetcher.prefetch({dir.filePath("missing.flac"), file});
+    ASSERT_TRUE(waitForFiles(1));
+    EXPECT_EQ(warmed[0].first, file);
+}
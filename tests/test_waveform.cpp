@@ -0,0 +1,240 @@
+#include <gtest/gtest.h>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "../waveformoverview.h"
+#include "../waveformbuilder.h"
+
+/**
+ * Test suite for the seek bar waveform: the min/max pyramid, its serialization and the
+ * on-disk cache keyed by the track's identity
+ */
+namespace {
+    using Planes = std::vector<std::vector<float>>;
+
+    // A slow swell on the left, noise at a different level on the right
+    Planes testSignal(int frames)
+    {
+        Planes planes(2, std::vector<float>(size_t(frames)));
+        uint32_t noise = 777;
+        for (int i = 0; i < frames; ++i) {
+            noise = noise * 1664525u + 1013904223u;
+            planes[0][size_t(i)] = float(0.9 * std::sin(i * 0.001) * std::sin(i * 0.05));
+            planes[1][size_t(i)] = (float(noise >> 8) / float(1 << 24) - 0.5f) * float(i % 50000) / 50000.0f;
+        }
+        return planes;
+    }
+
+    WaveformOverview build(const Planes &planes, int sampleRate, int blockSize)
+    {
+        const int frames = int(planes[0].size());
+        WaveformOverview overview(sampleRate, frames);
+        for (int offset = 0; offset < frames; offset += blockSize) {
+            const float *pointers[] = {planes[0].data() + offset, planes[1].data() + offset};
+            overview.add(pointers, 2, std::min(blockSize, frames - offset));
+        }
+        overview.finish();
+        return overview;
+    }
+
+    // 16-bit stereo PCM WAV
+    QByteArray wav(int sampleRate, const Planes &planes)
+    {
+        auto le = [](QByteArray &out, quint32 value, int bytes) {
+            for (int i = 0; i < bytes; ++i) {
+                out.append(char((value >> (8 * i)) & 0xFF));
+            }
+        };
+        QByteArray pcm;
+        for (size_t i = 0; i < planes[0].size(); ++i) {
+            for (const std::vector<float> &plane : planes) {
+                le(pcm, quint32(quint16(qint16(plane[i] * 32767.0f))), 2);
+            }
+        }
+        QByteArray out("RIFF");
+        le(out, 36 + quint32(pcm.size()), 4);
+        out.append("WAVEfmt ");
+        le(out, 16, 4);
+        le(out, 1, 2);
+        le(out, 2, 2);
+        le(out, quint32(sampleRate), 4);
+        le(out, quint32(sampleRate) * 4, 4);
+        le(out, 4, 2);
+        le(out, 16, 2);
+        out.append("data");
+        le(out, quint32(pcm.size()), 4);
+        out.append(pcm);
+        return out;
+    }
+}
+
+TEST(WaveformTest, PyramidHoldsTheBucketPeaks) {
+    const Planes planes = testSignal(300000);
+    const WaveformOverview overview = build(planes, 44100, 777);
+    ASSERT_FALSE(overview.isEmpty());
+    EXPECT_EQ(overview.totalSamples(), 300000);
+
+    // Level 0 against the samples themselves
+    const WaveformOverview::Level &base = overview.level(0);
+    EXPECT_LE(base.min.size(), size_t(WaveformOverview::MaxBuckets));
+    const qint64 bucket = base.samplesPerBucket;
+    ASSERT_EQ(qint64(base.min.size()), (300000 + bucket - 1) / bucket);
+    for (size_t b = 0; b < base.min.size(); ++b) {
+        float low = 1.0f;
+        float high = -1.0f;
+        for (qint64 i = qint64(b) * bucket; i < std::min<qint64>(300000, qint64(b + 1) * bucket); ++i) {
+            for (const std::vector<float> &plane : planes) {
+                low = std::min(low, plane[size_t(i)]);
+                high = std::max(high, plane[size_t(i)]);
+            }
+        }
+        ASSERT_EQ(base.min[b], qint8(std::floor(low * 127.0f))) << b;
+        ASSERT_EQ(base.max[b], qint8(std::ceil(high * 127.0f))) << b;
+    }
+
+    // Every level above halves the one below, the top one is small
+    for (int l = 1; l < overview.levelCount(); ++l) {
+        const WaveformOverview::Level &below = overview.level(l - 1);
+        const WaveformOverview::Level &level = overview.level(l);
+        ASSERT_EQ(level.samplesPerBucket, below.samplesPerBucket * 2);
+        ASSERT_EQ(level.min.size(), (below.min.size() + 1) / 2);
+        for (size_t b = 0; b < level.min.size(); ++b) {
+            const size_t second = std::min(2 * b + 1, below.min.size() - 1);
+            EXPECT_EQ(level.min[b], std::min(below.min[2 * b], below.min[second]));
+            EXPECT_EQ(level.max[b], std::max(below.max[2 * b], below.max[second]));
+        }
+    }
+    EXPECT_GT(overview.levelCount(), 1);
+    EXPECT_LE(overview.level(overview.levelCount() - 1).min.size(), size_t(WaveformOverview::MinBuckets));
+}
+
+TEST(WaveformTest, PeaksCoverTheirColumns) {
+    const Planes planes = testSignal(300000);
+    const WaveformOverview overview = build(planes, 44100, 4096);
+
+    // A cue track in the middle of the file at seek bar width, then the whole file
+    for (const auto &range : {std::make_pair(qint64(123456), qint64(201000)), std::make_pair(qint64(0), qint64(300000))}) {
+        const int columns = 800;
+        std::vector<qint8> mins(columns), maxs(columns);
+        overview.peaks(range.first, range.second, columns, mins.data(), maxs.data());
+        const qint64 span = range.second - range.first;
+        for (int c = 0; c < columns; ++c) {
+            const qint64 from = range.first + span * c / columns;
+            const qint64 to = range.first + span * (c + 1) / columns;
+            float low = 1.0f;
+            float high = -1.0f;
+            for (qint64 i = from; i < to; ++i) {
+                for (const std::vector<float> &plane : planes) {
+                    low = std::min(low, plane[size_t(i)]);
+                    high = std::max(high, plane[size_t(i)]);
+                }
+            }
+            // Whole buckets are merged, so a column may reach a little past its samples
+            ASSERT_LE(mins[size_t(c)], qint8(std::floor(low * 127.0f))) << c;
+            ASSERT_GE(maxs[size_t(c)], qint8(std::ceil(high * 127.0f))) << c;
+            ASSERT_LE(mins[size_t(c)], maxs[size_t(c)]);
+        }
+    }
+
+    // Past the end of the audio there is nothing
+    std::vector<qint8> mins(10, 5), maxs(10, 5);
+    overview.peaks(400000, 500000, 10, mins.data(), maxs.data());
+    EXPECT_EQ(mins, std::vector<qint8>(10, 0));
+    EXPECT_EQ(maxs, std::vector<qint8>(10, 0));
+}
+
+TEST(WaveformTest, SerializationRoundTrip) {
+    const WaveformOverview overview = build(testSignal(100000), 48000, 1000);
+    const QByteArray data = overview.serialize();
+
+    WaveformOverview restored;
+    ASSERT_TRUE(WaveformOverview::deserialize(data, &restored));
+    EXPECT_EQ(restored.sampleRate(), 48000);
+    EXPECT_EQ(restored.totalSamples(), 100000);
+    ASSERT_EQ(restored.levelCount(), overview.levelCount());
+    for (int l = 0; l < overview.levelCount(); ++l) {
+        EXPECT_EQ(restored.level(l).samplesPerBucket, overview.level(l).samplesPerBucket);
+        EXPECT_EQ(restored.level(l).min, overview.level(l).min);
+        EXPECT_EQ(restored.level(l).max, overview.level(l).max);
+    }
+
+    // Cut short or scribbled over is turned down, not half read
+    EXPECT_FALSE(WaveformOverview::deserialize(data.left(data.size() - 3), &restored));
+    EXPECT_FALSE(WaveformOverview::deserialize(QByteArray(64, 'x'), &restored));
+    EXPECT_FALSE(WaveformOverview::deserialize(QByteArray(), &restored));
+}
+
+TEST(WaveformTest, CacheFollowsTheTrack) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    WaveformBuilder::setCacheDirectory(dir.filePath("cache"));
+
+    const QString path = dir.filePath("tone.wav");
+    auto writeTrack = [&](int frames) {
+        QFile file(path);
+        ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+        file.write(wav(44100, testSignal(frames)));
+    };
+    writeTrack(88200);
+
+    bool fromCache = true;
+    std::shared_ptr<const WaveformOverview> first = WaveformBuilder::load(path, nullptr, &fromCache);
+    ASSERT_NE(first, nullptr);
+    EXPECT_FALSE(fromCache);
+    EXPECT_EQ(first->totalSamples(), 88200);
+    EXPECT_TRUE(QFile::exists(WaveformBuilder::cacheFile(path)));
+
+    std::shared_ptr<const WaveformOverview> second = WaveformBuilder::load(path, nullptr, &fromCache);
+    ASSERT_NE(second, nullptr);
+    EXPECT_TRUE(fromCache);
+    EXPECT_EQ(second->serialize(), first->serialize());
+
+    // A different file under the same name is decoded again
+    writeTrack(44100);
+    std::shared_ptr<const WaveformOverview> third = WaveformBuilder::load(path, nullptr, &fromCache);
+    ASSERT_NE(third, nullptr);
+    EXPECT_FALSE(fromCache);
+    EXPECT_EQ(third->totalSamples(), 44100);
+
+    // Nothing to decode, nothing cached
+    EXPECT_EQ(WaveformBuilder::load(dir.filePath("missing.wav")), nullptr);
+    WaveformBuilder::setCacheDirectory(QString());
+}
+
+TEST(WaveformTest, CacheKeepsTheRecentlyUsed) {
+    QTemporaryDir dir;
+    ASSERT_TRUE(dir.isValid());
+    WaveformBuilder::setCacheDirectory(dir.filePath("cache"));
+    const WaveformOverview overview = build(testSignal(4096), 44100, 1024);
+
+    // One more track than there is room for, each cached a minute after the one before
+    const int keep = WaveformBuilder::MaxCachedOverviews;
+    const QDateTime start = QDateTime::currentDateTime().addDays(-1);
+    QStringList tracks;
+    for (int i = 0; i <= keep; ++i) {
+        tracks.append(dir.filePath(QString("track%1.wav").arg(i)));
+        QFile track(tracks.last());
+        ASSERT_TRUE(track.open(QIODevice::WriteOnly));
+        track.write("x");
+    }
+    for (int i = 0; i < keep; ++i) {
+        ASSERT_TRUE(WaveformBuilder::writeCache(tracks[i], overview));
+        QFile cache(WaveformBuilder::cacheFile(tracks[i]));
+        ASSERT_TRUE(cache.open(QIODevice::ReadWrite));
+        cache.setFileTime(start.addSecs(60 * i), QFileDevice::FileModificationTime);
+    }
+
+    // Reading the oldest makes it the newest, the second oldest goes once the next one is cached
+    ASSERT_NE(WaveformBuilder::readCache(tracks[0]), nullptr);
+    ASSERT_TRUE(WaveformBuilder::writeCache(tracks[keep], overview));
+    EXPECT_EQ(QDir(dir.filePath("cache")).entryList({"*.wave"}, QDir::Files).size(), keep);
+    EXPECT_TRUE(QFile::exists(WaveformBuilder::cacheFile(tracks[0])));
+    EXPECT_FALSE(QFile::exists(WaveformBuilder::cacheFile(tracks[1])));
+    EXPECT_TRUE(QFile::exists(WaveformBuilder::cacheFile(tracks[2])));
+    EXPECT_TRUE(QFile::exists(WaveformBuilder::cacheFile(tracks[keep])));
+    WaveformBuilder::setCacheDirectory(QString());
+}
@@ -0,0 +1,160 @@
+#include "trackprefetcher.h"
+#include "logging.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QThread>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr qint64 ChunkSize = 1024 * 1024;
+
+    // Idle I/O class: the prefetch reads only get the disk when nobody else wants it
+    void lowerIoPriority()
+    {
+#if defined(Q_OS_LINUX) && defined(SYS_ioprio_set)
+        const int ioprioWhoProcess = 1;     // with id 0 this is the calling thread
+        const int ioprioClassIdle = 3;
+        syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << 13);
+#endif
+    }
+}
+
+TrackPrefetcher::TrackPrefetcher(QObject *parent)
+    : QObject(parent)
+{
+    m_thread = QThread::create([this]() { run(); });
+    m_thread->start(QThread::LowestPriority);
+}
+
+TrackPrefetcher::~TrackPrefetcher()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_stop = true;
+        m_wake.wakeAll();
+    }
+    m_thread->wait();
+    delete m_thread;
+}
+
+void TrackPrefetcher::setBudget(qint64 bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_budget = qMax<qint64>(bytes, 0);
+}
+
+void TrackPrefetcher::prefetch(const QStringList &files)
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    for (const QString &file : files) {
+        if (!m_warmed.contains(file) && !m_queue.contains(file)) {
+            m_queue.append(file);
+        }
+    }
+    // Forget files that dropped out of the lookahead, they may be evicted by the time they come up
+    for (qsizetype i = m_warmed.size() - 1; i >= 0; --i) {
+        if (!files.contains(m_warmed[i])) {
+            m_warmed.removeAt(i);
+        }
+    }
+    m_used = 0;
+    ++m_generation;
+    m_wake.wakeAll();
+}
+
+void TrackPrefetcher::cancel()
+{
+    QMutexLocker locker(&m_mutex);
+    m_queue.clear();
+    ++m_generation;
+}
+
+void TrackPrefetcher::setThrottled(bool throttled)
+{
+    m_throttled = throttled;
+}
+
+void TrackPrefetcher::run()
+{
+    lowerIoPriority();
+
+    while (true) {
+        QString file;
+        qint64 allowance = 0;
+        unsigned generation = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_stop && m_queue.isEmpty()) {
+                m_wake.wait(&m_mutex);
+            }
+            if (m_stop) {
+                return;
+            }
+            file = m_queue.takeFirst();
+            allowance = m_budget - m_used;
+            generation = m_generation;
+        }
+        if (allowance <= 0) {
+            continue;
+        }
+
+        qint64 warmed = warmFile(file, allowance, generation);
+
+        QMutexLocker locker(&m_mutex);
+        if (generation == m_generation) {
+            m_used += warmed;
+            if (warmed > 0) {
+                m_warmed.append(file);
+            }
+        }
+    }
+}
+
+bool TrackPrefetcher::interrupted(unsigned generation) const
+{
+    return m_stop.load(std::memory_order_relaxed) || m_generation.load(std::memory_order_relaxed) != generation;
+}
+
+qint64 TrackPrefetcher::warmFile(const QString &filePath, qint64 allowance, unsigned generation)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const qint64 length = qMin(file.size(), allowance);
+
+#ifdef Q_OS_LINUX
+    // Lets the kernel queue the whole range as large requests straight away
+    posix_fadvise(file.handle(), 0, length, POSIX_FADV_WILLNEED);
+#endif
+
+    // Read through as well, NFS and FUSE mounts may ignore the advice. Reads that already
+    // hit the cache cost a memcpy
+    QByteArray chunk(ChunkSize, Qt::Uninitialized);
+    qint64 done = 0;
+    while (done < length && !interrupted(generation)) {
+        while (m_throttled.load(std::memory_order_relaxed) && !interrupted(generation)) {
+            QThread::msleep(100);
+        }
+        qint64 got = file.read(chunk.data(), qMin(ChunkSize, length - done));
+        if (got <= 0) {
+            break;
+        }
+        done += got;
+    }
+
+    const qint64 elapsedMs = timer.elapsed();
+    qCDebug(lcPlayback) << "Prefetched" << done << "bytes of" << filePath << "in" << elapsedMs << "ms";
+    PerfLog::record("prefetch", "warm_file", elapsedMs * 1000, done, filePath);
+    emit fileWarmed(filePath, done, elapsedMs);
+    return done;
+}
@@ -0,0 +1,56 @@
+#ifndef TRACKPREFETCHER_H
+#define TRACKPREFETCHER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+
+class QThread;
+
+//warms the page cache for the next queue entries so a track change doesn't pay a cold open
+//on slow disks and network mounts. files are advised (WILLNEED) and then read through in
+//chunks on a background thread at idle I/O priority, up to a byte budget per round
+class TrackPrefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TrackPrefetcher(QObject *parent = nullptr);
+    ~TrackPrefetcher();
+
+    //bytes read ahead per prefetch() round, files over the rest of the budget are warmed partially
+    void setBudget(qint64 bytes);
+    qint64 budget() const { return m_budget; }
+
+    //replaces whatever is still queued, files are warmed in the given order. files warmed by
+    //the previous round and still upcoming are not read again
+    void prefetch(const QStringList &files);
+    void cancel();
+
+    //while set (conversion, verification scan) reads pause between chunks
+    void setThrottled(bool throttled);
+    bool isThrottled() const { return m_throttled; }
+
+signals:
+    void fileWarmed(const QString &filePath, qint64 bytes, qint64 elapsedMs);
+
+private:
+    void run();
+    qint64 warmFile(const QString &filePath, qint64 allowance, unsigned generation);
+    bool interrupted(unsigned generation) const;
+
+    QThread *m_thread = nullptr;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    QStringList m_queue;                // guarded by m_mutex
+    QStringList m_warmed;               // guarded by m_mutex
+    qint64 m_budget = 512LL * 1024 * 1024;
+    qint64 m_used = 0;                  // guarded by m_mutex
+    std::atomic<unsigned> m_generation{0};
+    std::atomic<bool> m_throttled{false};
+    std::atomic<bool> m_stop{false};
+};
+
+#endif // TRACKPREFETCHER_H
@@ -0,0 +1,202 @@
+#include "verifydialog.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFormLayout>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QThread>
+
+// VerifyDialog implementation
+
+VerifyDialog::VerifyDialog(const QStringList &initialFiles, QWidget *parent)
+    : QDialog(parent)
+    , m_paths(initialFiles)
+    , m_verifier(new FlacVerifier(this))
+    , m_okCount(0)
+    , m_unsignedCount(0)
+{
+    setupUI();
+    setWindowTitle("Verify Audio Integrity");
+    resize(640, 420);
+
+    connect(m_verifier, &FlacVerifier::fileVerified, this, &VerifyDialog::onFileVerified);
+    connect(m_verifier, &FlacVerifier::progressUpdated, this, &VerifyDialog::onProgressUpdated);
+    connect(m_verifier, &FlacVerifier::finished, this, &VerifyDialog::onVerificationFinished);
+}
+
+VerifyDialog::~VerifyDialog()
+{
+    // FlacVerifier's destructor cancels and waits for the pool
+}
+
+void VerifyDialog::setupUI()
+{
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+
+    // Source selection
+    QHBoxLayout *sourceLayout = new QHBoxLayout();
+    m_queuedLabel = new QLabel();
+    m_addFolderButton = new QPushButton("Add Folder...");
+    m_addFilesButton = new QPushButton("Add Files...");
+    sourceLayout->addWidget(m_queuedLabel);
+    sourceLayout->addStretch();
+    sourceLayout->addWidget(m_addFolderButton);
+    sourceLayout->addWidget(m_addFilesButton);
+    mainLayout->addLayout(sourceLayout);
+
+    // Parallelism, one decoder per thread
+    QFormLayout *formLayout = new QFormLayout();
+    m_threadsSpin = new QSpinBox();
+    m_threadsSpin->setRange(1, 64);
+    m_threadsSpin->setValue(QThread::idealThreadCount());
+    formLayout->addRow("Parallel files:", m_threadsSpin);
+    mainLayout->addLayout(formLayout);
+
+    // Only problems and unsigned files are listed, clean files are just counted
+    m_resultList = new QListWidget();
+    mainLayout->addWidget(m_resultList);
+
+    m_progressBar = new QProgressBar();
+    m_progressBar->setRange(0, 100);
+    m_progressBar->setValue(0);
+    mainLayout->addWidget(m_progressBar);
+
+    m_statusLabel = new QLabel("Ready to verify");
+    m_statusLabel->setAlignment(Qt::AlignCenter);
+    mainLayout->addWidget(m_statusLabel);
+
+    // Buttons
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    buttonLayout->addStretch();
+
+    m_verifyButton = new QPushButton("Verify");
+    m_verifyButton->setDefault(true);
+    m_verifyButton->setMinimumWidth(100);
+
+    m_cancelButton = new QPushButton("Close");
+    m_cancelButton->setMinimumWidth(100);
+
+    buttonLayout->addWidget(m_verifyButton);
+    buttonLayout->addWidget(m_cancelButton);
+    mainLayout->addLayout(buttonLayout);
+
+    connect(m_addFolderButton, &QPushButton::clicked, this, &VerifyDialog::onAddFolderClicked);
+    connect(m_addFilesButton, &QPushButton::clicked, this, &VerifyDialog::onAddFilesClicked);
+    connect(m_verifyButton, &QPushButton::clicked, this, &VerifyDialog::onVerifyClicked);
+    connect(m_cancelButton, &QPushButton::clicked, this, &VerifyDialog::onCancelClicked);
+
+    updateQueuedLabel();
+}
+
+void VerifyDialog::updateQueuedLabel()
+{
+    m_queuedLabel->setText(QString("%1 file(s)/folder(s) selected").arg(m_paths.size()));
+    m_verifyButton->setEnabled(!m_paths.isEmpty());
+}
+
+void VerifyDialog::onAddFolderClicked()
+{
+    QString dir = QFileDialog::getExistingDirectory(this, "Select Folder to Verify");
+    if (!dir.isEmpty()) {
+        m_paths.append(dir);
+        updateQueuedLabel();
+    }
+}
+
+void VerifyDialog::onAddFilesClicked()
+{
+    QStringList files = QFileDialog::getOpenFileNames(this, "Select FLAC Files", "",
+                                                      "FLAC Files (*.flac);;All Files (*)");
+    if (!files.isEmpty()) {
+        m_paths.append(files);
+        updateQueuedLabel();
+    }
+}
+
+void VerifyDialog::onVerifyClicked()
+{
+    if (m_verifier->isRunning()) {
+        return;
+    }
+
+    QStringList files = FlacVerifier::collectFlacFiles(m_paths);
+    files.removeDuplicates();
+    if (files.isEmpty()) {
+        m_statusLabel->setText("No FLAC files found");
+        return;
+    }
+
+    m_resultList->clear();
+    m_okCount = 0;
+    m_unsignedCount = 0;
+    m_progressBar->setRange(0, files.size());
+    m_progressBar->setValue(0);
+    m_statusLabel->setText(QString("Verifying %1 file(s)...").arg(files.size()));
+    m_verifyButton->setEnabled(false);
+    m_addFolderButton->setEnabled(false);
+    m_addFilesButton->setEnabled(false);
+    m_threadsSpin->setEnabled(false);
+    m_cancelButton->setText("Cancel");
+
+    m_verifier->start(files, m_threadsSpin->value());
+}
+
+void VerifyDialog::onCancelClicked()
+{
+    if (m_verifier->isRunning()) {
+        m_statusLabel->setText("Cancelling...");
+        m_cancelButton->setEnabled(false);
+        m_verifier->cancel();
+    } else {
+        reject();
+    }
+}
+
+void VerifyDialog::onFileVerified(const VerifyResult &result)
+{
+    if (result.status == VerifyResult::Ok) {
+        ++m_okCount;
+        return;
+    }
+    if (result.status == VerifyResult::Cancelled) {
+        return;
+    }
+    if (result.status == VerifyResult::NoSignature) {
+        ++m_unsignedCount;
+    }
+
+    QListWidgetItem *item = new QListWidgetItem(
+        QString("[%1] %2 - %3")
+        .arg(VerifyResult::statusName(result.status))
+        .arg(QFileInfo(result.filePath).fileName())
+        .arg(result.message));
+    item->setToolTip(result.filePath);
+    if (result.isProblem()) {
+        item->setForeground(QColor(220, 60, 60));
+    }
+    m_resultList->addItem(item);
+}
+
+void VerifyDialog::onProgressUpdated(int done, int total)
+{
+    m_progressBar->setValue(done);
+    m_statusLabel->setText(QString("Verified %1 of %2...").arg(done).arg(total));
+}
+
+void VerifyDialog::onVerificationFinished(int problems, qint64 totalBytes, qint64 elapsedMs)
+{
+    m_verifyButton->setEnabled(true);
+    m_addFolderButton->setEnabled(true);
+    m_addFilesButton->setEnabled(true);
+    m_threadsSpin->setEnabled(true);
+    m_cancelButton->setText("Close");
+    m_cancelButton->setEnabled(true);
+
+    double seconds = qMax<qint64>(elapsedMs, 1) / 1000.0;
+    double megabytesPerSecond = (totalBytes / (1024.0 * 1024.0)) / seconds;
+    m_statusLabel->setText(QString("%1 OK, %2 without MD5, %3 problem(s) - %4 MB/s")
+        .arg(m_okCount)
+        .arg(m_unsignedCount)
+        .arg(problems)
+        .arg(megabytesPerSecond, 0, 'f', 1));
+}
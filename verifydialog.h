@@ -0,0 +1,51 @@
+#ifndef VERIFYDIALOG_H
+#define VERIFYDIALOG_H
+
+#include <QDialog>
+#include <QListWidget>
+#include <QPushButton>
+#include <QProgressBar>
+#include <QLabel>
+#include <QSpinBox>
+#include "flacverifier.h"
+
+//audits FLAC files against their STREAMINFO MD5, lists only the files that need attention
+class VerifyDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit VerifyDialog(const QStringList &initialFiles, QWidget *parent = nullptr);
+    ~VerifyDialog();
+
+private slots:
+    void onAddFolderClicked();
+    void onAddFilesClicked();
+    void onVerifyClicked();
+    void onCancelClicked();
+    void onFileVerified(const VerifyResult &result);
+    void onProgressUpdated(int done, int total);
+    void onVerificationFinished(int problems, qint64 totalBytes, qint64 elapsedMs);
+
+private:
+    void setupUI();
+    void updateQueuedLabel();
+
+    QStringList m_paths;
+
+    QLabel *m_queuedLabel;
+    QPushButton *m_addFolderButton;
+    QPushButton *m_addFilesButton;
+    QSpinBox *m_threadsSpin;
+    QListWidget *m_resultList;
+    QProgressBar *m_progressBar;
+    QLabel *m_statusLabel;
+    QPushButton *m_verifyButton;
+    QPushButton *m_cancelButton;
+
+    FlacVerifier *m_verifier;
+    int m_okCount;
+    int m_unsignedCount;
+};
+
+#endif // VERIFYDIALOG_H
@@ -0,0 +1,260 @@
+#include "waveformbuilder.h"
+#include "audiodecoder.h"
+#include "parallelflacdecoder.h"
+#include "dspkernels.h"
+#include "logging.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThread>
+#include <vector>
+
+namespace {
+    constexpr quint32 CacheMagic = 0x46505743;     // "FPWC"
+
+    QMutex s_cacheDirectoryMutex;
+    QString s_cacheDirectory;
+
+    bool isCancelled(const std::atomic<bool> *cancelled)
+    {
+        return cancelled && cancelled->load(std::memory_order_relaxed);
+    }
+
+    // Oldest modification time first out, readCache() renews it on every hit
+    void pruneCache()
+    {
+        const QFileInfoList files = QDir(WaveformBuilder::cacheDirectory())
+                                        .entryInfoList({"*.wave"}, QDir::Files, QDir::Time);
+        for (int i = WaveformBuilder::MaxCachedOverviews; i < files.size(); ++i) {
+            QFile::remove(files[i].absoluteFilePath());
+        }
+    }
+}
+
+WaveformBuilder::WaveformBuilder(QObject *parent)
+    : QObject(parent)
+{
+    // One track at a time, an abandoned request gives up between blocks
+    m_pool.setMaxThreadCount(1);
+}
+
+WaveformBuilder::~WaveformBuilder()
+{
+    cancel();
+    m_pool.waitForDone();
+}
+
+void WaveformBuilder::setCacheDirectory(const QString &path)
+{
+    QMutexLocker locker(&s_cacheDirectoryMutex);
+    s_cacheDirectory = path;
+}
+
+QString WaveformBuilder::cacheDirectory()
+{
+    QMutexLocker locker(&s_cacheDirectoryMutex);
+    if (!s_cacheDirectory.isEmpty()) {
+        return s_cacheDirectory;
+    }
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/waveforms";
+}
+
+QString WaveformBuilder::cacheFile(const QString &filePath)
+{
+    const QByteArray key = QCryptographicHash::hash(QFileInfo(filePath).absoluteFilePath().toUtf8(),
+                                                    QCryptographicHash::Sha1);
+    return cacheDirectory() + "/" + QString::fromLatin1(key.toHex()) + ".wave";
+}
+
+std::shared_ptr<const WaveformOverview> WaveformBuilder::load(const QString &filePath,
+                                                              const std::atomic<bool> *cancelled, bool *fromCache)
+{
+    std::shared_ptr<const WaveformOverview> overview = readCache(filePath);
+    if (fromCache) {
+        *fromCache = overview != nullptr;
+    }
+    if (overview) {
+        return overview;
+    }
+    overview = compute(filePath, cancelled);
+    if (overview && !writeCache(filePath, *overview)) {
+        qCDebug(lcPlayback) << "Waveform not cached:" << cacheFile(filePath);
+    }
+    return overview;
+}
+
+// The track's path, size and modification time go in front of the overview, a cache file
+// whose track has changed since is ignored (and overwritten by the next writeCache)
+std::shared_ptr<const WaveformOverview> WaveformBuilder::readCache(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    QFile file(cacheFile(filePath));
+    if (!info.exists() || !file.open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    QDataStream in(&file);
+    quint32 magic = 0;
+    QString path;
+    qint64 size = 0;
+    qint64 modified = 0;
+    QByteArray data;
+    in >> magic >> path >> size >> modified >> data;
+    if (in.status() != QDataStream::Ok || magic != CacheMagic || path != info.absoluteFilePath()
+        || size != info.size() || modified != info.lastModified().toMSecsSinceEpoch()) {
+        return nullptr;
+    }
+    auto overview = std::make_shared<WaveformOverview>();
+    if (!WaveformOverview::deserialize(data, overview.get()) || overview->isEmpty()) {
+        return nullptr;
+    }
+    file.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    return overview;
+}
+
+bool WaveformBuilder::writeCache(const QString &filePath, const WaveformOverview &overview)
+{
+    const QFileInfo info(filePath);
+    if (!QDir().mkpath(cacheDirectory())) {
+        return false;
+    }
+    // Written aside and renamed, a reader never sees half an overview
+    QSaveFile file(cacheFile(filePath));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out << CacheMagic << info.absoluteFilePath() << info.size() << info.lastModified().toMSecsSinceEpoch()
+        << overview.serialize();
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        return false;
+    }
+    pruneCache();
+    return true;
+}
+
+std::shared_ptr<const WaveformOverview> WaveformBuilder::compute(const QString &filePath,
+                                                                 const std::atomic<bool> *cancelled)
+{
+    // Playback is running at the same time, the native decoder gets a couple of cores at most
+    if (filePath.endsWith(".flac", Qt::CaseInsensitive)) {
+        ParallelFlacDecoder flac;
+        if (flac.open(filePath, qBound(1, QThread::idealThreadCount() / 2, 2))) {
+            const int channels = flac.channels();
+            const int block = flac.maxBlockSize();
+            auto overview = std::make_shared<WaveformOverview>(flac.sampleRate(), flac.totalSamples());
+            std::vector<std::vector<float>> floatPlanes(size_t(channels), std::vector<float>(size_t(block)));
+            std::vector<float *> planes;
+            for (std::vector<float> &plane : floatPlanes) {
+                planes.push_back(plane.data());
+            }
+            const float gain = float(1u << (32 - flac.bitsPerSample()));
+            auto addAudio = [&](int begin, int end) {
+                for (int offset = begin; offset < end; offset += block) {
+                    const int count = qMin(block, end - offset);
+                    for (int ch = 0; ch < channels; ++ch) {
+                        Dsp::int32ToFloat(flac.planes()[ch] + offset, planes[size_t(ch)], size_t(count), gain);
+                    }
+                    overview->add(planes.data(), channels, count);
+                }
+            };
+            // Damaged frames are dropped by the decoder, the audio after them is drawn where it
+            // plays rather than moved up. a gap can't run past STREAMINFO's length
+            const std::vector<float> zeros(size_t(block));
+            const std::vector<const float *> silence(size_t(channels), zeros.data());
+            qint64 position = 0;
+            auto addSilence = [&](qint64 frames) {
+                if (flac.totalSamples() > 0) {
+                    frames = qMin(frames, flac.totalSamples() - position);
+                }
+                for (qint64 left = frames; left > 0; left -= block) {
+                    overview->add(silence.data(), channels, int(qMin<qint64>(block, left)));
+                }
+            };
+            int frames;
+            while ((frames = flac.next()) > 0) {
+                if (isCancelled(cancelled)) {
+                    return nullptr;
+                }
+                addSilence(flac.chunkFirstSample() - position);
+                position = flac.chunkFirstSample();
+                int at = 0;
+                for (const ParallelFlacDecoder::Gap &gap : flac.chunkGaps()) {
+                    addAudio(at, gap.at);
+                    position += gap.at - at;
+                    addSilence(gap.frames);
+                    position += gap.frames;
+                    at = gap.at;
+                }
+                addAudio(at, frames);
+                position += frames - at;
+            }
+            if (frames < 0) {
+                return nullptr;
+            }
+            overview->finish();
+            return overview->isEmpty() ? nullptr : overview;
+        }
+    }
+
+    AudioDecoder decoder;
+    PlanarFloatConverter converter;
+    if (!decoder.open(filePath) || !converter.init(decoder)) {
+        return nullptr;
+    }
+    auto overview = std::make_shared<WaveformOverview>(decoder.sampleRate(), decoder.totalSamples());
+    std::vector<float *> planes;
+    while (AVFrame *frame = decoder.decodeNextFrame()) {
+        if (isCancelled(cancelled)) {
+            return nullptr;
+        }
+        const int converted = converter.convert(frame, planes);
+        if (converted < 0) {
+            return nullptr;
+        }
+        overview->add(planes.data(), decoder.channels(), converted);
+    }
+    if (decoder.hadReadError()) {
+        return nullptr;
+    }
+    overview->finish();
+    return overview->isEmpty() ? nullptr : overview;
+}
+
+void WaveformBuilder::request(const QString &filePath)
+{
+    cancel();
+    m_cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::shared_ptr<std::atomic<bool>> cancelled = m_cancelled;
+    m_pool.start([this, filePath, cancelled]() {
+        if (cancelled->load()) {
+            return;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        bool fromCache = false;
+        std::shared_ptr<const WaveformOverview> overview = load(filePath, cancelled.get(), &fromCache);
+        PerfLog::record("waveform", fromCache ? "load_cached" : "compute", timer.nsecsElapsed() / 1000,
+                        QFileInfo(filePath).size(), filePath);
+        if (!overview) {
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, filePath, overview, cancelled]() {
+            if (!cancelled->load()) {
+                emit overviewReady(filePath, overview);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void WaveformBuilder::cancel()
+{
+    if (m_cancelled) {
+        m_cancelled->store(true);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef WAVEFORMBUILDER_H
+#define WAVEFORMBUILDER_H
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include "waveformoverview.h"
+
+//computes waveform overviews in the background and keeps them on disk, one file per track in the
+//cache directory. a cached overview is used as long as the track's size and modification time
+//match, so the seek bar of a long recording fills in at once from the second play on. the
+//directory holds the MaxCachedOverviews most recently used tracks. only the latest request is
+//worked on, results are delivered on the thread that owns the builder
+class WaveformBuilder : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int MaxCachedOverviews = 48;
+
+    explicit WaveformBuilder(QObject *parent = nullptr);
+    ~WaveformBuilder();
+
+    //<cache location>/waveforms unless set, e.g. by the tests
+    static void setCacheDirectory(const QString &path);
+    static QString cacheDirectory();
+    static QString cacheFile(const QString &filePath);
+
+    //synchronous, safe to call from any thread: the cached overview when it is still current,
+    //otherwise decoded and written to the cache. nullptr when the file can't be decoded or
+    //cancelled gets set
+    static std::shared_ptr<const WaveformOverview> load(const QString &filePath,
+                                                        const std::atomic<bool> *cancelled = nullptr,
+                                                        bool *fromCache = nullptr);
+    //a hit counts as a use of the cache file
+    static std::shared_ptr<const WaveformOverview> readCache(const QString &filePath);
+    //drops the least recently used files beyond MaxCachedOverviews
+    static bool writeCache(const QString &filePath, const WaveformOverview &overview);
+    //FLAC through the native decoder on a couple of cores, anything else through FFmpeg
+    static std::shared_ptr<const WaveformOverview> compute(const QString &filePath,
+                                                           const std::atomic<bool> *cancelled = nullptr);
+
+    //replaces the previous request, which is abandoned if it's still running
+    void request(const QString &filePath);
+    void cancel();
+
+signals:
+    void overviewReady(const QString &filePath, std::shared_ptr<const WaveformOverview> overview);
+
+private:
+    QThreadPool m_pool;
+    std::shared_ptr<std::atomic<bool>> m_cancelled;
+};
+
+#endif // WAVEFORMBUILDER_H
@@ -0,0 +1,185 @@
+#include "waveformoverview.h"
+#include <QDataStream>
+#include <QIODevice>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr quint32 Magic = 0x46505746;       // "FPWF"
+    constexpr quint32 Version = 1;
+    constexpr int MaxLevels = 40;
+
+    // Rounded outwards so quiet passages still show as a line
+    qint8 quantizeMin(float value)
+    {
+        return qint8(std::clamp(std::floor(value * 127.0f), -127.0f, 127.0f));
+    }
+
+    qint8 quantizeMax(float value)
+    {
+        return qint8(std::clamp(std::ceil(value * 127.0f), -127.0f, 127.0f));
+    }
+}
+
+WaveformOverview::WaveformOverview(int sampleRate, qint64 totalSamples)
+    : m_sampleRate(sampleRate)
+{
+    Level base;
+    base.samplesPerBucket = totalSamples > 0 ? std::max<qint64>(1, (totalSamples + MaxBuckets - 1) / MaxBuckets)
+                                             : std::max(1, sampleRate / 100);
+    if (totalSamples > 0) {
+        base.min.reserve(size_t(totalSamples / base.samplesPerBucket + 1));
+        base.max.reserve(base.min.capacity());
+    }
+    m_levels.push_back(std::move(base));
+}
+
+void WaveformOverview::add(const float *const *planes, int channels, int frames)
+{
+    if (m_levels.empty() || channels <= 0) {
+        return;
+    }
+    const qint64 bucket = m_levels[0].samplesPerBucket;
+    int done = 0;
+    while (done < frames) {
+        // Up to the end of the open bucket at a time, one channel after the other
+        const int count = int(std::min<qint64>(frames - done, bucket - m_bucketFill));
+        if (m_bucketFill == 0) {
+            m_bucketMin = planes[0][done];
+            m_bucketMax = planes[0][done];
+        }
+        float low = m_bucketMin;
+        float high = m_bucketMax;
+        for (int ch = 0; ch < channels; ++ch) {
+            const float *samples = planes[ch] + done;
+            for (int i = 0; i < count; ++i) {
+                low = std::min(low, samples[i]);
+                high = std::max(high, samples[i]);
+            }
+        }
+        m_bucketMin = low;
+        m_bucketMax = high;
+        m_bucketFill += count;
+        done += count;
+        if (m_bucketFill == bucket) {
+            closeBucket();
+        }
+    }
+    m_totalSamples += frames;
+}
+
+void WaveformOverview::closeBucket()
+{
+    m_levels[0].min.push_back(quantizeMin(m_bucketMin));
+    m_levels[0].max.push_back(quantizeMax(m_bucketMax));
+    m_bucketFill = 0;
+}
+
+void WaveformOverview::finish()
+{
+    if (m_levels.empty()) {
+        return;
+    }
+    if (m_bucketFill > 0) {
+        closeBucket();
+    }
+    m_levels.resize(1);
+    while (m_levels.back().min.size() > size_t(MinBuckets)) {
+        const Level &below = m_levels.back();
+        Level level;
+        level.samplesPerBucket = below.samplesPerBucket * 2;
+        const size_t size = (below.min.size() + 1) / 2;
+        level.min.resize(size);
+        level.max.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            const size_t second = std::min(2 * i + 1, below.min.size() - 1);
+            level.min[i] = std::min(below.min[2 * i], below.min[second]);
+            level.max[i] = std::max(below.max[2 * i], below.max[second]);
+        }
+        m_levels.push_back(std::move(level));
+    }
+}
+
+void WaveformOverview::peaks(qint64 firstSample, qint64 endSample, int columns, qint8 *mins, qint8 *maxs) const
+{
+    if (columns <= 0) {
+        return;
+    }
+    std::fill(mins, mins + columns, qint8(0));
+    std::fill(maxs, maxs + columns, qint8(0));
+    if (isEmpty() || endSample <= firstSample) {
+        return;
+    }
+
+    // The coarsest level that still has a bucket per column
+    const qint64 span = endSample - firstSample;
+    size_t index = 0;
+    while (index + 1 < m_levels.size() && m_levels[index + 1].samplesPerBucket * columns <= span) {
+        ++index;
+    }
+    const Level &level = m_levels[index];
+    const qint64 buckets = qint64(level.min.size());
+
+    for (int column = 0; column < columns; ++column) {
+        const qint64 from = firstSample + span * column / columns;
+        const qint64 to = firstSample + span * (column + 1) / columns;
+        const qint64 first = std::max<qint64>(0, from / level.samplesPerBucket);
+        const qint64 last = std::min(buckets, std::max(first + 1, (to + level.samplesPerBucket - 1) / level.samplesPerBucket));
+        if (first >= last) {
+            continue;
+        }
+        mins[column] = *std::min_element(level.min.begin() + first, level.min.begin() + last);
+        maxs[column] = *std::max_element(level.max.begin() + first, level.max.begin() + last);
+    }
+}
+
+QByteArray WaveformOverview::serialize() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << Magic << Version << qint32(m_sampleRate) << m_totalSamples << qint32(m_levels.size());
+    for (const Level &level : m_levels) {
+        out << level.samplesPerBucket << quint32(level.min.size());
+        out.writeRawData(reinterpret_cast<const char *>(level.min.data()), int(level.min.size()));
+        out.writeRawData(reinterpret_cast<const char *>(level.max.data()), int(level.max.size()));
+    }
+    return data;
+}
+
+bool WaveformOverview::deserialize(const QByteArray &data, WaveformOverview *overview)
+{
+    QDataStream in(data);
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 sampleRate = 0;
+    qint64 totalSamples = 0;
+    qint32 levels = 0;
+    in >> magic >> version >> sampleRate >> totalSamples >> levels;
+    if (in.status() != QDataStream::Ok || magic != Magic || version != Version || sampleRate <= 0
+        || levels <= 0 || levels > MaxLevels) {
+        return false;
+    }
+
+    WaveformOverview result;
+    result.m_sampleRate = sampleRate;
+    result.m_totalSamples = totalSamples;
+    for (int i = 0; i < levels; ++i) {
+        Level level;
+        quint32 size = 0;
+        in >> level.samplesPerBucket >> size;
+        // Every level halves the one below, anything else is a damaged file
+        if (in.status() != QDataStream::Ok || level.samplesPerBucket <= 0 || size > quint32(data.size())
+            || (i > 0 && level.samplesPerBucket != result.m_levels.back().samplesPerBucket * 2)) {
+            return false;
+        }
+        level.min.resize(size);
+        level.max.resize(size);
+        if (in.readRawData(reinterpret_cast<char *>(level.min.data()), int(size)) != int(size)
+            || in.readRawData(reinterpret_cast<char *>(level.max.data()), int(size)) != int(size)) {
+            return false;
+        }
+        result.m_levels.push_back(std::move(level));
+    }
+    *overview = std::move(result);
+    return true;
+}
@@ -0,0 +1,63 @@
+#ifndef WAVEFORMOVERVIEW_H
+#define WAVEFORMOVERVIEW_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <vector>
+
+//peak overview of a track for the seek bar, a min/max pyramid over all channels. level 0 has
+//up to MaxBuckets buckets and every level above halves the one below, down to MinBuckets, so
+//any span of the track is drawn from the level closest to one bucket per pixel. peaks are kept
+//in 8 bits, full scale is 127:
+//
+//  WaveformOverview overview(sampleRate, totalSamples);
+//  overview.add(planes, channels, frames);      for every block of decoded audio
+//  overview.finish();
+//  overview.peaks(first, end, width, mins, maxs);
+class WaveformOverview
+{
+public:
+    static constexpr int MaxBuckets = 1 << 16;
+    static constexpr int MinBuckets = 256;
+
+    struct Level {
+        qint64 samplesPerBucket = 0;
+        std::vector<qint8> min;
+        std::vector<qint8> max;
+    };
+
+    WaveformOverview() = default;
+    //totalSamples per channel only sizes the buckets, an estimate is fine. when it's unknown
+    //(<= 0) level 0 gets a bucket per 10 ms
+    WaveformOverview(int sampleRate, qint64 totalSamples);
+
+    //planar float, full scale is 1
+    void add(const float *const *planes, int channels, int frames);
+    //closes the last bucket and builds the levels above level 0, once everything is added
+    void finish();
+
+    bool isEmpty() const { return m_levels.empty() || m_levels[0].min.empty(); }
+    int sampleRate() const { return m_sampleRate; }
+    qint64 totalSamples() const { return m_totalSamples; }     // what was added
+    int levelCount() const { return int(m_levels.size()); }
+    const Level &level(int index) const { return m_levels[size_t(index)]; }
+
+    //peaks of [firstSample, endSample) split into columns equal parts. parts past the end of
+    //the audio come out as 0, 0
+    void peaks(qint64 firstSample, qint64 endSample, int columns, qint8 *mins, qint8 *maxs) const;
+
+    QByteArray serialize() const;
+    static bool deserialize(const QByteArray &data, WaveformOverview *overview);
+
+private:
+    void closeBucket();
+
+    int m_sampleRate = 0;
+    qint64 m_totalSamples = 0;
+    qint64 m_bucketFill = 0;        // Samples in the bucket being filled
+    float m_bucketMin = 0.0f;
+    float m_bucketMax = 0.0f;
+    std::vector<Level> m_levels;
+};
+
+#endif // WAVEFORMOVERVIEW_H
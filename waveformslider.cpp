@@ -0,0 +1,90 @@
+#include "waveformslider.h"
+#include <QPainter>
+#include <QStyleOptionSlider>
+
+namespace {
+    const QColor PlayedColor(76, 175, 80, 200);         // The handle's #4CAF50
+    const QColor UpcomingColor(255, 255, 255, 110);
+}
+
+WaveformSlider::WaveformSlider(QWidget *parent)
+    : QSlider(parent)
+{
+}
+
+void WaveformSlider::setOverview(std::shared_ptr<const WaveformOverview> overview)
+{
+    m_overview = std::move(overview);
+    updatePeaks();
+    update();
+}
+
+void WaveformSlider::clearOverview()
+{
+    setOverview(nullptr);
+}
+
+void WaveformSlider::setOverviewSpan(qint64 startMs, qint64 durationMs)
+{
+    if (startMs == m_startMs && durationMs == m_durationMs) {
+        return;
+    }
+    m_startMs = startMs;
+    m_durationMs = durationMs;
+    updatePeaks();
+    update();
+}
+
+// Between the handle centre's two extremes, so a column lines up with the position it seeks to
+QRect WaveformSlider::waveformRect() const
+{
+    QStyleOptionSlider option;
+    initStyleOption(&option);
+    const QRect handle = style()->subControlRect(QStyle::CC_Slider, &option, QStyle::SC_SliderHandle, this);
+    const int inset = qMax(1, handle.width() / 2);
+    return rect().adjusted(inset, 4, -inset, -4);
+}
+
+void WaveformSlider::updatePeaks()
+{
+    m_mins.clear();
+    m_maxs.clear();
+    const QRect area = waveformRect();
+    if (!m_overview || m_overview->isEmpty() || area.width() <= 0) {
+        return;
+    }
+    const qint64 rate = m_overview->sampleRate();
+    const qint64 first = m_startMs * rate / 1000;
+    const qint64 end = m_durationMs > 0 ? first + m_durationMs * rate / 1000 : m_overview->totalSamples();
+    m_mins.resize(size_t(area.width()));
+    m_maxs.resize(size_t(area.width()));
+    m_overview->peaks(first, end, area.width(), m_mins.data(), m_maxs.data());
+}
+
+void WaveformSlider::paintEvent(QPaintEvent *event)
+{
+    if (!m_mins.empty()) {
+        const QRect area = waveformRect();
+        const qreal middle = area.center().y() + 0.5;
+        const qreal scale = area.height() / 254.0;
+        const int span = maximum() - minimum();
+        const int played = span > 0 ? int(qint64(value() - minimum()) * area.width() / span) : 0;
+
+        QPainter painter(this);
+        for (int x = 0; x < int(m_mins.size()); ++x) {
+            painter.setPen(x < played ? PlayedColor : UpcomingColor);
+            // At least a pixel high, silence shows as a line
+            const qreal top = middle - m_maxs[size_t(x)] * scale;
+            const qreal bottom = qMax(top + 1.0, middle - m_mins[size_t(x)] * scale);
+            painter.drawLine(QLineF(area.left() + x + 0.5, top, area.left() + x + 0.5, bottom));
+        }
+    }
+    // Groove and handle on top
+    QSlider::paintEvent(event);
+}
+
+void WaveformSlider::resizeEvent(QResizeEvent *event)
+{
+    QSlider::resizeEvent(event);
+    updatePeaks();
+}
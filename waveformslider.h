@@ -0,0 +1,40 @@
+#ifndef WAVEFORMSLIDER_H
+#define WAVEFORMSLIDER_H
+
+#include <QSlider>
+#include <memory>
+#include <vector>
+#include "waveformoverview.h"
+
+//seek slider with the track's waveform drawn behind the groove, the part already played in the
+//handle's colour. the overview covers the whole file, the span picks the (cue) track out of it.
+//without an overview it paints like a plain QSlider
+class WaveformSlider : public QSlider
+{
+    Q_OBJECT
+
+public:
+    explicit WaveformSlider(QWidget *parent = nullptr);
+
+    void setOverview(std::shared_ptr<const WaveformOverview> overview);
+    void clearOverview();
+    bool hasOverview() const { return m_overview != nullptr; }
+    //part of the file between the slider's minimum and maximum, durationMs 0 = to the end
+    void setOverviewSpan(qint64 startMs, qint64 durationMs);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    QRect waveformRect() const;
+    void updatePeaks();
+
+    std::shared_ptr<const WaveformOverview> m_overview;
+    qint64 m_startMs = 0;
+    qint64 m_durationMs = 0;
+    std::vector<qint8> m_mins;      // One per pixel column of waveformRect()
+    std::vector<qint8> m_maxs;
+};
+
+#endif // WAVEFORMSLIDER_H